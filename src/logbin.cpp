@@ -0,0 +1,473 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <map>
+#include <tuple>
+#include <chrono>
+#include "logbin.h"
+#include "logger.h"
+#include "logformat.h"
+#include "logutf8.h"
+
+namespace xs
+{
+    // 二进制日志记录头：调用点标识 + 时间戳 + 线程标识
+    static const size_t BIN_RECORD_HEADER_SIZE = sizeof(uint32_t) + sizeof(int64_t) + sizeof(uint32_t);
+
+    // 格式状态的默认值，与新建的流对象一致
+    static void ResetFormat(std::wios& Stream)
+    {
+        Stream.flags(std::ios_base::skipws | std::ios_base::dec);
+        Stream.width(0);
+        Stream.precision(6);
+        Stream.fill(L' ');
+    }
+
+    // 从缓存中读取一个数值，数据不足时返回false
+    template<class T>
+    static bool ReadValue(const char*& pData, const char* pEnd, T& val)
+    {
+        if ((size_t)(pEnd - pData) < sizeof(T))
+        {
+            return false;
+        }
+        memcpy(&val, pData, sizeof(T));
+        pData += sizeof(T);
+        return true;
+    }
+
+    CBinLogMsg::CBinLogMsg(CLogger& Logger, const SLogSite& Site)
+        : m_pLogger(&Logger), m_pSite(&Site)
+    {
+        // 记录头：调用点标识 + 时间戳 + 线程标识
+        int64_t nTimestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        uint32_t nThreadId = (uint32_t)::GetCurrentThreadId();
+        char* pData = Reserve(BIN_RECORD_HEADER_SIZE);
+        memcpy(pData, &Site.nId, sizeof(uint32_t));
+        memcpy(pData + sizeof(uint32_t), &nTimestamp, sizeof(int64_t));
+        memcpy(pData + sizeof(uint32_t) + sizeof(int64_t), &nThreadId, sizeof(uint32_t));
+    }
+
+    CBinLogMsg::CBinLogMsg(CBinLogMsg&& Other) noexcept
+        : m_pLogger(Other.m_pLogger), m_pSite(Other.m_pSite), m_pFormat(Other.m_pFormat),
+        m_pOverflow(Other.m_pOverflow), m_nSize(Other.m_nSize), m_bFlush(Other.m_bFlush)
+    {
+        memcpy(m_szInline, Other.m_szInline, m_nSize);
+        Other.m_pLogger = nullptr;
+        Other.m_pOverflow = nullptr;
+    }
+
+    CBinLogMsg::~CBinLogMsg()
+    {
+        if (m_pLogger)
+        {
+            if (m_pOverflow)
+            {
+                m_pLogger->PushBinLog(m_pSite->eLevel, m_pOverflow->data(), m_pOverflow->size(), m_bFlush, m_pSite->bCaptureOnly);
+            }
+            else
+            {
+                m_pLogger->PushBinLog(m_pSite->eLevel, m_szInline, m_nSize, m_bFlush, m_pSite->bCaptureOnly);
+            }
+        }
+
+        if (m_pOverflow)
+        {
+            delete m_pOverflow;
+            m_pOverflow = nullptr;
+        }
+    }
+
+    char* CBinLogMsg::Grow(size_t nBytes)
+    {
+        if (!m_pOverflow)
+        {
+            m_pOverflow = new std::string();
+            m_pOverflow->reserve(sizeof(m_szInline) * 2 + nBytes);
+            m_pOverflow->assign(m_szInline, m_nSize);
+        }
+        size_t nOffset = m_pOverflow->size();
+        m_pOverflow->resize(nOffset + nBytes);
+        return &(*m_pOverflow)[nOffset];
+    }
+
+    void CBinLogMsg::AppendFormat()
+    {
+        uint32_t nFlags = (uint32_t)m_pFormat->flags();
+        int64_t nWidth = (int64_t)m_pFormat->width();
+        int64_t nPrecision = (int64_t)m_pFormat->precision();
+        wchar_t chFill = m_pFormat->fill();
+
+        char* pData = Reserve(1 + sizeof(nFlags) + sizeof(nWidth) + sizeof(nPrecision) + sizeof(chFill));
+        *pData++ = (char)EBinArgType::ARG_FORMAT;
+        memcpy(pData, &nFlags, sizeof(nFlags));
+        pData += sizeof(nFlags);
+        memcpy(pData, &nWidth, sizeof(nWidth));
+        pData += sizeof(nWidth);
+        memcpy(pData, &nPrecision, sizeof(nPrecision));
+        pData += sizeof(nPrecision);
+        memcpy(pData, &chFill, sizeof(chFill));
+    }
+
+    void CBinLogMsg::ResetWidth()
+    {
+        m_pFormat->width(0);
+    }
+
+    // 每个线程一个格式状态对象(无缓冲区的流，仅用于执行流操作函数)
+    static std::wostream& GetThreadFormat()
+    {
+        static thread_local std::wostream Format(nullptr);
+        return Format;
+    }
+
+    CBinLogMsg& CBinLogMsg::operator<<(const SLogSuppressed& val)
+    {
+        if (val.nCount)
+        {
+            *this << "[suppressed " << val.nCount << "] ";
+        }
+        return *this;
+    }
+
+    CBinLogMsg& CBinLogMsg::operator<<(std::ostream& (__cdecl* Func)(std::ostream&))
+    {
+        // 窄字符流操作函数不作用于日志内容
+        return *this;
+    }
+
+    CBinLogMsg& CBinLogMsg::operator<<(std::ios& (__cdecl* Func)(std::ios&))
+    {
+        // 窄字符流操作函数不作用于日志内容
+        return *this;
+    }
+
+    CBinLogMsg& CBinLogMsg::operator<<(std::ios_base& (__cdecl* Func)(std::ios_base&))
+    {
+        if (!m_pFormat)
+        {
+            m_pFormat = &GetThreadFormat();
+            ResetFormat(*m_pFormat);
+        }
+        Func(*m_pFormat);
+        AppendFormat();
+        return *this;
+    }
+
+    CBinLogMsg& CBinLogMsg::operator<<(const std::_Smanip<std::streamsize>& _Manip)
+    {
+        if (!m_pFormat)
+        {
+            m_pFormat = &GetThreadFormat();
+            ResetFormat(*m_pFormat);
+        }
+        *m_pFormat << _Manip;
+        AppendFormat();
+        return *this;
+    }
+
+    CBinLogMsg& CBinLogMsg::operator<<(const std::_Fillobj<char>& _Manip)
+    {
+        return *this << std::_Fillobj<wchar_t>((int)_Manip._Fill);
+    }
+
+    CBinLogMsg& CBinLogMsg::operator<<(const std::_Fillobj<wchar_t>& _Manip)
+    {
+        if (!m_pFormat)
+        {
+            m_pFormat = &GetThreadFormat();
+            ResetFormat(*m_pFormat);
+        }
+        *m_pFormat << _Manip;
+        AppendFormat();
+        return *this;
+    }
+
+    uint32_t CBinLogMsg::SiteId(const char* pRecord, size_t nSize)
+    {
+        uint32_t nSiteId = 0;
+        if (nSize >= sizeof(nSiteId))
+        {
+            memcpy(&nSiteId, pRecord, sizeof(nSiteId));
+        }
+        return nSiteId;
+    }
+
+    // 输出浮点数，与CLogMsg一致：默认格式状态下输出可还原的最短表示
+    template<class TValue>
+    static void FormatFloat(std::wostream& OSStream, TValue val)
+    {
+        typedef TLogFormat<wchar_t> TFormat;
+        if (!TFormat::IsShortestFloat(OSStream))
+        {
+            OSStream << val;
+            return;
+        }
+        wchar_t szText[TFormat::MAX_FLOAT_LENGTH + 1];
+        size_t nLength = TFormat::FormatFloat(val, (OSStream.flags() & std::ios_base::uppercase) != 0, szText);
+        szText[nLength] = L'\0';
+        OSStream << szText;
+    }
+
+    bool CBinLogMsg::Format(const SLogSite& Site, const char* pRecord, size_t nSize, const SBinLogFormat& Format, std::string& szOutput)
+    {
+        const char* pData = pRecord;
+        const char* pEnd = pRecord + nSize;
+        uint32_t nSiteId = 0;
+        int64_t nTimestamp = 0;
+        uint32_t nThreadId = 0;
+        if (!ReadValue(pData, pEnd, nSiteId) || !ReadValue(pData, pEnd, nTimestamp) || !ReadValue(pData, pEnd, nThreadId))
+        {
+            return false;
+        }
+
+        // 格式化端的流对象每个线程复用一个
+        static thread_local std::wostringstream OSStream;
+        OSStream.str(std::wstring());
+        OSStream.clear();
+        ResetFormat(OSStream);
+
+        // 输出日志前缀: [LEVEL YYYY-MM-DD HH:MM:SS.ZZZ THREAD FILE:LINE] MESSAGE
+        wchar_t szTime[CLogTime::MAX_LENGTH];
+        size_t nTimeLength = CLogTime::Format(nTimestamp, Format.eTimePrecision, Format.bUtcTime, szTime);
+        OSStream << L"[";
+        if (Format.ppszLevelNames && Format.nLevelCount > 0)
+        {
+            unsigned int nLevel = (unsigned int)Site.eLevel;
+            OSStream << Format.ppszLevelNames[nLevel < Format.nLevelCount ? nLevel : Format.nLevelCount - 1];
+        }
+        else
+        {
+            OSStream << CLogger::LevelName(Site.eLevel, true).c_str();
+        }
+        OSStream << L" ";
+        OSStream.write(szTime, nTimeLength);
+        OSStream << L" "
+            << nThreadId << L" "
+            << Site.pszFile << L":" << Site.nLine << L"] ";
+        ResetFormat(OSStream);
+
+        // 依次还原每个参数
+        while (pData < pEnd)
+        {
+            EBinArgType eType = (EBinArgType)*pData++;
+            bool bOk = true;
+            switch (eType)
+            {
+#define XSLOG_BIN_FORMAT_VALUE(eArgType, TValue, Output) \
+            case eArgType: \
+            { \
+                TValue val; \
+                bOk = ReadValue(pData, pEnd, val); \
+                if (bOk) \
+                { \
+                    Output; \
+                } \
+                break; \
+            }
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_BOOL, bool, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_CHAR, char, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_UCHAR, unsigned char, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_SHORT, short, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_USHORT, unsigned short, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_INT, int, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_UINT, unsigned int, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_LONG, long, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_ULONG, unsigned long, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_LLONG, long long, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_ULLONG, unsigned long long, OSStream << val)
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_FLOAT, float, FormatFloat(OSStream, val))
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_DOUBLE, double, FormatFloat(OSStream, val))
+            XSLOG_BIN_FORMAT_VALUE(EBinArgType::ARG_LDOUBLE, long double, FormatFloat(OSStream, val))
+#undef XSLOG_BIN_FORMAT_VALUE
+            case EBinArgType::ARG_POINTER:
+            {
+                unsigned long long val = 0;
+                bOk = ReadValue(pData, pEnd, val);
+                if (bOk)
+                {
+                    OSStream << (const void*)(uintptr_t)val;
+                }
+                break;
+            }
+            case EBinArgType::ARG_STRING:
+            case EBinArgType::ARG_WSTRING:
+            {
+                uint32_t nLength = 0;
+                bOk = ReadValue(pData, pEnd, nLength) && (size_t)(pEnd - pData) >= nLength;
+                if (bOk)
+                {
+                    if (eType == EBinArgType::ARG_STRING)
+                    {
+                        // 与CLogMsg一致：纯ASCII或UTF-8的多字节字符串按UTF-8解码，其它按当前区域设置转码
+                        if (CLogUtf8::IsAscii(pData, nLength) || CLogUtf8::IsAnsiUtf8())
+                        {
+                            std::wstring szWide;
+                            CLogUtf8::ToWide(pData, nLength, szWide);
+                            OSStream << szWide;
+                        }
+                        else
+                        {
+                            OSStream << CLogMsg::ToWString(std::string(pData, nLength));
+                        }
+                    }
+                    else
+                    {
+                        OSStream << std::wstring((const wchar_t*)pData, nLength / sizeof(wchar_t));
+                    }
+                    pData += nLength;
+                }
+                break;
+            }
+            case EBinArgType::ARG_FORMAT:
+            {
+                uint32_t nFlags = 0;
+                int64_t nWidth = 0;
+                int64_t nPrecision = 0;
+                wchar_t chFill = L' ';
+                bOk = ReadValue(pData, pEnd, nFlags) && ReadValue(pData, pEnd, nWidth)
+                    && ReadValue(pData, pEnd, nPrecision) && ReadValue(pData, pEnd, chFill);
+                if (bOk)
+                {
+                    OSStream.flags((std::ios_base::fmtflags)nFlags);
+                    OSStream.width((std::streamsize)nWidth);
+                    OSStream.precision((std::streamsize)nPrecision);
+                    OSStream.fill(chFill);
+                }
+                break;
+            }
+            default:
+                bOk = false;
+                break;
+            }
+
+            if (!bOk)
+            {
+                // 数据损坏，输出已还原的部分
+                OSStream << L"<corrupted>";
+                break;
+            }
+        }
+
+        // 格式化结果转为UTF-8
+        const std::wstring& szText = OSStream.str();
+        CLogUtf8::FromWide(szText.data(), szText.length(), szOutput);
+        return true;
+    }
+
+    // 离线解码时的调用点定义与文本格式
+    struct CLogBinDecoder::SSiteData
+    {
+        std::map<uint32_t, std::wstring> mapFiles;  // 调用点标识 -> 文件名(SLogSite中只保存指针)
+        std::map<uint32_t, SLogSite> mapSites;      // 调用点标识 -> 调用点信息
+        SBinLogFormat Format;                       // 文本日志前缀的格式
+    };
+
+    CLogBinDecoder::CLogBinDecoder(const SBinLogFormat& Format)
+    {
+        m_pSiteData = new SSiteData();
+        m_pSiteData->Format = Format;
+    }
+
+    CLogBinDecoder::~CLogBinDecoder()
+    {
+        if (m_pSiteData)
+        {
+            delete m_pSiteData;
+            m_pSiteData = nullptr;
+        }
+    }
+
+    size_t CLogBinDecoder::Decode(const char* pData, size_t nSize, const TOutputFunc& fnOutput)
+    {
+        const char* pBegin = pData;
+        const char* pEnd = pData + nSize;
+
+        if (!m_bHeaderChecked)
+        {
+            uint32_t nVersion = 0;
+            if (nSize < sizeof(XSLOG_BIN_MAGIC) + sizeof(nVersion))
+            {
+                return 0;
+            }
+            memcpy(&nVersion, pData + sizeof(XSLOG_BIN_MAGIC), sizeof(nVersion));
+            if (0 != memcmp(pData, XSLOG_BIN_MAGIC, sizeof(XSLOG_BIN_MAGIC)) || nVersion == 0 || nVersion > XSLOG_BIN_VERSION)
+            {
+                return DECODE_ERROR;
+            }
+            m_nVersion = nVersion;
+            pData += sizeof(XSLOG_BIN_MAGIC) + sizeof(nVersion);
+            m_bHeaderChecked = true;
+        }
+
+        std::string szLog;
+        while (pData < pEnd)
+        {
+            // 每次解析一个完整条目，数据不足时回退到条目起始位置
+            const char* pEntry = pData;
+            char chType = *pData++;
+            if (chType == XSLOG_BIN_ENTRY_SITE)
+            {
+                uint32_t nSiteId = 0;
+                unsigned char nLevel = 0;
+                uint32_t nLine = 0;
+                uint16_t nNameLength = 0;
+                if (!ReadValue(pData, pEnd, nSiteId) || !ReadValue(pData, pEnd, nLevel) || !ReadValue(pData, pEnd, nLine)
+                    || !ReadValue(pData, pEnd, nNameLength) || (size_t)(pEnd - pData) < nNameLength * sizeof(wchar_t))
+                {
+                    return pEntry - pBegin;
+                }
+                std::wstring& szFile = m_pSiteData->mapFiles[nSiteId];
+                szFile.assign((const wchar_t*)pData, nNameLength);
+                pData += nNameLength * sizeof(wchar_t);
+                m_pSiteData->mapSites.erase(nSiteId);
+                m_pSiteData->mapSites.emplace(std::piecewise_construct, std::forward_as_tuple(nSiteId),
+                    std::forward_as_tuple(nSiteId, (ELogLevel)nLevel, szFile.c_str(), nLine));
+            }
+            else if (chType == XSLOG_BIN_ENTRY_RECORD || chType == XSLOG_BIN_ENTRY_TEXT)
+            {
+                uint32_t nLength = 0;
+                if (!ReadValue(pData, pEnd, nLength))
+                {
+                    return pEntry - pBegin;
+                }
+                // 版本1的文本日志为宽字符，长度为字符数
+                bool bWideText = (chType == XSLOG_BIN_ENTRY_TEXT && m_nVersion == 1);
+                size_t nBytes = bWideText ? nLength * sizeof(wchar_t) : nLength;
+                if ((size_t)(pEnd - pData) < nBytes)
+                {
+                    return pEntry - pBegin;
+                }
+
+                if (chType == XSLOG_BIN_ENTRY_TEXT)
+                {
+                    if (bWideText)
+                    {
+                        CLogUtf8::FromWide((const wchar_t*)pData, nLength, szLog);
+                    }
+                    else
+                    {
+                        szLog.assign(pData, nLength);
+                    }
+                    fnOutput(szLog);
+                }
+                else
+                {
+                    auto iter = m_pSiteData->mapSites.find(CBinLogMsg::SiteId(pData, nLength));
+                    if (iter != m_pSiteData->mapSites.end() && CBinLogMsg::Format(iter->second, pData, nLength, m_pSiteData->Format, szLog))
+                    {
+                        szLog += '\n';
+                        fnOutput(szLog);
+                    }
+                }
+                pData += nBytes;
+            }
+            else
+            {
+                // 未知条目类型，无法继续解析
+                return DECODE_ERROR;
+            }
+        }
+        return pData - pBegin;
+    }
+}
@@ -0,0 +1,227 @@
+﻿#pragma once
+#include <cstring>
+#include <cwchar>
+#include <cstdint>
+#include <string>
+#include <functional>
+#include <iomanip>
+#include "logsite.h"
+#include "logtime.h"
+
+#ifdef XSLOG_LIB
+#define XSLOG_API
+#else
+#ifdef XSLOG_EXPORTS
+#define XSLOG_API __declspec(dllexport)
+#else
+#define XSLOG_API __declspec(dllimport)
+#endif /* XSLOG_EXPORTS */
+#endif /* XSLOG_LIB */
+
+namespace xs
+{
+    class CLogger;
+    struct SLogEndl;
+    struct SLogSuppressed;
+
+    ////////////////////////////////////////////////////////////////////////
+    // 二进制日志记录格式化为文本时的前缀格式
+    // - 由调用方指定，格式化时不访问日志对象，离线解码工具无需创建日志对象及其后台线程
+    ////////////////////////////////////////////////////////////////////////
+    struct SBinLogFormat
+    {
+        const char* const* ppszLevelNames = nullptr;    // 按等级值排列的等级名称，为空时使用CLogger::LevelName的简称
+        unsigned int nLevelCount = 0;                   // 等级名称个数，超出范围的等级使用最后一个名称
+        ETimePrecision eTimePrecision = ETimePrecision::PRECISION_MILLI;   // 时间戳精度
+        bool bUtcTime = false;                          // 时间戳是否使用UTC时间
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+    // 二进制日志记录格式(延迟格式化模式)
+    // - 记录头：调用点标识(u32) + 时间戳(i64，纳秒) + 线程标识(u32)
+    // - 参数区：每个参数为 类型(u8) + 原始数据，字符串为 类型(u8) + 长度(u32) + 字符数据
+    // - 数值按本机字节序与类型宽度保存，解码端须与写入端为同一平台
+    ////////////////////////////////////////////////////////////////////////
+    enum class EBinArgType : unsigned char
+    {
+        ARG_BOOL = 1,
+        ARG_CHAR,
+        ARG_UCHAR,
+        ARG_SHORT,
+        ARG_USHORT,
+        ARG_INT,
+        ARG_UINT,
+        ARG_LONG,
+        ARG_ULONG,
+        ARG_LLONG,
+        ARG_ULLONG,
+        ARG_FLOAT,
+        ARG_DOUBLE,
+        ARG_LDOUBLE,
+        ARG_POINTER,
+        ARG_STRING,     // 多字节字符串
+        ARG_WSTRING,    // 宽字符串
+        ARG_FORMAT,     // 格式状态：flags(u32) + width(i64) + precision(i64) + fill(wchar_t)
+    };
+
+    // 二进制日志流(文件)格式：文件头 + 若干条目，每个条目以类型字节开始
+    // - 'S' 调用点定义：标识(u32) + 等级(u8) + 行号(u32) + 文件名长度(u16) + 文件名(wchar_t)
+    // - 'R' 日志记录：长度(u32) + 二进制日志记录
+    // - 'T' 文本日志：长度(u32，字节数) + 已格式化的日志文本(UTF-8)，版本1为长度(u32，字符数) + 日志文本(wchar_t)
+    static const char XSLOG_BIN_MAGIC[4] = { 'X', 'S', 'L', 'B' };
+    static const uint32_t XSLOG_BIN_VERSION = 2;
+    static const char XSLOG_BIN_ENTRY_SITE = 'S';
+    static const char XSLOG_BIN_ENTRY_RECORD = 'R';
+    static const char XSLOG_BIN_ENTRY_TEXT = 'T';
+
+    ////////////////////////////////////////////////////////////////////////
+    // 二进制日志消息(延迟格式化模式)
+    // - 调用线程只记录调用点标识与参数的原始数据，文本格式化由写线程或离线解码工具完成
+    // - 参数小于内置缓存时不会分配内存
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CBinLogMsg
+    {
+    public:
+        CBinLogMsg(CLogger& Logger, const SLogSite& Site);
+        CBinLogMsg(const CBinLogMsg& Other) = delete;
+        CBinLogMsg(CBinLogMsg&& Other) noexcept;
+        ~CBinLogMsg();
+
+        CBinLogMsg& operator=(const CBinLogMsg& Other) = delete;
+        CBinLogMsg& operator=(CBinLogMsg&& Other) = delete;
+
+        // 支持输出基础数据结构
+        CBinLogMsg& operator<<(bool val) { return Append(EBinArgType::ARG_BOOL, val); }
+        CBinLogMsg& operator<<(char val) { return Append(EBinArgType::ARG_CHAR, val); }
+        CBinLogMsg& operator<<(unsigned char val) { return Append(EBinArgType::ARG_UCHAR, val); }
+        CBinLogMsg& operator<<(short val) { return Append(EBinArgType::ARG_SHORT, val); }
+        CBinLogMsg& operator<<(unsigned short val) { return Append(EBinArgType::ARG_USHORT, val); }
+        CBinLogMsg& operator<<(int val) { return Append(EBinArgType::ARG_INT, val); }
+        CBinLogMsg& operator<<(unsigned int val) { return Append(EBinArgType::ARG_UINT, val); }
+        CBinLogMsg& operator<<(long val) { return Append(EBinArgType::ARG_LONG, val); }
+        CBinLogMsg& operator<<(unsigned long val) { return Append(EBinArgType::ARG_ULONG, val); }
+        CBinLogMsg& operator<<(long long val) { return Append(EBinArgType::ARG_LLONG, val); }
+        CBinLogMsg& operator<<(unsigned long long val) { return Append(EBinArgType::ARG_ULLONG, val); }
+        CBinLogMsg& operator<<(float val) { return Append(EBinArgType::ARG_FLOAT, val); }
+        CBinLogMsg& operator<<(double val) { return Append(EBinArgType::ARG_DOUBLE, val); }
+        CBinLogMsg& operator<<(long double val) { return Append(EBinArgType::ARG_LDOUBLE, val); }
+        CBinLogMsg& operator<<(void* val) { return Append(EBinArgType::ARG_POINTER, (unsigned long long)(uintptr_t)val); }
+        CBinLogMsg& operator<<(const void* val) { return Append(EBinArgType::ARG_POINTER, (unsigned long long)(uintptr_t)val); }
+
+        // 支持输出多字节字符串
+        CBinLogMsg& operator<<(char* val) { return AppendString(EBinArgType::ARG_STRING, val, strlen(val) * sizeof(char)); }
+        CBinLogMsg& operator<<(const char* val) { return AppendString(EBinArgType::ARG_STRING, val, strlen(val) * sizeof(char)); }
+        CBinLogMsg& operator<<(const std::string& val) { return AppendString(EBinArgType::ARG_STRING, val.data(), val.length() * sizeof(char)); }
+
+        // 支持输出宽字符串
+        CBinLogMsg& operator<<(wchar_t* val) { return AppendString(EBinArgType::ARG_WSTRING, val, wcslen(val) * sizeof(wchar_t)); }
+        CBinLogMsg& operator<<(const wchar_t* val) { return AppendString(EBinArgType::ARG_WSTRING, val, wcslen(val) * sizeof(wchar_t)); }
+        CBinLogMsg& operator<<(const std::wstring& val) { return AppendString(EBinArgType::ARG_WSTRING, val.data(), val.length() * sizeof(wchar_t)); }
+
+        // 支持输出刷新缓存的操作符
+        CBinLogMsg& operator<<(const SLogEndl&)
+        {
+            m_bFlush = true;
+            return *this;
+        }
+
+        // 支持输出被抑制的日志条数
+        CBinLogMsg& operator<<(const SLogSuppressed& val);
+
+        // 支持流操作函数(记录操作后的格式状态，由格式化端还原)
+        CBinLogMsg& operator<<(std::ostream& (__cdecl* Func)(std::ostream&));
+        CBinLogMsg& operator<<(std::ios& (__cdecl* Func)(std::ios&));
+        CBinLogMsg& operator<<(std::ios_base& (__cdecl* Func)(std::ios_base&));
+        CBinLogMsg& operator<<(const std::_Smanip<std::streamsize>& _Manip);
+        CBinLogMsg& operator<<(const std::_Fillobj<char>& _Manip);
+        CBinLogMsg& operator<<(const std::_Fillobj<wchar_t>& _Manip);
+
+    public:
+        // 将一条二进制日志记录格式化为文本日志：[LEVEL YYYY-MM-DD HH:MM:SS.ZZZ THREAD FILE:LINE] MESSAGE
+        static bool Format(const SLogSite& Site, const char* pRecord, size_t nSize, const SBinLogFormat& Format, std::string& szOutput);
+
+        // 读取二进制日志记录中的调用点标识
+        static uint32_t SiteId(const char* pRecord, size_t nSize);
+
+    private:
+        template<class T>
+        CBinLogMsg& Append(EBinArgType eType, const T& val)
+        {
+            char* pData = Reserve(1 + sizeof(T));
+            *pData = (char)eType;
+            memcpy(pData + 1, &val, sizeof(T));
+            if (m_pFormat)
+            {
+                // 与流保持一致：宽度设置只对下一个输出有效
+                ResetWidth();
+            }
+            return *this;
+        }
+
+        CBinLogMsg& AppendString(EBinArgType eType, const void* pVal, size_t nBytes)
+        {
+            uint32_t nLength = (uint32_t)nBytes;
+            char* pData = Reserve(1 + sizeof(nLength) + nBytes);
+            *pData = (char)eType;
+            memcpy(pData + 1, &nLength, sizeof(nLength));
+            memcpy(pData + 1 + sizeof(nLength), pVal, nBytes);
+            if (m_pFormat)
+            {
+                ResetWidth();
+            }
+            return *this;
+        }
+
+        char* Reserve(size_t nBytes)
+        {
+            if (!m_pOverflow && m_nSize + nBytes <= sizeof(m_szInline))
+            {
+                char* pData = m_szInline + m_nSize;
+                m_nSize += nBytes;
+                return pData;
+            }
+            return Grow(nBytes);
+        }
+
+        // 内置缓存不足时转存到堆内存
+        char* Grow(size_t nBytes);
+        // 记录当前格式状态
+        void AppendFormat();
+        void ResetWidth();
+
+    private:
+        CLogger* m_pLogger = nullptr;       // 日志对象(为空表示已被移走)
+        const SLogSite* m_pSite = nullptr;  // 调用点信息
+        std::wostream* m_pFormat = nullptr; // 格式状态(仅在使用流操作函数时才会获取)
+        std::string* m_pOverflow = nullptr; // 超出内置缓存时使用的堆内存
+        size_t m_nSize = 0;                 // 内置缓存中已使用的字节数
+        bool m_bFlush = false;
+        char m_szInline[256];               // 内置缓存
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+    // 二进制日志流解码器(用于离线解码工具)
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CLogBinDecoder
+    {
+    public:
+        typedef std::function<void(const std::string& szLog)> TOutputFunc;
+
+        // Decode的返回值：文件头不正确或遇到未知的条目类型，数据无法继续解码
+        static const size_t DECODE_ERROR = (size_t)-1;
+
+        // 文本日志前缀按Format格式化(等级名称数组须在解码器的生命期内有效)
+        explicit CLogBinDecoder(const SBinLogFormat& Format = SBinLogFormat());
+        ~CLogBinDecoder();
+
+        // 解码一段二进制日志流，每解码出一条文本日志(UTF-8编码)调用一次回调
+        // 返回已消费的字节数，末尾不完整的条目需要与后续数据拼接后再次解码，出错时返回DECODE_ERROR
+        size_t Decode(const char* pData, size_t nSize, const TOutputFunc& fnOutput);
+
+    private:
+        struct SSiteData;
+        SSiteData* m_pSiteData = nullptr;   // 已解析的调用点定义与文本格式
+        bool m_bHeaderChecked = false;      // 是否已校验文件头
+        uint32_t m_nVersion = 0;            // 文件格式版本
+    };
+}
@@ -0,0 +1,132 @@
+﻿#pragma once
+#include <streambuf>
+#include <cstring>
+#include <cstddef>
+
+namespace xs
+{
+    ////////////////////////////////////////////////////////////////////////
+    // 日志消息缓存(流缓冲区)
+    // - 内置N个字符的缓存，只有超长日志才会分配堆内存
+    // - Clear()只重置写入位置，已分配的堆内存留给下一条日志复用(超过上限时释放)
+    // - 作为std::basic_ostream的缓冲区使用时，支持所有标准的流输出与格式化操作
+    ////////////////////////////////////////////////////////////////////////
+    template<class CharT, size_t N>
+    class TLogStreamBuf : public std::basic_streambuf<CharT>
+    {
+    public:
+        typedef typename std::basic_streambuf<CharT>::int_type int_type;
+        typedef typename std::basic_streambuf<CharT>::traits_type traits_type;
+
+        TLogStreamBuf()
+        {
+            this->setp(m_szInline, m_szInline + N);
+        }
+
+        virtual ~TLogStreamBuf()
+        {
+            if (m_pHeap)
+            {
+                delete[] m_pHeap;
+                m_pHeap = nullptr;
+            }
+        }
+
+        TLogStreamBuf(const TLogStreamBuf&) = delete;
+        TLogStreamBuf& operator=(const TLogStreamBuf&) = delete;
+
+        const CharT* Data() const { return this->pbase(); }
+        size_t Size() const { return (size_t)(this->pptr() - this->pbase()); }
+
+        // 清空缓存内容
+        void Clear()
+        {
+            if (m_pHeap && (size_t)(this->epptr() - this->pbase()) > MAX_KEEP_SIZE)
+            {
+                // 超长日志占用的堆内存不再保留
+                delete[] m_pHeap;
+                m_pHeap = nullptr;
+                this->setp(m_szInline, m_szInline + N);
+                return;
+            }
+            this->setp(this->pbase(), this->epptr());
+        }
+
+        // 直接追加字符(不经过流对象)
+        void Append(const CharT* pData, size_t nCount)
+        {
+            CharT* pDst = Reserve(nCount);
+            memcpy(pDst, pData, nCount * sizeof(CharT));
+            Commit(nCount);
+        }
+
+        void Append(CharT ch)
+        {
+            if (this->pptr() == this->epptr())
+            {
+                Grow(1);
+            }
+            *this->pptr() = ch;
+            this->pbump(1);
+        }
+
+        // 预留至少nCount个字符的可写空间，返回写入位置，写入后调用Commit提交实际写入的字符数
+        CharT* Reserve(size_t nCount)
+        {
+            if ((size_t)(this->epptr() - this->pptr()) < nCount)
+            {
+                Grow(nCount);
+            }
+            return this->pptr();
+        }
+
+        void Commit(size_t nCount)
+        {
+            this->pbump((int)nCount);
+        }
+
+    protected:
+        int_type overflow(int_type ch) override
+        {
+            if (traits_type::eq_int_type(ch, traits_type::eof()))
+            {
+                return traits_type::not_eof(ch);
+            }
+            Append(traits_type::to_char_type(ch));
+            return ch;
+        }
+
+        std::streamsize xsputn(const CharT* pData, std::streamsize nCount) override
+        {
+            Append(pData, (size_t)nCount);
+            return nCount;
+        }
+
+    private:
+        void Grow(size_t nCount)
+        {
+            size_t nSize = Size();
+            size_t nCapacity = (size_t)(this->epptr() - this->pbase()) * 2;
+            if (nCapacity < nSize + nCount)
+            {
+                nCapacity = nSize + nCount;
+            }
+
+            CharT* pNew = new CharT[nCapacity];
+            memcpy(pNew, this->pbase(), nSize * sizeof(CharT));
+            if (m_pHeap)
+            {
+                delete[] m_pHeap;
+            }
+            m_pHeap = pNew;
+            this->setp(pNew, pNew + nCapacity);
+            this->pbump((int)nSize);
+        }
+
+    private:
+        static const size_t MAX_KEEP_SIZE = 64 * 1024;  // 保留复用的堆内存上限(字符数)
+
+        CharT m_szInline[N];        // 内置缓存
+        CharT* m_pHeap = nullptr;   // 超长日志使用的堆内存
+    };
+}
@@ -0,0 +1,261 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <iostream>
+#include <cstring>
+#include "logfile.h"
+
+namespace xs
+{
+    CLogFileWriter::CLogFileWriter(bool bDirect, size_t nBufferSize, size_t nBufferCount)
+        : m_bDirect(bDirect)
+    {
+        // 缓存大小按扇区对齐，至少两块缓存才能在写入的同时继续填充
+        if (nBufferSize < SECTOR_SIZE)
+        {
+            nBufferSize = SECTOR_SIZE;
+        }
+        m_nBufferSize = (nBufferSize + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+        m_nBufferCount = nBufferCount < 2 ? 2 : nBufferCount;
+
+        // VirtualAlloc分配的内存按页对齐，满足直接写入的要求
+        m_pBuffers = new SBuffer[m_nBufferCount];
+        for (size_t i = 0; i < m_nBufferCount; i++)
+        {
+            m_pBuffers[i].pData = (char*)::VirtualAlloc(NULL, m_nBufferSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        }
+    }
+
+    CLogFileWriter::~CLogFileWriter()
+    {
+        Close();
+
+        if (m_pBuffers)
+        {
+            for (size_t i = 0; i < m_nBufferCount; i++)
+            {
+                if (m_pBuffers[i].pData)
+                {
+                    ::VirtualFree(m_pBuffers[i].pData, 0, MEM_RELEASE);
+                }
+            }
+            delete[] m_pBuffers;
+            m_pBuffers = nullptr;
+        }
+    }
+
+    bool CLogFileWriter::Open(const std::string& szFileName, bool bAppend)
+    {
+        Close();
+        for (size_t i = 0; i < m_nBufferCount; i++)
+        {
+            if (!m_pBuffers[i].pData)
+            {
+                return false;
+            }
+        }
+
+        DWORD nFlags = FILE_ATTRIBUTE_NORMAL | (m_bDirect ? FILE_FLAG_NO_BUFFERING : 0);
+        HANDLE hFile = ::CreateFileA(szFileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+            bAppend ? OPEN_ALWAYS : CREATE_ALWAYS, nFlags, NULL);
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            std::cout << "open '" << szFileName << "' error: " << ::GetLastError() << std::endl;
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> LockGuard(m_fileLocker);
+            m_hFile = hFile;
+        }
+
+        LARGE_INTEGER nSize = { 0 };
+        ::GetFileSizeEx(hFile, &nSize);
+        m_nFileSize = (unsigned long long)nSize.QuadPart;
+
+        SBuffer& Buffer = m_pBuffers[0];
+        Buffer.nOffset = m_nFileSize;
+        Buffer.nLength = 0;
+        if (m_bDirect && m_nFileSize % SECTOR_SIZE != 0)
+        {
+            // 直接写入只能从扇区边界开始，先读出末尾不完整的扇区
+            Buffer.nOffset = m_nFileSize / SECTOR_SIZE * SECTOR_SIZE;
+            OVERLAPPED Overlapped = { 0 };
+            Overlapped.Offset = (DWORD)Buffer.nOffset;
+            Overlapped.OffsetHigh = (DWORD)(Buffer.nOffset >> 32);
+            DWORD nRead = 0;
+            ::ReadFile(hFile, Buffer.pData, SECTOR_SIZE, &nRead, &Overlapped);
+            Buffer.nLength = (size_t)(m_nFileSize - Buffer.nOffset);
+        }
+        m_nCarry = Buffer.nLength;
+
+        m_nCurrent = 0;
+        m_nNextWrite = 0;
+        m_bStop = false;
+        m_ioThread = std::thread(&CLogFileWriter::IoThread, this);
+        return true;
+    }
+
+    void CLogFileWriter::Close(bool bSync)
+    {
+        if (!m_hFile)
+        {
+            return;
+        }
+
+        Submit();
+        Wait();
+        {
+            std::lock_guard<std::mutex> LockGuard(m_locker);
+            m_bStop = true;
+        }
+        m_cvSubmit.notify_all();
+        if (m_ioThread.joinable())
+        {
+            m_ioThread.join();
+        }
+
+        if (m_bDirect)
+        {
+            // 截断末尾扇区补齐的部分
+            FILE_END_OF_FILE_INFO EndOfFile;
+            EndOfFile.EndOfFile.QuadPart = (LONGLONG)m_nFileSize;
+            ::SetFileInformationByHandle(m_hFile, FileEndOfFileInfo, &EndOfFile, sizeof(EndOfFile));
+        }
+
+        std::lock_guard<std::mutex> LockGuard(m_fileLocker);
+        if (bSync)
+        {
+            ::FlushFileBuffers(m_hFile);
+        }
+        ::CloseHandle(m_hFile);
+        m_hFile = nullptr;
+        m_nFileSize = 0;
+    }
+
+    void CLogFileWriter::Write(const char* pData, size_t nLength)
+    {
+        while (nLength > 0)
+        {
+            SBuffer& Buffer = m_pBuffers[m_nCurrent];
+            size_t nCopy = m_nBufferSize - Buffer.nLength;
+            if (nCopy > nLength)
+            {
+                nCopy = nLength;
+            }
+            memcpy(Buffer.pData + Buffer.nLength, pData, nCopy);
+            Buffer.nLength += nCopy;
+            m_nFileSize += nCopy;
+            pData += nCopy;
+            nLength -= nCopy;
+
+            if (Buffer.nLength == m_nBufferSize)
+            {
+                Submit();
+            }
+        }
+    }
+
+    void CLogFileWriter::Flush()
+    {
+        Submit();
+    }
+
+    void CLogFileWriter::Wait()
+    {
+        std::unique_lock<std::mutex> Lock(m_locker);
+        m_cvComplete.wait(Lock, [this] {
+            for (size_t i = 0; i < m_nBufferCount; i++)
+            {
+                if (m_pBuffers[i].bPending)
+                {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    void CLogFileWriter::Sync()
+    {
+        {
+            // 只等待调用时已提交的缓存，不受之后持续写入的影响
+            std::unique_lock<std::mutex> Lock(m_locker);
+            unsigned long long nTarget = m_nSubmitCount;
+            m_cvComplete.wait(Lock, [this, nTarget] { return m_nCompleteCount >= nTarget; });
+        }
+
+        std::lock_guard<std::mutex> LockGuard(m_fileLocker);
+        if (m_hFile)
+        {
+            ::FlushFileBuffers(m_hFile);
+        }
+    }
+
+    void CLogFileWriter::Submit()
+    {
+        // 没有新数据(只有继承来的、已写入过的末尾扇区)时无需提交
+        SBuffer& Current = m_pBuffers[m_nCurrent];
+        if (Current.nLength == m_nCarry)
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> Lock(m_locker);
+        Current.bPending = true;
+        m_nSubmitCount++;
+        m_cvSubmit.notify_one();
+
+        // 切换到下一块缓存，该缓存仍未写完时等待(所有缓存都已提交)
+        size_t nNext = (m_nCurrent + 1) % m_nBufferCount;
+        SBuffer& Next = m_pBuffers[nNext];
+        m_cvComplete.wait(Lock, [&Next] { return !Next.bPending; });
+        Lock.unlock();
+
+        // 直接写入时末尾不完整的扇区复制到下一块缓存，下次提交时重写该扇区
+        size_t nTail = m_bDirect ? Current.nLength % SECTOR_SIZE : 0;
+        Next.nOffset = Current.nOffset + Current.nLength - nTail;
+        Next.nLength = nTail;
+        if (nTail > 0)
+        {
+            memcpy(Next.pData, Current.pData + Current.nLength - nTail, nTail);
+        }
+        m_nCarry = nTail;
+        m_nCurrent = nNext;
+    }
+
+    void CLogFileWriter::IoThread()
+    {
+        std::unique_lock<std::mutex> Lock(m_locker);
+        while (true)
+        {
+            SBuffer& Buffer = m_pBuffers[m_nNextWrite];
+            m_cvSubmit.wait(Lock, [this, &Buffer] { return m_bStop || Buffer.bPending; });
+            if (!Buffer.bPending)
+            {
+                break;
+            }
+            Lock.unlock();
+
+            // 直接写入的长度必须按扇区对齐，补齐部分填0
+            size_t nWrite = Buffer.nLength;
+            if (m_bDirect)
+            {
+                nWrite = (nWrite + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+                memset(Buffer.pData + Buffer.nLength, 0, nWrite - Buffer.nLength);
+            }
+            OVERLAPPED Overlapped = { 0 };
+            Overlapped.Offset = (DWORD)Buffer.nOffset;
+            Overlapped.OffsetHigh = (DWORD)(Buffer.nOffset >> 32);
+            DWORD nWritten = 0;
+            if (!::WriteFile((HANDLE)m_hFile, Buffer.pData, (DWORD)nWrite, &nWritten, &Overlapped))
+            {
+                std::cout << "write log file error: " << ::GetLastError() << std::endl;
+            }
+
+            Lock.lock();
+            Buffer.bPending = false;
+            m_nCompleteCount++;
+            m_nNextWrite = (m_nNextWrite + 1) % m_nBufferCount;
+            m_cvComplete.notify_all();
+        }
+    }
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+namespace xs
+{
+    ////////////////////////////////////////////////////////////////////////
+    // 日志文件异步写入器(文件输出的异步写入后端)
+    // - 调用线程只把数据复制到当前缓存，写满后提交给该文件独占的IO线程，立即切换到下一块缓存继续写入
+    // - 多块缓存同时处于提交状态，只有全部缓存都未写完时调用线程才会等待
+    // - IO线程按提交时记录的文件偏移写入(定位写，相当于pwrite)，不依赖文件指针
+    // - 直接写入模式使用FILE_FLAG_NO_BUFFERING绕过系统文件缓存，缓存按页对齐，写入长度按扇区对齐：
+    //      未写满的末尾扇区在下次提交时重写，关闭文件时截断到实际长度
+    ////////////////////////////////////////////////////////////////////////
+    class CLogFileWriter
+    {
+    public:
+        // 直接写入的对齐大小(覆盖512字节与4K扇区)
+        static const size_t SECTOR_SIZE = 4096;
+
+        CLogFileWriter(bool bDirect, size_t nBufferSize, size_t nBufferCount);
+        ~CLogFileWriter();
+
+        CLogFileWriter(const CLogFileWriter&) = delete;
+        CLogFileWriter& operator=(const CLogFileWriter&) = delete;
+
+        // 打开文件，追加模式下从文件末尾开始写入
+        bool Open(const std::string& szFileName, bool bAppend);
+        // 提交剩余数据，等待全部写完后关闭文件，bSync为true时关闭前持久化到磁盘
+        void Close(bool bSync = false);
+        bool IsOpen() const { return m_hFile != nullptr; }
+
+        // 写入数据(复制到缓存，缓存写满时提交)
+        void Write(const char* pData, size_t nLength);
+        // 提交当前缓存中的数据，不等待写完
+        void Flush();
+        // 等待已提交的数据全部写完
+        void Wait();
+        // 等待调用时已提交的数据写完，并持久化到磁盘(FlushFileBuffers)
+        // 可在其它线程写入的同时调用
+        void Sync();
+
+        // 文件的实际长度(包括尚未提交的数据)
+        unsigned long long Size() const { return m_nFileSize; }
+
+    private:
+        struct SBuffer
+        {
+            char* pData = nullptr;              // 缓存(按页对齐)
+            size_t nLength = 0;                 // 数据长度
+            unsigned long long nOffset = 0;     // 写入的文件偏移
+            bool bPending = false;              // 是否已提交但未写完
+        };
+
+        // 提交当前缓存并切换到下一块缓存(下一块缓存仍未写完时等待)
+        void Submit();
+        // IO线程入口函数
+        void IoThread();
+
+    private:
+        bool m_bDirect = false;                 // 是否绕过系统文件缓存
+        size_t m_nBufferSize = 0;               // 每块缓存的大小
+        size_t m_nBufferCount = 0;              // 缓存块数
+        SBuffer* m_pBuffers = nullptr;          // 缓存环
+        size_t m_nCurrent = 0;                  // 当前写入的缓存
+        size_t m_nNextWrite = 0;                // IO线程下一块要写的缓存
+        size_t m_nCarry = 0;                    // 当前缓存中继承来的、已写入过的末尾扇区数据长度
+        unsigned long long m_nSubmitCount = 0;  // 已提交的缓存块数
+        unsigned long long m_nCompleteCount = 0;    // 已写完的缓存块数
+        void* m_hFile = nullptr;                // 文件句柄(打开与关闭时持有m_fileLocker)
+        std::mutex m_fileLocker;                // 保护文件句柄，避免持久化时文件被关闭
+        unsigned long long m_nFileSize = 0;     // 文件的实际长度
+        std::thread m_ioThread;                 // IO线程
+        bool m_bStop = false;                   // IO线程退出标记
+        std::mutex m_locker;                    // 保护缓存状态
+        std::condition_variable m_cvSubmit;     // 有缓存提交
+        std::condition_variable m_cvComplete;   // 有缓存写完
+    };
+}
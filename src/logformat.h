@@ -0,0 +1,124 @@
+﻿#pragma once
+#include <ios>
+#include <charconv>
+#include <cstdint>
+#include <cstddef>
+
+namespace xs
+{
+    ////////////////////////////////////////////////////////////////////////
+    // 数值格式化内核
+    // - 直接写入字符缓存，不经过流对象的locale与虚函数调用，不分配内存
+    // - 整数按两位一组查表输出；浮点数输出可还原的最短表示；指针输出固定宽度的十六进制
+    // - 格式状态(进制、大小写、宽度、填充)由调用者从流对象读取后处理
+    ////////////////////////////////////////////////////////////////////////
+    template<class CharT>
+    class TLogFormat
+    {
+    public:
+        // 整数格式化所需的最大长度(64位八进制22位，加上前缀)
+        static const size_t MAX_INTEGER_LENGTH = 32;
+        // 浮点数格式化所需的最大长度(最短表示不超过24个字符)
+        static const size_t MAX_FLOAT_LENGTH = 32;
+        // 指针格式化的长度(与MSVC的%p一致：固定宽度的大写十六进制，无0x前缀)
+        static const size_t POINTER_LENGTH = sizeof(void*) * 2;
+
+        // 以下整数格式化函数从pszEnd向前写入，返回起始位置
+        static CharT* FormatDecimal(uint64_t nValue, CharT* pszEnd)
+        {
+            static const char szDigitPairs[] =
+                "00010203040506070809"
+                "10111213141516171819"
+                "20212223242526272829"
+                "30313233343536373839"
+                "40414243444546474849"
+                "50515253545556575859"
+                "60616263646566676869"
+                "70717273747576777879"
+                "80818283848586878889"
+                "90919293949596979899";
+
+            CharT* p = pszEnd;
+            while (nValue >= 100)
+            {
+                const char* pPair = szDigitPairs + (nValue % 100) * 2;
+                nValue /= 100;
+                *--p = (CharT)pPair[1];
+                *--p = (CharT)pPair[0];
+            }
+            if (nValue >= 10)
+            {
+                const char* pPair = szDigitPairs + nValue * 2;
+                *--p = (CharT)pPair[1];
+                *--p = (CharT)pPair[0];
+            }
+            else
+            {
+                *--p = (CharT)('0' + nValue);
+            }
+            return p;
+        }
+
+        static CharT* FormatHex(uint64_t nValue, bool bUpperCase, CharT* pszEnd)
+        {
+            const char* pszDigits = bUpperCase ? "0123456789ABCDEF" : "0123456789abcdef";
+            CharT* p = pszEnd;
+            do
+            {
+                *--p = (CharT)pszDigits[nValue & 0xF];
+                nValue >>= 4;
+            } while (nValue);
+            return p;
+        }
+
+        static CharT* FormatOctal(uint64_t nValue, CharT* pszEnd)
+        {
+            CharT* p = pszEnd;
+            do
+            {
+                *--p = (CharT)('0' + (nValue & 0x7));
+                nValue >>= 3;
+            } while (nValue);
+            return p;
+        }
+
+        // 指针格式化，返回写入的字符数
+        static size_t FormatPointer(const void* pValue, CharT* pszOutput)
+        {
+            uint64_t nValue = (uint64_t)(uintptr_t)pValue;
+            for (size_t i = POINTER_LENGTH; i > 0; i--)
+            {
+                pszOutput[i - 1] = (CharT)"0123456789ABCDEF"[nValue & 0xF];
+                nValue >>= 4;
+            }
+            return POINTER_LENGTH;
+        }
+
+        // 浮点数格式化(可还原的最短表示)，返回写入的字符数
+        template<class TValue>
+        static size_t FormatFloat(TValue val, bool bUpperCase, CharT* pszOutput)
+        {
+            char szBuffer[MAX_FLOAT_LENGTH];
+            std::to_chars_result Result = std::to_chars(szBuffer, szBuffer + sizeof(szBuffer), val);
+            size_t nLength = (size_t)(Result.ptr - szBuffer);
+            for (size_t i = 0; i < nLength; i++)
+            {
+                char ch = szBuffer[i];
+                if (bUpperCase && ch >= 'a' && ch <= 'z')
+                {
+                    ch = (char)(ch - 'a' + 'A');
+                }
+                pszOutput[i] = (CharT)ch;
+            }
+            return nLength;
+        }
+
+        // 判断流对象的浮点数格式是否为默认状态(未指定fixed/scientific/showpoint/showpos/precision)
+        // 默认状态下使用最短表示，否则仍由流对象按printf规则格式化
+        static bool IsShortestFloat(const std::ios_base& Stream)
+        {
+            const std::ios_base::fmtflags nMask = std::ios_base::floatfield | std::ios_base::showpoint | std::ios_base::showpos;
+            return (Stream.flags() & nMask) == 0 && Stream.precision() == 6;
+        }
+    };
+}
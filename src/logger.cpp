@@ -1,9 +1,117 @@
 ﻿#define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <cwctype>
+#include <algorithm>
+#include <sstream>
 #include "logger.h"
+#include "logscope.h"
+#include "logutf8.h"
 
 namespace xs
 {
+    struct SThreadQueue
+    {
+        CLogRing<SLogRecord> Ring;          // 日志记录队列，所属线程为唯一生产者，写线程为唯一消费者
+        std::atomic_bool bExited{ false };  // 所属线程是否已退出，退出且队列为空后由写线程回收
+
+        explicit SThreadQueue(size_t nCapacity) : Ring(nCapacity) {}
+    };
+
+    // 线程退出时标记其日志队列，队列本身由写线程输出剩余日志后回收
+    struct SThreadQueueHolder
+    {
+        std::shared_ptr<SThreadQueue> pQueue;
+
+        ~SThreadQueueHolder()
+        {
+            if (pQueue)
+            {
+                pQueue->bExited.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    static thread_local SThreadQueueHolder t_ThreadQueue;
+
+    // 每个线程复用的日志记录，异步模式下与队列槽位交换，避免每条日志都分配内存
+    static thread_local SLogRecord t_Record;
+
+    // 队列已满时丢弃最旧日志所用的记录
+    static thread_local SLogRecord t_Dropped;
+
+    // 当前线程刷新后需要持久化的输出对象，在释放写入锁后统一持久化
+    static thread_local std::vector<CLogSink::Ptr> t_vSyncSinks;
+
+    // 输出对象列表的读取者：构造时登记到当前组并取得列表快照，析构时注销，期间快照不会被释放
+    // 读取时只有两次原子加减，不会被添加、删除输出对象阻塞
+    class CLogger::CSinkReader
+    {
+    public:
+        explicit CSinkReader(SClassData& Data) : m_Data(Data)
+        {
+            // 先登记再读取快照，替换列表的线程在发布新列表后检查两组计数，能看到所有可能持有旧列表的读取者
+            m_nGroup = m_Data.m_nSinkEpoch.load(std::memory_order_seq_cst) & 1;
+            m_Data.m_nSinkReaders[m_nGroup].fetch_add(1, std::memory_order_seq_cst);
+            m_pSinkList = m_Data.m_pSinkList.load(std::memory_order_seq_cst);
+        }
+
+        ~CSinkReader()
+        {
+            m_Data.m_nSinkReaders[m_nGroup].fetch_sub(1, std::memory_order_release);
+        }
+
+        CSinkReader(const CSinkReader& Other) = delete;
+        CSinkReader& operator=(const CSinkReader& Other) = delete;
+
+        const TSinkList& Sinks() const { return *m_pSinkList; }
+
+    private:
+        SClassData& m_Data;
+        uint32_t m_nGroup = 0;
+        const TSinkList* m_pSinkList = nullptr;
+    };
+
+    static int64_t GetTimestamp()
+    {
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+    // 通配符匹配(*匹配任意个字符，?匹配一个字符，不区分大小写)
+    static bool MatchPattern(const wchar_t* pszPattern, const wchar_t* pszText)
+    {
+        const wchar_t* pszStar = nullptr;
+        const wchar_t* pszResume = nullptr;
+        while (*pszText)
+        {
+            if (*pszPattern == L'*')
+            {
+                // 记录回溯位置，先尝试匹配0个字符
+                pszStar = ++pszPattern;
+                pszResume = pszText;
+            }
+            else if (*pszPattern == L'?' || std::towlower(*pszPattern) == std::towlower(*pszText))
+            {
+                pszPattern++;
+                pszText++;
+            }
+            else if (pszStar)
+            {
+                // 回溯：*多匹配一个字符
+                pszPattern = pszStar;
+                pszText = ++pszResume;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        while (*pszPattern == L'*')
+        {
+            pszPattern++;
+        }
+        return *pszPattern == 0;
+    }
+
     CLogger& CLogger::Inst()
     {
         static CLogger inst;
@@ -13,6 +121,7 @@ namespace xs
     CLogger::CLogger()
     {
         m_pClsData = new SClassData();
+        m_pClsData->m_pSinkList = new TSinkList();
         // 创建异步触发线程
         m_pClsData->m_bThreadRun = true;
         m_pClsData->m_asyncTriggerThread = std::thread(&CLogger::AsyncTriggerThread, this);
@@ -20,6 +129,9 @@ namespace xs
 
     CLogger::~CLogger()
     {
+        // 退出异步写线程(输出队列中剩余的日志)
+        StopAsyncWriter();
+
         // 退出异步触发线程
         m_pClsData->m_bThreadRun = false;
         m_pClsData->m_cvThreadStop.notify_all();
@@ -28,7 +140,13 @@ namespace xs
             m_pClsData->m_asyncTriggerThread.join();
         }
 
-        m_pClsData->m_vSinks.clear();
+        delete m_pClsData->m_pSinkList.exchange(nullptr);
+
+        if (m_pClsData->m_pLogQueue)
+        {
+            delete m_pClsData->m_pLogQueue;
+            m_pClsData->m_pLogQueue = nullptr;
+        }
 
         if (m_pClsData)
         {
@@ -39,38 +157,246 @@ namespace xs
 
     void CLogger::SetOutputLevel(ELogLevel eOutputLevel)
     {
-        std::lock_guard<std::mutex> LockGuard(m_pClsData->m_globalLocker);
-        m_pClsData->m_eOutputLevel = eOutputLevel;
+        m_pClsData->m_eOutputLevel.store(eOutputLevel, std::memory_order_relaxed);
+        UpdateAllSites();
+    }
+
+    void CLogger::EnableSites(const wchar_t* pszFilePattern, ELogLevel eLevel, unsigned int nFirstLine, unsigned int nLastLine)
+    {
+        AddSiteRule(pszFilePattern, eLevel, nFirstLine, nLastLine, true);
+    }
+
+    void CLogger::DisableSites(const wchar_t* pszFilePattern, ELogLevel eLevel, unsigned int nFirstLine, unsigned int nLastLine)
+    {
+        AddSiteRule(pszFilePattern, eLevel, nFirstLine, nLastLine, false);
+    }
+
+    void CLogger::ClearSiteRules()
+    {
+        {
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_siteLocker);
+            m_pClsData->m_vSiteRules.clear();
+        }
+        UpdateAllSites();
+    }
+
+    void CLogger::AddSiteRule(const wchar_t* pszFilePattern, ELogLevel eLevel, unsigned int nFirstLine, unsigned int nLastLine, bool bEnable)
+    {
+        {
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_siteLocker);
+            SSiteRule Rule;
+            Rule.szFilePattern = pszFilePattern ? pszFilePattern : L"*";
+            Rule.eLevel = eLevel;
+            Rule.nFirstLine = nFirstLine;
+            Rule.nLastLine = nLastLine;
+            Rule.bEnable = bEnable;
+            m_pClsData->m_vSiteRules.push_back(Rule);
+        }
+        UpdateAllSites();
+    }
+
+    void CLogger::UpdateSite(const SLogSite& Site)
+    {
+        std::lock_guard<std::mutex> LockGuard(m_pClsData->m_siteLocker);
+        bool bEnabled = IsOutputLevel(Site.eLevel);
+        for (auto& Rule : m_pClsData->m_vSiteRules)
+        {
+            if (Site.nLine < Rule.nFirstLine || Site.nLine > Rule.nLastLine
+                || !MatchPattern(Rule.szFilePattern.c_str(), Site.pszFile))
+            {
+                continue;
+            }
+            if (Rule.bEnable && Site.eLevel >= Rule.eLevel)
+            {
+                bEnabled = true;
+            }
+            else if (!Rule.bEnable && Site.eLevel <= Rule.eLevel)
+            {
+                bEnabled = false;
+            }
+        }
+
+        // 规则只作用于普通输出，捕获等级只按等级判断
+        bool bCapture = Site.eLevel >= m_pClsData->m_eCaptureLevel.load(std::memory_order_relaxed);
+        Site.bCaptureOnly.store(!bEnabled && bCapture, std::memory_order_relaxed);
+        Site.bEnabled.store(bEnabled || bCapture, std::memory_order_relaxed);
+    }
+
+    void CLogger::UpdateCaptureLevel()
+    {
+        ELogLevel eSinkLevel = ELogLevel::LEVEL_MAX;
+        {
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_sinkLocker);
+            for (auto& pSink : *m_pClsData->m_pSinkList.load())
+            {
+                eSinkLevel = (std::min)(eSinkLevel, pSink->CaptureLevel());
+            }
+        }
+        m_pClsData->m_eSinkCaptureLevel.store(eSinkLevel, std::memory_order_relaxed);
+        ELogLevel eCaptureLevel = (std::min)(eSinkLevel, m_pClsData->m_eScopeLevel.load(std::memory_order_relaxed));
+        if (eCaptureLevel != m_pClsData->m_eCaptureLevel.exchange(eCaptureLevel, std::memory_order_relaxed))
+        {
+            UpdateAllSites();
+        }
+    }
+
+    bool CLogger::IsCaptured(ELogLevel eLevel) const
+    {
+        return IsSinkCaptured(eLevel) || CLogScope::IsCapturing(eLevel);
+    }
+
+    void CLogger::LowerScopeLevel(ELogLevel eLevel)
+    {
+        // 请求级的作用域频繁创建，捕获等级只降不升，只有首次使用更低的等级时才需要更新调用点
+        ELogLevel eOldLevel = m_pClsData->m_eScopeLevel.load(std::memory_order_relaxed);
+        while (eLevel < eOldLevel)
+        {
+            if (m_pClsData->m_eScopeLevel.compare_exchange_weak(eOldLevel, eLevel, std::memory_order_relaxed))
+            {
+                UpdateCaptureLevel();
+                return;
+            }
+        }
+    }
+
+    void CLogger::UpdateAllSites()
+    {
+        // 调用点只增不减，规则变化较少，逐个重新计算即可
+        uint32_t nCount = SLogSite::Count();
+        for (uint32_t nId = 1; nId <= nCount; nId++)
+        {
+            const SLogSite* pSite = SLogSite::Find(nId);
+            if (pSite)
+            {
+                UpdateSite(*pSite);
+            }
+        }
+    }
+
+    void CLogger::SetTimeFormat(ETimePrecision ePrecision, bool bUtcTime)
+    {
+        m_pClsData->m_eTimePrecision.store(ePrecision, std::memory_order_relaxed);
+        m_pClsData->m_bUtcTime.store(bUtcTime, std::memory_order_relaxed);
+    }
+
+    void CLogger::SetAsyncMode(EAsyncMode eMode, size_t nQueueSize)
+    {
+        if (eMode == m_pClsData->m_eAsyncMode)
+        {
+            return;
+        }
+
+        // 先切换为同步模式，等待已读到旧模式、正在入队的生产者完成(写线程仍在运行，等待空间的生产者也能完成)，
+        // 之后不会再有日志进入旧队列，再停止写线程，输出之前模式下队列中剩余的日志
+        m_pClsData->m_eAsyncMode.store(EAsyncMode::MODE_SYNC, std::memory_order_seq_cst);
+        while (m_pClsData->m_nAsyncPushers.load(std::memory_order_seq_cst) > 0)
+        {
+            std::this_thread::yield();
+        }
+        StopAsyncWriter();
+        if (eMode == EAsyncMode::MODE_SYNC)
+        {
+            return;
+        }
+
+        if (eMode == EAsyncMode::MODE_SHARED_QUEUE)
+        {
+            if (m_pClsData->m_pLogQueue)
+            {
+                delete m_pClsData->m_pLogQueue;
+                m_pClsData->m_pLogQueue = nullptr;
+            }
+            m_pClsData->m_pLogQueue = new CLogQueue<SLogRecord>(nQueueSize);
+        }
+        else
+        {
+            m_pClsData->m_nThreadQueueSize = nQueueSize;
+        }
+
+        // 创建异步写线程
+        m_pClsData->m_bWriterRun = true;
+        m_pClsData->m_asyncWriteThread = std::thread(&CLogger::AsyncWriteThread, this);
+        m_pClsData->m_eAsyncMode = eMode;
+    }
+
+    void CLogger::SetAsyncMode(bool bAsync, size_t nQueueSize)
+    {
+        SetAsyncMode(bAsync ? EAsyncMode::MODE_SHARED_QUEUE : EAsyncMode::MODE_SYNC, nQueueSize);
+    }
+
+    void CLogger::SetOverflowPolicy(const SOverflowPolicy& Policy)
+    {
+        m_pClsData->m_OverflowPolicy = Policy;
+    }
+
+    uint64_t CLogger::DroppedCount() const
+    {
+        return m_pClsData->m_nDroppedCount.load(std::memory_order_relaxed);
+    }
+
+    size_t CLogger::ThreadQueueCount() const
+    {
+        std::lock_guard<std::mutex> LockGuard(m_pClsData->m_queueLocker);
+        return m_pClsData->m_vThreadQueues.size();
     }
 
     void CLogger::InsertLogSink(CLogSink::Ptr LogSink)
     {
-        std::lock_guard<std::mutex> LockGuard(m_pClsData->m_globalLocker);
-        for (auto& sink : m_pClsData->m_vSinks)
         {
-            if (sink.pSink == LogSink)
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_sinkLocker);
+            const TSinkList& vSinks = *m_pClsData->m_pSinkList.load();
+            if (std::find(vSinks.begin(), vSinks.end(), LogSink) != vSinks.end())
             {
                 // 已存在
                 return;
             }
+            LogSink->SetLastFlushTime(GetTimestamp());
+            TSinkList* pSinkList = new TSinkList(vSinks);
+            pSinkList->push_back(LogSink);
+            PublishSinks(pSinkList);
         }
-        SSinkData sink;
-        sink.pSink = LogSink;
-        sink.bHasWritten = false;
-        m_pClsData->m_vSinks.push_back(sink);
+
+        // 唤醒触发线程与写线程，按新输出对象的刷新间隔重新计算等待时间
+        {
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_triggerLocker);
+            m_pClsData->m_cvThreadStop.notify_all();
+        }
+        m_pClsData->m_cvWriterWake.notify_one();
+        UpdateCaptureLevel();
     }
 
     void CLogger::RemoveLogSink(CLogSink::Ptr LogSink)
     {
-        std::lock_guard<std::mutex> LockGuard(m_pClsData->m_globalLocker);
-        for (auto iter = m_pClsData->m_vSinks.begin(); iter != m_pClsData->m_vSinks.end(); iter++)
         {
-            if (iter->pSink == LogSink)
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_sinkLocker);
+            const TSinkList& vSinks = *m_pClsData->m_pSinkList.load();
+            auto iter = std::find(vSinks.begin(), vSinks.end(), LogSink);
+            if (iter == vSinks.end())
             {
-                m_pClsData->m_vSinks.erase(iter);
-                break;
+                return;
             }
+            TSinkList* pSinkList = new TSinkList(vSinks.begin(), iter);
+            pSinkList->insert(pSinkList->end(), iter + 1, vSinks.end());
+            PublishSinks(pSinkList);
         }
+        UpdateCaptureLevel();
+    }
+
+    void CLogger::PublishSinks(TSinkList* pSinkList)
+    {
+        const TSinkList* pOldList = m_pClsData->m_pSinkList.exchange(pSinkList, std::memory_order_seq_cst);
+
+        // 依次切换两组计数并等待旧组清零：切换后新的读取者登记到另一组，旧组只会减少
+        // 两组都清零过一次后，发布新列表前登记的读取者都已完成，旧列表不再被使用
+        for (int i = 0; i < 2; i++)
+        {
+            uint32_t nGroup = m_pClsData->m_nSinkEpoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+            while (m_pClsData->m_nSinkReaders[nGroup].load(std::memory_order_seq_cst) != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+        delete pOldList;
     }
 
     CLogMsg CLogger::operator()(ELogLevel eLevel, const wchar_t* pFile, int nLine)
@@ -78,17 +404,27 @@ namespace xs
         return CLogMsg(*this, eLevel, pFile, nLine);
     }
 
-    const std::wstring& CLogger::LevelName(ELogLevel eLevel, bool bShortName)
+    CLogMsg CLogger::operator()(const SLogLocation& Location)
+    {
+        return CLogMsg(*this, Location);
+    }
+
+    CLogMsg CLogger::operator()(const SLogSite& Site)
+    {
+        return CLogMsg(*this, Site);
+    }
+
+    const std::string& CLogger::LevelName(ELogLevel eLevel, bool bShortName)
     {
         static const unsigned int nNameCount = static_cast<unsigned int>(ELogLevel::LEVEL_MAX) + 2;
-        static std::wstring LevelNames[nNameCount][2] = {
-            { L"DEBUG",  L"D" },
-            { L"TRACE",  L"T" },
-            { L"INFO",   L"I" },
-            { L"WARNING",L"W" },
-            { L"ERROR",  L"E" },
-            { L"FATAL",  L"F" },
-            { L"NONE",   L"N" }
+        static std::string LevelNames[nNameCount][2] = {
+            { "DEBUG",  "D" },
+            { "TRACE",  "T" },
+            { "INFO",   "I" },
+            { "WARNING","W" },
+            { "ERROR",  "E" },
+            { "FATAL",  "F" },
+            { "NONE",   "N" }
         };
 
         unsigned int nIndex = static_cast<unsigned int>(eLevel);
@@ -99,84 +435,646 @@ namespace xs
         return LevelNames[nIndex][bShortName ? 1 : 0];
     }
 
-    void CLogger::PushLog(ELogLevel eLevel, std::wstring&& szLog, bool bFlush)
+    void CLogger::FormatMarker(ELogLevel eLevel, const std::string& szText, std::string& szLog)
+    {
+        char szTime[CLogTime::MAX_LENGTH];
+        size_t nTimeLength = CLogTime::Format(CLogTime::Now(), GetTimePrecision(), IsUtcTime(), szTime);
+        std::ostringstream OSStream;
+        OSStream << std::this_thread::get_id();
+        szLog.assign("[").append(LevelName(eLevel, true)).append(" ");
+        szLog.append(szTime, nTimeLength).append(" ").append(OSStream.str()).append(" xslog:0] ");
+        szLog.append(szText).append("\n");
+    }
+
+    void CLogger::FormatDropMarker(uint64_t nDropped, std::string& szLog)
     {
-        std::lock_guard<std::mutex> LockGuard(m_pClsData->m_globalLocker);
+        FormatMarker(ELogLevel::LEVEL_WARNING, std::to_string(nDropped) + " messages dropped", szLog);
+    }
 
-        static std::wstring szLogHeader;
-        if (szLogHeader.empty())
+    void CLogger::PushLog(ELogLevel eLevel, const char* pszLog, size_t nLength, bool bFlush, bool bCaptureOnly)
+    {
+        // 当前线程有日志作用域时，低于输出等级的日志先交给作用域缓存
+        if (CLogScope::CaptureLog(eLevel, pszLog, nLength, false, bCaptureOnly)
+            || (bCaptureOnly && !IsSinkCaptured(eLevel)))
         {
-            std::wstring szPid = std::to_wstring(::GetCurrentProcessId());
-            szLogHeader.append(L"START LOGGING PROCESS(").append(szPid).append(L") ...\n");
-            szLogHeader.append(L"[LEVEL YYYY-MM-DD HH:MM:SS.SSS THREAD FILE:LINE] MESSAGE\n");
+            return;
         }
 
-        // 根据日志输出等级过滤
-        if (eLevel < m_pClsData->m_eOutputLevel)
+        SLogRecord& Record = t_Record;
+        Record.eLevel = eLevel;
+        Record.szLog.assign(pszLog, nLength);
+        Record.szBinary.clear();
+        Record.bFlush = bFlush;
+        Record.bCaptureOnly = bCaptureOnly;
+        Record.bReplay = false;
+        Record.ThreadId = std::this_thread::get_id();
+        PushRecord(Record);
+    }
+
+    void CLogger::PushBinLog(ELogLevel eLevel, const char* pData, size_t nLength, bool bFlush, bool bCaptureOnly)
+    {
+        if (CLogScope::CaptureLog(eLevel, pData, nLength, true, bCaptureOnly)
+            || (bCaptureOnly && !IsSinkCaptured(eLevel)))
         {
             return;
         }
 
-        if (szLog.length() > 0)
+        SLogRecord& Record = t_Record;
+        Record.eLevel = eLevel;
+        Record.szLog.clear();
+        Record.szBinary.assign(pData, nLength);
+        Record.bFlush = bFlush;
+        Record.bCaptureOnly = bCaptureOnly;
+        Record.bReplay = false;
+        Record.ThreadId = std::this_thread::get_id();
+        PushRecord(Record);
+    }
+
+    void CLogger::PushScopeLog(ELogLevel eLevel, const char* pData, size_t nLength, bool bBinary, bool bReplay)
+    {
+        SLogRecord& Record = t_Record;
+        Record.eLevel = eLevel;
+        if (bBinary)
         {
-            // 确保日志内容以换行符结尾
-            if (szLog.back() != L'\n')
+            Record.szLog.clear();
+            Record.szBinary.assign(pData, nLength);
+        }
+        else
+        {
+            Record.szLog.assign(pData, nLength);
+            Record.szBinary.clear();
+        }
+        Record.bFlush = false;
+        Record.bCaptureOnly = false;
+        Record.bReplay = bReplay;
+        Record.ThreadId = std::this_thread::get_id();
+        PushRecord(Record);
+    }
+
+    void CLogger::PushRecord(SLogRecord& Record)
+    {
+        EAsyncMode eMode = m_pClsData->m_eAsyncMode.load(std::memory_order_relaxed);
+        if (eMode != EAsyncMode::MODE_SYNC)
+        {
+            // 先登记为入队中的生产者再重新读取模式，与SetAsyncMode先切换模式再检查生产者数量相对应：
+            // 要么本线程看到已切换为同步模式，要么切换模式的线程等待本次入队完成后才停止写线程、释放队列
+            m_pClsData->m_nAsyncPushers.fetch_add(1, std::memory_order_seq_cst);
+            eMode = m_pClsData->m_eAsyncMode.load(std::memory_order_seq_cst);
+            if (eMode == EAsyncMode::MODE_SYNC)
             {
-                szLog += L"\n";
+                m_pClsData->m_nAsyncPushers.fetch_sub(1, std::memory_order_release);
             }
         }
+        if (eMode != EAsyncMode::MODE_SYNC)
+        {
+            // 异步模式：仅入队，队列满时按溢出策略等待写线程消费
+            Record.nTimestamp = GetTimestamp();
+            if (eMode == EAsyncMode::MODE_SHARED_QUEUE)
+            {
+                auto pQueue = m_pClsData->m_pLogQueue;
+                while (!pQueue->TryPush(Record))
+                {
+                    if (!WaitQueueSpace(Record, true))
+                    {
+                        m_pClsData->m_nDroppedCount.fetch_add(1, std::memory_order_relaxed);
+                        m_pClsData->m_nAsyncPushers.fetch_sub(1, std::memory_order_release);
+                        return;
+                    }
+                }
+            }
+            else
+            {
+                auto pQueue = GetThreadQueue();
+                while (!pQueue->Ring.TryPush(Record))
+                {
+                    if (!WaitQueueSpace(Record, false))
+                    {
+                        m_pClsData->m_nDroppedCount.fetch_add(1, std::memory_order_relaxed);
+                        m_pClsData->m_nAsyncPushers.fetch_sub(1, std::memory_order_release);
+                        return;
+                    }
+                }
+            }
+
+            // 写线程空闲时才需要唤醒，避免每条日志都进行一次系统调用
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_pClsData->m_bWriterIdle.load(std::memory_order_relaxed))
+            {
+                std::lock_guard<std::mutex> LockGuard(m_pClsData->m_writerLocker);
+                m_pClsData->m_cvWriterWake.notify_one();
+            }
+            m_pClsData->m_nAsyncPushers.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+
+        DispatchLog(Record);
+        SyncSinks();
+    }
+
+    bool CLogger::WaitQueueSpace(const SLogRecord& Record, bool bSharedQueue)
+    {
+        // ERROR与FATAL日志不丢弃，队列容量固定，只能等待写线程腾出空间
+        const SOverflowPolicy& Policy = m_pClsData->m_OverflowPolicy;
+        bool bKeep = (Record.eLevel >= ELogLevel::LEVEL_ERROR);
+        switch (Policy.ePolicy)
+        {
+        case EOverflowPolicy::OVERFLOW_DROP_NEWEST:
+            if (!bKeep)
+            {
+                return false;
+            }
+            break;
+        case EOverflowPolicy::OVERFLOW_DROP_OLDEST:
+            if (!bSharedQueue)
+            {
+                // 线程队列只能由写线程出队，按丢弃新日志处理
+                if (!bKeep)
+                {
+                    return false;
+                }
+                break;
+            }
+            // 取出最旧的一条记录腾出空间，ERROR与FATAL记录由当前线程直接输出(可能略早于队列中的其它日志)
+            if (m_pClsData->m_pLogQueue->TryPop(t_Dropped))
+            {
+                if (t_Dropped.eLevel >= ELogLevel::LEVEL_ERROR)
+                {
+                    DispatchLog(t_Dropped);
+                    SyncSinks();
+                }
+                else
+                {
+                    m_pClsData->m_nDroppedCount.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            return true;
+        default:
+            // 等待方式，或等级不低于阈值的日志：超时后丢弃
+            if (Policy.ePolicy == EOverflowPolicy::OVERFLOW_DROP_BELOW_LEVEL && !bKeep && Record.eLevel < Policy.eDropLevel)
+            {
+                return false;
+            }
+            break;
+        }
+
+        // 超时时间从日志产生时开始计算，ERROR与FATAL日志或超时时间为0时一直等待
+        auto nRemain = std::chrono::steady_clock::duration::max();
+        if (!bKeep && Policy.nBlockTimeout > 0)
+        {
+            nRemain = std::chrono::milliseconds(Policy.nBlockTimeout) - std::chrono::steady_clock::duration(GetTimestamp() - Record.nTimestamp);
+            if (nRemain <= std::chrono::steady_clock::duration::zero())
+            {
+                return false;
+            }
+        }
+
+        // 确保写线程处于运行状态
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_pClsData->m_bWriterIdle.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_writerLocker);
+            m_pClsData->m_cvWriterWake.notify_one();
+        }
+
+        // 阻塞等待写线程腾出空间(写线程退出时也不再等待)
+        auto HasSpace = [this, bSharedQueue] {
+            return !m_pClsData->m_bWriterRun.load(std::memory_order_relaxed)
+                || (bSharedQueue ? !m_pClsData->m_pLogQueue->IsFull() : !t_ThreadQueue.pQueue->Ring.IsFull());
+        };
+        std::unique_lock<std::mutex> Lock(m_pClsData->m_spaceLocker);
+        m_pClsData->m_nSpaceWaiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (nRemain == std::chrono::steady_clock::duration::max())
+        {
+            m_pClsData->m_cvQueueSpace.wait(Lock, HasSpace);
+        }
+        else
+        {
+            m_pClsData->m_cvQueueSpace.wait_for(Lock, nRemain, HasSpace);
+        }
+        m_pClsData->m_nSpaceWaiters.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void CLogger::DispatchLog(SLogRecord& Record)
+    {
+        // 多个线程可能同时分发，引导信息只初始化一次
+        static const std::string szLogHeader = []() {
+            std::string szPid = std::to_string(::GetCurrentProcessId());
+            return std::string("START LOGGING PROCESS(").append(szPid).append(") ...\n")
+                .append("[LEVEL YYYY-MM-DD HH:MM:SS.SSS THREAD FILE:LINE] MESSAGE\n");
+        }();
+        // 转码缓存只在分发时使用，每个线程复用其内存
+        static thread_local std::wstring szWideLog;
+        static thread_local std::string szFirstLog;
+
+        std::string& szLog = Record.szLog;
+        const SLogSite* pSite = nullptr;
+        if (!Record.szBinary.empty())
+        {
+            // 二进制日志记录，文本内容在首次需要时才格式化
+            pSite = SLogSite::Find(CBinLogMsg::SiteId(Record.szBinary.data(), Record.szBinary.size()));
+            if (!pSite)
+            {
+                return;
+            }
+        }
+        auto FormatText = [&]() {
+            if (pSite && szLog.empty())
+            {
+                SBinLogFormat Format;
+                Format.eTimePrecision = GetTimePrecision();
+                Format.bUtcTime = IsUtcTime();
+                CBinLogMsg::Format(*pSite, Record.szBinary.data(), Record.szBinary.size(), Format, szLog);
+            }
+            // 确保日志内容以换行符结尾
+            if (szLog.length() > 0 && szLog.back() != '\n')
+            {
+                szLog += '\n';
+            }
+        };
+        // 只有需要宽字符的输出对象(如控制台)才转码，且每条日志最多转码一次
+        bool bWideReady = false;
+        auto WideText = [&]() -> const std::wstring& {
+            if (!bWideReady)
+            {
+                bWideReady = true;
+                CLogUtf8::ToWide(szLog.data(), szLog.length(), szWideLog);
+            }
+            return szWideLog;
+        };
 
         // 如果没有添加任何输出对象，则默认输出到标准输出
-        if (m_pClsData->m_vSinks.empty())
+        CSinkReader Reader(*m_pClsData);
+        const TSinkList& vSinks = Reader.Sinks();
+        if (vSinks.empty())
         {
-            std::wcout << szLog;
+            if (Record.bCaptureOnly)
+            {
+                return;
+            }
+            FormatText();
+            static std::mutex s_consoleLocker;
+            std::lock_guard<std::mutex> LockGuard(s_consoleLocker);
+            std::wcout << WideText();
             std::wcout.flush();
             return;
         }
 
-        auto ThreadId = std::this_thread::get_id();
         // 将日志写入所有输出对象
-        for (auto& sink : m_pClsData->m_vSinks)
+        for (auto& pSink : vSinks)
         {
-            if (sink.pSink->MatchThreadFilter(ThreadId))
+            // 低于输出等级的日志只写入捕获该等级的输出对象，作用域补写的日志不再写入已捕获过的输出对象
+            ELogLevel eCaptureLevel = pSink->CaptureLevel();
+            if ((Record.bCaptureOnly && Record.eLevel < eCaptureLevel) || (Record.bReplay && Record.eLevel >= eCaptureLevel))
+            {
+                continue;
+            }
+            if (pSink->MatchThreadFilter(Record.ThreadId))
             {
-                if (szLog.length() > 0)
+                // 文本在加写入锁前格式化，锁内只有写入
+                bool bBinary = pSite && pSink->IsBinaryMode();
+                if (!bBinary)
+                {
+                    FormatText();
+                    if (szLog.length() > 0 && pSink->IsWideMode())
+                    {
+                        WideText();
+                    }
+                }
+
+                std::unique_lock<std::mutex> Lock = LockSink(*pSink);
+                if (bBinary)
+                {
+                    // 二进制输出对象直接写入原始记录
+                    pSink->WriteBinaryLog(*pSite, Record.szBinary);
+                }
+                else if (szLog.length() > 0)
                 {
                     // 如果是第一次输出日志，则添加日志引导信息
-                    if (!sink.bHasWritten)
+                    if (pSink->MarkWritten())
                     {
-                        sink.bHasWritten = true;
-                        szLog.insert(0, szLogHeader);
+                        szFirstLog.assign(szLogHeader).append(szLog);
+                        if (pSink->IsWideMode())
+                        {
+                            std::wstring szWideFirst;
+                            CLogUtf8::ToWide(szFirstLog.data(), szFirstLog.length(), szWideFirst);
+                            pSink->WriteWideLog(szWideFirst);
+                        }
+                        else
+                        {
+                            pSink->WriteLog(szFirstLog, Record.eLevel);
+                        }
+                    }
+                    else if (pSink->IsWideMode())
+                    {
+                        pSink->WriteWideLog(WideText());
+                    }
+                    else
+                    {
+                        pSink->WriteLog(szLog, Record.eLevel);
                     }
-                    sink.pSink->WriteLog(szLog);
                 }
 
-                if (bFlush && sink.pSink->IsAsyncMode())
+                if ((Record.bFlush || pSink->IsFlushLevel(Record.eLevel)) && pSink->IsAsyncMode())
                 {
-                    sink.pSink->Flush();
+                    FlushSink(pSink);
                 }
             }
         }
     }
 
+    std::unique_lock<std::mutex> CLogger::LockSink(CLogSink& Sink)
+    {
+        if (Sink.IsThreadSafe())
+        {
+            return std::unique_lock<std::mutex>();
+        }
+        return std::unique_lock<std::mutex>(Sink.WriteLocker());
+    }
+
+    void CLogger::FlushSink(const CLogSink::Ptr& pSink)
+    {
+        pSink->Flush();
+        pSink->SetLastFlushTime(GetTimestamp());
+        if (pSink->IsSyncMode())
+        {
+            for (auto& pSyncSink : t_vSyncSinks)
+            {
+                if (pSyncSink == pSink)
+                {
+                    return;
+                }
+            }
+            t_vSyncSinks.push_back(pSink);
+        }
+    }
+
+    std::chrono::milliseconds CLogger::FlushSinks(bool bForce)
+    {
+        // 没有需要定时刷新的输出对象时，最多等待3秒
+        auto nWait = std::chrono::milliseconds(3000);
+        CSinkReader Reader(*m_pClsData);
+        for (auto& pSink : Reader.Sinks())
+        {
+            if (!pSink->IsAsyncMode())
+            {
+                continue;
+            }
+            auto nInterval = std::chrono::milliseconds(pSink->FlushInterval());
+            auto nElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::duration(GetTimestamp() - pSink->LastFlushTime()));
+            if (bForce || nElapsed >= nInterval)
+            {
+                // 加锁后再次检查，其它线程可能刚刚刷新过
+                std::unique_lock<std::mutex> Lock = LockSink(*pSink);
+                nElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::duration(GetTimestamp() - pSink->LastFlushTime()));
+                if (bForce || nElapsed >= nInterval)
+                {
+                    FlushSink(pSink);
+                    nElapsed = std::chrono::milliseconds(0);
+                }
+            }
+            if (nInterval - nElapsed < nWait)
+            {
+                nWait = nInterval - nElapsed;
+            }
+        }
+        return nWait > std::chrono::milliseconds(1) ? nWait : std::chrono::milliseconds(1);
+    }
+
+    void CLogger::SyncSinks()
+    {
+        if (t_vSyncSinks.empty())
+        {
+            return;
+        }
+        for (auto& pSink : t_vSyncSinks)
+        {
+            pSink->Sync();
+        }
+        t_vSyncSinks.clear();
+    }
+
     void CLogger::AsyncTriggerThread()
     {
-        std::unique_lock<std::mutex> Lock(m_pClsData->m_globalLocker);
+        std::unique_lock<std::mutex> Lock(m_pClsData->m_triggerLocker);
 
         while (m_pClsData->m_bThreadRun)
         {
-            m_pClsData->m_cvThreadStop.wait_for(Lock, std::chrono::seconds(3));
-            if (!m_pClsData->m_bThreadRun)
+            // 异步模式下由写线程负责定时刷新
+            auto nWait = std::chrono::milliseconds(3000);
+            if (m_pClsData->m_eAsyncMode == EAsyncMode::MODE_SYNC)
+            {
+                // 按各输出对象的刷新间隔定时刷新，刷新与持久化时不持有触发线程的锁
+                Lock.unlock();
+                nWait = FlushSinks(false);
+                SyncSinks();
+                Lock.lock();
+                if (!m_pClsData->m_bThreadRun)
+                {
+                    break;
+                }
+            }
+            m_pClsData->m_cvThreadStop.wait_for(Lock, nWait);
+        }
+    }
+
+    void CLogger::AsyncWriteThread()
+    {
+        const size_t nMaxBatch = 1024;
+        auto nWait = std::chrono::milliseconds(3000);
+        auto pQueue = m_pClsData->m_pLogQueue;
+        SLogRecord Record;
+        std::vector<std::shared_ptr<SThreadQueue>> vThreadQueues;  // 线程队列列表的快照
+        uint64_t nQueueVersion = 0;
+        uint64_t nMarked = m_pClsData->m_nDroppedCount.load(std::memory_order_relaxed);   // 已输出丢弃标记的丢弃条数
+
+        for (;;)
+        {
+            // 先读取运行标记，保证退出前队列已被完全取空
+            bool bRunning = m_pClsData->m_bWriterRun;
+
+            // 线程队列列表有变化时才更新快照
+            if (nQueueVersion != m_pClsData->m_nQueueVersion)
+            {
+                std::lock_guard<std::mutex> LockGuard(m_pClsData->m_queueLocker);
+                vThreadQueues = m_pClsData->m_vThreadQueues;
+                nQueueVersion = m_pClsData->m_nQueueVersion;
+            }
+
+            // 批量取出日志记录
+            size_t nCount = 0;
+            while (pQueue && nCount < nMaxBatch && pQueue->TryPop(Record))
+            {
+                DispatchLog(Record);
+                nCount++;
+            }
+            if (!vThreadQueues.empty())
+            {
+                nCount += MergeThreadQueues(vThreadQueues, nMaxBatch);
+            }
+
+            // 本批次期间有日志因队列已满被丢弃，输出一条丢弃标记
+            uint64_t nDropped = m_pClsData->m_nDroppedCount.load(std::memory_order_relaxed);
+            if (nDropped != nMarked)
+            {
+                Record.eLevel = ELogLevel::LEVEL_WARNING;
+                FormatDropMarker(nDropped - nMarked, Record.szLog);
+                Record.szBinary.clear();
+                Record.bFlush = false;
+                Record.bCaptureOnly = false;
+                Record.bReplay = false;
+                Record.ThreadId = std::this_thread::get_id();
+                DispatchLog(Record);
+                nMarked = nDropped;
+            }
+
+            // 按各输出对象的刷新间隔定时刷新，退出前全部刷新
+            nWait = FlushSinks(!bRunning);
+            // 本批次中需要持久化的输出对象在批次结束后统一持久化
+            SyncSinks();
+
+            // 本批次腾出了队列空间，唤醒等待空间的生产者
+            if (nCount > 0 || !bRunning)
+            {
+                NotifyQueueSpace();
+            }
+
+            if (nCount > 0)
+            {
+                continue;
+            }
+
+            // 所有队列都已取空，回收已退出线程的队列
+            ReclaimThreadQueues(vThreadQueues);
+
+            if (!bRunning)
             {
                 break;
             }
-            for (auto& sink : m_pClsData->m_vSinks)
+
+            // 队列为空，等待生产者唤醒(或超时后进行定时刷新)
+            std::unique_lock<std::mutex> Lock(m_pClsData->m_writerLocker);
+            m_pClsData->m_bWriterIdle.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool bEmpty = !pQueue || pQueue->IsEmpty();
+            for (size_t i = 0; bEmpty && i < vThreadQueues.size(); i++)
             {
-                if (sink.pSink->IsAsyncMode())
+                bEmpty = vThreadQueues[i]->Ring.IsEmpty();
+            }
+            if (bEmpty && m_pClsData->m_bWriterRun && nQueueVersion == m_pClsData->m_nQueueVersion)
+            {
+                m_pClsData->m_cvWriterWake.wait_for(Lock, nWait);
+            }
+            m_pClsData->m_bWriterIdle.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    SThreadQueue* CLogger::GetThreadQueue()
+    {
+        auto& pQueue = t_ThreadQueue.pQueue;
+        if (!pQueue)
+        {
+            pQueue = std::make_shared<SThreadQueue>(m_pClsData->m_nThreadQueueSize);
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_queueLocker);
+            m_pClsData->m_vThreadQueues.push_back(pQueue);
+            m_pClsData->m_nQueueVersion++;
+        }
+        return pQueue.get();
+    }
+
+    size_t CLogger::MergeThreadQueues(std::vector<std::shared_ptr<SThreadQueue>>& vQueues, size_t nMaxCount)
+    {
+        // 只输出本批次开始前产生的日志，尚在入队途中的更早日志留到下一批次，尽量保证整体时间顺序
+        int64_t nLimit = GetTimestamp();
+        SLogRecord Record;
+        size_t nCount = 0;
+
+        while (nCount < nMaxCount)
+        {
+            // 选出队首时间戳最小的队列(同一线程内的日志天然有序)
+            SThreadQueue* pMinQueue = nullptr;
+            int64_t nMinTimestamp = nLimit;
+            for (auto& pQueue : vQueues)
+            {
+                SLogRecord* pFront = pQueue->Ring.Front();
+                if (pFront && pFront->nTimestamp <= nMinTimestamp)
+                {
+                    pMinQueue = pQueue.get();
+                    nMinTimestamp = pFront->nTimestamp;
+                }
+            }
+            if (!pMinQueue)
+            {
+                break;
+            }
+
+            std::swap(Record, *pMinQueue->Ring.Front());
+            pMinQueue->Ring.Pop();
+            DispatchLog(Record);
+            nCount++;
+        }
+        return nCount;
+    }
+
+    void CLogger::ReclaimThreadQueues(std::vector<std::shared_ptr<SThreadQueue>>& vQueues)
+    {
+        bool bReclaimed = false;
+        for (auto iter = vQueues.begin(); iter != vQueues.end();)
+        {
+            // 先判断退出标记，再判断队列是否为空，确保线程退出前写入的日志都已输出
+            auto& pQueue = *iter;
+            if (pQueue->bExited.load(std::memory_order_acquire) && pQueue->Ring.IsEmpty())
+            {
+                std::lock_guard<std::mutex> LockGuard(m_pClsData->m_queueLocker);
+                auto& vRegistered = m_pClsData->m_vThreadQueues;
+                for (auto it = vRegistered.begin(); it != vRegistered.end(); it++)
                 {
-                    sink.pSink->Flush();
+                    if (*it == pQueue)
+                    {
+                        vRegistered.erase(it);
+                        break;
+                    }
                 }
+                iter = vQueues.erase(iter);
+                bReclaimed = true;
             }
+            else
+            {
+                iter++;
+            }
+        }
+
+        if (bReclaimed)
+        {
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_queueLocker);
+            m_pClsData->m_nQueueVersion++;
+        }
+    }
+
+    void CLogger::NotifyQueueSpace()
+    {
+        // 生产者先登记等待再检查队列，写线程先出队再检查等待数量，两者至少有一方能看到对方的修改
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_pClsData->m_nSpaceWaiters.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_spaceLocker);
+            m_pClsData->m_cvQueueSpace.notify_all();
+        }
+    }
+
+    void CLogger::StopAsyncWriter()
+    {
+        {
+            std::lock_guard<std::mutex> LockGuard(m_pClsData->m_writerLocker);
+            m_pClsData->m_bWriterRun = false;
+            m_pClsData->m_cvWriterWake.notify_all();
+        }
+        if (m_pClsData->m_asyncWriteThread.joinable())
+        {
+            m_pClsData->m_asyncWriteThread.join();
         }
     }
 }
@@ -1,7 +1,14 @@
 ﻿#pragma once
+#include <climits>
+#include <chrono>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include "logmsg.h"
 #include "logsink.h"
+#include "logqueue.h"
+#include "logbin.h"
+#include "logtime.h"
 
 #ifdef XSLOG_LIB
 #define XSLOG_API
@@ -27,6 +34,31 @@ namespace xs
         LEVEL_MAX = LEVEL_FATAL // 最大日志等级
     };
 
+    // 日志输出模式
+    enum class EAsyncMode
+    {
+        MODE_SYNC = 0,          // 同步模式，调用线程直接写入各个输出对象
+        MODE_SHARED_QUEUE = 1,  // 异步模式，所有线程共用一个无锁多生产者队列
+        MODE_THREAD_QUEUE = 2,  // 异步模式，每个线程独占一个单生产者队列，写线程按时间顺序合并输出
+    };
+
+    // 一条完整的日志记录(异步模式下通过队列传递给写线程)
+    // 记录在线程与队列槽位之间交换使用，其中字符串的内存会被反复复用
+    struct SLogRecord
+    {
+        ELogLevel eLevel = ELogLevel::LEVEL_INFO;
+        std::string szLog;      // 日志文本(UTF-8编码)
+        bool bFlush = false;
+        bool bCaptureOnly = false;  // 是否只写入捕获等级不高于该日志等级的输出对象(低于输出等级的日志)
+        bool bReplay = false;       // 是否为日志作用域补写的缓存日志，已捕获过该日志的输出对象不再写入
+        std::thread::id ThreadId;
+        std::string szBinary;   // 二进制日志记录(延迟格式化模式)，非空时由分发端按需格式化到szLog
+        int64_t nTimestamp = 0; // 日志产生时间(steady_clock计数)，用于合并多个线程队列
+    };
+
+    // 线程独占的日志队列(定义见logger.cpp)
+    struct SThreadQueue;
+
     // 日志管理类
     class XSLOG_API CLogger
     {
@@ -38,45 +70,220 @@ namespace xs
         // 如果不设置，则默认INFO级别
         void SetOutputLevel(ELogLevel eOutputLevel);
 
+        // 判断某等级的日志是否需要输出(无锁读取，日志宏在构造日志消息前调用，用于提前过滤)
+        // 低于输出等级但不低于某个输出对象的捕获等级(如飞行记录器)的日志也需要输出，只写入这些输出对象
+        bool IsLevelEnabled(ELogLevel eLevel) const
+        {
+            return IsOutputLevel(eLevel) || eLevel >= m_pClsData->m_eCaptureLevel.load(std::memory_order_relaxed);
+        }
+
+        // 判断某等级的日志是否不低于输出等级(写入所有输出对象)
+        bool IsOutputLevel(ELogLevel eLevel) const
+        {
+            return eLevel >= m_pClsData->m_eOutputLevel.load(std::memory_order_relaxed);
+        }
+
+        // 按调用点开启或关闭日志输出，不影响其它调用点，例如只开启某个模块的调试日志而不降低全局输出等级
+        // pszFilePattern为文件名(不含路径)通配符，支持*与?，不区分大小写；nFirstLine~nLastLine为行号范围
+        // EnableSites开启等级不低于eLevel的调用点，DisableSites关闭等级不高于eLevel的调用点
+        // 规则按设置顺序依次匹配，后设置的规则优先，未匹配任何规则的调用点按输出等级过滤
+        void EnableSites(const wchar_t* pszFilePattern, ELogLevel eLevel = ELogLevel::LEVEL_DEBUG,
+            unsigned int nFirstLine = 0, unsigned int nLastLine = UINT_MAX);
+        void DisableSites(const wchar_t* pszFilePattern, ELogLevel eLevel = ELogLevel::LEVEL_FATAL,
+            unsigned int nFirstLine = 0, unsigned int nLastLine = UINT_MAX);
+        // 清除所有调用点规则，恢复为只按输出等级过滤
+        void ClearSiteRules();
+
+        // 设置日志时间戳格式：秒以下的精度(默认毫秒)，以及使用UTC时间还是本地时间(默认本地时间)
+        void SetTimeFormat(ETimePrecision ePrecision, bool bUtcTime = false);
+
+        // 设置日志输出模式，默认为同步模式
+        // 异步模式下调用线程只负责将日志记录放入无锁队列，由后台写线程统一写入各个输出对象
+        // nQueueSize为队列容量(向上取整为2的幂)，MODE_THREAD_QUEUE模式下为每个线程的队列容量
+        // 队列满时按溢出策略处理，默认调用线程会等待写线程腾出空间
+        // 非线程安全，必须在输出日志前设置
+        void SetAsyncMode(EAsyncMode eMode, size_t nQueueSize = 8192);
+        // 兼容接口，true表示MODE_SHARED_QUEUE，false表示MODE_SYNC
+        void SetAsyncMode(bool bAsync, size_t nQueueSize = 8192);
+
+        // 设置异步队列已满时的处理策略，默认一直等待写线程腾出空间
+        // OVERFLOW_DROP_OLDEST仅MODE_SHARED_QUEUE模式支持，MODE_THREAD_QUEUE模式下按OVERFLOW_DROP_NEWEST处理
+        // 丢弃日志后由写线程输出一条丢弃标记(WARNING)，非线程安全，必须在输出日志前设置
+        void SetOverflowPolicy(const SOverflowPolicy& Policy);
+
+        // 因异步队列已满而丢弃的日志条数(不含各输出对象自身丢弃的条数)
+        uint64_t DroppedCount() const;
+
+        // 已注册的线程独占队列个数(MODE_THREAD_QUEUE模式)，线程退出且其队列取空后由写线程回收
+        size_t ThreadQueueCount() const;
+
         // 添加日志输出对象
         // 如果不添加任何输出对象，则默认输出到控制台
+        // 输出对象列表以快照方式替换，不阻塞正在输出日志的线程，但需等待正在使用旧列表的线程完成分发
+        // 因此不能在输出对象的写入函数(如CFunctionSink的回调)中添加或删除输出对象
         void InsertLogSink(CLogSink::Ptr LogSink);
         void RemoveLogSink(CLogSink::Ptr LogSink);
 
         // 重载操作符，用于创建一个相应等级的日志消息的临时对象
         CLogMsg operator()(ELogLevel eLevel, const wchar_t* pFile, int nLine);
+        // 日志宏使用：调用点已完成过滤
+        CLogMsg operator()(const SLogLocation& Location);
+        CLogMsg operator()(const SLogSite& Site);
 
     protected:
         friend class CLogMsg;
+        friend class CBinLogMsg;
+        friend class CSegmentFileSink;
+        friend class CLogSink;
+        friend class CLogScope;
+        friend struct SLogSite;
+
+        // 根据输出等级与调用点规则更新调用点的输出标记(调用点注册时调用)
+        void UpdateSite(const SLogSite& Site);
 
-        // 获取日志等级对应的名称或简称
-        const std::wstring& LevelName(ELogLevel eLevel, bool bShortName = false);
+        // 获取日志等级对应的名称或简称(与日志对象的状态无关)
+        static const std::string& LevelName(ELogLevel eLevel, bool bShortName = false);
 
-        // 用于日志流对象推送一条完整日志记录
-        void PushLog(ELogLevel eLevel, std::wstring&& szLog, bool bFlush);
+        // 获取日志时间戳格式
+        ETimePrecision GetTimePrecision() const { return m_pClsData->m_eTimePrecision.load(std::memory_order_relaxed); }
+        bool IsUtcTime() const { return m_pClsData->m_bUtcTime.load(std::memory_order_relaxed); }
+
+        // 生成一条日志库自身的标记日志：[L 时间 线程 xslog:0] 文本
+        void FormatMarker(ELogLevel eLevel, const std::string& szText, std::string& szLog);
+
+        // 生成一条丢弃标记日志：[W 时间 线程 xslog:0] N messages dropped
+        void FormatDropMarker(uint64_t nDropped, std::string& szLog);
+
+        // 判断调用点只因捕获等级而开启时，是否有输出对象或当前线程的日志作用域需要该等级的日志
+        bool IsCaptured(ELogLevel eLevel) const;
+
+        // 判断是否有输出对象捕获该等级的日志
+        bool IsSinkCaptured(ELogLevel eLevel) const
+        {
+            return eLevel >= m_pClsData->m_eSinkCaptureLevel.load(std::memory_order_relaxed);
+        }
+
+        // 日志作用域使用：降低作用域的捕获等级(只降不升)，有变化时更新捕获等级
+        void LowerScopeLevel(ELogLevel eLevel);
+
+        // 日志作用域使用：推送作用域标记或补写缓存的日志(bReplay为true)，不再经过作用域
+        void PushScopeLog(ELogLevel eLevel, const char* pData, size_t nLength, bool bBinary, bool bReplay);
+
+        // 用于日志流对象推送一条完整日志记录(UTF-8编码)，调用前已完成等级过滤
+        // bCaptureOnly为true时只写入捕获等级不高于该日志等级的输出对象
+        void PushLog(ELogLevel eLevel, const char* pszLog, size_t nLength, bool bFlush, bool bCaptureOnly = false);
+
+        // 用于二进制日志消息推送一条二进制日志记录(延迟格式化模式)，调用点已完成过滤
+        // 记录复制到线程内复用的日志记录中，与队列槽位交换后通常不需要分配内存
+        void PushBinLog(ELogLevel eLevel, const char* pData, size_t nLength, bool bFlush, bool bCaptureOnly = false);
 
     private:
+        class CSinkReader;
+        typedef std::vector<CLogSink::Ptr> TSinkList;
+
         CLogger();
         ~CLogger();
 
+        // 按各输出对象与日志作用域的捕获等级更新日志管理类的捕获等级，有变化时更新所有已注册的调用点
+        void UpdateCaptureLevel();
+
+        // 添加一条调用点规则，并更新所有已注册的调用点
+        void AddSiteRule(const wchar_t* pszFilePattern, ELogLevel eLevel, unsigned int nFirstLine, unsigned int nLastLine, bool bEnable);
+
+        // 更新所有已注册调用点的输出标记
+        void UpdateAllSites();
+
+        // 推送日志记录：同步模式下直接分发，异步模式下放入队列
+        void PushRecord(SLogRecord& Record);
+
+        // 异步队列已满时按溢出策略处理，返回true表示继续尝试入队，false表示丢弃该记录
+        bool WaitQueueSpace(const SLogRecord& Record, bool bSharedQueue);
+
+        // 替换输出对象列表，等待所有正在使用旧列表的线程完成后释放旧列表，调用前必须持有输出对象列表的修改锁
+        void PublishSinks(TSinkList* pSinkList);
+
+        // 将一条日志记录写入所有输出对象(不加全局锁，各输出对象按需加自身的写入锁)
+        void DispatchLog(SLogRecord& Record);
+
+        // 加输出对象的写入锁，能自行同步的输出对象返回未加锁的对象
+        static std::unique_lock<std::mutex> LockSink(CLogSink& Sink);
+
+        // 刷新一个输出对象，需要持久化的输出对象记录到当前线程的待持久化列表，调用前必须持有该输出对象的写入锁
+        void FlushSink(const CLogSink::Ptr& pSink);
+
+        // 刷新已达到刷新间隔的输出对象(bForce为true时全部刷新)，返回距下次需要刷新的时间
+        std::chrono::milliseconds FlushSinks(bool bForce);
+
+        // 持久化当前线程待持久化的输出对象，必须在释放写入锁后调用，使多个线程可以共享一次持久化
+        void SyncSinks();
+
         // 日志异步触发线程入口函数
         void AsyncTriggerThread();
 
+        // 异步写线程入口函数(仅异步模式)
+        void AsyncWriteThread();
+
+        // 停止异步写线程，并输出队列中剩余的日志
+        void StopAsyncWriter();
+
+        // 唤醒等待队列空间的生产者
+        void NotifyQueueSpace();
+
+        // 获取当前线程独占的日志队列，首次调用时创建并注册
+        SThreadQueue* GetThreadQueue();
+
+        // 按时间顺序合并输出各线程队列中的日志，返回输出条数(仅写线程调用)
+        size_t MergeThreadQueues(std::vector<std::shared_ptr<SThreadQueue>>& vQueues, size_t nMaxCount);
+
+        // 回收已退出且队列已空的线程队列
+        void ReclaimThreadQueues(std::vector<std::shared_ptr<SThreadQueue>>& vQueues);
+
     private:
-        struct SSinkData
+        // 调用点规则
+        struct SSiteRule
         {
-            CLogSink::Ptr pSink;
-            bool bHasWritten = false;
+            std::wstring szFilePattern;     // 文件名通配符
+            ELogLevel eLevel;               // 开启时为最低等级，关闭时为最高等级
+            unsigned int nFirstLine;        // 起始行号
+            unsigned int nLastLine;         // 结束行号
+            bool bEnable;                   // 开启或关闭
         };
 
         struct SClassData
         {
-            std::mutex m_globalLocker;              // 全局互斥锁
-            ELogLevel m_eOutputLevel = ELogLevel::LEVEL_INFO;   // 日志输出等级，小于该等级的日志将会被忽略掉，默认为INFO
-            std::vector<SSinkData> m_vSinks;        // 日志输出对象列表，同一条日志会同步写入每一个输出对象
+            std::mutex m_triggerLocker;             // 触发线程等待用的互斥锁
+            std::atomic<ELogLevel> m_eOutputLevel{ ELogLevel::LEVEL_INFO }; // 日志输出等级，小于该等级的日志将会被忽略掉，默认为INFO
+            std::atomic<ELogLevel> m_eCaptureLevel{ ELogLevel::LEVEL_MAX }; // 输出对象与日志作用域捕获等级的最小值，低于输出等级的日志只写入捕获该等级的输出对象或作用域
+            std::atomic<ELogLevel> m_eSinkCaptureLevel{ ELogLevel::LEVEL_MAX };  // 各输出对象捕获等级的最小值
+            std::atomic<ELogLevel> m_eScopeLevel{ ELogLevel::LEVEL_MAX };    // 使用过的日志作用域捕获等级的最小值
+            std::atomic<ETimePrecision> m_eTimePrecision{ ETimePrecision::PRECISION_MILLI }; // 时间戳精度，默认为毫秒
+            std::atomic_bool m_bUtcTime{ false };   // 时间戳是否使用UTC时间，默认为本地时间
+            std::mutex m_sinkLocker;                // 输出对象列表的修改锁，只在添加、删除输出对象时使用
+            std::atomic<const TSinkList*> m_pSinkList{ nullptr };   // 日志输出对象列表的当前快照(不可修改)，同一条日志会同步写入每一个输出对象
+            std::atomic<uint32_t> m_nSinkEpoch{ 0 };    // 读取者计数的当前组，替换列表时切换
+            alignas(64) std::atomic<uint32_t> m_nSinkReaders[2] = {}; // 两组正在使用列表快照的线程数
             std::thread m_asyncTriggerThread;       // 日志异步输出触发线程，实现日志异步打印
             std::atomic_bool m_bThreadRun;          // 线程的运行标记，true指示继续运行，false指示线程退出
             std::condition_variable m_cvThreadStop; // 线程退出事件，指示线程立即退出
+            std::atomic<EAsyncMode> m_eAsyncMode{ EAsyncMode::MODE_SYNC }; // 日志输出模式
+            alignas(64) std::atomic<uint32_t> m_nAsyncPushers{ 0 }; // 正在入队的生产者数量，切换模式时等待其归零后才停止写线程、释放队列
+            CLogQueue<SLogRecord>* m_pLogQueue = nullptr;   // 异步日志队列(多生产者单消费者)
+            std::thread m_asyncWriteThread;         // 异步写线程，异步模式下由该线程统一调用所有输出对象
+            std::atomic_bool m_bWriterRun{ false }; // 写线程的运行标记
+            std::atomic_bool m_bWriterIdle{ false };// 写线程是否处于等待状态，生产者据此决定是否需要唤醒
+            std::mutex m_writerLocker;              // 写线程等待用的互斥锁
+            std::condition_variable m_cvWriterWake; // 写线程唤醒事件
+            std::mutex m_spaceLocker;               // 生产者等待队列空间用的互斥锁
+            std::condition_variable m_cvQueueSpace; // 队列空间事件，写线程每取出一批日志后通知
+            std::atomic<uint32_t> m_nSpaceWaiters{ 0 }; // 正在等待队列空间的生产者数量，为0时写线程无需通知
+            size_t m_nThreadQueueSize = 0;          // 线程独占队列的容量
+            std::mutex m_queueLocker;               // 线程队列列表的互斥锁
+            std::vector<std::shared_ptr<SThreadQueue>> m_vThreadQueues;   // 已注册的线程队列列表
+            std::atomic<uint64_t> m_nQueueVersion{ 0 }; // 线程队列列表的版本号，列表变化时递增
+            SOverflowPolicy m_OverflowPolicy;       // 异步队列已满时的处理策略
+            std::atomic<uint64_t> m_nDroppedCount{ 0 }; // 因异步队列已满而丢弃的日志条数
+            std::mutex m_siteLocker;                // 调用点规则的互斥锁，同时保护调用点输出标记的更新
+            std::vector<SSiteRule> m_vSiteRules;    // 调用点规则列表
         };
 
         SClassData* m_pClsData = nullptr;
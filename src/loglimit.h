@@ -0,0 +1,125 @@
+﻿#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace xs
+{
+    ////////////////////////////////////////////////////////////////////////
+    // 日志限流器(用于XSLOG_EVERY_N/XSLOG_FIRST_N/XSLOG_EVERY_T/XSLOG_RATE)
+    // - 每个日志语句对应一个静态实例，只使用原子变量，不加锁
+    // - 静态实例为常量初始化，不需要线程安全的静态初始化检查
+    // - Allow()返回false时日志语句被抑制，不会构造日志消息；返回true时nSuppressed为上次放行后被抑制的条数
+    // - 限流参数每次调用时传入，可以是运行期的值
+    ////////////////////////////////////////////////////////////////////////
+
+    // 单调时钟的当前时间(纳秒)
+    inline int64_t LimiterNow()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 每N次输出一次(第1次、第N+1次...)
+    class CLogEveryN
+    {
+    public:
+        bool Allow(uint64_t nCount, uint64_t& nSuppressed)
+        {
+            uint64_t nIndex = m_nCount.fetch_add(1, std::memory_order_relaxed);
+            if (nCount <= 1)
+            {
+                return true;
+            }
+            if (nIndex % nCount != 0)
+            {
+                return false;
+            }
+            nSuppressed = nIndex ? nCount - 1 : 0;
+            return true;
+        }
+
+    private:
+        std::atomic<uint64_t> m_nCount{ 0 };    // 调用次数
+    };
+
+    // 只输出前N次
+    class CLogFirstN
+    {
+    public:
+        bool Allow(uint64_t nCount, uint64_t& nSuppressed)
+        {
+            // 超出后不再递增，避免计数回绕
+            if (m_nCount.load(std::memory_order_relaxed) >= nCount)
+            {
+                return false;
+            }
+            return m_nCount.fetch_add(1, std::memory_order_relaxed) < nCount;
+        }
+
+    private:
+        std::atomic<uint64_t> m_nCount{ 0 };    // 已放行的次数
+    };
+
+    // 每隔指定毫秒数最多输出一次
+    class CLogEveryT
+    {
+    public:
+        bool Allow(uint64_t nMilliseconds, uint64_t& nSuppressed)
+        {
+            int64_t nNow = LimiterNow();
+            int64_t nNext = m_nNext.load(std::memory_order_relaxed);
+            // 同一时刻多个线程到达时只有一个能更新下次放行时间
+            if (nNow < nNext || !m_nNext.compare_exchange_strong(nNext, nNow + (int64_t)nMilliseconds * 1000000, std::memory_order_relaxed))
+            {
+                m_nSuppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            nSuppressed = m_nSuppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        std::atomic<int64_t> m_nNext{ 0 };          // 下次放行的时间
+        std::atomic<uint64_t> m_nSuppressed{ 0 };   // 被抑制的条数
+    };
+
+    // 令牌桶：每秒最多输出N条，允许N条的突发
+    // 使用GCRA算法实现，只需一个原子变量保存理论到达时间，与令牌桶等价
+    class CLogRate
+    {
+    public:
+        bool Allow(uint64_t nPerSecond, uint64_t& nSuppressed)
+        {
+            const int64_t nSecond = 1000000000;
+            if (nPerSecond == 0)
+            {
+                m_nSuppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            int64_t nInterval = nPerSecond >= (uint64_t)nSecond ? 1 : nSecond / (int64_t)nPerSecond;
+            int64_t nBurst = nSecond - nInterval;   // 允许超前的时间，即桶的容量
+            int64_t nNow = LimiterNow();
+            int64_t nTat = m_nTat.load(std::memory_order_relaxed);
+            while (true)
+            {
+                int64_t nStart = nTat > nNow ? nTat : nNow;
+                if (nStart - nNow > nBurst)
+                {
+                    // 桶中没有令牌
+                    m_nSuppressed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                if (m_nTat.compare_exchange_weak(nTat, nStart + nInterval, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            nSuppressed = m_nSuppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        std::atomic<int64_t> m_nTat{ 0 };           // 理论到达时间(Theoretical Arrival Time)
+        std::atomic<uint64_t> m_nSuppressed{ 0 };   // 被抑制的条数
+    };
+}
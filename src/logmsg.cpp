@@ -1,19 +1,72 @@
-﻿#include "logmsg.h"
+﻿#include <climits>
+#include <cstdlib>
+#include "logmsg.h"
 #include "logger.h"
+#include "logbuffer.h"
+#include "logformat.h"
+#include "logutf8.h"
 
 namespace xs
 {
+    // 日志缓存(UTF-8编码)与绑定在其上的流对象
+    struct SLogStream
+    {
+        TLogStreamBuf<char, 512> Buffer;
+        std::ostream Stream;
+        wchar_t chFill = L' ';      // 填充字符(流对象只能保存单字节的填充字符，非ASCII填充字符由日志消息自行处理)
+        bool bInUse = false;        // 是否正在被某条日志使用
+        bool bThreadLocal = false;  // 是否为线程内复用的对象(否则用完即释放)
+
+        SLogStream() : Stream(&Buffer) {}
+
+        // 恢复流对象的格式状态，与新建的流对象一致
+        void Reset()
+        {
+            Buffer.Clear();
+            Stream.clear();
+            Stream.flags(std::ios_base::skipws | std::ios_base::dec);
+            Stream.width(0);
+            Stream.precision(6);
+            Stream.fill(' ');
+            chFill = L' ';
+        }
+    };
+
+    // 获取日志缓存：优先使用线程内复用的对象，嵌套日志(输出参数时又产生了日志)时才临时创建
+    static SLogStream* AcquireStream()
+    {
+        static thread_local SLogStream ThreadStream;
+        if (!ThreadStream.bInUse)
+        {
+            ThreadStream.bInUse = true;
+            ThreadStream.bThreadLocal = true;
+            return &ThreadStream;
+        }
+        SLogStream* pStream = new SLogStream();
+        pStream->bInUse = true;
+        return pStream;
+    }
+
+    static void ReleaseStream(SLogStream* pStream)
+    {
+        if (pStream->bThreadLocal)
+        {
+            pStream->Reset();
+            pStream->bInUse = false;
+        }
+        else
+        {
+            delete pStream;
+        }
+    }
+
     SLogEndl CLogMsg::m_sLogEndl;
 
     CLogMsg::CLogMsg(CLogger& Logger, ELogLevel eLevel, const wchar_t* pszFile, unsigned int nLine)
-        : m_Logger(Logger), m_eLevel(eLevel), m_pOSStream(new std::wostringstream())
+        : m_Logger(Logger), m_eLevel(eLevel), m_pStream(AcquireStream())
     {
-        // 获取当前时间
-        std::chrono::time_point<std::chrono::system_clock> tpNowTime = std::chrono::system_clock::now();
-        std::chrono::milliseconds msDuration = std::chrono::duration_cast<std::chrono::milliseconds>(tpNowTime.time_since_epoch());
-        std::time_t ctNowTime = std::chrono::system_clock::to_time_t(tpNowTime);
-        struct tm tmNowTime = { 0 };
-        localtime_s(&tmNowTime, &ctNowTime);
+        m_pOSStream = &m_pStream->Stream;
+        AppendPrefix();
 
         // 截取文件名
         const wchar_t* pName = nullptr;
@@ -34,184 +87,392 @@ namespace xs
             pName = pszFile;
         } while (0);
 
-        // 输出日志前缀: [LEVEL YYYY-MM-DD HH:MM:SS.ZZZ THREAD FILE:LINE] MESSAGE
-        *m_pOSStream << L"[" << m_Logger.LevelName(m_eLevel, true)
-            << std::put_time(&tmNowTime, L" %F %T")
-            << L"." << std::setw(3) << std::setfill(L'0') << msDuration.count() % 1000 << L" "
-            << std::this_thread::get_id() << " "
-            << pName << L":" << nLine << L"] ";
+        auto& Buffer = m_pStream->Buffer;
+        size_t nNameLength = wcslen(pName);
+        Buffer.Commit(CLogUtf8::FromWide(pName, nNameLength, Buffer.Reserve(nNameLength * CLogUtf8::MAX_BYTES_PER_WCHAR)));
+        *m_pOSStream << ':' << nLine << "] ";
+    }
+
+    CLogMsg::CLogMsg(CLogger& Logger, const SLogLocation& Location)
+        : m_Logger(Logger), m_eLevel(Location.eLevel), m_pStream(AcquireStream()), m_bFiltered(true)
+    {
+        m_pOSStream = &m_pStream->Stream;
+        AppendPrefix();
+
+        // 文件名与行号已在编译期生成
+        auto& Buffer = m_pStream->Buffer;
+        Buffer.Append(Location.pszText, Location.nTextLength);
+        Buffer.Append("] ", 2);
+    }
+
+    CLogMsg::CLogMsg(CLogger& Logger, const SLogSite& Site)
+        : CLogMsg(Logger, *Site.pLocation)
+    {
+        m_bCaptureOnly = Site.bCaptureOnly.load(std::memory_order_relaxed);
     }
 
     CLogMsg::CLogMsg(CLogMsg&& Other) noexcept
-        : m_Logger(Other.m_Logger), m_eLevel(Other.m_eLevel), m_pOSStream(Other.m_pOSStream)
+        : m_Logger(Other.m_Logger), m_eLevel(Other.m_eLevel), m_pStream(Other.m_pStream), m_pOSStream(Other.m_pOSStream),
+        m_bFlush(Other.m_bFlush), m_bFiltered(Other.m_bFiltered), m_bCaptureOnly(Other.m_bCaptureOnly)
     {
+        Other.m_pStream = nullptr;
         Other.m_pOSStream = nullptr;
     }
 
     CLogMsg::~CLogMsg()
     {
-        if (m_pOSStream)
+        if (m_pStream)
         {
-            m_Logger.PushLog(m_eLevel, std::move(m_pOSStream->str()), m_bFlush);
+            if (m_bFiltered)
+            {
+                m_Logger.PushLog(m_eLevel, m_pStream->Buffer.Data(), m_pStream->Buffer.Size(), m_bFlush, m_bCaptureOnly);
+            }
+            else if (m_Logger.IsLevelEnabled(m_eLevel))
+            {
+                m_Logger.PushLog(m_eLevel, m_pStream->Buffer.Data(), m_pStream->Buffer.Size(), m_bFlush, !m_Logger.IsOutputLevel(m_eLevel));
+            }
 
-            delete m_pOSStream;
+            ReleaseStream(m_pStream);
+            m_pStream = nullptr;
             m_pOSStream = nullptr;
         }
     }
 
+    void CLogMsg::AppendPrefix()
+    {
+        // 输出日志前缀: [LEVEL YYYY-MM-DD HH:MM:SS.ZZZ THREAD FILE:LINE] MESSAGE
+        // 时间部分直接写入缓存，日期时间按秒缓存，避免每条日志都调用localtime_s/put_time
+        auto& Buffer = m_pStream->Buffer;
+        const std::string& szLevel = m_Logger.LevelName(m_eLevel, true);
+        Buffer.Append('[');
+        Buffer.Append(szLevel.data(), szLevel.size());
+        Buffer.Append(' ');
+        char* pszTime = Buffer.Reserve(CLogTime::MAX_LENGTH);
+        Buffer.Commit(CLogTime::Format(CLogTime::Now(), m_Logger.GetTimePrecision(), m_Logger.IsUtcTime(), pszTime));
+        Buffer.Append(' ');
+        *m_pOSStream << std::this_thread::get_id() << ' ';
+    }
+
+    void CLogMsg::AppendString(const char* pszVal, size_t nLength)
+    {
+        // 纯ASCII字符串与UTF-8字符串直接写入，其它编码的多字节字符串先转为宽字符
+        if (!CLogUtf8::IsAnsiUtf8() && !CLogUtf8::IsAscii(pszVal, nLength))
+        {
+            std::wstring szWide = ToWString(std::string(pszVal, nLength));
+            AppendWideString(szWide.data(), szWide.length());
+            return;
+        }
+        // 只有指定了宽度时才需要统计字符个数
+        AppendPadded(pszVal, nLength, 0, m_pOSStream->width() > 0 ? CLogUtf8::CountChars(pszVal, nLength) : nLength);
+    }
+
+    void CLogMsg::AppendWideString(const wchar_t* pszVal, size_t nLength)
+    {
+        auto& Buffer = m_pStream->Buffer;
+        size_t nPad = m_pOSStream->width() > 0 ? PaddingCount(CLogUtf8::CountChars(pszVal, nLength)) : 0;
+        bool bLeft = (m_pOSStream->flags() & std::ios_base::adjustfield) == std::ios_base::left;
+        if (!bLeft)
+        {
+            AppendFill(nPad);
+        }
+        Buffer.Commit(CLogUtf8::FromWide(pszVal, nLength, Buffer.Reserve(nLength * CLogUtf8::MAX_BYTES_PER_WCHAR)));
+        if (bLeft)
+        {
+            AppendFill(nPad);
+        }
+        m_pOSStream->width(0);
+    }
+
+    size_t CLogMsg::PaddingCount(size_t nCharCount)
+    {
+        std::streamsize nWidth = m_pOSStream->width();
+        return (nWidth > 0 && (size_t)nWidth > nCharCount) ? (size_t)nWidth - nCharCount : 0;
+    }
+
+    void CLogMsg::AppendFill(size_t nCount)
+    {
+        if (nCount == 0)
+        {
+            return;
+        }
+
+        auto& Buffer = m_pStream->Buffer;
+        wchar_t chFill = m_pStream->chFill;
+        if ((unsigned int)chFill < 0x80)
+        {
+            char* pDst = Buffer.Reserve(nCount);
+            std::fill(pDst, pDst + nCount, (char)chFill);
+            Buffer.Commit(nCount);
+            return;
+        }
+
+        // 非ASCII填充字符先编码为UTF-8，再重复写入
+        char szFill[8];
+        size_t nFillLength = CLogUtf8::FromWide(&chFill, 1, szFill);
+        char* pDst = Buffer.Reserve(nCount * nFillLength);
+        for (size_t i = 0; i < nCount; i++)
+        {
+            memcpy(pDst + i * nFillLength, szFill, nFillLength);
+        }
+        Buffer.Commit(nCount * nFillLength);
+    }
+
+    void CLogMsg::AppendPadded(const char* pszText, size_t nLength, size_t nPrefixLength, size_t nCharCount)
+    {
+        auto& Buffer = m_pStream->Buffer;
+        size_t nPad = PaddingCount(nCharCount);
+        std::ios_base::fmtflags nAdjust = m_pOSStream->flags() & std::ios_base::adjustfield;
+        if (nAdjust == std::ios_base::left)
+        {
+            Buffer.Append(pszText, nLength);
+            AppendFill(nPad);
+        }
+        else if (nAdjust == std::ios_base::internal)
+        {
+            Buffer.Append(pszText, nPrefixLength);
+            AppendFill(nPad);
+            Buffer.Append(pszText + nPrefixLength, nLength - nPrefixLength);
+        }
+        else
+        {
+            AppendFill(nPad);
+            Buffer.Append(pszText, nLength);
+        }
+        m_pOSStream->width(0);
+    }
+
+    void CLogMsg::AppendInteger(unsigned long long nMagnitude, unsigned long long nBits, bool bSigned, bool bNegative)
+    {
+        typedef TLogFormat<char> TFormat;
+        char szText[TFormat::MAX_INTEGER_LENGTH];
+        char* pszEnd = szText + TFormat::MAX_INTEGER_LENGTH;
+        char* pszBegin = nullptr;
+        std::ios_base::fmtflags nFlags = m_pOSStream->flags();
+        std::ios_base::fmtflags nBase = nFlags & std::ios_base::basefield;
+
+        // 与printf的%d/%x/%o规则一致：showpos只作用于有符号十进制，showbase对0不输出前缀
+        if (nBase == std::ios_base::hex)
+        {
+            bool bUpperCase = (nFlags & std::ios_base::uppercase) != 0;
+            pszBegin = TFormat::FormatHex(nBits, bUpperCase, pszEnd);
+            if ((nFlags & std::ios_base::showbase) && nBits != 0)
+            {
+                *--pszBegin = bUpperCase ? 'X' : 'x';
+                *--pszBegin = '0';
+            }
+        }
+        else if (nBase == std::ios_base::oct)
+        {
+            pszBegin = TFormat::FormatOctal(nBits, pszEnd);
+            if ((nFlags & std::ios_base::showbase) && nBits != 0)
+            {
+                *--pszBegin = '0';
+            }
+        }
+        else
+        {
+            pszBegin = TFormat::FormatDecimal(nMagnitude, pszEnd);
+            if (bNegative)
+            {
+                *--pszBegin = '-';
+            }
+            else if ((nFlags & std::ios_base::showpos) && bSigned)
+            {
+                *--pszBegin = '+';
+            }
+        }
+
+        size_t nPrefixLength = 0;
+        if (pszBegin[0] == '-' || pszBegin[0] == '+')
+        {
+            nPrefixLength = 1;
+        }
+        else if (pszEnd - pszBegin > 2 && pszBegin[0] == '0' && (pszBegin[1] == 'x' || pszBegin[1] == 'X'))
+        {
+            nPrefixLength = 2;
+        }
+        AppendPadded(pszBegin, (size_t)(pszEnd - pszBegin), nPrefixLength, (size_t)(pszEnd - pszBegin));
+    }
+
+    template<class TValue>
+    void CLogMsg::AppendFloat(TValue val)
+    {
+        typedef TLogFormat<char> TFormat;
+        if (!TFormat::IsShortestFloat(*m_pOSStream))
+        {
+            *m_pOSStream << val;
+            return;
+        }
+
+        char szText[TFormat::MAX_FLOAT_LENGTH];
+        size_t nLength = TFormat::FormatFloat(val, (m_pOSStream->flags() & std::ios_base::uppercase) != 0, szText);
+        AppendPadded(szText, nLength, szText[0] == '-' ? 1 : 0, nLength);
+    }
+
     CLogMsg& CLogMsg::operator<<(bool val)
     {
-        *m_pOSStream << val;
+        if (m_pOSStream->flags() & std::ios_base::boolalpha)
+        {
+            *m_pOSStream << val;
+        }
+        else
+        {
+            AppendInteger(val ? 1 : 0, val ? 1 : 0, true, false);
+        }
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(char val)
     {
-        *m_pOSStream << val;
+        AppendString((const char*)&val, 1);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(unsigned char val)
     {
-        *m_pOSStream << val;
+        AppendString((const char*)&val, 1);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(short val)
     {
-        *m_pOSStream << val;
+        AppendInteger(val < 0 ? 0 - (unsigned long long)val : (unsigned long long)val, (unsigned short)val, true, val < 0);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(unsigned short val)
     {
-        *m_pOSStream << val;
+        AppendInteger(val, val, false, false);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(int val)
     {
-        *m_pOSStream << val;
+        AppendInteger(val < 0 ? 0 - (unsigned long long)val : (unsigned long long)val, (unsigned int)val, true, val < 0);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(unsigned int val)
     {
-        *m_pOSStream << val;
+        AppendInteger(val, val, false, false);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(long val)
     {
-        *m_pOSStream << val;
+        AppendInteger(val < 0 ? 0 - (unsigned long long)val : (unsigned long long)val, (unsigned long)val, true, val < 0);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(unsigned long val)
     {
-        *m_pOSStream << val;
+        AppendInteger(val, val, false, false);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(long long val)
     {
-        *m_pOSStream << val;
+        AppendInteger(val < 0 ? 0 - (unsigned long long)val : (unsigned long long)val, (unsigned long long)val, true, val < 0);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(unsigned long long val)
     {
-        *m_pOSStream << val;
+        AppendInteger(val, val, false, false);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(float val)
     {
-        *m_pOSStream << val;
+        AppendFloat(val);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(double val)
     {
-        *m_pOSStream << val;
+        AppendFloat(val);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(long double val)
     {
-        *m_pOSStream << val;
+        AppendFloat(val);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(void* val)
     {
-        *m_pOSStream << val;
+        char szText[TLogFormat<char>::POINTER_LENGTH];
+        size_t nLength = TLogFormat<char>::FormatPointer(val, szText);
+        AppendPadded(szText, nLength, 0, nLength);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(const void* val)
     {
-        *m_pOSStream << val;
+        char szText[TLogFormat<char>::POINTER_LENGTH];
+        size_t nLength = TLogFormat<char>::FormatPointer(val, szText);
+        AppendPadded(szText, nLength, 0, nLength);
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(char* val)
     {
-        *m_pOSStream << ToWString(val);
+        AppendString(val, strlen(val));
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(const char* val)
     {
-        *m_pOSStream << ToWString(val);
+        AppendString(val, strlen(val));
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(std::string& val)
     {
-        *m_pOSStream << ToWString(val);
+        AppendString(val.data(), val.length());
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(const std::string& val)
     {
-        *m_pOSStream << ToWString(val);
+        AppendString(val.data(), val.length());
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(std::string&& val)
     {
-        *m_pOSStream << ToWString(val);
+        AppendString(val.data(), val.length());
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(wchar_t* val)
     {
-        *m_pOSStream << val;
+        AppendWideString(val, wcslen(val));
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(const wchar_t* val)
     {
-        *m_pOSStream << val;
+        AppendWideString(val, wcslen(val));
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(std::wstring& val)
     {
-        *m_pOSStream << val;
+        AppendWideString(val.data(), val.length());
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(const std::wstring& val)
     {
-        *m_pOSStream << val;
+        AppendWideString(val.data(), val.length());
         return *this;
     }
 
     CLogMsg& CLogMsg::operator<<(std::wstring&& val)
     {
-        *m_pOSStream << val;
+        AppendWideString(val.data(), val.length());
         return *this;
     }
 
@@ -231,6 +492,15 @@ namespace xs
         return *this;
     }
 
+    CLogMsg& CLogMsg::operator<<(const SLogSuppressed& val)
+    {
+        if (val.nCount)
+        {
+            *this << "[suppressed " << val.nCount << "] ";
+        }
+        return *this;
+    }
+
     CLogMsg& CLogMsg::operator<<(std::ostream& (__cdecl* Func)(std::ostream&))
     {
         *m_pOSStream << Func;
@@ -257,68 +527,64 @@ namespace xs
 
     CLogMsg& CLogMsg::operator<<(const std::_Fillobj<char>& _Manip)
     {
-        *m_pOSStream << std::_Fillobj<wchar_t>((int)_Manip._Fill);
-        return *this;
+        return *this << std::_Fillobj<wchar_t>((wchar_t)(unsigned char)_Manip._Fill);
     }
 
     CLogMsg& CLogMsg::operator<<(const std::_Fillobj<wchar_t>& _Manip)
     {
-        *m_pOSStream << _Manip;
+        // 流对象只用于输出bool(boolalpha)与非默认格式的浮点数，非ASCII填充字符对其使用空格代替
+        m_pStream->chFill = _Manip._Fill;
+        m_pOSStream->fill((unsigned int)_Manip._Fill < 0x80 ? (char)_Manip._Fill : ' ');
         return *this;
     }
 
     std::string CLogMsg::ToString(const std::wstring& szInput)
     {
         std::string szOutput;
+        size_t nLength = szInput.length();
+        if (nLength == 0)
+        {
+            return szOutput;
+        }
 
-        if (szInput.length() > 0)
+        // 先按UTF-8转换：ANSI代码页为UTF-8时即为结果；否则只要转换后字节数不变(全部为ASCII字符)，结果在任何代码页下都相同
+        CLogUtf8::FromWide(szInput.data(), nLength, szOutput);
+        if (CLogUtf8::IsAnsiUtf8() || szOutput.length() == nLength)
         {
-            static auto local = _create_locale(LC_ALL, "");
-            const wchar_t* pSrc = szInput.c_str();
-            size_t nDstCnt = 0; // included null terminator
-            errno_t err = _wcstombs_s_l(&nDstCnt, NULL, 0, pSrc, 0, local);
-            if (err == 0)
-            {
-                std::shared_ptr<char> dstPtr(new char[nDstCnt]);
-                if (dstPtr)
-                {
-                    char* pDst = dstPtr.get();
-                    err = _wcstombs_s_l(&nDstCnt, pDst, nDstCnt, pSrc, nDstCnt - 1, local);
-                    if (err == 0)
-                    {
-                        szOutput.assign(pDst, nDstCnt - 1);
-                    }
-                }
-            }
+            return szOutput;
         }
+
+        // 按当前区域设置转码，直接写入输出缓存(多字节字符最多占用MB_LEN_MAX个字节)
+        static auto local = _create_locale(LC_ALL, "");
+        size_t nDstCnt = 0; // included null terminator
+        szOutput.resize(nLength * MB_LEN_MAX + 1);
+        errno_t err = _wcstombs_s_l(&nDstCnt, &szOutput[0], szOutput.size(), szInput.c_str(), _TRUNCATE, local);
+        szOutput.resize((err == 0 || err == STRUNCATE) && nDstCnt > 0 ? nDstCnt - 1 : 0);
         return szOutput;
     }
 
     std::wstring CLogMsg::ToWString(const std::string& szInput)
     {
         std::wstring szOutput;
+        size_t nLength = szInput.length();
+        if (nLength == 0)
+        {
+            return szOutput;
+        }
 
-        if (szInput.length() > 0)
+        // 纯ASCII字符串或ANSI代码页为UTF-8时，直接按UTF-8解码
+        if (CLogUtf8::IsAnsiUtf8() || CLogUtf8::IsAscii(szInput.data(), nLength))
         {
-            static auto local = _create_locale(LC_ALL, "");
-            const char* pSrc = szInput.c_str();
-            size_t nDstCnt = 0; // included null terminator
-            errno_t err = _mbstowcs_s_l(&nDstCnt, NULL, 0, pSrc, 0, local);
-            if (err == 0)
-            {
-                std::shared_ptr<wchar_t> dstPtr(new wchar_t[nDstCnt]);
-                if (dstPtr)
-                {
-                    wchar_t* pDst = dstPtr.get();
-                    err = _mbstowcs_s_l(&nDstCnt, pDst, nDstCnt, pSrc, nDstCnt - 1, local);
-                    if (err == 0)
-                    {
-                        szOutput.assign(pDst, nDstCnt - 1);
-                    }
-                }
-            }
+            CLogUtf8::ToWide(szInput.data(), nLength, szOutput);
+            return szOutput;
         }
 
+        // 按当前区域设置转码，直接写入输出缓存(宽字符个数不超过字节数)
+        static auto local = _create_locale(LC_ALL, "");
+        size_t nDstCnt = 0; // included null terminator
+        szOutput.resize(nLength + 1);
+        errno_t err = _mbstowcs_s_l(&nDstCnt, &szOutput[0], szOutput.size(), szInput.c_str(), _TRUNCATE, local);
+        szOutput.resize((err == 0 || err == STRUNCATE) && nDstCnt > 0 ? nDstCnt - 1 : 0);
         return szOutput;
     }
 
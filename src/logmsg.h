@@ -3,6 +3,7 @@
 #include <string>
 #include <sstream>
 #include <iomanip>
+#include <cstring>
 
 #ifdef XSLOG_LIB
 #define XSLOG_API
@@ -18,15 +19,39 @@ namespace xs
 {
     class CLogger;
     enum class ELogLevel;
+    struct SLogStream;
+    struct SLogLocation;
+    struct SLogSite;
 
     struct SLogEndl
     {
     };
 
+    // 限流日志被再次放行时，在消息开头输出之前被抑制的条数(为0时不输出)
+    struct SLogSuppressed
+    {
+        unsigned long long nCount;
+    };
+
+    class CLogMsg;
+    class CBinLogMsg;
+
+    // 用于日志宏，将日志消息表达式的结果转换为void
+    // 其中operator&的优先级低于operator<<，从而保证整条流式表达式先于转换求值
+    struct SLogMsgVoidify
+    {
+        void operator&(const CLogMsg&) {}
+        void operator&(const CBinLogMsg&) {}
+    };
+
     class XSLOG_API CLogMsg
     {
     public:
         CLogMsg(CLogger& Logger, ELogLevel eLevel, const wchar_t* pszFile, unsigned int nLine);
+        // 使用编译期生成的调用点位置构造，直接复制预先生成的"file:line"文本(日志宏使用，调用点已完成过滤)
+        CLogMsg(CLogger& Logger, const SLogLocation& Location);
+        // 使用调用点构造(日志宏使用)，调用点只因输出对象的捕获等级而开启时，日志只写入这些输出对象
+        CLogMsg(CLogger& Logger, const SLogSite& Site);
         CLogMsg(const CLogMsg& Other) = delete;
         CLogMsg(CLogMsg&& Other) noexcept;
         ~CLogMsg();
@@ -71,6 +96,9 @@ namespace xs
         CLogMsg& operator<<(const SLogEndl&);
         CLogMsg& operator<<(SLogEndl&&);
 
+        // 支持输出被抑制的日志条数
+        CLogMsg& operator<<(const SLogSuppressed& val);
+
         // 支持流操作函数
         // call basic_ostream manipulator: std::endl/std::flush/...
         CLogMsg& operator<<(std::ostream& (__cdecl* Func)(std::ostream&));
@@ -89,10 +117,33 @@ namespace xs
 
         static SLogEndl m_sLogEndl;
 
+    private:
+        // 输出日志前缀中调用点位置之前的部分: [LEVEL YYYY-MM-DD HH:MM:SS.ZZZ THREAD 
+        void AppendPrefix();
+        // 输出多字节字符串
+        void AppendString(const char* pszVal, size_t nLength);
+        // 输出宽字符串(转为UTF-8)
+        void AppendWideString(const wchar_t* pszVal, size_t nLength);
+        // 计算按流对象的宽度需要填充的字符个数
+        size_t PaddingCount(size_t nCharCount);
+        // 输出nCount个填充字符
+        void AppendFill(size_t nCount);
+        // 按流对象的宽度与对齐方式输出已编码为UTF-8的文本，nCharCount为其字符个数
+        // nPrefixLength为符号与进制前缀的长度(std::internal时填充在其后)
+        void AppendPadded(const char* pszText, size_t nLength, size_t nPrefixLength, size_t nCharCount);
+        // 输出整数：十进制使用绝对值nMagnitude与符号bNegative(bSigned为有符号类型)，八进制与十六进制使用补码nBits
+        void AppendInteger(unsigned long long nMagnitude, unsigned long long nBits, bool bSigned, bool bNegative);
+        // 输出浮点数
+        template<class TValue>
+        void AppendFloat(TValue val);
+
     private:
         CLogger& m_Logger;                  // 日志对象的引用
         ELogLevel m_eLevel;                 // 日志等级(当前这条日志记录的等级)
-        std::wostringstream* m_pOSStream;   // 日志信息流(用于转码并缓存当前这条日志的每个片段)
+        SLogStream* m_pStream;              // 日志缓存(优先使用线程内复用的缓存，不分配堆内存)
+        std::ostream* m_pOSStream;          // 日志信息流(UTF-8编码，缓存当前这条日志的每个片段，并保存格式状态)
         bool m_bFlush = false;
+        bool m_bFiltered = false;           // 是否已在调用点完成过滤，否则析构时按输出等级过滤
+        bool m_bCaptureOnly = false;        // 是否只写入捕获等级不高于该日志等级的输出对象
     };
 }
@@ -0,0 +1,467 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <climits>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+#include "logger.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace xs
+{
+    // 连接超时(毫秒)
+    static const unsigned int CONNECT_TIMEOUT = 5000;
+    // 空闲时检查连接是否被对端关闭的间隔(毫秒)
+    static const unsigned int IDLE_CHECK_INTERVAL = 1000;
+    // 等待套接字时每次select的最长时间(毫秒)，以便及时响应退出
+    static const unsigned int SELECT_SLICE = 100;
+    // UDP数据报的最大载荷
+    static const size_t UDP_MAX_PAYLOAD = 65507;
+
+    // 网络输出的缓存、套接字与IO线程状态
+    struct SNetworkData
+    {
+        struct SSpoolEntry
+        {
+            std::string szLog;                  // 日志文本
+            ELogLevel eLevel;                   // 日志等级(丢弃最旧的日志时保留ERROR与FATAL)
+        };
+
+        SOCKET hSocket = INVALID_SOCKET;        // 套接字(只在IO线程中访问)
+        std::atomic<bool> bConnected{ false };  // 是否已连接
+        std::thread ioThread;                   // IO线程(首次输出日志时创建)
+        std::mutex locker;                      // 保护缓存与退出标记
+        std::condition_variable cvSend;         // 有待发送的日志、需要刷新或需要退出
+        std::condition_variable cvSpace;        // IO线程已从缓存中取走日志
+        std::deque<SSpoolEntry> dqSpool;        // 待发送的日志(从旧到新)
+        std::atomic<size_t> nSpoolBytes{ 0 };   // 缓存中日志的总字节数(持有锁时修改)
+        bool bStarted = false;                  // 是否已创建IO线程
+        std::atomic<bool> bStop{ false };       // IO线程退出标记
+        bool bCloseTimed = false;               // 是否已开始计算退出超时(只在IO线程中访问)
+        std::chrono::steady_clock::time_point tpCloseDeadline;  // 退出时发送剩余日志的截止时间(只在IO线程中访问)
+        std::atomic<uint64_t> nSentCount{ 0 };  // 已发送的日志条数
+    };
+
+    // 是否已超过退出时发送剩余日志的截止时间
+    static bool IsCloseTimeout(SNetworkData& Net, unsigned int nCloseTimeout)
+    {
+        if (!Net.bStop)
+        {
+            return false;
+        }
+        auto tpNow = std::chrono::steady_clock::now();
+        if (!Net.bCloseTimed)
+        {
+            Net.bCloseTimed = true;
+            Net.tpCloseDeadline = tpNow + std::chrono::milliseconds(nCloseTimeout);
+        }
+        return tpNow >= Net.tpCloseDeadline;
+    }
+
+    // 等待套接字可写，返回1表示可写，0表示超时或退出超时，-1表示出错
+    static int WaitWritable(SNetworkData& Net, SOCKET hSocket, unsigned int nTimeout, unsigned int nCloseTimeout)
+    {
+        auto tpDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeout);
+        while (!IsCloseTimeout(Net, nCloseTimeout) && std::chrono::steady_clock::now() < tpDeadline)
+        {
+            fd_set WriteFds;
+            fd_set ExceptFds;
+            FD_ZERO(&WriteFds);
+            FD_ZERO(&ExceptFds);
+            FD_SET(hSocket, &WriteFds);
+            FD_SET(hSocket, &ExceptFds);
+            timeval Timeout = { 0, (long)SELECT_SLICE * 1000 };
+            int nResult = ::select((int)hSocket + 1, nullptr, &WriteFds, &ExceptFds, &Timeout);
+            if (nResult == SOCKET_ERROR || FD_ISSET(hSocket, &ExceptFds))
+            {
+                return -1;
+            }
+            if (nResult > 0)
+            {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // 定义网络输出类
+    CNetworkSink::CNetworkSink(const std::string& szHost, unsigned short nPort, ENetProtocol eProtocol)
+        : CLogSink(false), m_pszHost(new std::string(szHost)), m_nPort(nPort)
+    {
+        m_Policy.eProtocol = eProtocol;
+        m_pNetData = new SNetworkData();
+
+        // 网络故障时优先保留最新的日志
+        SOverflowPolicy Overflow;
+        Overflow.ePolicy = EOverflowPolicy::OVERFLOW_DROP_OLDEST;
+        SetOverflowPolicy(Overflow);
+    }
+
+    CNetworkSink::~CNetworkSink()
+    {
+        if (m_pNetData)
+        {
+            // 通知IO线程在超时前发送剩余日志后退出
+            {
+                std::lock_guard<std::mutex> LockGuard(m_pNetData->locker);
+                m_pNetData->bStop = true;
+            }
+            m_pNetData->cvSend.notify_all();
+            if (m_pNetData->ioThread.joinable())
+            {
+                m_pNetData->ioThread.join();
+            }
+            delete m_pNetData;
+            m_pNetData = nullptr;
+        }
+
+        if (m_pszHost)
+        {
+            delete m_pszHost;
+            m_pszHost = nullptr;
+        }
+    }
+
+    void CNetworkSink::SetNetworkPolicy(const SNetworkPolicy& Policy)
+    {
+        m_Policy = Policy;
+        m_Policy.nBatchSize = (std::max)(m_Policy.nBatchSize, (size_t)1);
+        m_Policy.nDatagramSize = (std::min)((std::max)(m_Policy.nDatagramSize, (size_t)512), UDP_MAX_PAYLOAD);
+        m_Policy.nReconnectMin = (std::max)(m_Policy.nReconnectMin, 1u);
+        m_Policy.nReconnectMax = (std::max)(m_Policy.nReconnectMax, m_Policy.nReconnectMin);
+    }
+
+    void CNetworkSink::WriteLog(const std::string& szLog)
+    {
+        WriteLog(szLog, ELogLevel::LEVEL_INFO);
+    }
+
+    void CNetworkSink::WriteLog(const std::string& szLog, ELogLevel eLevel)
+    {
+        SNetworkData& Net = *m_pNetData;
+        bool bNotify = false;
+        {
+            // 先创建IO线程，等待空间时才有线程取走日志
+            std::lock_guard<std::mutex> LockGuard(Net.locker);
+            if (!Net.bStarted)
+            {
+                Net.bStarted = true;
+                Net.ioThread = std::thread(&CNetworkSink::NetworkThread, this);
+            }
+        }
+
+        // 缓存已满时按溢出策略处理
+        std::string szMarker;
+        if (!AdmitLog(eLevel, szMarker))
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> LockGuard(Net.locker);
+            // 缓存由空变为非空时才需要唤醒IO线程，其余情况IO线程发送完当前一批后会继续取
+            bNotify = Net.dqSpool.empty();
+            if (!szMarker.empty())
+            {
+                Net.nSpoolBytes += szMarker.size();
+                Net.dqSpool.push_back({ std::move(szMarker), ELogLevel::LEVEL_WARNING });
+            }
+            Net.nSpoolBytes += szLog.size();
+            Net.dqSpool.push_back({ szLog, eLevel });
+        }
+        if (bNotify)
+        {
+            Net.cvSend.notify_one();
+        }
+    }
+
+    void CNetworkSink::Flush()
+    {
+        // 只唤醒IO线程，不等待网络
+        m_pNetData->cvSend.notify_one();
+    }
+
+    bool CNetworkSink::IsConnected() const
+    {
+        return m_pNetData->bConnected;
+    }
+
+    uint64_t CNetworkSink::SentCount() const
+    {
+        return m_pNetData->nSentCount;
+    }
+
+    bool CNetworkSink::IsFull() const
+    {
+        return m_pNetData->nSpoolBytes >= m_Policy.nSpoolSize;
+    }
+
+    bool CNetworkSink::WaitSpace(unsigned int nTimeout)
+    {
+        SNetworkData& Net = *m_pNetData;
+        std::unique_lock<std::mutex> Lock(Net.locker);
+        auto IsReady = [this, &Net] { return Net.nSpoolBytes < m_Policy.nSpoolSize; };
+        if (nTimeout == 0)
+        {
+            Net.cvSpace.wait(Lock, IsReady);
+            return true;
+        }
+        return Net.cvSpace.wait_for(Lock, std::chrono::milliseconds(nTimeout), IsReady);
+    }
+
+    bool CNetworkSink::DropOldest()
+    {
+        // 从最旧的日志开始丢弃，保留ERROR与FATAL日志
+        SNetworkData& Net = *m_pNetData;
+        std::lock_guard<std::mutex> LockGuard(Net.locker);
+        uint64_t nDropped = 0;
+        for (auto it = Net.dqSpool.begin(); it != Net.dqSpool.end() && Net.nSpoolBytes >= m_Policy.nSpoolSize;)
+        {
+            if (it->eLevel >= ELogLevel::LEVEL_ERROR)
+            {
+                ++it;
+                continue;
+            }
+            Net.nSpoolBytes -= it->szLog.size();
+            it = Net.dqSpool.erase(it);
+            nDropped++;
+        }
+        AddDropped(nDropped);
+        return Net.nSpoolBytes < m_Policy.nSpoolSize;
+    }
+
+    bool CNetworkSink::Connect(const std::string& szHost, unsigned short nPort)
+    {
+        SNetworkData& Net = *m_pNetData;
+        bool bTcp = (m_Policy.eProtocol == ENetProtocol::PROTOCOL_TCP);
+        addrinfo Hints = { 0 };
+        Hints.ai_family = AF_UNSPEC;
+        Hints.ai_socktype = bTcp ? SOCK_STREAM : SOCK_DGRAM;
+        Hints.ai_protocol = bTcp ? IPPROTO_TCP : IPPROTO_UDP;
+        addrinfo* pAddrList = nullptr;
+        if (0 != ::getaddrinfo(szHost.c_str(), std::to_string(nPort).c_str(), &Hints, &pAddrList))
+        {
+            return false;
+        }
+
+        // 依次尝试解析到的各个地址
+        for (addrinfo* pAddr = pAddrList; pAddr && Net.hSocket == INVALID_SOCKET; pAddr = pAddr->ai_next)
+        {
+            SOCKET hSocket = ::socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+            if (hSocket == INVALID_SOCKET)
+            {
+                continue;
+            }
+            u_long nNonBlocking = 1;
+            ::ioctlsocket(hSocket, FIONBIO, &nNonBlocking);
+            if (bTcp)
+            {
+                // 已自行合并发送，关闭Nagle算法以免额外延迟
+                int nEnable = 1;
+                ::setsockopt(hSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&nEnable, sizeof(nEnable));
+                ::setsockopt(hSocket, SOL_SOCKET, SO_KEEPALIVE, (const char*)&nEnable, sizeof(nEnable));
+            }
+
+            // 非阻塞连接：等待可写后检查连接结果(UDP连接只是绑定目标地址，立即完成)
+            int nResult = ::connect(hSocket, pAddr->ai_addr, (int)pAddr->ai_addrlen);
+            if (nResult == SOCKET_ERROR && ::WSAGetLastError() == WSAEWOULDBLOCK)
+            {
+                int nError = 0;
+                socklen_t nErrorLength = sizeof(nError);
+                if (1 == WaitWritable(Net, hSocket, CONNECT_TIMEOUT, m_Policy.nCloseTimeout)
+                    && 0 == ::getsockopt(hSocket, SOL_SOCKET, SO_ERROR, (char*)&nError, &nErrorLength) && nError == 0)
+                {
+                    nResult = 0;
+                }
+            }
+            if (nResult == 0)
+            {
+                Net.hSocket = hSocket;
+            }
+            else
+            {
+                ::closesocket(hSocket);
+            }
+        }
+        ::freeaddrinfo(pAddrList);
+
+        Net.bConnected = (Net.hSocket != INVALID_SOCKET);
+        return Net.bConnected;
+    }
+
+    void CNetworkSink::Disconnect()
+    {
+        SNetworkData& Net = *m_pNetData;
+        if (Net.hSocket != INVALID_SOCKET)
+        {
+            ::closesocket(Net.hSocket);
+            Net.hSocket = INVALID_SOCKET;
+        }
+        Net.bConnected = false;
+    }
+
+    bool CNetworkSink::SendData(const char* pData, size_t nLength)
+    {
+        SNetworkData& Net = *m_pNetData;
+        while (nLength > 0)
+        {
+            int nSent = ::send(Net.hSocket, pData, (int)(std::min)(nLength, (size_t)INT_MAX), 0);
+            if (nSent == SOCKET_ERROR)
+            {
+                if (::WSAGetLastError() != WSAEWOULDBLOCK)
+                {
+                    return false;
+                }
+                // 发送缓冲区已满，等待可写(对端长时间不接收时由溢出策略限制缓存)
+                int nWait = 0;
+                while (0 == (nWait = WaitWritable(Net, Net.hSocket, IDLE_CHECK_INTERVAL, m_Policy.nCloseTimeout)))
+                {
+                    if (IsCloseTimeout(Net, m_Policy.nCloseTimeout))
+                    {
+                        return false;
+                    }
+                }
+                if (nWait < 0)
+                {
+                    return false;
+                }
+                continue;
+            }
+            pData += nSent;
+            nLength -= nSent;
+        }
+        return true;
+    }
+
+    void CNetworkSink::NetworkThread()
+    {
+        SNetworkData& Net = *m_pNetData;
+        WSADATA WsaData;
+        bool bWsaStarted = (0 == ::WSAStartup(MAKEWORD(2, 2), &WsaData));
+        bool bTcp = (m_Policy.eProtocol == ENetProtocol::PROTOCOL_TCP);
+        unsigned int nBackoff = m_Policy.nReconnectMin;
+        std::deque<std::string> dqBatch;    // 正在发送的一批日志，TCP发送失败时重连后重新发送
+        std::string szPacket;               // 一批日志的TCP帧或一个UDP数据报
+
+        std::unique_lock<std::mutex> Lock(Net.locker);
+        while (true)
+        {
+            // 未连接时连接，失败后按指数退避等待；退出时只再尝试一次
+            if (!Net.bConnected)
+            {
+                bool bStopping = Net.bStop;
+                Lock.unlock();
+                bool bConnected = bWsaStarted && Connect(*m_pszHost, m_nPort);
+                Lock.lock();
+                if (!bConnected)
+                {
+                    if (bStopping)
+                    {
+                        break;
+                    }
+                    Net.cvSend.wait_for(Lock, std::chrono::milliseconds(nBackoff), [&Net] { return Net.bStop.load(); });
+                    nBackoff = (std::min)(nBackoff * 2, m_Policy.nReconnectMax);
+                    continue;
+                }
+                nBackoff = m_Policy.nReconnectMin;
+            }
+
+            // 取一批日志：所有日志已发送且需要退出时结束；空闲时定期检查连接
+            if (dqBatch.empty())
+            {
+                if (!Net.cvSend.wait_for(Lock, std::chrono::milliseconds(IDLE_CHECK_INTERVAL), [&Net] { return Net.bStop || !Net.dqSpool.empty(); }))
+                {
+                    char ch = 0;
+                    int nResult = bTcp ? ::recv(Net.hSocket, &ch, 1, MSG_PEEK) : SOCKET_ERROR;
+                    if (bTcp && (nResult == 0 || (nResult == SOCKET_ERROR && ::WSAGetLastError() != WSAEWOULDBLOCK)))
+                    {
+                        Disconnect();
+                    }
+                    continue;
+                }
+                if (Net.dqSpool.empty())
+                {
+                    break;
+                }
+                size_t nBatchBytes = 0;
+                while (!Net.dqSpool.empty() && (dqBatch.empty() || nBatchBytes + Net.dqSpool.front().szLog.size() <= m_Policy.nBatchSize))
+                {
+                    nBatchBytes += Net.dqSpool.front().szLog.size();
+                    Net.nSpoolBytes -= Net.dqSpool.front().szLog.size();
+                    dqBatch.push_back(std::move(Net.dqSpool.front().szLog));
+                    Net.dqSpool.pop_front();
+                }
+                Net.cvSpace.notify_all();
+            }
+            Lock.unlock();
+
+            if (bTcp)
+            {
+                // 每条日志一帧：4字节网络字节序长度 + 日志文本，整批一次发送
+                szPacket.clear();
+                for (const std::string& szLog : dqBatch)
+                {
+                    uint32_t nLength = ::htonl((uint32_t)szLog.size());
+                    szPacket.append((const char*)&nLength, 4).append(szLog);
+                }
+                if (SendData(szPacket.data(), szPacket.size()))
+                {
+                    Net.nSentCount += dqBatch.size();
+                    dqBatch.clear();
+                }
+                else
+                {
+                    Disconnect();
+                }
+            }
+            else
+            {
+                // 多条日志拼接为一个数据报，超长的日志单独发送并截断；发送失败的数据报直接丢弃
+                while (!dqBatch.empty())
+                {
+                    size_t nCount = 0;
+                    szPacket.clear();
+                    for (; nCount < dqBatch.size() && szPacket.size() + dqBatch[nCount].size() <= m_Policy.nDatagramSize; nCount++)
+                    {
+                        szPacket.append(dqBatch[nCount]);
+                    }
+                    if (nCount == 0)
+                    {
+                        szPacket.assign(dqBatch[0], 0, UDP_MAX_PAYLOAD);
+                        nCount = 1;
+                    }
+                    if (SendData(szPacket.data(), szPacket.size()))
+                    {
+                        Net.nSentCount += nCount;
+                    }
+                    else
+                    {
+                        AddDropped(nCount);
+                    }
+                    dqBatch.erase(dqBatch.begin(), dqBatch.begin() + nCount);
+                }
+            }
+
+            Lock.lock();
+        }
+
+        // 退出时未能发送的日志计为丢弃
+        AddDropped(dqBatch.size() + Net.dqSpool.size());
+        Net.dqSpool.clear();
+        Net.nSpoolBytes = 0;
+        Net.cvSpace.notify_all();
+        Lock.unlock();
+
+        Disconnect();
+        if (bWsaStarted)
+        {
+            ::WSACleanup();
+        }
+    }
+}
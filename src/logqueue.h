@@ -0,0 +1,239 @@
+﻿#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace xs
+{
+    ////////////////////////////////////////////////////////////////////////
+    // 有界无锁队列(基于环形数组，每个槽位带序号，多生产者多消费者安全)
+    // - 日志模块中用作多生产者单消费者队列：任意线程入队，异步写线程出队(丢弃最旧日志时生产者也会出队)
+    // - 容量会向上取整为2的幂，队列满时TryPush返回false，由调用方决定如何处理
+    ////////////////////////////////////////////////////////////////////////
+    template<class T>
+    class CLogQueue
+    {
+    public:
+        explicit CLogQueue(size_t nCapacity)
+        {
+            size_t nSize = 2;
+            while (nSize < nCapacity)
+            {
+                nSize <<= 1;
+            }
+            m_nMask = nSize - 1;
+            m_pCells = new SCell[nSize];
+            for (size_t i = 0; i < nSize; i++)
+            {
+                m_pCells[i].nSequence.store(i, std::memory_order_relaxed);
+            }
+            m_nEnqueuePos.store(0, std::memory_order_relaxed);
+            m_nDequeuePos.store(0, std::memory_order_relaxed);
+        }
+
+        ~CLogQueue()
+        {
+            if (m_pCells)
+            {
+                delete[] m_pCells;
+                m_pCells = nullptr;
+            }
+        }
+
+        CLogQueue(const CLogQueue&) = delete;
+        CLogQueue& operator=(const CLogQueue&) = delete;
+
+        size_t Capacity() const { return m_nMask + 1; }
+
+        // 入队，入队后Item与槽位中的旧对象交换(复用其已分配的内存)，队列已满时返回false
+        bool TryPush(T& Item)
+        {
+            SCell* pCell = nullptr;
+            size_t nPos = m_nEnqueuePos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                pCell = &m_pCells[nPos & m_nMask];
+                size_t nSeq = pCell->nSequence.load(std::memory_order_acquire);
+                intptr_t nDiff = (intptr_t)nSeq - (intptr_t)nPos;
+                if (nDiff == 0)
+                {
+                    // 槽位空闲，尝试占用
+                    if (m_nEnqueuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (nDiff < 0)
+                {
+                    // 槽位仍未被消费，队列已满
+                    return false;
+                }
+                else
+                {
+                    // 被其他生产者抢先，重新读取位置
+                    nPos = m_nEnqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            std::swap(pCell->Data, Item);
+            pCell->nSequence.store(nPos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 出队，出队后Item与槽位中的对象交换，队列为空时返回false
+        bool TryPop(T& Item)
+        {
+            SCell* pCell = nullptr;
+            size_t nPos = m_nDequeuePos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                pCell = &m_pCells[nPos & m_nMask];
+                size_t nSeq = pCell->nSequence.load(std::memory_order_acquire);
+                intptr_t nDiff = (intptr_t)nSeq - (intptr_t)(nPos + 1);
+                if (nDiff == 0)
+                {
+                    if (m_nDequeuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (nDiff < 0)
+                {
+                    // 队列为空
+                    return false;
+                }
+                else
+                {
+                    nPos = m_nDequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            std::swap(pCell->Data, Item);
+            pCell->nSequence.store(nPos + m_nMask + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 判断队列是否为空(仅为瞬时状态，供消费者判断是否需要等待)
+        bool IsEmpty() const
+        {
+            size_t nPos = m_nDequeuePos.load(std::memory_order_acquire);
+            size_t nSeq = m_pCells[nPos & m_nMask].nSequence.load(std::memory_order_acquire);
+            return (intptr_t)nSeq - (intptr_t)(nPos + 1) < 0;
+        }
+
+        // 判断队列是否已满(仅为瞬时状态，供生产者判断是否需要等待)
+        bool IsFull() const
+        {
+            size_t nPos = m_nEnqueuePos.load(std::memory_order_acquire);
+            size_t nSeq = m_pCells[nPos & m_nMask].nSequence.load(std::memory_order_acquire);
+            return (intptr_t)nSeq - (intptr_t)nPos < 0;
+        }
+
+    private:
+        // 每个槽位独占缓存行，避免相邻生产者之间的伪共享
+        struct alignas(64) SCell
+        {
+            std::atomic<size_t> nSequence;
+            T Data;
+        };
+
+        SCell* m_pCells = nullptr;
+        size_t m_nMask = 0;
+        alignas(64) std::atomic<size_t> m_nEnqueuePos;  // 生产者写入位置
+        alignas(64) std::atomic<size_t> m_nDequeuePos;  // 消费者读取位置
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+    // 有界单生产者单消费者环形队列
+    // - 日志模块中每个生产者线程独占一个，写线程作为唯一消费者
+    // - 生产者与消费者各自缓存对方的位置，通常情况下入队/出队都不会访问对方的缓存行
+    ////////////////////////////////////////////////////////////////////////
+    template<class T>
+    class CLogRing
+    {
+    public:
+        explicit CLogRing(size_t nCapacity)
+        {
+            size_t nSize = 2;
+            while (nSize < nCapacity)
+            {
+                nSize <<= 1;
+            }
+            m_nMask = nSize - 1;
+            m_pItems = new T[nSize];
+        }
+
+        ~CLogRing()
+        {
+            if (m_pItems)
+            {
+                delete[] m_pItems;
+                m_pItems = nullptr;
+            }
+        }
+
+        CLogRing(const CLogRing&) = delete;
+        CLogRing& operator=(const CLogRing&) = delete;
+
+        size_t Capacity() const { return m_nMask + 1; }
+
+        // 入队(仅限生产者线程)，入队后Item与槽位中的旧对象交换，队列已满时返回false
+        bool TryPush(T& Item)
+        {
+            size_t nTail = m_nTail.load(std::memory_order_relaxed);
+            if (nTail - m_nHeadCache > m_nMask)
+            {
+                m_nHeadCache = m_nHead.load(std::memory_order_acquire);
+                if (nTail - m_nHeadCache > m_nMask)
+                {
+                    return false;
+                }
+            }
+            std::swap(m_pItems[nTail & m_nMask], Item);
+            m_nTail.store(nTail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 获取队首元素(仅限消费者线程)，队列为空时返回nullptr
+        T* Front()
+        {
+            size_t nHead = m_nHead.load(std::memory_order_relaxed);
+            if (nHead == m_nTailCache)
+            {
+                m_nTailCache = m_nTail.load(std::memory_order_acquire);
+                if (nHead == m_nTailCache)
+                {
+                    return nullptr;
+                }
+            }
+            return &m_pItems[nHead & m_nMask];
+        }
+
+        // 移除队首元素(仅限消费者线程)，调用前必须确认Front()不为空
+        void Pop()
+        {
+            m_nHead.store(m_nHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // 判断队列是否为空(仅为瞬时状态)
+        bool IsEmpty() const
+        {
+            return m_nHead.load(std::memory_order_acquire) == m_nTail.load(std::memory_order_acquire);
+        }
+
+        // 判断队列是否已满(仅为瞬时状态)
+        bool IsFull() const
+        {
+            return m_nTail.load(std::memory_order_acquire) - m_nHead.load(std::memory_order_acquire) > m_nMask;
+        }
+
+    private:
+        T* m_pItems = nullptr;
+        size_t m_nMask = 0;
+        alignas(64) std::atomic<size_t> m_nTail{ 0 };   // 生产者写入位置
+        size_t m_nHeadCache = 0;                        // 生产者缓存的消费者位置
+        alignas(64) std::atomic<size_t> m_nHead{ 0 };   // 消费者读取位置
+        size_t m_nTailCache = 0;                        // 消费者缓存的生产者位置
+    };
+}
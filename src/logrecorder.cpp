@@ -0,0 +1,397 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <atomic>
+#include <iostream>
+#include <limits>
+#include <algorithm>
+#include "logrecorder.h"
+#include "logger.h"
+
+namespace xs
+{
+    // 映射在文件起始处的文件头，写入位置由各写入线程原子递增
+    struct SRecorderHeader
+    {
+        char szMagic[4];                    // 魔数
+        uint32_t nVersion;                  // 版本
+        uint32_t nHeaderSize;               // 文件头大小(数据区偏移)
+        uint32_t nProcessId;                // 写入进程标识
+        uint64_t nCapacity;                 // 数据区大小
+        std::atomic<uint64_t> nWritePos;    // 写入位置
+        int64_t nCreateTime;                // 创建时间
+    };
+    static_assert(sizeof(SRecorderHeader) <= XSLOG_REC_HEADER_SIZE, "recorder header too large");
+
+    // 记录头中位置之后的部分
+    struct SRecorderEntry
+    {
+        uint32_t nLength;                   // 日志文本长度
+        uint8_t nLevel;                     // 日志等级
+        uint8_t nReserved[3];
+    };
+
+    // 按记录对齐向上取整
+    static uint64_t AlignRecord(uint64_t nSize)
+    {
+        return (nSize + XSLOG_REC_ALIGNMENT - 1) & ~(uint64_t)(XSLOG_REC_ALIGNMENT - 1);
+    }
+
+    // 从日志前缀"[L "中解析等级，无法解析时(如日志引导信息)记为INFO
+    static ELogLevel ParseLevel(const std::string& szLog)
+    {
+        static const char szLevels[] = "DTIWEF";
+        if (szLog.size() > 2 && szLog[0] == '[' && szLog[2] == ' ')
+        {
+            const char* pLevel = strchr(szLevels, szLog[1]);
+            if (pLevel && *pLevel)
+            {
+                return (ELogLevel)(pLevel - szLevels);
+            }
+        }
+        return ELogLevel::LEVEL_INFO;
+    }
+
+    // 飞行记录器的映射状态
+    struct SRecorderData
+    {
+        HANDLE hFile = nullptr;             // 文件句柄
+        HANDLE hMapping = nullptr;          // 文件映射对象句柄
+        char* pView = nullptr;              // 映射视图(整个文件)
+        SRecorderHeader* pHeader = nullptr; // 文件头
+        char* pRing = nullptr;              // 数据区
+        uint64_t nMask = 0;                 // 数据区大小 - 1
+        ELogLevel eCaptureLevel = ELogLevel::LEVEL_DEBUG;   // 捕获等级
+    };
+
+    // 定义飞行记录器输出类
+    CFlightRecorderSink::CFlightRecorderSink(const std::string& szFilePrefix, size_t nCapacity)
+        : CLogSink(false)
+    {
+        m_pRecorderData = new SRecorderData();
+        OpenFile(szFilePrefix + ".xslr", nCapacity);
+    }
+
+    CFlightRecorderSink::CFlightRecorderSink(const std::wstring& wszFilePrefix, size_t nCapacity)
+        : CLogSink(false)
+    {
+        m_pRecorderData = new SRecorderData();
+        OpenFile(CLogMsg::ToString(wszFilePrefix) + ".xslr", nCapacity);
+    }
+
+    CFlightRecorderSink::~CFlightRecorderSink()
+    {
+        if (m_pRecorderData)
+        {
+            CloseFile();
+            delete m_pRecorderData;
+            m_pRecorderData = nullptr;
+        }
+    }
+
+    void CFlightRecorderSink::SetCaptureLevel(ELogLevel eLevel)
+    {
+        m_pRecorderData->eCaptureLevel = eLevel;
+    }
+
+    ELogLevel CFlightRecorderSink::CaptureLevel() const
+    {
+        return m_pRecorderData->eCaptureLevel;
+    }
+
+    bool CFlightRecorderSink::IsOpened() const
+    {
+        return m_pRecorderData->pHeader != nullptr;
+    }
+
+    void CFlightRecorderSink::WriteLog(const std::string& szLog)
+    {
+        WriteLog(szLog, ParseLevel(szLog));
+    }
+
+    void CFlightRecorderSink::WriteLog(const std::string& szLog, ELogLevel eLevel)
+    {
+        SRecorderData& Data = *m_pRecorderData;
+        if (!Data.pHeader || szLog.empty())
+        {
+            return;
+        }
+
+        // 分配空间只需一次原子加法，超长的日志截断到数据区的一半
+        size_t nLength = (std::min)(szLog.size(), (size_t)((Data.nMask + 1) / 2 - XSLOG_REC_RECORD_HEADER_SIZE));
+        uint64_t nSize = AlignRecord(XSLOG_REC_RECORD_HEADER_SIZE + nLength);
+        uint64_t nPos = Data.pHeader->nWritePos.fetch_add(nSize, std::memory_order_relaxed);
+
+        // 先写入长度与日志文本，最后写入位置(取反)，读取时位置一致才认为记录完整
+        SRecorderEntry Entry = { (uint32_t)nLength, (uint8_t)eLevel, { 0, 0, 0 } };
+        CopyIn(nPos + sizeof(uint64_t), &Entry, sizeof(Entry));
+        CopyIn(nPos + XSLOG_REC_RECORD_HEADER_SIZE, szLog.data(), nLength);
+        reinterpret_cast<std::atomic<uint64_t>*>(Data.pRing + (nPos & Data.nMask))->store(~nPos, std::memory_order_release);
+    }
+
+    void CFlightRecorderSink::CopyIn(uint64_t nPos, const void* pData, size_t nLength)
+    {
+        SRecorderData& Data = *m_pRecorderData;
+        size_t nOffset = (size_t)(nPos & Data.nMask);
+        size_t nFirst = (std::min)(nLength, (size_t)(Data.nMask + 1 - nOffset));
+        memcpy(Data.pRing + nOffset, pData, nFirst);
+        if (nFirst < nLength)
+        {
+            memcpy(Data.pRing, (const char*)pData + nFirst, nLength - nFirst);
+        }
+    }
+
+    bool CFlightRecorderSink::OpenFile(const std::string& szFilePath, size_t nCapacity)
+    {
+        SRecorderData& Data = *m_pRecorderData;
+
+        // 数据区大小取2的幂，位置到偏移的换算只需按位与
+        uint64_t nRingSize = 64 * 1024;
+        while (nRingSize < nCapacity)
+        {
+            nRingSize <<= 1;
+        }
+
+        // 保留上次运行的记录(可能是崩溃前的记录)，只保留一份
+        std::string szBackup = szFilePath + ".1";
+        remove(szBackup.c_str());
+        rename(szFilePath.c_str(), szBackup.c_str());
+
+        // 允许其它进程在写入期间读取
+        HANDLE hFile = ::CreateFileA(szFilePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            std::cout << "open '" << szFilePath << "' error: " << ::GetLastError() << std::endl;
+            return false;
+        }
+        Data.hFile = hFile;
+
+        // 映射对象按文件头与数据区的大小扩展文件，新扩展的部分全为0
+        uint64_t nFileSize = XSLOG_REC_HEADER_SIZE + nRingSize;
+        Data.hMapping = ::CreateFileMappingW(hFile, NULL, PAGE_READWRITE, (DWORD)(nFileSize >> 32), (DWORD)nFileSize, NULL);
+        if (Data.hMapping)
+        {
+            Data.pView = (char*)::MapViewOfFile(Data.hMapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)nFileSize);
+        }
+        if (!Data.pView)
+        {
+            std::cout << "map '" << szFilePath << "' error: " << ::GetLastError() << std::endl;
+            CloseFile();
+            return false;
+        }
+
+        SRecorderHeader* pHeader = (SRecorderHeader*)Data.pView;
+        memcpy(pHeader->szMagic, XSLOG_REC_MAGIC, sizeof(XSLOG_REC_MAGIC));
+        pHeader->nVersion = XSLOG_REC_VERSION;
+        pHeader->nHeaderSize = XSLOG_REC_HEADER_SIZE;
+        pHeader->nProcessId = (uint32_t)::GetCurrentProcessId();
+        pHeader->nCapacity = nRingSize;
+        pHeader->nWritePos.store(0, std::memory_order_relaxed);
+        pHeader->nCreateTime = CLogTime::Now();
+        Data.pRing = Data.pView + XSLOG_REC_HEADER_SIZE;
+        Data.nMask = nRingSize - 1;
+        Data.pHeader = pHeader;
+        return true;
+    }
+
+    void CFlightRecorderSink::CloseFile()
+    {
+        // 映射的页面由系统写回文件，无需刷新
+        SRecorderData& Data = *m_pRecorderData;
+        Data.pHeader = nullptr;
+        Data.pRing = nullptr;
+        if (Data.pView)
+        {
+            ::UnmapViewOfFile(Data.pView);
+            Data.pView = nullptr;
+        }
+        if (Data.hMapping)
+        {
+            ::CloseHandle(Data.hMapping);
+            Data.hMapping = nullptr;
+        }
+        if (Data.hFile)
+        {
+            ::CloseHandle(Data.hFile);
+            Data.hFile = nullptr;
+        }
+    }
+
+    // 定义飞行记录器文件读取器
+    struct CLogRecorderReader::SReaderData
+    {
+        HANDLE hFile = INVALID_HANDLE_VALUE;
+        HANDLE hMapping = nullptr;
+        const char* pView = nullptr;
+        const SRecorderHeader* pHeader = nullptr;
+        const char* pRing = nullptr;
+        uint64_t nCapacity = 0;
+    };
+
+    CLogRecorderReader::CLogRecorderReader()
+    {
+        m_pData = new SReaderData();
+    }
+
+    CLogRecorderReader::~CLogRecorderReader()
+    {
+        if (m_pData)
+        {
+            Close();
+            delete m_pData;
+            m_pData = nullptr;
+        }
+    }
+
+    bool CLogRecorderReader::Open(const std::wstring& szFilePath)
+    {
+        Close();
+
+        SReaderData& Data = *m_pData;
+        Data.hFile = ::CreateFileW(szFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (Data.hFile == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER nFileSize = { 0 };
+        if (!::GetFileSizeEx(Data.hFile, &nFileSize) || nFileSize.QuadPart < XSLOG_REC_HEADER_SIZE
+            || (unsigned long long)nFileSize.QuadPart > (std::numeric_limits<size_t>::max)())
+        {
+            Close();
+            return false;
+        }
+        Data.hMapping = ::CreateFileMappingW(Data.hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (Data.hMapping)
+        {
+            Data.pView = (const char*)::MapViewOfFile(Data.hMapping, FILE_MAP_READ, 0, 0, (SIZE_T)nFileSize.QuadPart);
+        }
+        if (!Data.pView)
+        {
+            Close();
+            return false;
+        }
+
+        // 校验文件头，数据区大小必须为2的幂且与文件大小一致
+        const SRecorderHeader* pHeader = (const SRecorderHeader*)Data.pView;
+        uint64_t nCapacity = pHeader->nCapacity;
+        if (0 != memcmp(pHeader->szMagic, XSLOG_REC_MAGIC, sizeof(XSLOG_REC_MAGIC)) || pHeader->nVersion != XSLOG_REC_VERSION
+            || pHeader->nHeaderSize != XSLOG_REC_HEADER_SIZE || nCapacity == 0 || (nCapacity & (nCapacity - 1)) != 0
+            || (uint64_t)nFileSize.QuadPart < XSLOG_REC_HEADER_SIZE + nCapacity)
+        {
+            Close();
+            return false;
+        }
+        Data.pHeader = pHeader;
+        Data.pRing = Data.pView + XSLOG_REC_HEADER_SIZE;
+        Data.nCapacity = nCapacity;
+        return true;
+    }
+
+    void CLogRecorderReader::Close()
+    {
+        SReaderData& Data = *m_pData;
+        Data.pHeader = nullptr;
+        Data.pRing = nullptr;
+        Data.nCapacity = 0;
+        if (Data.pView)
+        {
+            ::UnmapViewOfFile(Data.pView);
+            Data.pView = nullptr;
+        }
+        if (Data.hMapping)
+        {
+            ::CloseHandle(Data.hMapping);
+            Data.hMapping = nullptr;
+        }
+        if (Data.hFile != INVALID_HANDLE_VALUE)
+        {
+            ::CloseHandle(Data.hFile);
+            Data.hFile = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    uint32_t CLogRecorderReader::ProcessId() const
+    {
+        return m_pData->pHeader ? m_pData->pHeader->nProcessId : 0;
+    }
+
+    int64_t CLogRecorderReader::CreateTime() const
+    {
+        return m_pData->pHeader ? m_pData->pHeader->nCreateTime : 0;
+    }
+
+    uint64_t CLogRecorderReader::Capacity() const
+    {
+        return m_pData->nCapacity;
+    }
+
+    uint64_t CLogRecorderReader::WritePosition() const
+    {
+        return m_pData->pHeader ? m_pData->pHeader->nWritePos.load(std::memory_order_acquire) : 0;
+    }
+
+    size_t CLogRecorderReader::Read(ELogLevel eMinLevel, const TRecordFunc& fnRecord) const
+    {
+        const SReaderData& Data = *m_pData;
+        if (!Data.pHeader)
+        {
+            return 0;
+        }
+
+        // 从环形数据区中复制一段数据(可能跨越数据区末尾)
+        uint64_t nMask = Data.nCapacity - 1;
+        auto CopyOut = [&Data, nMask](uint64_t nPos, void* pOutput, size_t nLength) {
+            size_t nOffset = (size_t)(nPos & nMask);
+            size_t nFirst = (std::min)(nLength, (size_t)(Data.nCapacity - nOffset));
+            memcpy(pOutput, Data.pRing + nOffset, nFirst);
+            memcpy((char*)pOutput + nFirst, Data.pRing, nLength - nFirst);
+        };
+
+        // 只有最近一圈(数据区大小)内的记录可能完整，从最旧的位置开始按对齐逐个校验
+        uint64_t nWritePos = WritePosition();
+        uint64_t nPos = nWritePos > Data.nCapacity ? nWritePos - Data.nCapacity : 0;
+        std::string szWrapped;
+        size_t nCount = 0;
+        while (nPos + XSLOG_REC_RECORD_HEADER_SIZE <= nWritePos)
+        {
+            uint64_t nStored = 0;
+            SRecorderEntry Entry;
+            CopyOut(nPos, &nStored, sizeof(nStored));
+            CopyOut(nPos + sizeof(uint64_t), &Entry, sizeof(Entry));
+            uint64_t nSize = AlignRecord(XSLOG_REC_RECORD_HEADER_SIZE + (uint64_t)Entry.nLength);
+            if (~nStored != nPos || Entry.nLength == 0 || Entry.nLevel > (uint8_t)ELogLevel::LEVEL_MAX || nPos + nSize > nWritePos)
+            {
+                // 已被覆盖或未写完，查找下一条记录
+                nPos += XSLOG_REC_ALIGNMENT;
+                continue;
+            }
+
+            if ((ELogLevel)Entry.nLevel >= eMinLevel)
+            {
+                SRecord Record;
+                Record.nPosition = nPos;
+                Record.eLevel = (ELogLevel)Entry.nLevel;
+                Record.nLength = Entry.nLength;
+                size_t nOffset = (size_t)((nPos + XSLOG_REC_RECORD_HEADER_SIZE) & nMask);
+                if (nOffset + Entry.nLength <= Data.nCapacity)
+                {
+                    Record.pData = Data.pRing + nOffset;
+                }
+                else
+                {
+                    szWrapped.resize(Entry.nLength);
+                    CopyOut(nPos + XSLOG_REC_RECORD_HEADER_SIZE, &szWrapped[0], Entry.nLength);
+                    Record.pData = szWrapped.data();
+                }
+                nCount++;
+                if (!fnRecord(Record))
+                {
+                    break;
+                }
+            }
+            nPos += nSize;
+        }
+        return nCount;
+    }
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <functional>
+
+#ifdef XSLOG_LIB
+#define XSLOG_API
+#else
+#ifdef XSLOG_EXPORTS
+#define XSLOG_API __declspec(dllexport)
+#else
+#define XSLOG_API __declspec(dllimport)
+#endif /* XSLOG_EXPORTS */
+#endif /* XSLOG_LIB */
+
+namespace xs
+{
+    enum class ELogLevel;
+
+    // 飞行记录器文件格式(CFlightRecorderSink生成的.xslr文件)：文件头之后是固定大小的环形数据区
+    // - 文件头：魔数(4) + 版本(u32) + 文件头大小(u32) + 进程标识(u32) + 数据区大小(u64，2的幂)
+    //      + 写入位置(u64，自创建起累计分配的字节数，写入线程原子递增) + 创建时间(i64，自1970-01-01 00:00:00 UTC起的纳秒数)
+    // - 数据区偏移 = 写入流中的位置 % 数据区大小，写到末尾后回到开头覆盖最旧的记录，一条记录可以跨越数据区末尾
+    // - 记录按8字节对齐：位置(u64，该记录在写入流中的位置按位取反) + 长度(u32) + 等级(u8) + 保留(u8 x 3) + 日志文本(UTF-8)
+    //      先写入长度与日志文本，最后写入位置；位置与记录实际所在的位置一致时记录才是完整的，
+    //      已被覆盖或写入途中崩溃的记录不一致，读取时跳过(取反是为了让全0的数据区不会被当作位置0的记录)
+    static const char XSLOG_REC_MAGIC[4] = { 'X', 'S', 'L', 'R' };
+    static const uint32_t XSLOG_REC_VERSION = 1;
+    static const uint32_t XSLOG_REC_HEADER_SIZE = 4096;
+    static const uint32_t XSLOG_REC_RECORD_HEADER_SIZE = 16;
+    static const uint32_t XSLOG_REC_ALIGNMENT = 8;
+
+    ////////////////////////////////////////////////////////////////////////
+    // 飞行记录器文件读取器(用于崩溃后导出最近的日志)
+    // - 以只读方式映射整个文件，从最旧的可能完整的位置开始按位置校验逐条读取，不一致时按对齐向后查找下一条记录
+    // - 可以读取正在写入的文件，但读取期间被覆盖的记录可能不完整
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CLogRecorderReader
+    {
+    public:
+        // 一条日志记录，文本只在回调期间有效
+        struct SRecord
+        {
+            uint64_t nPosition;         // 在写入流中的位置(越大越新)
+            ELogLevel eLevel;           // 日志等级
+            const char* pData;          // 日志文本(UTF-8)
+            size_t nLength;             // 日志文本长度
+        };
+
+        // 返回false时停止读取
+        typedef std::function<bool(const SRecord& Record)> TRecordFunc;
+
+        CLogRecorderReader();
+        ~CLogRecorderReader();
+
+        // 打开飞行记录器文件，文件不存在或格式不正确时返回false
+        bool Open(const std::wstring& szFilePath);
+        void Close();
+
+        // 文件头信息：写入进程标识、创建时间(纳秒)、数据区大小、写入位置
+        uint32_t ProcessId() const;
+        int64_t CreateTime() const;
+        uint64_t Capacity() const;
+        uint64_t WritePosition() const;
+
+        // 从旧到新读取等级不低于eMinLevel的完整记录，返回读取的记录数
+        size_t Read(ELogLevel eMinLevel, const TRecordFunc& fnRecord) const;
+
+    private:
+        struct SReaderData;
+        SReaderData* m_pData = nullptr;     // 映射区与文件头信息
+    };
+}
@@ -0,0 +1,186 @@
+﻿#include <vector>
+#include <memory>
+#include "logscope.h"
+#include "logger.h"
+
+namespace xs
+{
+    // 一条缓存的日志在缓存区中的位置
+    struct SScopeEntry
+    {
+        ELogLevel eLevel;
+        bool bBinary;           // 是否为二进制日志记录(延迟格式化模式)
+        size_t nOffset;         // 在缓存区中的偏移
+        size_t nLength;         // 长度
+    };
+
+    struct SScopeData
+    {
+        CLogScope* pScope = nullptr;
+        std::string szScopeId;                  // 请求或事务标识
+        ELogLevel eCaptureLevel = ELogLevel::LEVEL_DEBUG;   // 缓存的最低日志等级
+        size_t nBufferSize = 0;                 // 缓存容量
+        std::string szBuffer;                   // 缓存区，所有缓存的日志依次存放
+        std::vector<SScopeEntry> vEntries;      // 缓存的日志
+        uint64_t nDiscarded = 0;                // 因超出容量丢弃的条数
+        bool bMarked = false;                   // 是否已输出缓存
+    };
+
+    // 当前线程的作用域栈，作用域结束后缓存数据留给下一个作用域复用其内存
+    static thread_local std::vector<std::unique_ptr<SScopeData>> t_vScopes;
+    static thread_local size_t t_nScopeDepth = 0;
+
+    // 缓存一条日志，超出容量时丢弃最旧的一半
+    static void AppendEntry(SScopeData& Data, ELogLevel eLevel, const char* pData, size_t nLength, bool bBinary)
+    {
+        while (!Data.vEntries.empty() && Data.szBuffer.size() + nLength > Data.nBufferSize)
+        {
+            size_t nCount = (Data.vEntries.size() + 1) / 2;
+            size_t nShift = nCount < Data.vEntries.size() ? Data.vEntries[nCount].nOffset : Data.szBuffer.size();
+            Data.szBuffer.erase(0, nShift);
+            Data.vEntries.erase(Data.vEntries.begin(), Data.vEntries.begin() + nCount);
+            for (auto& Entry : Data.vEntries)
+            {
+                Entry.nOffset -= nShift;
+            }
+            Data.nDiscarded += nCount;
+        }
+        Data.vEntries.push_back({ eLevel, bBinary, Data.szBuffer.size(), nLength });
+        Data.szBuffer.append(pData, nLength);
+    }
+
+    // 先输出一条作用域标记，再按原顺序补写缓存的日志
+    void CLogScope::FlushScope(SScopeData& Data)
+    {
+        Data.bMarked = true;
+        if (Data.vEntries.empty() && Data.nDiscarded == 0)
+        {
+            return;
+        }
+
+        CLogger& Logger = CLogger::Inst();
+        std::string szText = "scope " + Data.szScopeId + ": " + std::to_string(Data.vEntries.size()) + " buffered messages";
+        if (Data.nDiscarded > 0)
+        {
+            szText.append(", ").append(std::to_string(Data.nDiscarded)).append(" discarded");
+        }
+        std::string szMarker;
+        Logger.FormatMarker(ELogLevel::LEVEL_INFO, szText, szMarker);
+        Logger.PushScopeLog(ELogLevel::LEVEL_INFO, szMarker.data(), szMarker.size(), false, false);
+        for (auto& Entry : Data.vEntries)
+        {
+            Logger.PushScopeLog(Entry.eLevel, Data.szBuffer.data() + Entry.nOffset, Entry.nLength, Entry.bBinary, true);
+        }
+        Data.vEntries.clear();
+        Data.szBuffer.clear();
+        Data.nDiscarded = 0;
+    }
+
+    CLogScope::CLogScope(const std::string& szScopeId, ELogLevel eCaptureLevel, size_t nBufferSize)
+    {
+        if (t_nScopeDepth == t_vScopes.size())
+        {
+            t_vScopes.emplace_back(new SScopeData());
+        }
+        m_pScopeData = t_vScopes[t_nScopeDepth].get();
+        m_pScopeData->pScope = this;
+        m_pScopeData->szScopeId = szScopeId;
+        m_pScopeData->eCaptureLevel = eCaptureLevel;
+        m_pScopeData->nBufferSize = nBufferSize;
+        m_pScopeData->bMarked = false;
+        t_nScopeDepth++;
+
+        // 首次使用该捕获等级时开启相应的调用点
+        CLogger::Inst().LowerScopeLevel(eCaptureLevel);
+    }
+
+    CLogScope::CLogScope(const std::string& szScopeId)
+        : CLogScope(szScopeId, ELogLevel::LEVEL_DEBUG)
+    {
+    }
+
+    CLogScope::~CLogScope()
+    {
+        // 正常结束时丢弃缓存，保留缓存区的内存供下一个作用域使用
+        SScopeData& Data = *m_pScopeData;
+        Data.pScope = nullptr;
+        Data.vEntries.clear();
+        Data.szBuffer.clear();
+        Data.nDiscarded = 0;
+        if (Data.szBuffer.capacity() > Data.nBufferSize * 2)
+        {
+            Data.szBuffer.shrink_to_fit();
+        }
+        t_nScopeDepth--;
+        m_pScopeData = nullptr;
+    }
+
+    void CLogScope::Mark()
+    {
+        if (!m_pScopeData->bMarked)
+        {
+            FlushScope(*m_pScopeData);
+        }
+    }
+
+    bool CLogScope::IsMarked() const
+    {
+        return m_pScopeData->bMarked;
+    }
+
+    size_t CLogScope::BufferedCount() const
+    {
+        return m_pScopeData->vEntries.size();
+    }
+
+    const std::string& CLogScope::ScopeId() const
+    {
+        return m_pScopeData->szScopeId;
+    }
+
+    CLogScope* CLogScope::Current()
+    {
+        return t_nScopeDepth > 0 ? t_vScopes[t_nScopeDepth - 1]->pScope : nullptr;
+    }
+
+    bool CLogScope::IsCapturing(ELogLevel eLevel)
+    {
+        return t_nScopeDepth > 0 && eLevel >= t_vScopes[t_nScopeDepth - 1]->eCaptureLevel;
+    }
+
+    bool CLogScope::CaptureLog(ELogLevel eLevel, const char* pData, size_t nLength, bool bBinary, bool& bCaptureOnly)
+    {
+        if (t_nScopeDepth == 0)
+        {
+            return false;
+        }
+
+        // 出现错误时由外到内输出所有作用域的缓存，缓存的上下文位于错误日志之前
+        if (eLevel >= ELogLevel::LEVEL_ERROR)
+        {
+            for (size_t i = 0; i < t_nScopeDepth; i++)
+            {
+                if (!t_vScopes[i]->bMarked)
+                {
+                    FlushScope(*t_vScopes[i]);
+                }
+            }
+            return false;
+        }
+
+        SScopeData& Data = *t_vScopes[t_nScopeDepth - 1];
+        if (!bCaptureOnly || eLevel < Data.eCaptureLevel)
+        {
+            return false;
+        }
+        if (Data.bMarked)
+        {
+            bCaptureOnly = false;
+            return false;
+        }
+        AppendEntry(Data, eLevel, pData, nLength, bBinary);
+
+        // 捕获该等级的输出对象(如飞行记录器)仍然立即写入
+        return !CLogger::Inst().IsSinkCaptured(eLevel);
+    }
+}
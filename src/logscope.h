@@ -0,0 +1,74 @@
+﻿#pragma once
+#include <cstddef>
+#include <string>
+
+#ifdef XSLOG_LIB
+#define XSLOG_API
+#else
+#ifdef XSLOG_EXPORTS
+#define XSLOG_API __declspec(dllexport)
+#else
+#define XSLOG_API __declspec(dllimport)
+#endif /* XSLOG_EXPORTS */
+#endif /* XSLOG_LIB */
+
+namespace xs
+{
+    enum class ELogLevel;
+
+    // 日志作用域的缓存数据(定义见logscope.cpp)
+    struct SScopeData;
+
+    ////////////////////////////////////////////////////////////////////////
+    // 日志作用域(按请求或事务延迟输出调试日志)
+    // - 在栈上创建，作用域内当前线程低于输出等级、不低于捕获等级的日志只缓存在作用域中，不写入输出对象
+    // - 作用域内出现ERROR及以上等级的日志时，先输出当前线程所有作用域(由外到内)的缓存，再输出该日志
+    // - 调用Mark()只输出本作用域的缓存；输出缓存后，本作用域之后的调试日志直接写入所有输出对象
+    // - 作用域正常结束时丢弃缓存；缓存超出容量时丢弃最旧的一半，输出时报告丢弃条数
+    // - 作用域可以嵌套，日志缓存在最内层的作用域中；只能在创建它的线程中使用，且必须按创建的相反顺序销毁
+    // - 首次使用某个捕获等级后，日志宏对该等级的调用点多一次线程局部的判断(没有作用域的线程不会构造日志)
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CLogScope
+    {
+    public:
+        static const size_t DEFAULT_BUFFER_SIZE = 256 * 1024;
+
+        // szScopeId为请求或事务标识(UTF-8)，输出缓存时写在缓存日志之前
+        // eCaptureLevel为缓存的最低日志等级，nBufferSize为缓存容量(字节)
+        explicit CLogScope(const std::string& szScopeId, ELogLevel eCaptureLevel, size_t nBufferSize = DEFAULT_BUFFER_SIZE);
+        explicit CLogScope(const std::string& szScopeId);
+        ~CLogScope();
+
+        CLogScope(const CLogScope& Other) = delete;
+        CLogScope& operator=(const CLogScope& Other) = delete;
+
+        // 标记本作用域需要输出：立即输出已缓存的日志，之后的调试日志直接输出
+        void Mark();
+        bool IsMarked() const;
+
+        // 当前缓存的日志条数
+        size_t BufferedCount() const;
+
+        const std::string& ScopeId() const;
+
+        // 当前线程最内层的日志作用域，没有时返回nullptr
+        static CLogScope* Current();
+
+    protected:
+        friend class CLogger;
+
+        // 当前线程是否有作用域需要捕获该等级的日志(用于调用点过滤)
+        static bool IsCapturing(ELogLevel eLevel);
+
+        // 日志对象推送日志前调用：缓存低于输出等级的日志，遇到错误日志时输出缓存
+        // 已输出缓存的作用域将bCaptureOnly改为false，使日志写入所有输出对象
+        // 返回true表示日志已缓存且没有其它输出对象需要，不必再推送
+        static bool CaptureLog(ELogLevel eLevel, const char* pData, size_t nLength, bool bBinary, bool& bCaptureOnly);
+
+    private:
+        // 输出作用域的缓存并标记为已输出
+        static void FlushScope(SScopeData& Data);
+
+        SScopeData* m_pScopeData = nullptr;     // 缓存数据(当前线程的作用域栈中的一项)
+    };
+}
@@ -0,0 +1,419 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <vector>
+#include <map>
+#include <memory>
+#include <limits>
+#include "logseg.h"
+#include "logbin.h"
+#include "logger.h"
+
+namespace xs
+{
+    // 从缓存中读取一个数值，数据不足时返回false
+    template<class T>
+    static bool ReadValue(const char*& pData, const char* pEnd, T& val)
+    {
+        if ((size_t)(pEnd - pData) < sizeof(T))
+        {
+            return false;
+        }
+        memcpy(&val, pData, sizeof(T));
+        pData += sizeof(T);
+        return true;
+    }
+
+    // 段尾中的一个索引项
+    struct SSegIndex
+    {
+        uint32_t nOffset;               // 块中第一条记录的偏移(相对段起始)
+        int64_t nMinTime;               // 块中的最小时间
+        int64_t nMaxTime;               // 块中的最大时间
+        unsigned char nLevelMask;       // 块中出现过的等级(按位)
+    };
+
+    // 一个完整段的段尾信息
+    struct SSegInfo
+    {
+        const char* pBase = nullptr;    // 段起始地址(映射区)
+        uint32_t nFooterOffset = 0;     // 段尾偏移，即记录区的结束位置
+        uint32_t nRecordCount = 0;
+        int64_t nMinTime = 0;
+        int64_t nMaxTime = 0;
+        uint32_t nLevelCounts[XSLOG_SEG_LEVEL_COUNT] = { 0 };
+        const char* pSites = nullptr;   // 调用点定义的起始地址(格式化二进制记录时才解析)
+        const char* pSitesEnd = nullptr;
+        uint32_t nSiteCount = 0;
+        std::vector<SSegIndex> vIndexes;
+    };
+
+    // 从段尾解析出的调用点(SLogSite中只保存文件名指针)
+    struct SSegSite
+    {
+        std::wstring szFile;
+        std::unique_ptr<SLogSite> pSite;
+    };
+
+    struct CLogSegmentReader::SReaderData
+    {
+        HANDLE hFile = INVALID_HANDLE_VALUE;    // 文件句柄
+        HANDLE hMapping = NULL;                 // 文件映射对象句柄
+        const char* pView = nullptr;            // 映射视图(整个文件)
+        size_t nSize = 0;                       // 文件大小
+        std::vector<SSegInfo> vSegments;        // 完整段的段尾信息
+        std::map<size_t, std::map<uint32_t, SSegSite>> mapSites;   // 段序号 -> 已解析的调用点
+        SBinLogFormat Format;                   // 二进制记录的文本日志前缀格式
+    };
+
+    // 解析一个段的段头与段尾，格式不正确或不完整时返回false
+    static bool ParseSegment(const char* pBase, size_t nAvailable, SSegInfo& Segment, uint32_t& nSegmentLength)
+    {
+        const char* pData = pBase;
+        const char* pEnd = pBase + nAvailable;
+        uint32_t nVersion = 0;
+        uint32_t nFooterOffset = 0;
+        if (nAvailable < XSLOG_SEG_HEADER_SIZE || 0 != memcmp(pData, XSLOG_SEG_MAGIC, sizeof(XSLOG_SEG_MAGIC)))
+        {
+            return false;
+        }
+        pData += sizeof(XSLOG_SEG_MAGIC);
+        ReadValue(pData, pEnd, nVersion);
+        ReadValue(pData, pEnd, nSegmentLength);
+        ReadValue(pData, pEnd, nFooterOffset);
+        if (nVersion == 0 || nVersion > XSLOG_SEG_VERSION || nSegmentLength > nAvailable
+            || nFooterOffset < XSLOG_SEG_HEADER_SIZE || nFooterOffset >= nSegmentLength)
+        {
+            return false;
+        }
+
+        // 段尾：记录数 + 时间范围 + 各等级记录数
+        pData = pBase + nFooterOffset;
+        pEnd = pBase + nSegmentLength;
+        Segment.pBase = pBase;
+        Segment.nFooterOffset = nFooterOffset;
+        if (!ReadValue(pData, pEnd, Segment.nRecordCount) || !ReadValue(pData, pEnd, Segment.nMinTime) || !ReadValue(pData, pEnd, Segment.nMaxTime))
+        {
+            return false;
+        }
+        for (unsigned int i = 0; i < XSLOG_SEG_LEVEL_COUNT; i++)
+        {
+            if (!ReadValue(pData, pEnd, Segment.nLevelCounts[i]))
+            {
+                return false;
+            }
+        }
+
+        // 调用点定义：只记录位置，跳过内容
+        if (!ReadValue(pData, pEnd, Segment.nSiteCount))
+        {
+            return false;
+        }
+        Segment.pSites = pData;
+        for (uint32_t i = 0; i < Segment.nSiteCount; i++)
+        {
+            uint16_t nNameLength = 0;
+            pData += sizeof(uint32_t) + sizeof(unsigned char) + sizeof(uint32_t);
+            if (pData > pEnd || !ReadValue(pData, pEnd, nNameLength) || (size_t)(pEnd - pData) < nNameLength * sizeof(wchar_t))
+            {
+                return false;
+            }
+            pData += nNameLength * sizeof(wchar_t);
+        }
+        Segment.pSitesEnd = pData;
+
+        // 索引项
+        uint32_t nIndexCount = 0;
+        if (!ReadValue(pData, pEnd, nIndexCount) || nIndexCount > (size_t)(pEnd - pData) / XSLOG_SEG_INDEX_SIZE)
+        {
+            return false;
+        }
+        Segment.vIndexes.resize(nIndexCount);
+        for (auto& Index : Segment.vIndexes)
+        {
+            if (!ReadValue(pData, pEnd, Index.nOffset) || !ReadValue(pData, pEnd, Index.nMinTime)
+                || !ReadValue(pData, pEnd, Index.nMaxTime) || !ReadValue(pData, pEnd, Index.nLevelMask)
+                || Index.nOffset < XSLOG_SEG_HEADER_SIZE || Index.nOffset > nFooterOffset)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    CLogSegmentReader::SQuery::SQuery()
+        : nBeginTime(std::numeric_limits<int64_t>::min()), nEndTime(std::numeric_limits<int64_t>::max()),
+        eMinLevel(ELogLevel::LEVEL_DEBUG), nThreadId(0)
+    {
+    }
+
+    CLogSegmentReader::CLogSegmentReader(const SBinLogFormat& Format)
+    {
+        m_pData = new SReaderData();
+        m_pData->Format = Format;
+    }
+
+    CLogSegmentReader::~CLogSegmentReader()
+    {
+        Close();
+        if (m_pData)
+        {
+            delete m_pData;
+            m_pData = nullptr;
+        }
+    }
+
+    bool CLogSegmentReader::Open(const std::wstring& szFilePath)
+    {
+        Close();
+
+        // 允许读取正在写入的日志文件，映射的是打开时的文件内容
+        SReaderData& Data = *m_pData;
+        Data.hFile = ::CreateFileW(szFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (Data.hFile == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER nFileSize = { 0 };
+        if (!::GetFileSizeEx(Data.hFile, &nFileSize) || nFileSize.QuadPart < XSLOG_SEG_HEADER_SIZE
+            || (unsigned long long)nFileSize.QuadPart > (std::numeric_limits<size_t>::max)())
+        {
+            Close();
+            return false;
+        }
+        Data.nSize = (size_t)nFileSize.QuadPart;
+        Data.hMapping = ::CreateFileMappingW(Data.hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (Data.hMapping)
+        {
+            Data.pView = (const char*)::MapViewOfFile(Data.hMapping, FILE_MAP_READ, 0, 0, Data.nSize);
+        }
+        if (!Data.pView)
+        {
+            Close();
+            return false;
+        }
+
+        // 依次读取各段的段头与段尾，遇到不完整的段时停止
+        size_t nOffset = 0;
+        while (nOffset < Data.nSize)
+        {
+            SSegInfo Segment;
+            uint32_t nSegmentLength = 0;
+            if (!ParseSegment(Data.pView + nOffset, Data.nSize - nOffset, Segment, nSegmentLength))
+            {
+                break;
+            }
+            Data.vSegments.push_back(std::move(Segment));
+            nOffset += nSegmentLength;
+        }
+        if (Data.vSegments.empty())
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void CLogSegmentReader::Close()
+    {
+        SReaderData& Data = *m_pData;
+        Data.mapSites.clear();
+        Data.vSegments.clear();
+        if (Data.pView)
+        {
+            ::UnmapViewOfFile(Data.pView);
+            Data.pView = nullptr;
+        }
+        if (Data.hMapping)
+        {
+            ::CloseHandle(Data.hMapping);
+            Data.hMapping = NULL;
+        }
+        if (Data.hFile != INVALID_HANDLE_VALUE)
+        {
+            ::CloseHandle(Data.hFile);
+            Data.hFile = INVALID_HANDLE_VALUE;
+        }
+        Data.nSize = 0;
+    }
+
+    size_t CLogSegmentReader::SegmentCount() const
+    {
+        return m_pData->vSegments.size();
+    }
+
+    int64_t CLogSegmentReader::MinTime() const
+    {
+        int64_t nMinTime = 0;
+        bool bFound = false;
+        for (auto& Segment : m_pData->vSegments)
+        {
+            if (Segment.nRecordCount > 0 && (!bFound || Segment.nMinTime < nMinTime))
+            {
+                nMinTime = Segment.nMinTime;
+                bFound = true;
+            }
+        }
+        return nMinTime;
+    }
+
+    int64_t CLogSegmentReader::MaxTime() const
+    {
+        int64_t nMaxTime = 0;
+        bool bFound = false;
+        for (auto& Segment : m_pData->vSegments)
+        {
+            if (Segment.nRecordCount > 0 && (!bFound || Segment.nMaxTime > nMaxTime))
+            {
+                nMaxTime = Segment.nMaxTime;
+                bFound = true;
+            }
+        }
+        return nMaxTime;
+    }
+
+    void CLogSegmentReader::CountLevels(int64_t nBeginTime, int64_t nEndTime, uint64_t nCounts[XSLOG_SEG_LEVEL_COUNT]) const
+    {
+        for (unsigned int i = 0; i < XSLOG_SEG_LEVEL_COUNT; i++)
+        {
+            nCounts[i] = 0;
+        }
+        for (auto& Segment : m_pData->vSegments)
+        {
+            if (Segment.nRecordCount == 0 || Segment.nMaxTime < nBeginTime || Segment.nMinTime > nEndTime)
+            {
+                continue;
+            }
+            for (unsigned int i = 0; i < XSLOG_SEG_LEVEL_COUNT; i++)
+            {
+                nCounts[i] += Segment.nLevelCounts[i];
+            }
+        }
+    }
+
+    size_t CLogSegmentReader::Query(const SQuery& Query, const TRecordFunc& fnRecord) const
+    {
+        unsigned int nMinLevel = (unsigned int)Query.eMinLevel;
+        if (nMinLevel >= XSLOG_SEG_LEVEL_COUNT)
+        {
+            nMinLevel = XSLOG_SEG_LEVEL_COUNT - 1;
+        }
+        unsigned char nLevelMask = (unsigned char)(((1u << XSLOG_SEG_LEVEL_COUNT) - 1) & ~((1u << nMinLevel) - 1));
+
+        size_t nMatched = 0;
+        const std::vector<SSegInfo>& vSegments = m_pData->vSegments;
+        for (size_t nSegment = 0; nSegment < vSegments.size(); nSegment++)
+        {
+            // 按段尾的时间范围与各等级记录数跳过整段
+            const SSegInfo& Segment = vSegments[nSegment];
+            if (Segment.nRecordCount == 0 || Segment.nMaxTime < Query.nBeginTime || Segment.nMinTime > Query.nEndTime)
+            {
+                continue;
+            }
+            bool bHasLevel = false;
+            for (unsigned int i = nMinLevel; i < XSLOG_SEG_LEVEL_COUNT && !bHasLevel; i++)
+            {
+                bHasLevel = Segment.nLevelCounts[i] > 0;
+            }
+            if (!bHasLevel)
+            {
+                continue;
+            }
+
+            for (size_t nIndex = 0; nIndex < Segment.vIndexes.size(); nIndex++)
+            {
+                // 按索引块的时间范围与等级掩码跳过整块
+                const SSegIndex& Index = Segment.vIndexes[nIndex];
+                if (Index.nMaxTime < Query.nBeginTime || Index.nMinTime > Query.nEndTime || 0 == (Index.nLevelMask & nLevelMask))
+                {
+                    continue;
+                }
+
+                const char* pData = Segment.pBase + Index.nOffset;
+                const char* pEnd = Segment.pBase + (nIndex + 1 < Segment.vIndexes.size() ? Segment.vIndexes[nIndex + 1].nOffset : Segment.nFooterOffset);
+                while (pData < pEnd)
+                {
+                    SRecord Record;
+                    unsigned char nLevel = 0;
+                    char chType = 0;
+                    uint32_t nLength = 0;
+                    if (!ReadValue(pData, pEnd, Record.nTimestamp) || !ReadValue(pData, pEnd, Record.nThreadId) || !ReadValue(pData, pEnd, Record.nSiteId)
+                        || !ReadValue(pData, pEnd, nLevel) || !ReadValue(pData, pEnd, chType) || !ReadValue(pData, pEnd, nLength)
+                        || (size_t)(pEnd - pData) < nLength)
+                    {
+                        // 记录区损坏，跳过该块的剩余部分
+                        break;
+                    }
+                    Record.eLevel = (ELogLevel)nLevel;
+                    Record.bText = (chType == XSLOG_BIN_ENTRY_TEXT);
+                    Record.pData = pData;
+                    Record.nLength = nLength;
+                    Record.nSegment = nSegment;
+                    pData += nLength;
+
+                    if (nLevel < nMinLevel || Record.nTimestamp < Query.nBeginTime || Record.nTimestamp > Query.nEndTime
+                        || (Query.nThreadId != 0 && Record.nThreadId != Query.nThreadId))
+                    {
+                        continue;
+                    }
+                    nMatched++;
+                    if (!fnRecord(Record))
+                    {
+                        return nMatched;
+                    }
+                }
+            }
+        }
+        return nMatched;
+    }
+
+    bool CLogSegmentReader::Format(const SRecord& Record, std::string& szLog) const
+    {
+        if (Record.bText)
+        {
+            szLog.assign(Record.pData, Record.nLength);
+            if (szLog.empty() || szLog.back() != '\n')
+            {
+                szLog += '\n';
+            }
+            return true;
+        }
+
+        // 首次格式化某段的二进制记录时解析该段的调用点定义
+        if (Record.nSegment >= m_pData->vSegments.size())
+        {
+            return false;
+        }
+        auto iterSegment = m_pData->mapSites.find(Record.nSegment);
+        if (iterSegment == m_pData->mapSites.end())
+        {
+            const SSegInfo& Segment = m_pData->vSegments[Record.nSegment];
+            std::map<uint32_t, SSegSite>& mapSites = m_pData->mapSites[Record.nSegment];
+            const char* pData = Segment.pSites;
+            for (uint32_t i = 0; i < Segment.nSiteCount; i++)
+            {
+                uint32_t nSiteId = 0;
+                unsigned char nLevel = 0;
+                uint32_t nLine = 0;
+                uint16_t nNameLength = 0;
+                ReadValue(pData, Segment.pSitesEnd, nSiteId);
+                ReadValue(pData, Segment.pSitesEnd, nLevel);
+                ReadValue(pData, Segment.pSitesEnd, nLine);
+                ReadValue(pData, Segment.pSitesEnd, nNameLength);
+                SSegSite& Site = mapSites[nSiteId];
+                Site.szFile.assign((const wchar_t*)pData, nNameLength);
+                Site.pSite.reset(new SLogSite(nSiteId, (ELogLevel)nLevel, Site.szFile.c_str(), nLine));
+                pData += nNameLength * sizeof(wchar_t);
+            }
+            iterSegment = m_pData->mapSites.find(Record.nSegment);
+        }
+
+        auto iterSite = iterSegment->second.find(Record.nSiteId);
+        if (iterSite == iterSegment->second.end() || !CBinLogMsg::Format(*iterSite->second.pSite, Record.pData, Record.nLength, m_pData->Format, szLog))
+        {
+            return false;
+        }
+        szLog += '\n';
+        return true;
+    }
+}
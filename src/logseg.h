@@ -0,0 +1,102 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <functional>
+#include "logbin.h"
+
+#ifdef XSLOG_LIB
+#define XSLOG_API
+#else
+#ifdef XSLOG_EXPORTS
+#define XSLOG_API __declspec(dllexport)
+#else
+#define XSLOG_API __declspec(dllimport)
+#endif /* XSLOG_EXPORTS */
+#endif /* XSLOG_LIB */
+
+namespace xs
+{
+    enum class ELogLevel;
+
+    // 分段二进制日志文件格式(CSegmentFileSink生成的.xsls文件)：若干个独立的段依次拼接，每段可单独解析
+    // - 段头：魔数(4) + 版本(u32) + 段长度(u32，含段头与段尾) + 段尾偏移(u32，相对段起始)
+    // - 记录：时间戳(i64，纳秒) + 线程标识(u32) + 调用点标识(u32，文本日志为0) + 等级(u8) + 类型(u8) + 长度(u32) + 数据
+    //      类型为'R'时数据为二进制日志记录(延迟格式化模式)，为'T'时数据为已格式化的日志文本(UTF-8)
+    // - 段尾：记录数(u32) + 最小时间(i64) + 最大时间(i64) + 各等级记录数(u32 x 6)
+    //      + 调用点定义个数(u32) + 每个定义：标识(u32) + 等级(u8) + 行号(u32) + 文件名长度(u16) + 文件名(wchar_t)
+    //      + 索引项个数(u32) + 每项：偏移(u32，相对段起始) + 最小时间(i64) + 最大时间(i64) + 等级掩码(u8)
+    // - 每XSLOG_SEG_INDEX_INTERVAL条记录为一个索引块，按时间与等级查询时只读取可能匹配的段与块
+    static const char XSLOG_SEG_MAGIC[4] = { 'X', 'S', 'L', 'S' };
+    static const uint32_t XSLOG_SEG_VERSION = 1;
+    static const uint32_t XSLOG_SEG_HEADER_SIZE = 16;
+    static const uint32_t XSLOG_SEG_RECORD_HEADER_SIZE = 22;
+    static const uint32_t XSLOG_SEG_INDEX_SIZE = 21;
+    static const uint32_t XSLOG_SEG_INDEX_INTERVAL = 64;
+    static const unsigned int XSLOG_SEG_LEVEL_COUNT = 6;
+
+    ////////////////////////////////////////////////////////////////////////
+    // 分段二进制日志文件读取器(用于离线查询工具)
+    // - 以只读方式映射整个文件，打开时只读取各段的段头与段尾
+    // - 查询时跳过时间范围或等级不匹配的段与索引块，只遍历可能匹配的块中的记录
+    // - 文件末尾不完整的段(异常退出时未写完)被忽略
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CLogSegmentReader
+    {
+    public:
+        // 一条日志记录，数据指向映射区，只在回调期间有效
+        struct SRecord
+        {
+            int64_t nTimestamp;         // 时间戳(自1970-01-01 00:00:00 UTC起的纳秒数)
+            uint32_t nThreadId;         // 线程标识
+            uint32_t nSiteId;           // 调用点标识(文本日志为0)
+            ELogLevel eLevel;           // 日志等级
+            bool bText;                 // 数据是否为已格式化的文本
+            const char* pData;          // 记录数据
+            size_t nLength;             // 记录数据长度
+            size_t nSegment;            // 所在段的序号
+        };
+
+        // 查询条件，时间范围为闭区间
+        struct SQuery
+        {
+            SQuery();
+
+            int64_t nBeginTime;         // 起始时间(纳秒)，默认不限
+            int64_t nEndTime;           // 结束时间(纳秒)，默认不限
+            ELogLevel eMinLevel;        // 最低等级，默认为LEVEL_DEBUG
+            uint32_t nThreadId;         // 线程标识，默认为0表示不限
+        };
+
+        // 返回false时停止查询
+        typedef std::function<bool(const SRecord& Record)> TRecordFunc;
+
+        // 二进制记录的文本日志前缀按Format格式化(等级名称数组须在读取器的生命期内有效)
+        explicit CLogSegmentReader(const SBinLogFormat& Format = SBinLogFormat());
+        ~CLogSegmentReader();
+
+        // 打开分段日志文件，文件不存在、格式不正确或没有完整的段时返回false
+        bool Open(const std::wstring& szFilePath);
+        void Close();
+
+        // 完整段的个数
+        size_t SegmentCount() const;
+
+        // 文件中的最小与最大时间戳(纳秒)，没有记录时均为0
+        int64_t MinTime() const;
+        int64_t MaxTime() const;
+
+        // 统计时间范围内可能匹配的记录数(只读取段尾，按段累加各等级的记录数，部分重叠的段整段计入)
+        void CountLevels(int64_t nBeginTime, int64_t nEndTime, uint64_t nCounts[XSLOG_SEG_LEVEL_COUNT]) const;
+
+        // 按条件查询记录，按文件中的顺序回调，返回匹配的记录数
+        size_t Query(const SQuery& Query, const TRecordFunc& fnRecord) const;
+
+        // 将记录格式化为文本日志(UTF-8编码，以换行符结尾)
+        bool Format(const SRecord& Record, std::string& szLog) const;
+
+    private:
+        struct SReaderData;
+        SReaderData* m_pData = nullptr;     // 映射区、各段的段尾信息与文本格式
+    };
+}
@@ -2,8 +2,16 @@
 #include <windows.h>
 #include <io.h>
 #include <direct.h>
+#include <deque>
+#include <algorithm>
 #include "logsink.h"
 #include "logmsg.h"
+#include "logbin.h"
+#include "logutf8.h"
+#include "logfile.h"
+#include "logger.h"
+#include "logzip.h"
+#include "logseg.h"
 
 namespace xs
 {
@@ -11,31 +19,29 @@ namespace xs
     {
         try
         {
+            std::wstring wszDst;
             if (szSrc.empty())
             {
-                return L"";
+                return wszDst;
             }
 
-            /* 获取转码后宽字符的字符数 */
-            auto nWideCharCount = ::MultiByteToWideChar(nCodePage, 0, szSrc.c_str(), (int)szSrc.length(), NULL, 0);
-            if (nWideCharCount <= 0)
+            /* UTF-8或纯ASCII字符串直接解码 */
+            if (CP_UTF8 == nCodePage || CLogUtf8::IsAscii(szSrc.data(), szSrc.length()))
             {
-                auto err = ::GetLastError();
-                return L"";
+                CLogUtf8::ToWide(szSrc.data(), szSrc.length(), wszDst);
+                return wszDst;
             }
 
-            /* 分配宽字符内存 */
-            std::shared_ptr<wchar_t> pTmpWideBuff(new wchar_t[nWideCharCount]);
-
-            /* 转码 */
-            nWideCharCount = ::MultiByteToWideChar(nCodePage, 0, szSrc.c_str(), (int)szSrc.length(), pTmpWideBuff.get(), nWideCharCount);
+            /* 宽字符的字符数不超过多字节的字节数，直接转码到输出缓存 */
+            wszDst.resize(szSrc.length());
+            auto nWideCharCount = ::MultiByteToWideChar(nCodePage, 0, szSrc.c_str(), (int)szSrc.length(), &wszDst[0], (int)wszDst.size());
             if (nWideCharCount <= 0)
             {
                 auto err = ::GetLastError();
                 return L"";
             }
-
-            return std::wstring(pTmpWideBuff.get(), nWideCharCount);
+            wszDst.resize(nWideCharCount);
+            return wszDst;
         }
         catch (...)
         {
@@ -43,48 +49,31 @@ namespace xs
         }
     }
 
-    static std::string WStringToString(const std::wstring& wszSrc, int nCodePage)
+    SOverflowPolicy::SOverflowPolicy() : eDropLevel(ELogLevel::LEVEL_WARNING)
     {
-        try
-        {
-            if (wszSrc.empty())
-            {
-                return "";
-            }
-
-            /* 获取转码后多字节字节数 */
-            auto nMultiByteCount = ::WideCharToMultiByte(nCodePage, 0, wszSrc.c_str(), (int)wszSrc.length(), NULL, 0, NULL, NULL);
-            if (nMultiByteCount <= 0)
-            {
-                auto err = ::GetLastError();
-                return "";
-            }
-
-            /* 分配多字节内存 */
-            std::shared_ptr<char> pMultiByteBuff(new char[nMultiByteCount]);
+    }
 
-            /* 转码 */
-            BOOL bUsedDefaultChar = FALSE;
-            nMultiByteCount = ::WideCharToMultiByte(nCodePage, 0, wszSrc.c_str(), (int)wszSrc.length(), pMultiByteBuff.get(),
-                nMultiByteCount, NULL, (CP_UTF8 == nCodePage || CP_UTF7 == nCodePage) ? NULL : &bUsedDefaultChar);
-            if (nMultiByteCount <= 0)
-            {
-                auto err = ::GetLastError();
-                return "";
-            }
+    // 输出对象的溢出策略与丢弃统计
+    struct SOverflowData
+    {
+        SOverflowPolicy Policy;                     // 缓存已满时的处理策略
+        std::atomic<uint64_t> nDroppedCount{ 0 };   // 丢弃的日志条数
+        std::atomic<uint64_t> nMarkedCount{ 0 };    // 已写入丢弃标记的丢弃条数
+    };
 
-            return std::string(pMultiByteBuff.get(), nMultiByteCount);
-        }
-        catch (...)
-        {
-            return "";
-        }
-    }
+    struct SSinkState
+    {
+        std::mutex locker;                          // 写入锁(不能自行同步的输出对象)
+        std::atomic_bool bHasWritten{ false };      // 是否已写入日志引导信息
+        std::atomic<int64_t> nLastFlush{ 0 };       // 上次刷新时间(steady_clock计数)
+    };
 
     // 输出基类
     CLogSink::CLogSink(bool bAsyncMode) : m_bAsyncMode(bAsyncMode)
     {
         m_pThreadIds = new std::vector<std::thread::id>();
+        m_pOverflowData = new SOverflowData();
+        m_pSinkState = new SSinkState();
     }
 
     CLogSink::~CLogSink()
@@ -94,6 +83,39 @@ namespace xs
             delete m_pThreadIds;
             m_pThreadIds = nullptr;
         }
+
+        if (m_pOverflowData)
+        {
+            delete m_pOverflowData;
+            m_pOverflowData = nullptr;
+        }
+
+        if (m_pSinkState)
+        {
+            delete m_pSinkState;
+            m_pSinkState = nullptr;
+        }
+    }
+
+    std::mutex& CLogSink::WriteLocker()
+    {
+        return m_pSinkState->locker;
+    }
+
+    bool CLogSink::MarkWritten()
+    {
+        // 先读取一次，已写入后不再产生写操作
+        return !m_pSinkState->bHasWritten.load(std::memory_order_relaxed) && !m_pSinkState->bHasWritten.exchange(true);
+    }
+
+    int64_t CLogSink::LastFlushTime() const
+    {
+        return m_pSinkState->nLastFlush.load(std::memory_order_relaxed);
+    }
+
+    void CLogSink::SetLastFlushTime(int64_t nTime)
+    {
+        m_pSinkState->nLastFlush.store(nTime, std::memory_order_relaxed);
     }
 
     void CLogSink::SetThreadFilter(const std::vector<std::thread::id>& vThreadIds)
@@ -125,6 +147,188 @@ namespace xs
         return false;
     }
 
+    ELogLevel CLogSink::CaptureLevel() const
+    {
+        return ELogLevel::LEVEL_MAX;
+    }
+
+    void CLogSink::SetOverflowPolicy(const SOverflowPolicy& Policy)
+    {
+        m_pOverflowData->Policy = Policy;
+    }
+
+    uint64_t CLogSink::DroppedCount() const
+    {
+        return m_pOverflowData->nDroppedCount.load(std::memory_order_relaxed);
+    }
+
+    void CLogSink::AddDropped(uint64_t nCount)
+    {
+        m_pOverflowData->nDroppedCount.fetch_add(nCount, std::memory_order_relaxed);
+    }
+
+    bool CLogSink::AdmitLog(ELogLevel eLevel, std::string& szMarker)
+    {
+        SOverflowData& Overflow = *m_pOverflowData;
+        if (IsFull())
+        {
+            // ERROR与FATAL日志不丢弃：等待超时或丢弃方式下超出上限写入
+            const SOverflowPolicy& Policy = Overflow.Policy;
+            bool bKeep = (eLevel >= ELogLevel::LEVEL_ERROR);
+            bool bAdmit = bKeep;
+            switch (Policy.ePolicy)
+            {
+            case EOverflowPolicy::OVERFLOW_BLOCK:
+                bAdmit = WaitSpace(Policy.nBlockTimeout) || bKeep;
+                break;
+            case EOverflowPolicy::OVERFLOW_DROP_OLDEST:
+                bAdmit = DropOldest() || bKeep;
+                break;
+            case EOverflowPolicy::OVERFLOW_DROP_BELOW_LEVEL:
+                bAdmit = (bKeep || eLevel >= Policy.eDropLevel) && (WaitSpace(Policy.nBlockTimeout) || bKeep);
+                break;
+            default:
+                break;
+            }
+            if (!bAdmit)
+            {
+                Overflow.nDroppedCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            // 仍处于过载状态，丢弃标记留到缓存未满时再写入，避免每条日志前都有一条标记
+            return true;
+        }
+
+        // 之前有丢弃的日志，由抢先更新标记条数的线程生成丢弃标记
+        uint64_t nMarked = Overflow.nMarkedCount.load(std::memory_order_relaxed);
+        uint64_t nDropped = Overflow.nDroppedCount.load(std::memory_order_relaxed);
+        if (nDropped != nMarked && Overflow.nMarkedCount.compare_exchange_strong(nMarked, nDropped, std::memory_order_relaxed))
+        {
+            CLogger::Inst().FormatDropMarker(nDropped - nMarked, szMarker);
+        }
+        return true;
+    }
+
+    // 定义控制台输出类
+    void CConsoleSink::WriteLog(const std::string& szLog)
+    {
+        std::wstring szWideLog;
+        CLogUtf8::ToWide(szLog.data(), szLog.length(), szWideLog);
+        WriteWideLog(szWideLog);
+    }
+
+    SFileFlushPolicy::SFileFlushPolicy() : eFlushLevel(ELogLevel::LEVEL_FATAL)
+    {
+    }
+
+    // 文件输出的后台写入状态
+    // - 前台缓存(m_pszBuffer)只在持有该输出对象的写入锁时追加，写满或刷新时整块交给后台线程，
+    //   交换时只移动指针；后台线程写文件时不持有写入锁，磁盘较慢时后台缓存按需增加，写完后回收复用；
+    //   待写入的字节数达到上限(nPendingLimit)时按溢出策略等待或丢弃日志
+    // - 持久化采用组提交：每次刷新递增刷新序号，持久化前先等待后台线程写完该序号之前的数据；
+    //   若已有线程正在持久化则等待其完成，未被覆盖时再由其中一个线程持久化一次，覆盖期间所有的刷新
+    struct SFileWriteData
+    {
+        struct SBackBuffer
+        {
+            std::string* pszData;               // 待写入的数据
+            bool bFlush;                        // 写入后是否提交异步写入器的缓存
+            uint64_t nFlushSeq;                 // 交换时的刷新序号
+        };
+
+        std::mutex locker;                      // 保护以下所有状态，只在交换缓存时短暂持有
+        std::condition_variable cvWrite;        // 有待写入的缓存或需要退出
+        std::condition_variable cvWritten;      // 缓存已写入或已持久化
+        std::deque<SBackBuffer> dqPending;      // 待后台线程写入的缓存
+        std::atomic<size_t> nPendingBytes{ 0 }; // 待后台线程写入(含正在写入)的字节数
+        std::vector<std::string*> vFree;        // 已写完可复用的缓存
+        std::thread writeThread;                // 后台写线程(首次交换缓存时创建)
+        bool bStop = false;                     // 后台写线程退出标记
+        bool bDirty = false;                    // 上次刷新后是否交换过缓存
+        uint64_t nFlushSeq = 0;                 // 已请求的刷新序号
+        uint64_t nWrittenSeq = 0;               // 后台线程已写入的刷新序号
+        uint64_t nSyncedSeq = 0;                // 已持久化的刷新序号
+        bool bSyncing = false;                  // 是否有线程正在持久化
+        std::string szCompressed;               // 压缩后的数据(仅写入时压缩，只在写文件时使用)
+
+        ~SFileWriteData()
+        {
+            for (auto pszData : vFree)
+            {
+                delete pszData;
+            }
+        }
+    };
+
+    // 日志文件的滚动状态
+    // - 首次打开日志文件时扫描一次已有的滚动文件，之后只在内存中维护序号，滚动时只需一次重命名
+    // - 超出个数限制的旧文件删除与滚动文件的压缩交给后台文件线程(低优先级)，不占用写文件的时间
+    struct SFileRollData
+    {
+        struct SFileTask
+        {
+            std::string szFilePath;             // 文件路径
+            bool bCompress;                     // 压缩还是删除
+        };
+
+        bool bScanned = false;                  // 是否已扫描过已有的日志文件
+        bool bRollPending = false;              // 下次打开日志文件前是否需要滚动
+        ERollInterval eInterval = ERollInterval::ROLL_NONE; // 按时间滚动的周期
+        time_t nNextRollTime = 0;               // 下次按时间滚动的时间点，0表示不按时间滚动
+        std::deque<size_t> dqIndexes;           // 已有滚动文件的序号(从旧到新)
+        size_t nNextIndex = 1;                  // 下一个滚动文件的序号
+
+        std::thread taskThread;                 // 后台文件线程(首次有文件任务时创建)
+        std::mutex locker;                      // 保护任务列表与退出标记
+        std::condition_variable cvTask;         // 有文件任务或需要退出
+        std::deque<SFileTask> dqTasks;          // 待处理的文件任务
+        bool bStop = false;                     // 后台文件线程退出标记
+    };
+
+    // 分段文件输出的当前段状态，段在前台缓存(m_pszBuffer)中构建，只在持有写入锁时访问
+    struct SSegmentData
+    {
+        uint32_t nRecordCount = 0;                          // 当前段的记录数
+        int64_t nMinTime = 0;                               // 当前段的最小时间
+        int64_t nMaxTime = 0;                               // 当前段的最大时间
+        uint32_t nLevelCounts[XSLOG_SEG_LEVEL_COUNT] = { 0 }; // 当前段各等级的记录数
+        std::vector<const SLogSite*> vSites;                // 当前段中出现过的调用点
+        std::vector<bool> vSiteMarks;                       // 按调用点标识标记是否已加入vSites
+        std::string szIndex;                                // 已完成的索引项
+        uint32_t nBlockCount = 0;                           // 当前索引块的记录数
+        uint32_t nBlockOffset = 0;                          // 当前索引块的起始偏移
+        int64_t nBlockMinTime = 0;                          // 当前索引块的最小时间
+        int64_t nBlockMaxTime = 0;                          // 当前索引块的最大时间
+        unsigned char nBlockLevelMask = 0;                  // 当前索引块中出现过的等级
+        char szLastSecond[19] = { 0 };                      // 上次解析的文本日志时间(精确到秒)
+        int64_t nLastSecond = 0;                            // 上次解析的文本日志时间对应的秒数
+        bool bLastUtc = false;                              // 上次解析时是否为UTC时间
+
+        // 结束当前索引块，写入索引项
+        void CloseBlock()
+        {
+            szIndex.append((const char*)&nBlockOffset, sizeof(nBlockOffset));
+            szIndex.append((const char*)&nBlockMinTime, sizeof(nBlockMinTime));
+            szIndex.append((const char*)&nBlockMaxTime, sizeof(nBlockMaxTime));
+            szIndex.append((const char*)&nBlockLevelMask, sizeof(nBlockLevelMask));
+            nBlockCount = 0;
+        }
+
+        // 开始新的段(保留时间解析缓存)
+        void Reset()
+        {
+            nRecordCount = 0;
+            memset(nLevelCounts, 0, sizeof(nLevelCounts));
+            for (auto pSite : vSites)
+            {
+                vSiteMarks[pSite->nId] = false;
+            }
+            vSites.clear();
+            szIndex.clear();
+            nBlockCount = 0;
+        }
+    };
+
     // 定义文件输出类
     CFileSink::CFileSink(const std::string& szFilePrefix, bool bAppend, size_t nFileMaxSize, unsigned short nFileMaxCount)
         : CLogSink(true), m_bAppend(bAppend), m_nFileMaxSize(nFileMaxSize), m_nFileMaxCount(nFileMaxCount)
@@ -133,6 +337,8 @@ namespace xs
         m_pszLogName = new std::string();
         m_pFileStream = new std::ofstream();
         m_pszBuffer = new std::string();
+        m_pWriteData = new SFileWriteData();
+        m_pRollData = new SFileRollData();
 
         ParseFilePrefix(szFilePrefix);
     }
@@ -144,18 +350,32 @@ namespace xs
         m_pszLogName = new std::string();
         m_pFileStream = new std::ofstream();
         m_pszBuffer = new std::string();
+        m_pWriteData = new SFileWriteData();
+        m_pRollData = new SFileRollData();
         ParseFilePrefix(CLogMsg::ToString(wszFilePrefix));
     }
 
     CFileSink::~CFileSink()
     {
+        // 后台线程写完剩余的缓存后退出
         Flush();
+        {
+            std::lock_guard<std::mutex> LockGuard(m_pWriteData->locker);
+            m_pWriteData->bStop = true;
+        }
+        m_pWriteData->cvWrite.notify_all();
+        if (m_pWriteData->writeThread.joinable())
+        {
+            m_pWriteData->writeThread.join();
+        }
 
         // 记录统计信息
-        std::stringstream ss;
-        ss << "STOP LOGGING: LOG(" << m_nLogCount << " - " << m_nLogSize << "), WRITTEN(" << m_nWriteCount << " - " << m_nWriteSize << ")";
-        *m_pszBuffer = ss.str();
-        WriteFile();
+        if (!m_bBinary)
+        {
+            std::stringstream ss;
+            ss << "STOP LOGGING: LOG(" << m_nLogCount << " - " << m_nLogSize << "), WRITTEN(" << m_nWriteCount << " - " << m_nWriteSize << ")";
+            WriteFile(ss.str());
+        }
 
         if (m_pszLogPath)
         {
@@ -176,6 +396,36 @@ namespace xs
             m_pFileStream = nullptr;
         }
 
+        if (m_pFileWriter)
+        {
+            // 写完已提交的数据后关闭文件
+            m_pFileWriter->Close(m_FlushPolicy.bSync);
+            delete m_pFileWriter;
+            m_pFileWriter = nullptr;
+        }
+
+        if (m_pWriteData)
+        {
+            delete m_pWriteData;
+            m_pWriteData = nullptr;
+        }
+
+        if (m_pRollData)
+        {
+            // 后台文件线程处理完剩余的删除与压缩任务后退出
+            {
+                std::lock_guard<std::mutex> LockGuard(m_pRollData->locker);
+                m_pRollData->bStop = true;
+            }
+            m_pRollData->cvTask.notify_all();
+            if (m_pRollData->taskThread.joinable())
+            {
+                m_pRollData->taskThread.join();
+            }
+            delete m_pRollData;
+            m_pRollData = nullptr;
+        }
+
         if (m_pszBuffer)
         {
             delete m_pszBuffer;
@@ -183,33 +433,268 @@ namespace xs
         }
     }
 
-    void CFileSink::WriteLog(const std::wstring& wszLog)
+    void CFileSink::SetWriteMode(EFileWriteMode eMode, size_t nBufferSize, size_t nBufferCount)
+    {
+        if (m_pFileWriter)
+        {
+            delete m_pFileWriter;
+            m_pFileWriter = nullptr;
+        }
+        if (eMode != EFileWriteMode::WRITE_STREAM)
+        {
+            m_pFileWriter = new CLogFileWriter(eMode == EFileWriteMode::WRITE_ASYNC_DIRECT, nBufferSize, nBufferCount);
+        }
+    }
+
+    void CFileSink::SetFlushPolicy(const SFileFlushPolicy& Policy)
+    {
+        m_FlushPolicy = Policy;
+        if (m_FlushPolicy.bSync && !m_pFileWriter)
+        {
+            // 持久化需要文件句柄，文件流写入方式改为异步写入
+            SetWriteMode(EFileWriteMode::WRITE_ASYNC);
+        }
+        if (IsLiveCompress() && m_FlushPolicy.nBufferSize < 64 * 1024)
+        {
+            m_FlushPolicy.nBufferSize = 64 * 1024;
+        }
+    }
+
+    void CFileSink::SetCompressMode(ECompressMode eMode)
+    {
+        m_eCompressMode = eMode;
+        if (IsLiveCompress() && m_FlushPolicy.nBufferSize < 64 * 1024)
+        {
+            // 每块缓存压缩为一个独立的gzip成员，块太小时压缩率低
+            m_FlushPolicy.nBufferSize = 64 * 1024;
+        }
+    }
+
+    void CFileSink::SetRollInterval(ERollInterval eInterval)
+    {
+        m_pRollData->eInterval = eInterval;
+    }
+
+    void CFileSink::WriteLog(const std::string& szLog)
     {
-        auto szLog = WStringToString(wszLog, CP_UTF8);
+        // 日志文本已是UTF-8编码，直接写入
         m_nLogCount++;
         m_nLogSize += szLog.size();
         m_pszBuffer->append(szLog);
-        if (m_pszBuffer->length() >= 4096)
+        if (m_pszBuffer->length() >= m_FlushPolicy.nBufferSize)
+        {
+            SwapBuffer(false);
+        }
+    }
+
+    void CFileSink::WriteLog(const std::string& szLog, ELogLevel eLevel)
+    {
+        // 后台线程写入较慢时按溢出策略处理，丢弃标记与日志一样写入(派生类按各自的格式保存)
+        std::string szMarker;
+        if (!AdmitLog(eLevel, szMarker))
+        {
+            return;
+        }
+        if (!szMarker.empty())
         {
-            WriteFile();
+            WriteLog(szMarker);
         }
+        WriteLog(szLog);
     }
 
     void CFileSink::Flush()
     {
-        if (m_pszBuffer->length() > 0)
+        SwapBuffer(true);
+    }
+
+    bool CFileSink::IsFull() const
+    {
+        return m_pWriteData->nPendingBytes.load(std::memory_order_relaxed) >= m_FlushPolicy.nPendingLimit;
+    }
+
+    bool CFileSink::WaitSpace(unsigned int nTimeout)
+    {
+        SFileWriteData& Data = *m_pWriteData;
+        std::unique_lock<std::mutex> Lock(Data.locker);
+        auto IsReady = [this, &Data] { return Data.nPendingBytes.load(std::memory_order_relaxed) < m_FlushPolicy.nPendingLimit; };
+        if (nTimeout == 0)
+        {
+            Data.cvWritten.wait(Lock, IsReady);
+            return true;
+        }
+        return Data.cvWritten.wait_for(Lock, std::chrono::milliseconds(nTimeout), IsReady);
+    }
+
+    void CFileSink::Sync()
+    {
+        if (!m_pFileWriter)
+        {
+            return;
+        }
+
+        SFileWriteData& Data = *m_pWriteData;
+        std::unique_lock<std::mutex> Lock(Data.locker);
+        uint64_t nSeq = Data.nFlushSeq;
+        while (Data.nSyncedSeq < nSeq)
+        {
+            if (Data.bSyncing || Data.nWrittenSeq < nSeq)
+            {
+                // 等待后台线程写完本次刷新的数据，或等待正在进行的持久化完成后再判断是否已覆盖本次刷新
+                Data.cvWritten.wait(Lock);
+                continue;
+            }
+
+            // 由当前线程持久化，覆盖后台线程已写入的所有刷新
+            uint64_t nTarget = Data.nWrittenSeq;
+            Data.bSyncing = true;
+            Lock.unlock();
+            m_pFileWriter->Sync();
+            Lock.lock();
+            Data.bSyncing = false;
+            if (nTarget > Data.nSyncedSeq)
+            {
+                Data.nSyncedSeq = nTarget;
+            }
+            Data.cvWritten.notify_all();
+        }
+    }
+
+    void CFileSink::SwapBuffer(bool bFlush)
+    {
+        SFileWriteData& Data = *m_pWriteData;
+        std::unique_lock<std::mutex> Lock(Data.locker);
+        if (m_pszBuffer->empty() && !(bFlush && Data.bDirty))
+        {
+            // 没有新数据，上次刷新后也没有写入过数据
+            return;
+        }
+
+        SFileWriteData::SBackBuffer Back;
+        Back.pszData = m_pszBuffer;
+        Back.bFlush = bFlush;
+        if (bFlush)
+        {
+            Data.nFlushSeq++;
+            Data.bDirty = false;
+        }
+        else
+        {
+            Data.bDirty = true;
+        }
+        Back.nFlushSeq = Data.nFlushSeq;
+        Data.dqPending.push_back(Back);
+        Data.nPendingBytes.fetch_add(Back.pszData->size(), std::memory_order_relaxed);
+
+        // 换上一块空闲的缓存作为前台缓存
+        if (Data.vFree.empty())
+        {
+            m_pszBuffer = new std::string();
+        }
+        else
+        {
+            m_pszBuffer = Data.vFree.back();
+            Data.vFree.pop_back();
+        }
+
+        if (!Data.writeThread.joinable())
+        {
+            Data.writeThread = std::thread(&CFileSink::BackWriteThread, this);
+        }
+        Lock.unlock();
+        Data.cvWrite.notify_one();
+    }
+
+    void CFileSink::BackWriteThread()
+    {
+        SFileWriteData& Data = *m_pWriteData;
+        std::unique_lock<std::mutex> Lock(Data.locker);
+        while (true)
         {
-            WriteFile();
+            Data.cvWrite.wait(Lock, [&Data] { return Data.bStop || !Data.dqPending.empty(); });
+            if (Data.dqPending.empty())
+            {
+                break;
+            }
+            SFileWriteData::SBackBuffer Back = Data.dqPending.front();
+            Data.dqPending.pop_front();
+            Lock.unlock();
+
+            size_t nSize = Back.pszData->size();
+            if (!Back.pszData->empty())
+            {
+                WriteFile(*Back.pszData);
+                Back.pszData->clear();
+            }
+            if (Back.bFlush && m_pFileWriter && m_pFileWriter->IsOpen())
+            {
+                // 提交异步写入器中未满的缓存，不等待写完
+                m_pFileWriter->Flush();
+            }
+
+            Lock.lock();
+            Data.vFree.push_back(Back.pszData);
+            Data.nPendingBytes.fetch_sub(nSize, std::memory_order_relaxed);
+            Data.nWrittenSeq = Back.nFlushSeq;
+            Data.cvWritten.notify_all();
         }
     }
 
-    void CFileSink::WriteFile()
+    void CFileSink::WriteFile(const std::string& szData)
     {
+        // 写入时压缩：每块数据压缩为一个独立的gzip成员，统计信息仍按压缩前的大小计算
+        const std::string* pszWrite = &szData;
+        if (IsLiveCompress())
+        {
+            std::string& szCompressed = m_pWriteData->szCompressed;
+            szCompressed.clear();
+            CLogGzip::Compress(szData.data(), szData.size(), szCompressed);
+            pszWrite = &szCompressed;
+        }
+
+        if (m_pFileWriter)
+        {
+            if (m_pFileWriter->IsOpen() && IsRollTime())
+            {
+                // 已到滚动时间，关闭当前日志文件，重新打开时滚动
+                m_pFileWriter->Close(m_FlushPolicy.bSync);
+                m_pRollData->bRollPending = true;
+            }
+
+            // 异步写入：复制到写入器的缓存后立即返回，由IO线程写文件
+            if (!m_pFileWriter->IsOpen() && !m_pFileWriter->Open(GetLogFullPath(), m_bAppend))
+            {
+                return;
+            }
+            m_nWriteCount++;
+            m_nWriteSize += szData.size();
+            m_pFileWriter->Write(pszWrite->data(), pszWrite->size());
+
+            if (m_nFileMaxSize > 0 && m_pFileWriter->Size() >= m_nFileMaxSize)
+            {
+                // 当前日志文件已满，写完后关闭，重新打开时滚动
+                m_pFileWriter->Close(m_FlushPolicy.bSync);
+                m_pRollData->bRollPending = true;
+            }
+            return;
+        }
+
+        if (m_pFileStream->is_open() && IsRollTime())
+        {
+            // 已到滚动时间，关闭当前日志文件，重新打开时滚动
+            m_pFileStream->close();
+            m_pRollData->bRollPending = true;
+        }
+
         if (!m_pFileStream->is_open())
         {
             // 懒加载模式，有日志输出时才打开/创建日志文件
             std::string szFileName = GetLogFullPath();
-            m_pFileStream->open(szFileName, m_bAppend ? std::ios::app : std::ios::trunc);
+            std::ios::openmode nMode = m_bAppend ? std::ios::app : std::ios::trunc;
+            if (m_bBinary || IsLiveCompress())
+            {
+                nMode |= std::ios::binary;
+            }
+            m_pFileStream->open(szFileName, nMode);
             if (!m_pFileStream->is_open())
             {
                 return;
@@ -217,9 +702,8 @@ namespace xs
         }
 
         m_nWriteCount++;
-        m_nWriteSize += m_pszBuffer->size();
-        *m_pFileStream << *m_pszBuffer;
-        m_pszBuffer->clear();
+        m_nWriteSize += szData.size();
+        m_pFileStream->write(pszWrite->data(), pszWrite->size());
 
         m_pFileStream->flush();
 
@@ -229,8 +713,9 @@ namespace xs
             size_t nFileSize = (size_t)(std::streamoff)m_pFileStream->tellp();
             if (nFileSize >= m_nFileMaxSize)
             {
-                // 当前日志文件已满，关闭文件流
+                // 当前日志文件已满，关闭文件流，重新打开时滚动
                 m_pFileStream->close();
+                m_pRollData->bRollPending = true;
             }
         }
     }
@@ -243,29 +728,73 @@ namespace xs
         // 确保目录存在
         CreatePath(szFullName);
 
-        // 判断是否需要滚动(将之前的所有日志文件序号依次递增，并删除序号超过个数限制的日志文件)
-        if (m_bAppend)
+        // 写入时压缩的日志文件追加 .gz
+        std::string szFilePath = IsLiveCompress() ? szFullName + ".gz" : szFullName;
+
+        SFileRollData& Roll = *m_pRollData;
+        if (!Roll.bScanned)
         {
-            // 追加模式下，如果有限制文件大小且当前日志文件大小已超限制，则进行滚动
-            if (m_nFileMaxSize > 0 && GetFileSize(szFullName) >= m_nFileMaxSize)
+            // 首次打开时扫描已有的滚动文件；已有的日志文件在非追加模式、已满或不属于当前时间周期时滚动
+            Roll.bScanned = true;
+            ScanLogFiles(szFullName);
+            unsigned long long nFileSize = 0;
+            time_t nWriteTime = 0;
+            if (GetFileInfo(szFilePath, nFileSize, nWriteTime))
             {
-                RollLogFiles(szFullName);
+                Roll.bRollPending = !m_bAppend || (m_nFileMaxSize > 0 && nFileSize >= m_nFileMaxSize)
+                    || (Roll.eInterval != ERollInterval::ROLL_NONE && GetNextRollTime(nWriteTime) <= time(nullptr));
             }
         }
-        else
+        if (Roll.bRollPending)
         {
-            // 非追加模式下，均要滚动
+            Roll.bRollPending = false;
             RollLogFiles(szFullName);
         }
+        Roll.nNextRollTime = GetNextRollTime(time(nullptr));
 
-        return szFullName;
+        return szFilePath;
     }
 
     void CFileSink::RollLogFiles(const std::string& szBaseLog)
     {
-        // 先查找当前进程生成的所有日志文件
+        // 当前日志文件重命名为下一个序号，序号越大越新
+        SFileRollData& Roll = *m_pRollData;
+        std::string szExt = IsLiveCompress() ? ".gz" : "";
+        std::string szOldFullPath = szBaseLog + szExt;
+        std::string szNewFullPath = szBaseLog + "." + std::to_string(Roll.nNextIndex);
+        if (0 != rename(szOldFullPath.c_str(), (szNewFullPath + szExt).c_str()))
+        {
+            int err = errno;
+            std::cout << "rename '" << szOldFullPath << "' to '" << szNewFullPath << szExt << "' error: " << err << std::endl;
+            return;
+        }
+        Roll.dqIndexes.push_back(Roll.nNextIndex++);
+        if (m_eCompressMode == ECompressMode::COMPRESS_ROLLED)
+        {
+            CompressLater(szNewFullPath);
+        }
+
+        // 超出个数限制的最旧文件交给后台文件线程删除
+        if (m_nFileMaxCount > 0)
+        {
+            while (Roll.dqIndexes.size() > (size_t)m_nFileMaxCount - 1)
+            {
+                RemoveLater(szBaseLog + "." + std::to_string(Roll.dqIndexes.front()));
+                Roll.dqIndexes.pop_front();
+            }
+        }
+    }
+
+    bool CFileSink::IsRollTime() const
+    {
+        return m_pRollData->nNextRollTime != 0 && time(nullptr) >= m_pRollData->nNextRollTime;
+    }
+
+    void CFileSink::ScanLogFiles(const std::string& szBaseLog)
+    {
+        // 查找当前日志文件的所有滚动文件
         std::vector<std::string> vFileNames;
-        std::string szFindPattern = szBaseLog + "*";
+        std::string szFindPattern = szBaseLog + ".*";
         WIN32_FIND_DATAA FindData;
         HANDLE hFindFile = ::FindFirstFileA(szFindPattern.c_str(), &FindData);
         if (INVALID_HANDLE_VALUE != hFindFile)
@@ -282,19 +811,19 @@ namespace xs
             hFindFile = INVALID_HANDLE_VALUE;
         }
 
-        // 获取每个日志文件的序号
+        // 获取每个滚动文件的序号(压缩文件为 .index.gz)
         std::set<size_t> FileIndexSet;
+        std::set<size_t> UncompressedSet;
         for (auto& szFileName : vFileNames)
         {
             // 获取日志文件的后缀
             std::string szSuffix = szFileName.substr(m_pszLogName->length());
-            if (szSuffix.empty())
+            bool bCompressed = szSuffix.length() > 3 && 0 == szSuffix.compare(szSuffix.length() - 3, 3, ".gz");
+            if (bCompressed)
             {
-                // 没有后缀表示为当前日志文件
-                FileIndexSet.emplace(0);
-                continue;
+                szSuffix.resize(szSuffix.length() - 3);
             }
-            if (szSuffix.length() == 1 || szSuffix[0] != '.')
+            if (szSuffix.length() <= 1 || szSuffix[0] != '.')
             {
                 // 忽略不正确后缀格式
                 continue;
@@ -329,35 +858,138 @@ namespace xs
                 continue;
             }
             FileIndexSet.emplace(nIndex);
+            if (!bCompressed)
+            {
+                UncompressedSet.emplace(nIndex);
+            }
         }
 
-        // 倒序遍历(先处理序号较大的文件)
-        auto it = FileIndexSet.rbegin();
-        for (; it != FileIndexSet.rend(); it++)
+        // 按序号从旧到新记录，超出个数限制(为即将滚动的当前文件预留一个)的最旧文件交给后台文件线程删除
+        SFileRollData& Roll = *m_pRollData;
+        Roll.dqIndexes.assign(FileIndexSet.begin(), FileIndexSet.end());
+        Roll.nNextIndex = FileIndexSet.empty() ? 1 : *FileIndexSet.rbegin() + 1;
+        if (m_nFileMaxCount > 0)
         {
-            size_t nOldIndex = *it;
-            std::string szOldFullPath(szBaseLog);
-            if (nOldIndex > 0)
-            {
-                szOldFullPath += "." + std::to_string(nOldIndex);
-            }
-            // 如果文件序号超出限制，则删除该文件，否则重命名文件(文件序号递增)
-            if (m_nFileMaxCount > 0 && nOldIndex >= (size_t)m_nFileMaxCount - 1)
+            while (!Roll.dqIndexes.empty() && Roll.dqIndexes.size() > (size_t)m_nFileMaxCount - 1)
             {
-                remove(szOldFullPath.c_str());
+                RemoveLater(szBaseLog + "." + std::to_string(Roll.dqIndexes.front()));
+                Roll.dqIndexes.pop_front();
             }
-            else
+        }
+
+        // 上次未压缩完的滚动文件重新压缩
+        if (m_eCompressMode == ECompressMode::COMPRESS_ROLLED)
+        {
+            for (size_t nIndex : Roll.dqIndexes)
             {
-                std::string szNewFullPath = szBaseLog + "." + std::to_string(nOldIndex + 1);
-                if (0 != rename(szOldFullPath.c_str(), szNewFullPath.c_str()))
+                if (UncompressedSet.count(nIndex))
                 {
-                    int err = errno;
-                    std::cout << "rename '" << szOldFullPath << "' to '" << szNewFullPath << "' error: " << err << std::endl;
+                    CompressLater(szBaseLog + "." + std::to_string(nIndex));
                 }
             }
         }
     }
 
+    time_t CFileSink::GetNextRollTime(time_t nTime) const
+    {
+        if (m_pRollData->eInterval == ERollInterval::ROLL_NONE)
+        {
+            return 0;
+        }
+
+        // 按本地时间计算下一个整点或零点
+        tm m;
+        localtime_s(&m, &nTime);
+        m.tm_min = 0;
+        m.tm_sec = 0;
+        if (m_pRollData->eInterval == ERollInterval::ROLL_HOURLY)
+        {
+            m.tm_hour++;
+        }
+        else
+        {
+            m.tm_hour = 0;
+            m.tm_mday++;
+        }
+        m.tm_isdst = -1;
+        return mktime(&m);
+    }
+
+    void CFileSink::RemoveLater(const std::string& szFilePath)
+    {
+        {
+            // 尚未开始压缩的文件不必再压缩
+            SFileRollData& Roll = *m_pRollData;
+            std::lock_guard<std::mutex> LockGuard(Roll.locker);
+            auto it = std::find_if(Roll.dqTasks.begin(), Roll.dqTasks.end(), [&szFilePath](const SFileRollData::SFileTask& Task) {
+                return Task.bCompress && Task.szFilePath == szFilePath;
+            });
+            if (it != Roll.dqTasks.end())
+            {
+                Roll.dqTasks.erase(it);
+            }
+        }
+        PostFileTask(szFilePath, false);
+    }
+
+    void CFileSink::CompressLater(const std::string& szFilePath)
+    {
+        PostFileTask(szFilePath, true);
+    }
+
+    void CFileSink::PostFileTask(const std::string& szFilePath, bool bCompress)
+    {
+        SFileRollData& Roll = *m_pRollData;
+        {
+            std::lock_guard<std::mutex> LockGuard(Roll.locker);
+            Roll.dqTasks.push_back({ szFilePath, bCompress });
+        }
+        if (!Roll.taskThread.joinable())
+        {
+            Roll.taskThread = std::thread(&CFileSink::FileTaskThread, this);
+        }
+        Roll.cvTask.notify_one();
+    }
+
+    void CFileSink::FileTaskThread()
+    {
+        // 压缩占用CPU较多，以低优先级运行，不与输出日志的线程争抢
+        ::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+        SFileRollData& Roll = *m_pRollData;
+        std::unique_lock<std::mutex> Lock(Roll.locker);
+        while (true)
+        {
+            Roll.cvTask.wait(Lock, [&Roll] { return Roll.bStop || !Roll.dqTasks.empty(); });
+            if (Roll.dqTasks.empty())
+            {
+                break;
+            }
+            SFileRollData::SFileTask Task = std::move(Roll.dqTasks.front());
+            Roll.dqTasks.pop_front();
+            Lock.unlock();
+
+            if (Task.bCompress)
+            {
+                CLogGzip::CompressFile(Task.szFilePath, Task.szFilePath + ".gz");
+            }
+            else
+            {
+                // 删除滚动文件及其压缩文件(两者通常只有一个存在)
+                for (const std::string& szFilePath : { Task.szFilePath, Task.szFilePath + ".gz" })
+                {
+                    if (0 != remove(szFilePath.c_str()) && errno != ENOENT)
+                    {
+                        int err = errno;
+                        std::cout << "remove '" << szFilePath << "' error: " << err << std::endl;
+                    }
+                }
+            }
+
+            Lock.lock();
+        }
+    }
+
     void CFileSink::ParseFilePrefix(const std::string& szFilePrefix)
     {
         std::string szFullName(szFilePrefix);
@@ -429,57 +1061,672 @@ namespace xs
         return std::string(buf);
     }
 
-    size_t CFileSink::GetFileSize(const std::string& szFilePath)
+    bool CFileSink::GetFileInfo(const std::string& szFilePath, unsigned long long& nFileSize, time_t& nWriteTime)
     {
-        size_t nFileSize = 0;
-        std::ifstream ifs(szFilePath);
-        if (ifs)
+        // 只查询文件属性，不打开文件
+        WIN32_FILE_ATTRIBUTE_DATA FileData;
+        if (!::GetFileAttributesExA(szFilePath.c_str(), GetFileExInfoStandard, &FileData))
         {
-            ifs.seekg(0, std::ios::end);
-            nFileSize = (size_t)(std::streamoff)ifs.tellg();
+            return false;
         }
-        return nFileSize;
+        nFileSize = ((unsigned long long)FileData.nFileSizeHigh << 32) | FileData.nFileSizeLow;
+        // FILETIME为1601年起的100纳秒数
+        unsigned long long nFileTime = ((unsigned long long)FileData.ftLastWriteTime.dwHighDateTime << 32) | FileData.ftLastWriteTime.dwLowDateTime;
+        nWriteTime = (time_t)((nFileTime - 116444736000000000ULL) / 10000000ULL);
+        return true;
+    }
+
+    // 定义二进制文件输出类
+    CBinaryFileSink::CBinaryFileSink(const std::string& szFilePrefix)
+        : CFileSink(szFilePrefix, false)
+    {
+        Init();
+    }
+
+    CBinaryFileSink::CBinaryFileSink(const std::wstring& wszFilePrefix)
+        : CFileSink(wszFilePrefix, false)
+    {
+        Init();
     }
 
-    // 定义网络输出类
-    CNetworkSink::CNetworkSink(const std::string& szHost, unsigned short nPort)
-        : CLogSink(false), m_pszHost(new std::string(szHost)), m_nPort(nPort)
+    CBinaryFileSink::~CBinaryFileSink()
     {
+        Flush();
 
+        if (m_pWrittenSites)
+        {
+            delete m_pWrittenSites;
+            m_pWrittenSites = nullptr;
+        }
     }
 
-    CNetworkSink::~CNetworkSink()
+    void CBinaryFileSink::Init()
     {
-        if (m_pszHost)
+        m_bBinary = true;
+        m_pWrittenSites = new std::vector<bool>();
+
+        // 替换日志文件后缀名
+        size_t pos = m_pszLogName->rfind(".log");
+        if (pos != std::string::npos)
         {
-            delete m_pszHost;
-            m_pszHost = nullptr;
+            m_pszLogName->erase(pos);
         }
+        m_pszLogName->append(".xslb");
+
+        // 写入文件头
+        m_pszBuffer->append(XSLOG_BIN_MAGIC, sizeof(XSLOG_BIN_MAGIC));
+        m_pszBuffer->append((const char*)&XSLOG_BIN_VERSION, sizeof(XSLOG_BIN_VERSION));
     }
 
-    void CNetworkSink::WriteLog(const std::wstring& szLog)
+    void CBinaryFileSink::WriteLog(const std::string& szLog)
     {
-        if (!m_bConnected)
+        // 已格式化的文本日志原样保存
+        uint32_t nLength = (uint32_t)szLog.length();
+        m_nLogCount++;
+        m_nLogSize += nLength;
+        m_pszBuffer->push_back(XSLOG_BIN_ENTRY_TEXT);
+        m_pszBuffer->append((const char*)&nLength, sizeof(nLength));
+        m_pszBuffer->append(szLog);
+        if (m_pszBuffer->length() >= m_FlushPolicy.nBufferSize)
         {
-            m_bConnected = Connect(*m_pszHost, m_nPort);
-            if (!m_bConnected)
+            SwapBuffer(false);
+        }
+    }
+
+    void CBinaryFileSink::WriteBinaryLog(const SLogSite& Site, const std::string& szRecord)
+    {
+        std::string szMarker;
+        if (!AdmitLog(Site.eLevel, szMarker))
+        {
+            return;
+        }
+        if (!szMarker.empty())
+        {
+            WriteLog(szMarker);
+        }
+
+        // 首次写入该调用点的日志，先写入调用点定义
+        if (m_pWrittenSites->size() <= Site.nId)
+        {
+            m_pWrittenSites->resize(Site.nId + 1, false);
+        }
+        if (!(*m_pWrittenSites)[Site.nId])
+        {
+            (*m_pWrittenSites)[Site.nId] = true;
+            unsigned char nLevel = (unsigned char)Site.eLevel;
+            uint32_t nLine = Site.nLine;
+            uint16_t nNameLength = (uint16_t)wcslen(Site.pszFile);
+            m_pszBuffer->push_back(XSLOG_BIN_ENTRY_SITE);
+            m_pszBuffer->append((const char*)&Site.nId, sizeof(Site.nId));
+            m_pszBuffer->append((const char*)&nLevel, sizeof(nLevel));
+            m_pszBuffer->append((const char*)&nLine, sizeof(nLine));
+            m_pszBuffer->append((const char*)&nNameLength, sizeof(nNameLength));
+            m_pszBuffer->append((const char*)Site.pszFile, nNameLength * sizeof(wchar_t));
+        }
+
+        uint32_t nLength = (uint32_t)szRecord.size();
+        m_nLogCount++;
+        m_nLogSize += nLength;
+        m_pszBuffer->push_back(XSLOG_BIN_ENTRY_RECORD);
+        m_pszBuffer->append((const char*)&nLength, sizeof(nLength));
+        m_pszBuffer->append(szRecord);
+        if (m_pszBuffer->length() >= m_FlushPolicy.nBufferSize)
+        {
+            SwapBuffer(false);
+        }
+    }
+
+    // 定义内存映射文件输出类
+    // 映射视图的偏移必须按分配粒度对齐
+    static size_t AllocationGranularity()
+    {
+        static const size_t nGranularity = []() {
+            SYSTEM_INFO SysInfo;
+            ::GetSystemInfo(&SysInfo);
+            return (size_t)SysInfo.dwAllocationGranularity;
+        }();
+        return nGranularity;
+    }
+
+    CMmapFileSink::CMmapFileSink(const std::string& szFilePrefix, bool bAppend, size_t nFileMaxSize, unsigned short nFileMaxCount,
+        size_t nSegmentSize)
+        : CFileSink(szFilePrefix, bAppend, nFileMaxSize, nFileMaxCount)
+    {
+        Init(nSegmentSize);
+    }
+
+    CMmapFileSink::CMmapFileSink(const std::wstring& wszFilePrefix, bool bAppend, size_t nFileMaxSize, unsigned short nFileMaxCount,
+        size_t nSegmentSize)
+        : CFileSink(wszFilePrefix, bAppend, nFileMaxSize, nFileMaxCount)
+    {
+        Init(nSegmentSize);
+    }
+
+    CMmapFileSink::~CMmapFileSink()
+    {
+        // 记录统计信息(基类以二进制模式构造，不再重复输出)
+        std::stringstream ss;
+        ss << "STOP LOGGING: LOG(" << m_nLogCount << " - " << m_nLogSize << "), WRITTEN(" << m_nWriteCount << " - " << m_nWriteSize << ")";
+        std::string szStat = ss.str();
+        Append(szStat.data(), szStat.size());
+
+        CloseFile();
+    }
+
+    void CMmapFileSink::Init(size_t nSegmentSize)
+    {
+        m_bBinary = true;
+
+        size_t nGranularity = AllocationGranularity();
+        if (nSegmentSize < nGranularity)
+        {
+            nSegmentSize = nGranularity;
+        }
+        m_nSegmentSize = (nSegmentSize + nGranularity - 1) / nGranularity * nGranularity;
+    }
+
+    void CMmapFileSink::SetCompressMode(ECompressMode eMode)
+    {
+        // 映射区直接写文件，只能在滚动后压缩
+        CFileSink::SetCompressMode(eMode == ECompressMode::COMPRESS_LIVE ? ECompressMode::COMPRESS_ROLLED : eMode);
+    }
+
+    void CMmapFileSink::WriteLog(const std::string& szLog)
+    {
+        m_nLogCount++;
+        m_nLogSize += szLog.size();
+        Append(szLog.data(), szLog.size());
+    }
+
+    void CMmapFileSink::Append(const char* pData, size_t nLength)
+    {
+        if (nLength == 0)
+        {
+            return;
+        }
+        if (m_hFile && IsRollTime())
+        {
+            // 已到滚动时间，关闭当前文件，重新打开时滚动
+            CloseFile();
+            m_pRollData->bRollPending = true;
+        }
+        if ((size_t)(m_pViewEnd - m_pWrite) < nLength)
+        {
+            // 达到文件大小限制时关闭当前文件，重新打开时按CFileSink的规则滚动(单条日志不跨文件)
+            if (m_hFile && m_nFileMaxSize > 0 && m_nFileSize > 0 && m_nFileSize + nLength > m_nFileMaxSize)
+            {
+                CloseFile();
+                m_pRollData->bRollPending = true;
+            }
+            if (!m_hFile && !OpenFile())
             {
                 return;
             }
+            if ((size_t)(m_pViewEnd - m_pWrite) < nLength && !MapSegment(nLength))
+            {
+                return;
+            }
+        }
+
+        memcpy(m_pWrite, pData, nLength);
+        m_pWrite += nLength;
+        m_nFileSize += nLength;
+        m_nWriteCount++;
+        m_nWriteSize += nLength;
+    }
+
+    bool CMmapFileSink::OpenFile()
+    {
+        // 懒加载模式，有日志输出时才打开/创建日志文件
+        std::string szFileName = GetLogFullPath();
+        HANDLE hFile = ::CreateFileA(szFileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+            m_bAppend ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            std::cout << "open '" << szFileName << "' error: " << ::GetLastError() << std::endl;
+            return false;
+        }
+        m_hFile = hFile;
+
+        LARGE_INTEGER nSize = { 0 };
+        ::GetFileSizeEx(hFile, &nSize);
+        m_nFileSize = (unsigned long long)nSize.QuadPart;
+
+        // 上次异常退出时未截断的预分配部分全为0，从尾部向前跳过
+        char szBlock[4096];
+        while (m_nFileSize > 0)
+        {
+            DWORD nBlock = (DWORD)(m_nFileSize < sizeof(szBlock) ? m_nFileSize : sizeof(szBlock));
+            LARGE_INTEGER nOffset;
+            nOffset.QuadPart = (LONGLONG)(m_nFileSize - nBlock);
+            DWORD nRead = 0;
+            if (!::SetFilePointerEx(hFile, nOffset, NULL, FILE_BEGIN) || !::ReadFile(hFile, szBlock, nBlock, &nRead, NULL) || nRead != nBlock)
+            {
+                break;
+            }
+            DWORD nData = nBlock;
+            while (nData > 0 && szBlock[nData - 1] == 0)
+            {
+                nData--;
+            }
+            m_nFileSize -= nBlock - nData;
+            if (nData > 0)
+            {
+                break;
+            }
+        }
+        return true;
+    }
+
+    void CMmapFileSink::CloseFile()
+    {
+        UnmapSegment();
+        if (m_hFile)
+        {
+            // 截断预分配但未使用的部分
+            LARGE_INTEGER nOffset;
+            nOffset.QuadPart = (LONGLONG)m_nFileSize;
+            if (::SetFilePointerEx(m_hFile, nOffset, NULL, FILE_BEGIN))
+            {
+                ::SetEndOfFile(m_hFile);
+            }
+            ::CloseHandle(m_hFile);
+            m_hFile = nullptr;
+        }
+        m_nFileSize = 0;
+    }
+
+    bool CMmapFileSink::MapSegment(size_t nMinSize)
+    {
+        UnmapSegment();
+
+        // 从当前写入位置所在的粒度边界开始映射，文件长度随映射对象的大小扩展(即预分配)
+        size_t nGranularity = AllocationGranularity();
+        unsigned long long nViewOffset = m_nFileSize / nGranularity * nGranularity;
+        unsigned long long nMapEnd = m_nFileSize + (nMinSize > m_nSegmentSize ? nMinSize : m_nSegmentSize);
+        if (m_nFileMaxSize > 0 && nMapEnd > m_nFileMaxSize)
+        {
+            // 最后一段不超过文件大小限制
+            nMapEnd = m_nFileSize + nMinSize > m_nFileMaxSize ? m_nFileSize + nMinSize : m_nFileMaxSize;
+        }
+
+        m_hMapping = ::CreateFileMappingW(m_hFile, NULL, PAGE_READWRITE, (DWORD)(nMapEnd >> 32), (DWORD)nMapEnd, NULL);
+        if (!m_hMapping)
+        {
+            std::cout << "CreateFileMapping error: " << ::GetLastError() << std::endl;
+            return false;
+        }
+        m_pViewBase = (char*)::MapViewOfFile(m_hMapping, FILE_MAP_WRITE, (DWORD)(nViewOffset >> 32), (DWORD)nViewOffset,
+            (SIZE_T)(nMapEnd - nViewOffset));
+        if (!m_pViewBase)
+        {
+            std::cout << "MapViewOfFile error: " << ::GetLastError() << std::endl;
+            ::CloseHandle(m_hMapping);
+            m_hMapping = nullptr;
+            return false;
         }
+        m_pWrite = m_pViewBase + (size_t)(m_nFileSize - nViewOffset);
+        m_pViewEnd = m_pViewBase + (size_t)(nMapEnd - nViewOffset);
+        return true;
     }
 
-    bool CNetworkSink::Connect(const std::string& szHost, unsigned short nPort)
+    void CMmapFileSink::UnmapSegment()
     {
+        if (m_pViewBase)
+        {
+            ::UnmapViewOfFile(m_pViewBase);
+            m_pViewBase = nullptr;
+        }
+        if (m_hMapping)
+        {
+            ::CloseHandle(m_hMapping);
+            m_hMapping = nullptr;
+        }
+        m_pWrite = nullptr;
+        m_pViewEnd = nullptr;
+    }
+
+    // 定义分段二进制文件输出类
+    CSegmentFileSink::CSegmentFileSink(const std::string& szFilePrefix, bool bAppend, size_t nFileMaxSize, unsigned short nFileMaxCount,
+        size_t nSegmentSize)
+        : CFileSink(szFilePrefix, bAppend, nFileMaxSize, nFileMaxCount)
+    {
+        Init(nSegmentSize);
+    }
+
+    CSegmentFileSink::CSegmentFileSink(const std::wstring& wszFilePrefix, bool bAppend, size_t nFileMaxSize, unsigned short nFileMaxCount,
+        size_t nSegmentSize)
+        : CFileSink(wszFilePrefix, bAppend, nFileMaxSize, nFileMaxCount)
+    {
+        Init(nSegmentSize);
+    }
+
+    CSegmentFileSink::~CSegmentFileSink()
+    {
+        // 写入未结束的段(基类析构时只刷新缓存)
+        Flush();
+
+        if (m_pSegmentData)
+        {
+            delete m_pSegmentData;
+            m_pSegmentData = nullptr;
+        }
+    }
+
+    void CSegmentFileSink::Init(size_t nSegmentSize)
+    {
+        m_bBinary = true;
+        m_pSegmentData = new SSegmentData();
+
+        // 段长度与偏移均为32位，段大小限制在1GB以内
+        if (nSegmentSize < 4096)
+        {
+            nSegmentSize = 4096;
+        }
+        else if (nSegmentSize > 1024 * 1024 * 1024)
+        {
+            nSegmentSize = 1024 * 1024 * 1024;
+        }
+        m_FlushPolicy.nBufferSize = nSegmentSize;
+
+        // 替换日志文件后缀名
+        size_t pos = m_pszLogName->rfind(".log");
+        if (pos != std::string::npos)
+        {
+            m_pszLogName->erase(pos);
+        }
+        m_pszLogName->append(".xsls");
+    }
+
+    void CSegmentFileSink::SetCompressMode(ECompressMode eMode)
+    {
+        // 整段写入后才能建立索引，只能在滚动后压缩
+        CFileSink::SetCompressMode(eMode == ECompressMode::COMPRESS_LIVE ? ECompressMode::COMPRESS_ROLLED : eMode);
+    }
+
+    void CSegmentFileSink::WriteLog(const std::string& szLog)
+    {
+        // 文本日志从前缀中解析等级、时间与线程，无法解析时(如日志引导信息)按写入时间记为INFO
+        ELogLevel eLevel = ELogLevel::LEVEL_INFO;
+        int64_t nTimestamp = 0;
+        uint32_t nThreadId = 0;
+        if (!ParseTextHeader(szLog, eLevel, nTimestamp, nThreadId))
+        {
+            eLevel = ELogLevel::LEVEL_INFO;
+            nTimestamp = CLogTime::Now();
+            nThreadId = 0;
+        }
+        m_nLogCount++;
+        m_nLogSize += szLog.size();
+        AppendRecord(nTimestamp, nThreadId, nullptr, eLevel, XSLOG_BIN_ENTRY_TEXT, szLog.data(), szLog.size());
+    }
+
+    void CSegmentFileSink::WriteBinaryLog(const SLogSite& Site, const std::string& szRecord)
+    {
+        std::string szMarker;
+        if (!AdmitLog(Site.eLevel, szMarker))
+        {
+            return;
+        }
+        if (!szMarker.empty())
+        {
+            WriteLog(szMarker);
+        }
+
+        // 二进制日志记录头：调用点标识(u32) + 时间戳(i64) + 线程标识(u32)
+        int64_t nTimestamp = 0;
+        uint32_t nThreadId = 0;
+        if (szRecord.size() < sizeof(uint32_t) + sizeof(nTimestamp) + sizeof(nThreadId))
+        {
+            return;
+        }
+        memcpy(&nTimestamp, szRecord.data() + sizeof(uint32_t), sizeof(nTimestamp));
+        memcpy(&nThreadId, szRecord.data() + sizeof(uint32_t) + sizeof(nTimestamp), sizeof(nThreadId));
+        m_nLogCount++;
+        m_nLogSize += szRecord.size();
+        AppendRecord(nTimestamp, nThreadId, &Site, Site.eLevel, XSLOG_BIN_ENTRY_RECORD, szRecord.data(), szRecord.size());
+    }
+
+    void CSegmentFileSink::Flush()
+    {
+        CloseSegment(true);
+    }
+
+    void CSegmentFileSink::AppendRecord(int64_t nTimestamp, uint32_t nThreadId, const SLogSite* pSite, ELogLevel eLevel, char chType,
+        const char* pData, size_t nLength)
+    {
+        std::string& szSegment = *m_pszBuffer;
+        SSegmentData& Seg = *m_pSegmentData;
+        if (szSegment.empty())
+        {
+            // 开始新段，段长度与段尾偏移在结束时回填
+            uint32_t nZero = 0;
+            szSegment.append(XSLOG_SEG_MAGIC, sizeof(XSLOG_SEG_MAGIC));
+            szSegment.append((const char*)&XSLOG_SEG_VERSION, sizeof(XSLOG_SEG_VERSION));
+            szSegment.append((const char*)&nZero, sizeof(nZero));
+            szSegment.append((const char*)&nZero, sizeof(nZero));
+        }
+
+        unsigned char nLevel = (unsigned char)eLevel;
+        if (nLevel >= XSLOG_SEG_LEVEL_COUNT)
+        {
+            nLevel = XSLOG_SEG_LEVEL_COUNT - 1;
+        }
+
+        // 更新段与索引块的统计
+        if (Seg.nRecordCount == 0)
+        {
+            Seg.nMinTime = nTimestamp;
+            Seg.nMaxTime = nTimestamp;
+        }
+        else
+        {
+            Seg.nMinTime = (std::min)(Seg.nMinTime, nTimestamp);
+            Seg.nMaxTime = (std::max)(Seg.nMaxTime, nTimestamp);
+        }
+        Seg.nLevelCounts[nLevel]++;
+        if (Seg.nBlockCount == 0)
+        {
+            Seg.nBlockOffset = (uint32_t)szSegment.size();
+            Seg.nBlockMinTime = nTimestamp;
+            Seg.nBlockMaxTime = nTimestamp;
+            Seg.nBlockLevelMask = 0;
+        }
+        else
+        {
+            Seg.nBlockMinTime = (std::min)(Seg.nBlockMinTime, nTimestamp);
+            Seg.nBlockMaxTime = (std::max)(Seg.nBlockMaxTime, nTimestamp);
+        }
+        Seg.nBlockLevelMask |= (unsigned char)(1u << nLevel);
+
+        // 段中首次出现的调用点，段尾写入其定义
+        uint32_t nSiteId = 0;
+        if (pSite)
+        {
+            nSiteId = pSite->nId;
+            if (Seg.vSiteMarks.size() <= nSiteId)
+            {
+                Seg.vSiteMarks.resize(nSiteId + 1, false);
+            }
+            if (!Seg.vSiteMarks[nSiteId])
+            {
+                Seg.vSiteMarks[nSiteId] = true;
+                Seg.vSites.push_back(pSite);
+            }
+        }
+
+        uint32_t nDataLength = (uint32_t)nLength;
+        szSegment.append((const char*)&nTimestamp, sizeof(nTimestamp));
+        szSegment.append((const char*)&nThreadId, sizeof(nThreadId));
+        szSegment.append((const char*)&nSiteId, sizeof(nSiteId));
+        szSegment.append((const char*)&nLevel, sizeof(nLevel));
+        szSegment.push_back(chType);
+        szSegment.append((const char*)&nDataLength, sizeof(nDataLength));
+        szSegment.append(pData, nLength);
+
+        Seg.nRecordCount++;
+        if (++Seg.nBlockCount >= XSLOG_SEG_INDEX_INTERVAL)
+        {
+            Seg.CloseBlock();
+        }
+        if (szSegment.size() >= m_FlushPolicy.nBufferSize)
+        {
+            CloseSegment(false);
+        }
+    }
+
+    void CSegmentFileSink::CloseSegment(bool bFlush)
+    {
+        std::string& szSegment = *m_pszBuffer;
+        SSegmentData& Seg = *m_pSegmentData;
+        if (!szSegment.empty())
+        {
+            if (Seg.nBlockCount > 0)
+            {
+                Seg.CloseBlock();
+            }
+
+            // 段尾：记录数 + 时间范围 + 各等级记录数 + 调用点定义 + 索引项
+            uint32_t nFooterOffset = (uint32_t)szSegment.size();
+            szSegment.append((const char*)&Seg.nRecordCount, sizeof(Seg.nRecordCount));
+            szSegment.append((const char*)&Seg.nMinTime, sizeof(Seg.nMinTime));
+            szSegment.append((const char*)&Seg.nMaxTime, sizeof(Seg.nMaxTime));
+            szSegment.append((const char*)Seg.nLevelCounts, sizeof(Seg.nLevelCounts));
+            uint32_t nSiteCount = (uint32_t)Seg.vSites.size();
+            szSegment.append((const char*)&nSiteCount, sizeof(nSiteCount));
+            for (auto pSite : Seg.vSites)
+            {
+                unsigned char nLevel = (unsigned char)pSite->eLevel;
+                uint32_t nLine = pSite->nLine;
+                uint16_t nNameLength = (uint16_t)wcslen(pSite->pszFile);
+                szSegment.append((const char*)&pSite->nId, sizeof(pSite->nId));
+                szSegment.append((const char*)&nLevel, sizeof(nLevel));
+                szSegment.append((const char*)&nLine, sizeof(nLine));
+                szSegment.append((const char*)&nNameLength, sizeof(nNameLength));
+                szSegment.append((const char*)pSite->pszFile, nNameLength * sizeof(wchar_t));
+            }
+            uint32_t nIndexCount = (uint32_t)(Seg.szIndex.size() / (sizeof(uint32_t) + sizeof(int64_t) * 2 + 1));
+            szSegment.append((const char*)&nIndexCount, sizeof(nIndexCount));
+            szSegment.append(Seg.szIndex);
+
+            // 回填段头
+            uint32_t nSegmentLength = (uint32_t)szSegment.size();
+            memcpy(&szSegment[sizeof(XSLOG_SEG_MAGIC) + sizeof(uint32_t)], &nSegmentLength, sizeof(nSegmentLength));
+            memcpy(&szSegment[sizeof(XSLOG_SEG_MAGIC) + sizeof(uint32_t) * 2], &nFooterOffset, sizeof(nFooterOffset));
+            Seg.Reset();
+        }
+
+        // 整段交给后台线程写入，前台缓存为空时开始新段
+        SwapBuffer(bFlush);
+    }
+
+    bool CSegmentFileSink::ParseTextHeader(const std::string& szLog, ELogLevel& eLevel, int64_t& nTimestamp, uint32_t& nThreadId)
+    {
+        // 依次尝试以'['开头的行
+        size_t nPos = 0;
+        while (nPos < szLog.size())
+        {
+            if (szLog[nPos] == '[' && ParseTextLine(szLog.data() + nPos, szLog.data() + szLog.size(), eLevel, nTimestamp, nThreadId))
+            {
+                return true;
+            }
+            nPos = szLog.find("\n[", nPos);
+            if (nPos == std::string::npos)
+            {
+                break;
+            }
+            nPos++;
+        }
         return false;
     }
 
+    bool CSegmentFileSink::ParseTextLine(const char* p, const char* pEnd, ELogLevel& eLevel, int64_t& nTimestamp, uint32_t& nThreadId)
+    {
+        // 等级(短名称)
+        if (pEnd - p < 24 || p[2] != ' ')
+        {
+            return false;
+        }
+        bool bLevel = false;
+        for (unsigned int i = 0; i < XSLOG_SEG_LEVEL_COUNT && !bLevel; i++)
+        {
+            if (CLogger::Inst().LevelName((ELogLevel)i, true)[0] == p[1])
+            {
+                eLevel = (ELogLevel)i;
+                bLevel = true;
+            }
+        }
+        if (!bLevel)
+        {
+            return false;
+        }
+        p += 3;
+
+        // 日期时间(YYYY-MM-DD HH:MM:SS)每秒只转换一次
+        SSegmentData& Seg = *m_pSegmentData;
+        bool bUtcTime = CLogger::Inst().IsUtcTime();
+        if (0 != memcmp(p, Seg.szLastSecond, sizeof(Seg.szLastSecond)) || bUtcTime != Seg.bLastUtc)
+        {
+            tm m = { 0 };
+            if (6 != sscanf_s(std::string(p, sizeof(Seg.szLastSecond)).c_str(), "%d-%d-%d %d:%d:%d",
+                &m.tm_year, &m.tm_mon, &m.tm_mday, &m.tm_hour, &m.tm_min, &m.tm_sec))
+            {
+                return false;
+            }
+            m.tm_year -= 1900;
+            m.tm_mon -= 1;
+            m.tm_isdst = -1;
+            time_t nSecond = bUtcTime ? _mkgmtime(&m) : mktime(&m);
+            if (nSecond == (time_t)-1)
+            {
+                return false;
+            }
+            memcpy(Seg.szLastSecond, p, sizeof(Seg.szLastSecond));
+            Seg.nLastSecond = (int64_t)nSecond;
+            Seg.bLastUtc = bUtcTime;
+        }
+        p += sizeof(Seg.szLastSecond);
+
+        // 秒以下部分(3/6/9位)
+        int64_t nFraction = 0;
+        int nDigits = 0;
+        if (p < pEnd && *p == '.')
+        {
+            for (p++; p < pEnd && *p >= '0' && *p <= '9' && nDigits < 9; p++, nDigits++)
+            {
+                nFraction = nFraction * 10 + (*p - '0');
+            }
+        }
+        for (; nDigits < 9; nDigits++)
+        {
+            nFraction *= 10;
+        }
+        nTimestamp = Seg.nLastSecond * 1000000000LL + nFraction;
+
+        // 线程标识
+        if (p >= pEnd || *p != ' ')
+        {
+            return false;
+        }
+        nThreadId = 0;
+        for (p++; p < pEnd && *p >= '0' && *p <= '9'; p++)
+        {
+            nThreadId = nThreadId * 10 + (*p - '0');
+        }
+        return true;
+    }
+
     // 定义函数输出类
     CFunctionSink::CFunctionSink(TOutputFunc fnCallback) : CLogSink(false)
     {
         m_pfnCallback = new TOutputFunc(fnCallback);
     }
 
+    CFunctionSink::CFunctionSink(TUtf8OutputFunc fnCallback) : CLogSink(false)
+    {
+        m_pfnUtf8Callback = new TUtf8OutputFunc(fnCallback);
+    }
+
     CFunctionSink::~CFunctionSink()
     {
         if (m_pfnCallback)
@@ -487,5 +1734,28 @@ namespace xs
             delete m_pfnCallback;
             m_pfnCallback = nullptr;
         }
+
+        if (m_pfnUtf8Callback)
+        {
+            delete m_pfnUtf8Callback;
+            m_pfnUtf8Callback = nullptr;
+        }
+    }
+
+    void CFunctionSink::WriteLog(const std::string& szLog)
+    {
+        if (m_pfnUtf8Callback)
+        {
+            if (*m_pfnUtf8Callback)
+            {
+                (*m_pfnUtf8Callback)(szLog);
+            }
+        }
+        else if (m_pfnCallback && *m_pfnCallback)
+        {
+            std::wstring szWideLog;
+            CLogUtf8::ToWide(szLog.data(), szLog.length(), szWideLog);
+            (*m_pfnCallback)(szWideLog);
+        }
     }
 }
@@ -6,7 +6,9 @@
 #include <vector>
 #include <memory>
 #include <thread>
+#include <mutex>
 #include <functional>
+#include <ctime>
 
 #ifdef XSLOG_LIB
 #define XSLOG_API
@@ -20,6 +22,93 @@
 
 namespace xs
 {
+    struct SLogSite;
+    enum class ELogLevel;
+    class CLogFileWriter;
+    struct SFileWriteData;
+    struct SFileRollData;
+    struct SSegmentData;
+    struct SNetworkData;
+    struct SOverflowData;
+    struct SSinkState;
+    struct SRecorderData;
+
+    // 文件写入方式
+    enum class EFileWriteMode
+    {
+        WRITE_STREAM = 0,           // 文件流同步写入(默认)
+        WRITE_ASYNC = 1,            // 异步写入：由该文件独占的IO线程定位写入，多块缓存同时提交，调用线程不等待磁盘
+        WRITE_ASYNC_DIRECT = 2,     // 异步直接写入：在异步写入的基础上绕过系统文件缓存(FILE_FLAG_NO_BUFFERING)，适合大量日志
+    };
+
+    // 日志文件按时间滚动的周期(本地时间)
+    enum class ERollInterval
+    {
+        ROLL_NONE = 0,              // 不按时间滚动(默认)
+        ROLL_HOURLY = 1,            // 每个整点滚动
+        ROLL_DAILY = 2,             // 每天零点滚动
+    };
+
+    // 日志文件压缩方式(gzip格式)
+    enum class ECompressMode
+    {
+        COMPRESS_NONE = 0,          // 不压缩(默认)
+        COMPRESS_ROLLED = 1,        // 滚动后由后台线程压缩为 .index.gz，当前日志文件不压缩
+        COMPRESS_LIVE = 2,          // 写入时压缩，当前日志文件即为 .gz，每次写入的缓存块是一个独立的gzip成员
+    };
+
+    // 网络输出的传输协议
+    enum class ENetProtocol
+    {
+        PROTOCOL_TCP = 0,           // TCP(默认)：每条日志为一帧(4字节网络字节序长度 + UTF-8文本)，多帧合并发送
+        PROTOCOL_UDP = 1,           // UDP：多条日志直接拼接为一个数据报，不超过数据报大小限制，日志不跨数据报
+    };
+
+    // 队列或缓存已满时的处理方式，ERROR与FATAL日志在任何方式下都不会被丢弃
+    enum class EOverflowPolicy
+    {
+        OVERFLOW_DROP_NEWEST = 0,   // 丢弃新日志
+        OVERFLOW_DROP_OLDEST = 1,   // 丢弃最旧的日志，不支持时按OVERFLOW_DROP_NEWEST处理
+        OVERFLOW_BLOCK = 2,         // 等待空间，超时后丢弃新日志
+        OVERFLOW_DROP_BELOW_LEVEL = 3, // 丢弃低于指定等级的新日志，其余日志按OVERFLOW_BLOCK处理
+    };
+
+    // 队列或缓存已满时的处理策略
+    // - 丢弃的日志计入丢弃条数，下一条写入的日志之前插入一条丢弃标记(WARNING)：N messages dropped
+    // - ERROR与FATAL日志不丢弃：等待超时或丢弃方式下超出上限写入(固定容量的队列中一直等待)
+    struct XSLOG_API SOverflowPolicy
+    {
+        SOverflowPolicy();
+
+        EOverflowPolicy ePolicy = EOverflowPolicy::OVERFLOW_BLOCK;   // 处理方式，默认一直等待
+        unsigned int nBlockTimeout = 0;     // 等待空间的最长时间(毫秒)，0表示一直等待
+        ELogLevel eDropLevel;               // OVERFLOW_DROP_BELOW_LEVEL时丢弃低于该等级的日志，默认为LEVEL_WARNING
+    };
+
+    // 网络输出的发送策略
+    struct XSLOG_API SNetworkPolicy
+    {
+        ENetProtocol eProtocol = ENetProtocol::PROTOCOL_TCP;            // 传输协议
+        size_t nSpoolSize = 4 * 1024 * 1024;                            // 未发送日志的缓存上限(字节)，未连接时日志暂存在缓存中
+        size_t nBatchSize = 64 * 1024;                                  // TCP每批发送的最大字节数
+        size_t nDatagramSize = 1400;                                    // UDP数据报的最大字节数(不超过MTU，避免IP分片)
+        unsigned int nReconnectMin = 100;                               // 重连的初始等待时间(毫秒)，连续失败时每次加倍
+        unsigned int nReconnectMax = 30000;                             // 重连的最大等待时间(毫秒)
+        unsigned int nCloseTimeout = 3000;                              // 析构时发送剩余日志的最长时间(毫秒)
+    };
+
+    // 文件输出的刷新与持久化策略
+    struct XSLOG_API SFileFlushPolicy
+    {
+        SFileFlushPolicy();
+
+        size_t nBufferSize = 4096;          // 日志缓存达到该大小时写入文件
+        unsigned int nFlushInterval = 3000; // 定时刷新的间隔(毫秒)，缓存中的日志最多延迟该时间写入文件
+        ELogLevel eFlushLevel;              // 等级不低于该值的日志写入后立即刷新，默认为LEVEL_FATAL
+        bool bSync = false;                 // 刷新后是否持久化到磁盘(FlushFileBuffers)，同时刷新的多个线程共享一次持久化
+        size_t nPendingLimit = 64 * 1024 * 1024; // 等待后台线程写入的缓存上限(字节)，达到上限时按溢出策略处理
+    };
+
     ////////////////////////////////////////////////////////////////////////
     // 日志输出基类
     ////////////////////////////////////////////////////////////////////////
@@ -39,15 +128,82 @@ namespace xs
         // 判断某线程是在存在于过滤列表
         bool MatchThreadFilter(const std::thread::id& ThreadId);
 
-        // 写日志，异步模式时可能是仅暂存起来
-        virtual void WriteLog(const std::wstring& szLog) = 0;
+        // 设置缓存已满时的处理策略，非线程安全，必须在使用该Sink前设置
+        void SetOverflowPolicy(const SOverflowPolicy& Policy);
+
+        // 因缓存已满而丢弃的日志条数
+        uint64_t DroppedCount() const;
+
+        // 写日志(UTF-8编码)，异步模式时可能是仅暂存起来
+        virtual void WriteLog(const std::string& szLog) = 0;
+
+        // 写指定等级的日志(日志管理类调用)，有缓存上限的输出对象据此按溢出策略处理，默认忽略等级
+        virtual void WriteLog(const std::string& szLog, ELogLevel eLevel) { WriteLog(szLog); }
+
+        // 捕获等级：低于日志管理类输出等级但不低于该等级的日志也写入该输出对象(如飞行记录器)
+        // 默认为LEVEL_MAX，即只输出不低于输出等级的日志，添加到日志管理类后不应改变
+        virtual ELogLevel CaptureLevel() const;
+
+        // 是否需要宽字符的日志文本(如控制台)，是则由日志管理类转码后调用WriteWideLog
+        virtual bool IsWideMode() const { return false; }
+
+        // 写宽字符日志(仅宽字符模式)
+        virtual void WriteWideLog(const std::wstring& szLog) {}
 
         // 同步Dump日志
         virtual void Flush() {}
 
+        // 写入该等级的日志后是否立即刷新
+        virtual bool IsFlushLevel(ELogLevel eLevel) const { return false; }
+
+        // 定时刷新的间隔(毫秒)，仅异步模式
+        virtual unsigned int FlushInterval() const { return 3000; }
+
+        // 刷新后是否需要持久化，是则由日志管理类在释放写入锁后调用Sync
+        virtual bool IsSyncMode() const { return false; }
+
+        // 持久化已刷新的日志，可能被多个线程同时调用
+        virtual void Sync() {}
+
+        // 是否直接接收二进制日志记录(延迟格式化模式)，否则由日志管理类格式化为文本后再写入
+        virtual bool IsBinaryMode() const { return false; }
+
+        // 写二进制日志记录(仅二进制模式)
+        virtual void WriteBinaryLog(const SLogSite& Site, const std::string& szRecord) {}
+
+        // 是否自行处理多线程同步，否则日志管理类调用写入与刷新函数时加该输出对象的写入锁
+        // 日志管理类分发日志时不加全局锁，多个线程可能同时写入同一个输出对象
+        virtual bool IsThreadSafe() const { return false; }
+
+    protected:
+        // 待写入的数据是否已达到上限(有缓存上限的输出对象重载)
+        virtual bool IsFull() const { return false; }
+        // 等待待写入的数据低于上限，最多等待nTimeout毫秒(0表示一直等待)，返回是否已有空间
+        virtual bool WaitSpace(unsigned int nTimeout) { return true; }
+        // 丢弃最旧的待写入日志(ERROR与FATAL除外)直到低于上限，返回是否已有空间
+        virtual bool DropOldest() { return false; }
+        // 写入一条日志前按溢出策略检查，返回是否写入该日志
+        // 之前有丢弃的日志时szMarker为丢弃标记，应在该日志之前写入
+        bool AdmitLog(ELogLevel eLevel, std::string& szMarker);
+        // 累计丢弃条数(输出对象内部丢弃日志时调用)
+        void AddDropped(uint64_t nCount);
+
+    private:
+        friend class CLogger;
+
+        // 日志管理类使用：写入锁(不能自行同步的输出对象)
+        std::mutex& WriteLocker();
+        // 日志管理类使用：标记已写入日志，返回是否为首次写入(需要添加日志引导信息)
+        bool MarkWritten();
+        // 日志管理类使用：上次刷新时间(steady_clock计数)
+        int64_t LastFlushTime() const;
+        void SetLastFlushTime(int64_t nTime);
+
     private:
         bool m_bAsyncMode = false;  // 是否为异步模式
         std::vector<std::thread::id>* m_pThreadIds = nullptr; // 只输出该列表中的线程产生的日志消息
+        SOverflowData* m_pOverflowData = nullptr;   // 溢出策略与丢弃统计
+        SSinkState* m_pSinkState = nullptr;         // 写入锁与写入状态
     };
 
     ////////////////////////////////////////////////////////////////////////
@@ -59,7 +215,9 @@ namespace xs
         CConsoleSink() : CLogSink(false) {}
         virtual ~CConsoleSink() = default;
 
-        void WriteLog(const std::wstring& szLog) override
+        bool IsWideMode() const override { return true; }
+        void WriteLog(const std::string& szLog) override;
+        void WriteWideLog(const std::wstring& szLog) override
         {
             std::wcout << szLog;
             std::wcout.flush();
@@ -73,6 +231,9 @@ namespace xs
     //      默认情况为不限大小单文件追加模式的格式 prefix.log
     //      非追加模式则会自动添加 _pid_timestamp
     //      多文件模式则会自动添加 .index
+    // - 当前日志文件已满或已到滚动时间时重命名为 .index，序号递增(越大越新)，超出个数限制的最旧文件由后台线程删除
+    // - 日志先追加到前台缓存，缓存写满或刷新时交给后台线程写文件，写文件时不阻塞输出日志的线程
+    // - 可选gzip压缩，压缩只在后台线程中进行，启用压缩后日志文件名追加 .gz
     ////////////////////////////////////////////////////////////////////////
     class XSLOG_API CFileSink : public CLogSink
     {
@@ -81,16 +242,47 @@ namespace xs
         CFileSink(const std::wstring& wszFilePrefix, bool bAppend = true, size_t nFileMaxSize = 0, unsigned short nFileMaxCount = 0);
         virtual ~CFileSink();
 
-        void WriteLog(const std::wstring& szLog) override;
+        // 设置文件写入方式，nBufferSize与nBufferCount为异步写入的每块缓存大小与缓存块数
+        // 异步写入以二进制方式写文件，换行符为\n
+        // 非线程安全，必须在使用该Sink前设置
+        void SetWriteMode(EFileWriteMode eMode, size_t nBufferSize = 1024 * 1024, size_t nBufferCount = 4);
+
+        // 设置刷新与持久化策略，需要持久化时文件流写入方式自动改为异步写入
+        // 非线程安全，必须在使用该Sink前设置
+        void SetFlushPolicy(const SFileFlushPolicy& Policy);
+
+        // 设置按时间滚动的周期，可与文件大小限制同时使用
+        // 非线程安全，必须在使用该Sink前设置
+        void SetRollInterval(ERollInterval eInterval);
+
+        // 设置压缩方式，COMPRESS_LIVE时文件大小限制按压缩后的大小计算，且前台缓存至少为64KB以保证压缩率
+        // 非线程安全，必须在使用该Sink前设置
+        virtual void SetCompressMode(ECompressMode eMode);
+
+        void WriteLog(const std::string& szLog) override;
+        void WriteLog(const std::string& szLog, ELogLevel eLevel) override;
         void Flush() override;
+        bool IsFlushLevel(ELogLevel eLevel) const override { return eLevel >= m_FlushPolicy.eFlushLevel; }
+        unsigned int FlushInterval() const override { return m_FlushPolicy.nFlushInterval; }
+        bool IsSyncMode() const override { return m_FlushPolicy.bSync && m_pFileWriter; }
+        void Sync() override;
 
     protected:
-        // 写日志文件
-        void WriteFile();
-        // 获取日志文件全路径
+        // 等待后台线程写入的缓存是否已达到上限
+        bool IsFull() const override;
+        bool WaitSpace(unsigned int nTimeout) override;
+        // 将前台缓存交给后台线程写入(调用时持有写入锁，只交换指针)，bFlush为true时写入后提交异步写入器的缓存
+        void SwapBuffer(bool bFlush);
+        // 写日志文件(只在后台线程中或后台线程退出后调用)
+        void WriteFile(const std::string& szData);
+        // 获取日志文件全路径，需要滚动时先滚动
         std::string GetLogFullPath();
-        // 滚动日志文件(递增日志文件序号，删除超出个数的日志文件)
+        // 滚动日志文件(重命名为下一个序号，超出个数的日志文件交给后台线程删除)
         void RollLogFiles(const std::string& szBaseLog);
+        // 是否已到按时间滚动的时间
+        bool IsRollTime() const;
+        // 是否写入时压缩
+        bool IsLiveCompress() const { return m_eCompressMode == ECompressMode::COMPRESS_LIVE; }
 
     private:
         // 根据日志文件前缀
@@ -101,41 +293,245 @@ namespace xs
         std::string GetCurrentPid();
         // 获取当前时间戳(格式化为MMDDhhmmss)
         std::string GetFormatTime();
-        // 获取文件大小
-        size_t GetFileSize(const std::string& szFilePath);
+        // 获取文件大小与最后写入时间
+        bool GetFileInfo(const std::string& szFilePath, unsigned long long& nFileSize, time_t& nWriteTime);
+        // 扫描已有的滚动文件(仅首次打开日志文件时)
+        void ScanLogFiles(const std::string& szBaseLog);
+        // 计算某时间之后的下一个滚动时间点，不按时间滚动时返回0
+        time_t GetNextRollTime(time_t nTime) const;
+        // 交给后台文件线程删除文件(包括其压缩文件)
+        void RemoveLater(const std::string& szFilePath);
+        // 交给后台文件线程压缩文件，完成后删除源文件
+        void CompressLater(const std::string& szFilePath);
+        // 添加后台文件任务，首次添加时创建后台文件线程
+        void PostFileTask(const std::string& szFilePath, bool bCompress);
+        // 后台文件线程入口函数
+        void FileTaskThread();
+        // 后台写线程入口函数
+        void BackWriteThread();
 
     protected:
         std::string* m_pszLogPath = nullptr;        // 日志存储目录
         std::string* m_pszLogName = nullptr;        // 日志文件名称
         bool m_bAppend = false;                     // 是否为追加模式
+        bool m_bBinary = false;                     // 是否以二进制方式写文件(不输出统计信息)
         size_t m_nFileMaxSize = 0;                  // 日志文件大小限制，单位字节，默认为0，表示不限制
         unsigned short m_nFileMaxCount = 0;         // 日志文件个数限制，默认为0，表示不限制
         std::ofstream* m_pFileStream = nullptr;     // 日志文件流对象
-        std::string* m_pszBuffer = nullptr;         // 日志缓存
+        CLogFileWriter* m_pFileWriter = nullptr;    // 异步写入器(仅异步写入方式)
+        std::string* m_pszBuffer = nullptr;         // 前台日志缓存
+        SFileFlushPolicy m_FlushPolicy;             // 刷新与持久化策略
+        ECompressMode m_eCompressMode = ECompressMode::COMPRESS_NONE; // 压缩方式
+        SFileWriteData* m_pWriteData = nullptr;     // 后台写入与持久化状态
+        SFileRollData* m_pRollData = nullptr;       // 日志文件的滚动状态
         int64_t m_nLogCount = 0;
         int64_t m_nLogSize = 0;
         int64_t m_nWriteCount = 0;
         int64_t m_nWriteSize = 0;
     };
 
+    ////////////////////////////////////////////////////////////////////////
+    // 二进制文件输出(延迟格式化模式)
+    // - 直接写入二进制日志记录，由离线解码工具(xslog_decode)还原为文本日志
+    // - 日志文件名格式：prefix_pid_timestamp.xslb，不支持追加与滚动
+    // - 首次写入某调用点的日志前，先写入该调用点的定义
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CBinaryFileSink : public CFileSink
+    {
+    public:
+        CBinaryFileSink(const std::string& szFilePrefix);
+        CBinaryFileSink(const std::wstring& wszFilePrefix);
+        virtual ~CBinaryFileSink();
+
+        bool IsBinaryMode() const override { return true; }
+        void WriteLog(const std::string& szLog) override;
+        void WriteBinaryLog(const SLogSite& Site, const std::string& szRecord) override;
+
+    private:
+        void Init();
+
+    protected:
+        std::vector<bool>* m_pWrittenSites = nullptr;   // 已写入定义的调用点
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+    // 内存映射文件输出
+    // - 日志文件名格式、追加模式、大小与个数限制均与CFileSink相同，可直接替换CFileSink
+    // - 按段预分配文件空间(默认64MB)并映射到内存，写日志时直接复制到映射区，不经过文件流与系统调用
+    // - 映射区写满后扩展文件并映射下一段；达到文件大小限制时滚动到新文件
+    // - 关闭文件时截断预分配但未使用的部分；异常退出后残留的尾部0字节在下次追加打开时被跳过
+    // - 以二进制方式写入，换行符为\n
+    // - 映射区无法边写边压缩，压缩方式COMPRESS_LIVE按COMPRESS_ROLLED处理
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CMmapFileSink : public CFileSink
+    {
+    public:
+        static const size_t DEFAULT_SEGMENT_SIZE = 64 * 1024 * 1024;
+
+        CMmapFileSink(const std::string& szFilePrefix, bool bAppend = true, size_t nFileMaxSize = 0, unsigned short nFileMaxCount = 0,
+            size_t nSegmentSize = DEFAULT_SEGMENT_SIZE);
+        CMmapFileSink(const std::wstring& wszFilePrefix, bool bAppend = true, size_t nFileMaxSize = 0, unsigned short nFileMaxCount = 0,
+            size_t nSegmentSize = DEFAULT_SEGMENT_SIZE);
+        virtual ~CMmapFileSink();
+
+        void SetCompressMode(ECompressMode eMode) override;
+        void WriteLog(const std::string& szLog) override;
+        void Flush() override {}
+
+    protected:
+        // 写入一段数据，空间不足时映射下一段或滚动文件
+        void Append(const char* pData, size_t nLength);
+        // 打开日志文件，追加模式下定位到实际数据的末尾
+        bool OpenFile();
+        // 关闭日志文件，并截断到实际长度
+        void CloseFile();
+        // 从当前写入位置开始映射至少nMinSize字节(nMinSize大于0，按段扩展文件)
+        bool MapSegment(size_t nMinSize);
+        // 解除当前映射
+        void UnmapSegment();
+
+    private:
+        void Init(size_t nSegmentSize);
+
+    protected:
+        size_t m_nSegmentSize = 0;          // 每次预分配并映射的大小(按分配粒度对齐)
+        void* m_hFile = nullptr;            // 文件句柄
+        void* m_hMapping = nullptr;         // 文件映射对象句柄
+        char* m_pViewBase = nullptr;        // 映射视图的起始地址
+        char* m_pWrite = nullptr;           // 当前写入位置
+        char* m_pViewEnd = nullptr;         // 映射视图的结束地址
+        unsigned long long m_nFileSize = 0;     // 文件的实际数据长度(不含预分配部分)
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+    // 分段二进制文件输出
+    // - 日志文件名格式：prefix[_pid_timestamp].xsls[.index]，追加模式、大小与个数限制、按时间滚动均与CFileSink相同
+    // - 每条日志保存时间戳、等级、线程、调用点与内容：延迟格式化模式的日志保存二进制记录，其它日志保存格式化后的文本
+    // - 日志先写入内存中的当前段，段写满(默认1MB)或刷新时补上段尾(稀疏时间索引与各等级记录数)，整段交给后台线程写入，段不跨文件
+    // - 由CLogSegmentReader或查询工具(xslog_query)按时间范围与等级直接定位，不必扫描整个文件，格式见logseg.h
+    // - 查询时需要映射文件，压缩方式COMPRESS_LIVE按COMPRESS_ROLLED处理，滚动后压缩的文件需解压后再查询
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CSegmentFileSink : public CFileSink
+    {
+    public:
+        static const size_t DEFAULT_SEGMENT_SIZE = 1024 * 1024;
+
+        CSegmentFileSink(const std::string& szFilePrefix, bool bAppend = true, size_t nFileMaxSize = 0, unsigned short nFileMaxCount = 0,
+            size_t nSegmentSize = DEFAULT_SEGMENT_SIZE);
+        CSegmentFileSink(const std::wstring& wszFilePrefix, bool bAppend = true, size_t nFileMaxSize = 0, unsigned short nFileMaxCount = 0,
+            size_t nSegmentSize = DEFAULT_SEGMENT_SIZE);
+        virtual ~CSegmentFileSink();
+
+        bool IsBinaryMode() const override { return true; }
+        void SetCompressMode(ECompressMode eMode) override;
+        void WriteLog(const std::string& szLog) override;
+        void WriteBinaryLog(const SLogSite& Site, const std::string& szRecord) override;
+        void Flush() override;
+
+    protected:
+        // 追加一条记录到当前段，段写满时结束当前段
+        void AppendRecord(int64_t nTimestamp, uint32_t nThreadId, const SLogSite* pSite, ELogLevel eLevel, char chType, const char* pData, size_t nLength);
+        // 结束当前段：写入段尾并回填段头，交给后台线程写入
+        void CloseSegment(bool bFlush);
+        // 从文本日志的前缀([L YYYY-MM-DD HH:MM:SS.mmm THREAD FILE:LINE])中解析等级、时间与线程
+        // 第一条日志前带有日志引导信息，从第一个能解析的行开始
+        bool ParseTextHeader(const std::string& szLog, ELogLevel& eLevel, int64_t& nTimestamp, uint32_t& nThreadId);
+        bool ParseTextLine(const char* p, const char* pEnd, ELogLevel& eLevel, int64_t& nTimestamp, uint32_t& nThreadId);
+
+    private:
+        void Init(size_t nSegmentSize);
+
+    protected:
+        SSegmentData* m_pSegmentData = nullptr;    // 当前段的统计、索引与调用点
+    };
+
     ////////////////////////////////////////////////////////////////////////
     // 网络输出
+    // - 日志先追加到有上限的缓存，由该Sink独占的IO线程以非阻塞套接字批量发送，输出日志的线程不等待网络
+    // - 首次输出日志时创建IO线程并连接，连接失败或断开后按指数退避重连，未连接期间日志暂存在缓存中
+    // - 缓存已满时按溢出策略处理(默认丢弃最旧的日志)，丢弃条数可通过DroppedCount获取
+    // - 发送失败的一批日志在重连后重新发送(TCP)，接收端可能收到断开前已发送的部分日志
     ////////////////////////////////////////////////////////////////////////
     class XSLOG_API CNetworkSink : public CLogSink
     {
     public:
-        CNetworkSink(const std::string& szHost, unsigned short nPort);
+        CNetworkSink(const std::string& szHost, unsigned short nPort, ENetProtocol eProtocol = ENetProtocol::PROTOCOL_TCP);
         virtual ~CNetworkSink();
 
-        void WriteLog(const std::wstring& szLog) override;
+        // 设置发送策略，非线程安全，必须在使用该Sink前设置
+        void SetNetworkPolicy(const SNetworkPolicy& Policy);
+
+        void WriteLog(const std::string& szLog) override;
+        void WriteLog(const std::string& szLog, ELogLevel eLevel) override;
+        void Flush() override;
+        // 发送缓存由自身的锁保护
+        bool IsThreadSafe() const override { return true; }
+
+        // 是否已连接
+        bool IsConnected() const;
+        // 已发送的日志条数
+        uint64_t SentCount() const;
 
     protected:
+        bool IsFull() const override;
+        bool WaitSpace(unsigned int nTimeout) override;
+        bool DropOldest() override;
+        // 解析地址并连接，连接成功时返回true(只在IO线程中调用)
         bool Connect(const std::string& szHost, unsigned short nPort);
+        // 关闭套接字
+        void Disconnect();
+        // 发送一段数据(TCP)或一个数据报(UDP)，发送缓冲区已满时等待，直到发送完成、出错或退出超时(只在IO线程中调用)
+        bool SendData(const char* pData, size_t nLength);
+        // IO线程入口函数
+        void NetworkThread();
 
     protected:
-        bool m_bConnected = false;
         std::string* m_pszHost = nullptr;
         unsigned short m_nPort = 0;
+        SNetworkPolicy m_Policy;                // 发送策略
+        SNetworkData* m_pNetData = nullptr;     // 缓存、套接字与IO线程状态
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+    // 飞行记录器
+    // - 日志写入映射到内存的固定大小环形文件(前缀.xslr)，写满后覆盖最旧的日志，文件格式见logrecorder.h
+    // - 映射的页面位于系统文件缓存中，进程崩溃(访问违例、abort等)后最近的日志仍在文件中，不需要刷新
+    // - 写入只有一次原子加法与内存复制，不加锁，可以常开；默认捕获所有等级的日志，包括低于输出等级的DEBUG/TRACE
+    // - 创建时已存在的记录文件(如崩溃前的记录)重命名为.xslr.1保留，由xslog_extract导出为文本日志
+    // - 只能保证进程崩溃时不丢失，系统崩溃或断电时尚未写回磁盘的页面仍会丢失
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CFlightRecorderSink : public CLogSink
+    {
+    public:
+        static const size_t DEFAULT_CAPACITY = 16 * 1024 * 1024;
+
+        // nCapacity为环形数据区大小，向上取整为2的幂(最小64KB)
+        CFlightRecorderSink(const std::string& szFilePrefix, size_t nCapacity = DEFAULT_CAPACITY);
+        CFlightRecorderSink(const std::wstring& wszFilePrefix, size_t nCapacity = DEFAULT_CAPACITY);
+        virtual ~CFlightRecorderSink();
+
+        // 设置捕获等级，默认为LEVEL_DEBUG，必须在添加到日志管理类前设置
+        void SetCaptureLevel(ELogLevel eLevel);
+        ELogLevel CaptureLevel() const override;
+
+        // 记录文件是否已创建并映射
+        bool IsOpened() const;
+
+        void WriteLog(const std::string& szLog) override;
+        void WriteLog(const std::string& szLog, ELogLevel eLevel) override;
+        // 写入只需一次原子加法分配空间，多个线程可以同时写入
+        bool IsThreadSafe() const override { return true; }
+
+    protected:
+        // 创建记录文件并映射整个文件
+        bool OpenFile(const std::string& szFilePath, size_t nCapacity);
+        // 解除映射并关闭文件
+        void CloseFile();
+        // 从写入流中的位置nPos开始写入数据，超过数据区末尾的部分写到数据区开头
+        void CopyIn(uint64_t nPos, const void* pData, size_t nLength);
+
+    protected:
+        SRecorderData* m_pRecorderData = nullptr;   // 映射状态与捕获等级
     };
 
     ////////////////////////////////////////////////////////////////////////
@@ -145,13 +541,21 @@ namespace xs
     {
     public:
         typedef std::function<void(const std::wstring& szLog)> TOutputFunc;
+        typedef std::function<void(const std::string& szLog)> TUtf8OutputFunc;
 
+        // 回调函数接收宽字符日志
         CFunctionSink(TOutputFunc fnCallback);
+        // 回调函数接收UTF-8编码的日志(无需转码)
+        CFunctionSink(TUtf8OutputFunc fnCallback);
         virtual ~CFunctionSink();
 
-        void WriteLog(const std::wstring& szLog) override
+        bool IsWideMode() const override { return m_pfnCallback != nullptr; }
+
+        void WriteLog(const std::string& szLog) override;
+
+        void WriteWideLog(const std::wstring& szLog) override
         {
-            if (*m_pfnCallback)
+            if (m_pfnCallback && *m_pfnCallback)
             {
                 (*m_pfnCallback)(szLog);
             }
@@ -159,5 +563,6 @@ namespace xs
 
     protected:
         TOutputFunc* m_pfnCallback = nullptr;
+        TUtf8OutputFunc* m_pfnUtf8Callback = nullptr;
     };
 }
@@ -0,0 +1,96 @@
+﻿#include <atomic>
+#include <cwchar>
+#include "logsite.h"
+#include "logger.h"
+
+namespace xs
+{
+    // 调用点注册表：按块分配的两级数组，注册时追加，查找时无锁
+    static const uint32_t SITE_CHUNK_SIZE = 4096;
+    static const uint32_t SITE_CHUNK_COUNT = 1024;
+
+    typedef std::atomic<const SLogSite*> TSiteSlot;
+
+    static TSiteSlot* s_SiteChunks[SITE_CHUNK_COUNT] = { nullptr };
+    static std::atomic<uint32_t> s_nSiteCount{ 0 };
+    static std::atomic_flag s_SiteLocker = ATOMIC_FLAG_INIT;
+
+    static uint32_t RegisterSite(const SLogSite* pSite)
+    {
+        // 调用点只在首次执行时注册一次，使用自旋锁即可
+        while (s_SiteLocker.test_and_set(std::memory_order_acquire))
+        {
+        }
+
+        uint32_t nId = s_nSiteCount.load(std::memory_order_relaxed) + 1;
+        uint32_t nChunk = nId / SITE_CHUNK_SIZE;
+        if (nChunk >= SITE_CHUNK_COUNT)
+        {
+            // 超出注册表容量，返回无效标识
+            s_SiteLocker.clear(std::memory_order_release);
+            return 0;
+        }
+        if (!s_SiteChunks[nChunk])
+        {
+            s_SiteChunks[nChunk] = new TSiteSlot[SITE_CHUNK_SIZE]();
+        }
+        s_SiteChunks[nChunk][nId % SITE_CHUNK_SIZE].store(pSite, std::memory_order_release);
+        s_nSiteCount.store(nId, std::memory_order_release);
+
+        s_SiteLocker.clear(std::memory_order_release);
+        return nId;
+    }
+
+    SLogSite::SLogSite(ELogLevel eLevel, const wchar_t* pszFile, unsigned int nLine)
+        : eLevel(eLevel), pszFile(FileName(pszFile)), nLine(nLine)
+    {
+        nId = RegisterSite(this);
+        CLogger::Inst().UpdateSite(*this);
+    }
+
+    SLogSite::SLogSite(const SLogLocation& Location)
+        : eLevel(Location.eLevel), pszFile(Location.pszFile), nLine(Location.nLine), pLocation(&Location)
+    {
+        nId = RegisterSite(this);
+        CLogger::Inst().UpdateSite(*this);
+    }
+
+    SLogSite::SLogSite(uint32_t nSiteId, ELogLevel eLevel, const wchar_t* pszFile, unsigned int nLine)
+        : nId(nSiteId), eLevel(eLevel), pszFile(pszFile), nLine(nLine)
+    {
+    }
+
+    const SLogSite* SLogSite::Find(uint32_t nSiteId)
+    {
+        if (nSiteId == 0 || nSiteId > s_nSiteCount.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return s_SiteChunks[nSiteId / SITE_CHUNK_SIZE][nSiteId % SITE_CHUNK_SIZE].load(std::memory_order_acquire);
+    }
+
+    uint32_t SLogSite::Count()
+    {
+        return s_nSiteCount.load(std::memory_order_acquire);
+    }
+
+    bool SLogSite::IsCaptured() const
+    {
+        return CLogger::Inst().IsCaptured(eLevel);
+    }
+
+    const wchar_t* SLogSite::FileName(const wchar_t* pszPath)
+    {
+        const wchar_t* pName = wcsrchr(pszPath, L'\\');
+        if (pName)
+        {
+            return pName + 1;
+        }
+        pName = wcsrchr(pszPath, L'/');
+        if (pName)
+        {
+            return pName + 1;
+        }
+        return pszPath;
+    }
+}
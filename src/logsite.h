@@ -0,0 +1,168 @@
+﻿#pragma once
+#include <cstdint>
+#include <atomic>
+
+#ifdef XSLOG_LIB
+#define XSLOG_API
+#else
+#ifdef XSLOG_EXPORTS
+#define XSLOG_API __declspec(dllexport)
+#else
+#define XSLOG_API __declspec(dllimport)
+#endif /* XSLOG_EXPORTS */
+#endif /* XSLOG_LIB */
+
+namespace xs
+{
+    enum class ELogLevel;
+
+    ////////////////////////////////////////////////////////////////////////
+    // 日志调用点位置(编译期生成)
+    // - 文件名(不含路径)与预先生成的"file:line"文本(UTF-8)均在编译期计算，输出日志时直接复制
+    // - 由日志宏为每个日志语句生成一个静态常量实例，其地址在进程内唯一且固定
+    ////////////////////////////////////////////////////////////////////////
+    struct SLogLocation
+    {
+        const wchar_t* pszFile;         // 文件名(不含路径)
+        unsigned int nLine;             // 行号
+        ELogLevel eLevel;               // 日志等级
+        const char* pszText;            // "file:line"文本(UTF-8，不以0结尾)
+        unsigned int nTextLength;       // "file:line"文本的字节数
+
+        // 文件名在路径中的偏移
+        static constexpr unsigned int FileOffset(const wchar_t* pszPath)
+        {
+            unsigned int nOffset = 0;
+            for (unsigned int i = 0; pszPath[i]; i++)
+            {
+                if (pszPath[i] == L'\\' || pszPath[i] == L'/')
+                {
+                    nOffset = i + 1;
+                }
+            }
+            return nOffset;
+        }
+
+        // 生成"file:line"文本，pszText为nullptr时只计算长度
+        static constexpr unsigned int RenderText(const wchar_t* pszPath, unsigned int nLine, char* pszText)
+        {
+            unsigned int nLength = 0;
+            for (unsigned int i = FileOffset(pszPath); pszPath[i]; i++)
+            {
+                // 文件名编码为UTF-8(非法的代理项替换为U+FFFD)
+                unsigned long nCode = (unsigned long)pszPath[i];
+                if (nCode >= 0xD800 && nCode <= 0xDFFF)
+                {
+                    unsigned long nLow = (unsigned long)pszPath[i + 1];
+                    if (sizeof(wchar_t) == 2 && nCode <= 0xDBFF && nLow >= 0xDC00 && nLow <= 0xDFFF)
+                    {
+                        nCode = 0x10000 + ((nCode - 0xD800) << 10) + (nLow - 0xDC00);
+                        i++;
+                    }
+                    else
+                    {
+                        nCode = 0xFFFD;
+                    }
+                }
+                unsigned int nBytes = nCode < 0x80 ? 1 : nCode < 0x800 ? 2 : nCode < 0x10000 ? 3 : 4;
+                if (pszText)
+                {
+                    if (nBytes == 1)
+                    {
+                        pszText[nLength] = (char)nCode;
+                    }
+                    else
+                    {
+                        const unsigned long nLeads[5] = { 0, 0, 0xC0, 0xE0, 0xF0 };
+                        for (unsigned int j = nBytes - 1; j > 0; j--)
+                        {
+                            pszText[nLength + j] = (char)(0x80 | (nCode & 0x3F));
+                            nCode >>= 6;
+                        }
+                        pszText[nLength] = (char)(nLeads[nBytes] | nCode);
+                    }
+                }
+                nLength += nBytes;
+            }
+
+            if (pszText)
+            {
+                pszText[nLength] = ':';
+            }
+            nLength++;
+
+            unsigned int nDigits = 1;
+            for (unsigned int n = nLine; n >= 10; n /= 10)
+            {
+                nDigits++;
+            }
+            if (pszText)
+            {
+                for (unsigned int j = nDigits; j > 0; j--)
+                {
+                    pszText[nLength + j - 1] = (char)('0' + nLine % 10);
+                    nLine /= 10;
+                }
+            }
+            return nLength + nDigits;
+        }
+    };
+
+    // 编译期生成的"file:line"文本存储，N为文本长度
+    template<unsigned int N>
+    struct TLogLocationText
+    {
+        char szText[N] = {};
+
+        constexpr TLogLocationText(const wchar_t* pszPath, unsigned int nLine)
+        {
+            SLogLocation::RenderText(pszPath, nLine, szText);
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+    // 日志调用点信息
+    // - 每个日志语句对应一个静态实例，首次执行时注册并分配唯一标识
+    // - 标识从1开始连续分配，0表示无效调用点
+    // - 是否输出由日志对象按输出等级与调用点规则计算后写入bEnabled，日志宏只需一次原子读取
+    // - 含有原子成员，因此只导出成员函数
+    ////////////////////////////////////////////////////////////////////////
+    struct SLogSite
+    {
+        // 注册一个新的调用点，自动分配标识
+        XSLOG_API SLogSite(ELogLevel eLevel, const wchar_t* pszFile, unsigned int nLine);
+        // 使用编译期生成的调用点位置注册一个新的调用点
+        XSLOG_API SLogSite(const SLogLocation& Location);
+        // 使用指定标识构造调用点，不进行注册(用于离线解码)
+        XSLOG_API SLogSite(uint32_t nSiteId, ELogLevel eLevel, const wchar_t* pszFile, unsigned int nLine);
+
+        SLogSite(const SLogSite& Other) = delete;
+        SLogSite& operator=(const SLogSite& Other) = delete;
+
+        // 该调用点的日志是否需要输出
+        // 只因捕获等级而开启时，还需判断是否有输出对象或当前线程的日志作用域需要
+        bool IsEnabled() const
+        {
+            return bEnabled.load(std::memory_order_relaxed) && (!bCaptureOnly.load(std::memory_order_relaxed) || IsCaptured());
+        }
+
+        // 只因捕获等级而开启的调用点，是否有输出对象或当前线程的日志作用域需要该日志
+        XSLOG_API bool IsCaptured() const;
+
+        // 根据标识查找已注册的调用点，不存在时返回nullptr(无锁)
+        XSLOG_API static const SLogSite* Find(uint32_t nSiteId);
+        // 已注册的调用点个数(标识为1~Count())
+        XSLOG_API static uint32_t Count();
+
+        // 截取路径中的文件名
+        XSLOG_API static const wchar_t* FileName(const wchar_t* pszPath);
+
+        uint32_t nId = 0;               // 调用点标识
+        ELogLevel eLevel;               // 日志等级
+        const wchar_t* pszFile = nullptr;   // 文件名(不含路径)
+        unsigned int nLine = 0;         // 行号
+        const SLogLocation* pLocation = nullptr;    // 编译期生成的调用点位置(未使用编译期位置构造时为nullptr)
+        mutable std::atomic_bool bEnabled{ false }; // 是否输出该调用点的日志(由日志对象更新)
+        mutable std::atomic_bool bCaptureOnly{ false }; // 是否只因输出对象的捕获等级而开启，此时只写入这些输出对象(由日志对象更新)
+    };
+}
@@ -0,0 +1,104 @@
+﻿#include <chrono>
+#include <ctime>
+#include "logtime.h"
+
+namespace xs
+{
+    // 每个线程缓存最近一次格式化的日期时间部分
+    struct STimeCache
+    {
+        int64_t nSecond = INT64_MIN;    // 缓存对应的秒数
+        bool bUtcTime = false;          // 缓存是否为UTC时间
+        char szDateTime[19];            // YYYY-MM-DD HH:MM:SS
+    };
+
+    static thread_local STimeCache t_TimeCache;
+
+    // 按固定位数输出十进制数字(不足补0)
+    template<class CharT>
+    static inline void WriteDigits(CharT* pszOutput, uint32_t nValue, int nDigits)
+    {
+        for (int i = nDigits - 1; i >= 0; i--)
+        {
+            pszOutput[i] = (CharT)('0' + nValue % 10);
+            nValue /= 10;
+        }
+    }
+
+    int64_t CLogTime::Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    template<class CharT>
+    static size_t FormatTime(int64_t nTimestamp, ETimePrecision ePrecision, bool bUtcTime, CharT* pszOutput)
+    {
+        // 向下取整，兼容1970年以前的时间
+        int64_t nSecond = nTimestamp / 1000000000;
+        int64_t nNanosecond = nTimestamp % 1000000000;
+        if (nNanosecond < 0)
+        {
+            nSecond--;
+            nNanosecond += 1000000000;
+        }
+
+        STimeCache& Cache = t_TimeCache;
+        if (Cache.nSecond != nSecond || Cache.bUtcTime != bUtcTime)
+        {
+            std::time_t ctTime = (std::time_t)nSecond;
+            struct tm tmTime = { 0 };
+            if (bUtcTime)
+            {
+                gmtime_s(&tmTime, &ctTime);
+            }
+            else
+            {
+                localtime_s(&tmTime, &ctTime);
+            }
+
+            char* p = Cache.szDateTime;
+            WriteDigits(p, (uint32_t)(tmTime.tm_year + 1900), 4);
+            p[4] = '-';
+            WriteDigits(p + 5, (uint32_t)(tmTime.tm_mon + 1), 2);
+            p[7] = '-';
+            WriteDigits(p + 8, (uint32_t)tmTime.tm_mday, 2);
+            p[10] = ' ';
+            WriteDigits(p + 11, (uint32_t)tmTime.tm_hour, 2);
+            p[13] = ':';
+            WriteDigits(p + 14, (uint32_t)tmTime.tm_min, 2);
+            p[16] = ':';
+            WriteDigits(p + 17, (uint32_t)tmTime.tm_sec, 2);
+
+            Cache.nSecond = nSecond;
+            Cache.bUtcTime = bUtcTime;
+        }
+
+        // 日期时间部分直接复制缓存，只填写秒以下部分
+        const size_t nDateTimeLength = sizeof(Cache.szDateTime);
+        for (size_t i = 0; i < nDateTimeLength; i++)
+        {
+            pszOutput[i] = (CharT)Cache.szDateTime[i];
+        }
+        pszOutput[nDateTimeLength] = '.';
+
+        int nDigits = (int)ePrecision;
+        uint32_t nFraction = (uint32_t)nNanosecond;
+        for (int i = nDigits; i < 9; i++)
+        {
+            nFraction /= 10;
+        }
+        WriteDigits(pszOutput + nDateTimeLength + 1, nFraction, nDigits);
+        return nDateTimeLength + 1 + nDigits;
+    }
+
+    size_t CLogTime::Format(int64_t nTimestamp, ETimePrecision ePrecision, bool bUtcTime, char* pszOutput)
+    {
+        return FormatTime(nTimestamp, ePrecision, bUtcTime, pszOutput);
+    }
+
+    size_t CLogTime::Format(int64_t nTimestamp, ETimePrecision ePrecision, bool bUtcTime, wchar_t* pszOutput)
+    {
+        return FormatTime(nTimestamp, ePrecision, bUtcTime, pszOutput);
+    }
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#ifdef XSLOG_LIB
+#define XSLOG_API
+#else
+#ifdef XSLOG_EXPORTS
+#define XSLOG_API __declspec(dllexport)
+#else
+#define XSLOG_API __declspec(dllimport)
+#endif /* XSLOG_EXPORTS */
+#endif /* XSLOG_LIB */
+
+namespace xs
+{
+    // 日志时间戳的秒以下精度
+    enum class ETimePrecision
+    {
+        PRECISION_MILLI = 3,    // 毫秒(默认)：YYYY-MM-DD HH:MM:SS.mmm
+        PRECISION_MICRO = 6,    // 微秒：YYYY-MM-DD HH:MM:SS.uuuuuu
+        PRECISION_NANO = 9,     // 纳秒：YYYY-MM-DD HH:MM:SS.nnnnnnnnn
+    };
+
+    ////////////////////////////////////////////////////////////////////////
+    // 日志时间戳格式化
+    // - 日期时间部分(YYYY-MM-DD HH:MM:SS)每个线程每秒只计算一次，其余时间只填写秒以下部分
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CLogTime
+    {
+    public:
+        // 格式化后的最大长度(字符数，不含结束符)
+        static const size_t MAX_LENGTH = 29;
+
+        // 获取当前时间(自1970-01-01 00:00:00 UTC起的纳秒数)
+        static int64_t Now();
+
+        // 格式化时间戳，返回写入的字符数
+        static size_t Format(int64_t nTimestamp, ETimePrecision ePrecision, bool bUtcTime, char* pszOutput);
+        static size_t Format(int64_t nTimestamp, ETimePrecision ePrecision, bool bUtcTime, wchar_t* pszOutput);
+    };
+}
@@ -0,0 +1,445 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <cstdint>
+#include "logutf8.h"
+
+// x86/x64平台使用SSE2(编译器默认支持)，并在运行时检测AVX2
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define XSLOG_UTF8_SIMD
+#endif
+
+namespace xs
+{
+    static const uint32_t UNICODE_REPLACEMENT = 0xFFFD;
+
+    // 将一个码点编码为UTF-8，返回写入的字节数
+    static inline size_t EncodeUtf8(uint32_t nCode, char* pszDst)
+    {
+        if (nCode < 0x80)
+        {
+            pszDst[0] = (char)nCode;
+            return 1;
+        }
+        if (nCode < 0x800)
+        {
+            pszDst[0] = (char)(0xC0 | (nCode >> 6));
+            pszDst[1] = (char)(0x80 | (nCode & 0x3F));
+            return 2;
+        }
+        if (nCode < 0x10000)
+        {
+            pszDst[0] = (char)(0xE0 | (nCode >> 12));
+            pszDst[1] = (char)(0x80 | ((nCode >> 6) & 0x3F));
+            pszDst[2] = (char)(0x80 | (nCode & 0x3F));
+            return 3;
+        }
+        pszDst[0] = (char)(0xF0 | (nCode >> 18));
+        pszDst[1] = (char)(0x80 | ((nCode >> 12) & 0x3F));
+        pszDst[2] = (char)(0x80 | ((nCode >> 6) & 0x3F));
+        pszDst[3] = (char)(0x80 | (nCode & 0x3F));
+        return 4;
+    }
+
+    // 将一个码点写为宽字符，返回写入的字符数
+    static inline size_t EncodeWide(uint32_t nCode, wchar_t* pszDst)
+    {
+        if (sizeof(wchar_t) == 2 && nCode >= 0x10000)
+        {
+            nCode -= 0x10000;
+            pszDst[0] = (wchar_t)(0xD800 | (nCode >> 10));
+            pszDst[1] = (wchar_t)(0xDC00 | (nCode & 0x3FF));
+            return 2;
+        }
+        pszDst[0] = (wchar_t)nCode;
+        return 1;
+    }
+
+    // 从宽字符中读取一个码点，返回消耗的字符数
+    static inline size_t DecodeWide(const wchar_t* pszSrc, const wchar_t* pszEnd, uint32_t& nCode)
+    {
+        uint32_t nUnit = (uint32_t)pszSrc[0];
+        if (nUnit >= 0xD800 && nUnit <= 0xDFFF)
+        {
+            // 代理项：UTF-16中只有高代理项后跟低代理项才是合法的
+            if (sizeof(wchar_t) == 2 && nUnit <= 0xDBFF && pszSrc + 1 < pszEnd)
+            {
+                uint32_t nLow = (uint32_t)pszSrc[1];
+                if (nLow >= 0xDC00 && nLow <= 0xDFFF)
+                {
+                    nCode = 0x10000 + ((nUnit - 0xD800) << 10) + (nLow - 0xDC00);
+                    return 2;
+                }
+            }
+            nCode = UNICODE_REPLACEMENT;
+            return 1;
+        }
+        nCode = nUnit <= 0x10FFFF ? nUnit : UNICODE_REPLACEMENT;
+        return 1;
+    }
+
+    // 从UTF-8中读取一个码点，返回消耗的字节数(非法序列只消耗一个字节)
+    static inline size_t DecodeUtf8(const unsigned char* pSrc, const unsigned char* pEnd, uint32_t& nCode)
+    {
+        unsigned char ch = pSrc[0];
+        size_t nCount = 0;
+        uint32_t nMin = 0;
+        if (ch < 0x80)
+        {
+            nCode = ch;
+            return 1;
+        }
+        else if (ch >= 0xC2 && ch <= 0xDF)
+        {
+            nCount = 2;
+            nCode = ch & 0x1F;
+            nMin = 0x80;
+        }
+        else if (ch >= 0xE0 && ch <= 0xEF)
+        {
+            nCount = 3;
+            nCode = ch & 0x0F;
+            nMin = 0x800;
+        }
+        else if (ch >= 0xF0 && ch <= 0xF4)
+        {
+            nCount = 4;
+            nCode = ch & 0x07;
+            nMin = 0x10000;
+        }
+        else
+        {
+            nCode = UNICODE_REPLACEMENT;
+            return 1;
+        }
+
+        if ((size_t)(pEnd - pSrc) < nCount)
+        {
+            nCode = UNICODE_REPLACEMENT;
+            return 1;
+        }
+        for (size_t i = 1; i < nCount; i++)
+        {
+            if ((pSrc[i] & 0xC0) != 0x80)
+            {
+                nCode = UNICODE_REPLACEMENT;
+                return 1;
+            }
+            nCode = (nCode << 6) | (pSrc[i] & 0x3F);
+        }
+        // 过长编码、代理项与超出范围的码点均为非法
+        if (nCode < nMin || nCode > 0x10FFFF || (nCode >= 0xD800 && nCode <= 0xDFFF))
+        {
+            nCode = UNICODE_REPLACEMENT;
+            return 1;
+        }
+        return nCount;
+    }
+
+#ifdef XSLOG_UTF8_SIMD
+    // 检测CPU与操作系统是否支持AVX2
+    static bool DetectAvx2()
+    {
+        int nInfo[4] = { 0 };
+        __cpuid(nInfo, 0);
+        if (nInfo[0] < 7)
+        {
+            return false;
+        }
+        // OSXSAVE与AVX，且操作系统会保存YMM寄存器
+        __cpuid(nInfo, 1);
+        if ((nInfo[2] & (1 << 27)) == 0 || (nInfo[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+        {
+            return false;
+        }
+        __cpuidex(nInfo, 7, 0);
+        return (nInfo[1] & (1 << 5)) != 0;
+    }
+
+    static bool HasAvx2()
+    {
+        static const bool bAvx2 = DetectAvx2();
+        return bAvx2;
+    }
+
+    static inline size_t LowestBit(unsigned int nMask)
+    {
+        unsigned long nIndex = 0;
+        _BitScanForward(&nIndex, nMask);
+        return nIndex;
+    }
+
+    // 以下向量化函数均返回从开头起连续ASCII字符的个数
+    // 遇到非ASCII字符时，该字符之前的部分已经写入目标缓存(目标缓存可能被多写入一个向量的长度，调用者需保证空间足够)
+
+    // 统计连续ASCII字节个数(AVX2，每次32字节)
+    static size_t AsciiLengthAvx2(const char* pszSrc, size_t nLength)
+    {
+        size_t i = 0;
+        for (; i + 32 <= nLength; i += 32)
+        {
+            unsigned int nMask = (unsigned int)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(pszSrc + i)));
+            if (nMask != 0)
+            {
+                _mm256_zeroupper();
+                return i + LowestBit(nMask);
+            }
+        }
+        _mm256_zeroupper();
+        return i;
+    }
+
+    // 统计连续ASCII字节个数(SSE2，每次16字节)
+    static size_t AsciiLengthSse2(const char* pszSrc, size_t nLength)
+    {
+        size_t i = 0;
+        for (; i + 16 <= nLength; i += 16)
+        {
+            unsigned int nMask = (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(pszSrc + i)));
+            if (nMask != 0)
+            {
+                return i + LowestBit(nMask);
+            }
+        }
+        return i;
+    }
+
+    // ASCII字节扩展为UTF-16(AVX2，每次32字节)
+    static size_t WidenAsciiAvx2(const char* pszSrc, size_t nLength, wchar_t* pszDst)
+    {
+        size_t i = 0;
+        for (; i + 32 <= nLength; i += 32)
+        {
+            __m256i Bytes = _mm256_loadu_si256((const __m256i*)(pszSrc + i));
+            _mm256_storeu_si256((__m256i*)(pszDst + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(Bytes)));
+            _mm256_storeu_si256((__m256i*)(pszDst + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(Bytes, 1)));
+            unsigned int nMask = (unsigned int)_mm256_movemask_epi8(Bytes);
+            if (nMask != 0)
+            {
+                _mm256_zeroupper();
+                return i + LowestBit(nMask);
+            }
+        }
+        _mm256_zeroupper();
+        return i;
+    }
+
+    // ASCII字节扩展为UTF-16(SSE2，每次16字节)
+    static size_t WidenAsciiSse2(const char* pszSrc, size_t nLength, wchar_t* pszDst)
+    {
+        const __m128i Zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= nLength; i += 16)
+        {
+            __m128i Bytes = _mm_loadu_si128((const __m128i*)(pszSrc + i));
+            _mm_storeu_si128((__m128i*)(pszDst + i), _mm_unpacklo_epi8(Bytes, Zero));
+            _mm_storeu_si128((__m128i*)(pszDst + i + 8), _mm_unpackhi_epi8(Bytes, Zero));
+            unsigned int nMask = (unsigned int)_mm_movemask_epi8(Bytes);
+            if (nMask != 0)
+            {
+                return i + LowestBit(nMask);
+            }
+        }
+        return i;
+    }
+
+    // UTF-16中的ASCII字符压缩为字节(SSE2，每次16个字符)
+    static size_t NarrowAsciiSse2(const wchar_t* pszSrc, size_t nLength, char* pszDst)
+    {
+        const __m128i NonAscii = _mm_set1_epi16((short)0xFF80);
+        const __m128i Zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= nLength; i += 16)
+        {
+            __m128i Low = _mm_loadu_si128((const __m128i*)(pszSrc + i));
+            __m128i High = _mm_loadu_si128((const __m128i*)(pszSrc + i + 8));
+            _mm_storeu_si128((__m128i*)(pszDst + i), _mm_packus_epi16(Low, High));
+            // 每个字符比较结果占2个字节，非ASCII字符对应的位为0
+            unsigned int nLowMask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(Low, NonAscii), Zero));
+            unsigned int nHighMask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(High, NonAscii), Zero));
+            unsigned int nMask = ~(nLowMask | (nHighMask << 16));
+            if (nMask != 0)
+            {
+                return i + LowestBit(nMask) / 2;
+            }
+        }
+        return i;
+    }
+
+    // 统计UTF-8字符个数：后续字节(0x80~0xBF)作为有符号数不大于-65(SSE2，每次16字节)
+    static size_t CountCharsSse2(const char* pszSrc, size_t nLength, size_t& nCount)
+    {
+        const __m128i Threshold = _mm_set1_epi8(-65);
+        const __m128i One = _mm_set1_epi8(1);
+        const __m128i Zero = _mm_setzero_si128();
+        __m128i Sum = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= nLength; i += 16)
+        {
+            __m128i Bytes = _mm_loadu_si128((const __m128i*)(pszSrc + i));
+            __m128i Leads = _mm_and_si128(_mm_cmpgt_epi8(Bytes, Threshold), One);
+            Sum = _mm_add_epi64(Sum, _mm_sad_epu8(Leads, Zero));
+        }
+        nCount += (size_t)_mm_cvtsi128_si32(Sum) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(Sum, 8));
+        return i;
+    }
+#endif
+
+    // 从开头起连续ASCII字节的个数
+    // 向量化部分遇到非ASCII字符即停止，剩余不足一个向量的部分逐个处理
+    static size_t AsciiLength(const char* pszSrc, size_t nLength)
+    {
+        size_t i = 0;
+#ifdef XSLOG_UTF8_SIMD
+        if (HasAvx2())
+        {
+            i = AsciiLengthAvx2(pszSrc, nLength);
+        }
+        i += AsciiLengthSse2(pszSrc + i, nLength - i);
+#endif
+        while (i < nLength && (unsigned char)pszSrc[i] < 0x80)
+        {
+            i++;
+        }
+        return i;
+    }
+
+    // 从开头起连续的ASCII字节扩展为宽字符，返回处理的个数
+    static size_t WidenAscii(const char* pszSrc, size_t nLength, wchar_t* pszDst)
+    {
+        size_t i = 0;
+#ifdef XSLOG_UTF8_SIMD
+        if (sizeof(wchar_t) == 2)
+        {
+            if (HasAvx2())
+            {
+                i = WidenAsciiAvx2(pszSrc, nLength, pszDst);
+            }
+            i += WidenAsciiSse2(pszSrc + i, nLength - i, pszDst + i);
+        }
+#endif
+        while (i < nLength && (unsigned char)pszSrc[i] < 0x80)
+        {
+            pszDst[i] = (wchar_t)pszSrc[i];
+            i++;
+        }
+        return i;
+    }
+
+    // 从开头起连续的ASCII宽字符压缩为字节，返回处理的个数
+    static size_t NarrowAscii(const wchar_t* pszSrc, size_t nLength, char* pszDst)
+    {
+        size_t i = 0;
+#ifdef XSLOG_UTF8_SIMD
+        if (sizeof(wchar_t) == 2)
+        {
+            i = NarrowAsciiSse2(pszSrc, nLength, pszDst);
+        }
+#endif
+        while (i < nLength && (uint32_t)pszSrc[i] < 0x80)
+        {
+            pszDst[i] = (char)pszSrc[i];
+            i++;
+        }
+        return i;
+    }
+
+    bool CLogUtf8::IsAnsiUtf8()
+    {
+        static const bool bAnsiUtf8 = (::GetACP() == CP_UTF8);
+        return bAnsiUtf8;
+    }
+
+    bool CLogUtf8::IsAscii(const char* pszSrc, size_t nLength)
+    {
+        return AsciiLength(pszSrc, nLength) == nLength;
+    }
+
+    size_t CLogUtf8::CountChars(const char* pszSrc, size_t nLength)
+    {
+        // 不是后续字节(10xxxxxx)的字节均为一个字符的开始
+        size_t nCount = 0;
+        size_t i = 0;
+#ifdef XSLOG_UTF8_SIMD
+        i = CountCharsSse2(pszSrc, nLength, nCount);
+#endif
+        for (; i < nLength; i++)
+        {
+            if (((unsigned char)pszSrc[i] & 0xC0) != 0x80)
+            {
+                nCount++;
+            }
+        }
+        return nCount;
+    }
+
+    size_t CLogUtf8::CountChars(const wchar_t* pszSrc, size_t nLength)
+    {
+        // 低代理项与前面的高代理项组成同一个字符
+        size_t nCount = nLength;
+        if (sizeof(wchar_t) == 2)
+        {
+            for (size_t i = 1; i < nLength; i++)
+            {
+                if (pszSrc[i] >= 0xDC00 && pszSrc[i] <= 0xDFFF && pszSrc[i - 1] >= 0xD800 && pszSrc[i - 1] <= 0xDBFF)
+                {
+                    nCount--;
+                }
+            }
+        }
+        return nCount;
+    }
+
+    size_t CLogUtf8::FromWide(const wchar_t* pszSrc, size_t nLength, char* pszDst)
+    {
+        const wchar_t* pszEnd = pszSrc + nLength;
+        char* p = pszDst;
+        while (pszSrc < pszEnd)
+        {
+            // 连续的ASCII字符批量处理，其余字符逐个编码
+            size_t nAscii = NarrowAscii(pszSrc, (size_t)(pszEnd - pszSrc), p);
+            pszSrc += nAscii;
+            p += nAscii;
+            while (pszSrc < pszEnd && (uint32_t)*pszSrc >= 0x80)
+            {
+                uint32_t nCode = 0;
+                pszSrc += DecodeWide(pszSrc, pszEnd, nCode);
+                p += EncodeUtf8(nCode, p);
+            }
+        }
+        return (size_t)(p - pszDst);
+    }
+
+    size_t CLogUtf8::ToWide(const char* pszSrc, size_t nLength, wchar_t* pszDst)
+    {
+        const unsigned char* pSrc = (const unsigned char*)pszSrc;
+        const unsigned char* pEnd = pSrc + nLength;
+        wchar_t* p = pszDst;
+        while (pSrc < pEnd)
+        {
+            // 连续的ASCII字符批量处理，其余字符逐个解码(同时校验)
+            size_t nAscii = WidenAscii((const char*)pSrc, (size_t)(pEnd - pSrc), p);
+            pSrc += nAscii;
+            p += nAscii;
+            while (pSrc < pEnd && *pSrc >= 0x80)
+            {
+                uint32_t nCode = 0;
+                pSrc += DecodeUtf8(pSrc, pEnd, nCode);
+                p += EncodeWide(nCode, p);
+            }
+        }
+        return (size_t)(p - pszDst);
+    }
+
+    void CLogUtf8::FromWide(const wchar_t* pszSrc, size_t nLength, std::string& szDst)
+    {
+        szDst.resize(nLength * MAX_BYTES_PER_WCHAR);
+        szDst.resize(nLength > 0 ? FromWide(pszSrc, nLength, &szDst[0]) : 0);
+    }
+
+    void CLogUtf8::ToWide(const char* pszSrc, size_t nLength, std::wstring& szDst)
+    {
+        szDst.resize(nLength);
+        szDst.resize(nLength > 0 ? ToWide(pszSrc, nLength, &szDst[0]) : 0);
+    }
+}
@@ -0,0 +1,49 @@
+﻿#pragma once
+#include <string>
+#include <cstddef>
+
+#ifdef XSLOG_LIB
+#define XSLOG_API
+#else
+#ifdef XSLOG_EXPORTS
+#define XSLOG_API __declspec(dllexport)
+#else
+#define XSLOG_API __declspec(dllimport)
+#endif /* XSLOG_EXPORTS */
+#endif /* XSLOG_LIB */
+
+namespace xs
+{
+    ////////////////////////////////////////////////////////////////////////
+    // UTF-8编码转换(日志内部统一使用UTF-8编码)
+    // - 宽字符按UTF-16(wchar_t为2字节)或UTF-32(wchar_t为4字节)处理
+    // - 非法编码(孤立的代理项、不完整或非法的UTF-8字节序列)替换为U+FFFD
+    // - 直接写入调用者提供的缓存，不分配内存
+    // - 连续的ASCII字符批量转换(SSE2/AVX2，运行时检测，其它平台逐个处理)，非ASCII字符转换的同时完成校验
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CLogUtf8
+    {
+    public:
+        // 每个宽字符编码为UTF-8后的最大字节数
+        static const size_t MAX_BYTES_PER_WCHAR = sizeof(wchar_t) == 2 ? 3 : 4;
+
+        // 进程的ANSI代码页是否为UTF-8(是则多字节字符串无需转码即为UTF-8)
+        static bool IsAnsiUtf8();
+
+        // 判断是否全部为ASCII字符
+        static bool IsAscii(const char* pszSrc, size_t nLength);
+
+        // 统计字符(码点)个数，用于按宽度填充
+        static size_t CountChars(const char* pszSrc, size_t nLength);
+        static size_t CountChars(const wchar_t* pszSrc, size_t nLength);
+
+        // 宽字符转为UTF-8，pszDst至少需要nLength * MAX_BYTES_PER_WCHAR字节，返回写入的字节数
+        static size_t FromWide(const wchar_t* pszSrc, size_t nLength, char* pszDst);
+        // UTF-8转为宽字符，pszDst至少需要nLength个字符，返回写入的字符数
+        static size_t ToWide(const char* pszSrc, size_t nLength, wchar_t* pszDst);
+
+        // 转换到字符串对象(复用其已有的内存)
+        static void FromWide(const wchar_t* pszSrc, size_t nLength, std::string& szDst);
+        static void ToWide(const char* pszSrc, size_t nLength, std::wstring& szDst);
+    };
+}
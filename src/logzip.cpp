@@ -0,0 +1,616 @@
+﻿#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <queue>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include "logzip.h"
+
+namespace xs
+{
+    static const unsigned int WINDOW_SIZE = 32768;      // 滑动窗口大小(最大距离)
+    static const unsigned int MIN_MATCH = 3;            // 最短匹配长度
+    static const unsigned int MAX_MATCH = 258;          // 最长匹配长度
+    static const unsigned int HASH_BITS = 15;           // 哈希表大小(位数)
+    static const unsigned int MAX_CHAIN = 32;           // 哈希链的最大查找次数
+    static const unsigned int GOOD_MATCH = 64;          // 找到该长度的匹配后不再继续查找
+    static const unsigned int LITLEN_COUNT = 286;       // 字面量/长度码个数
+    static const unsigned int FIXED_LITLEN_COUNT = 288; // 固定编码表的字面量/长度码个数(含未使用的286、287)
+    static const unsigned int DIST_COUNT = 30;          // 距离码个数
+    static const unsigned int CODELEN_COUNT = 19;       // 码长码个数
+    static const unsigned int END_OF_BLOCK = 256;       // 块结束码
+
+    // 长度码(257~285)的基础长度与附加位数
+    static const uint16_t LENGTH_BASE[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const uint8_t LENGTH_EXTRA[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    // 距离码(0~29)的基础距离与附加位数
+    static const uint16_t DIST_BASE[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const uint8_t DIST_EXTRA[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    // 码长码的写入顺序
+    static const uint8_t CODELEN_ORDER[CODELEN_COUNT] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    // 按位写入，低位在前
+    class CBitWriter
+    {
+    public:
+        explicit CBitWriter(std::string& szOut) : m_szOut(szOut) {}
+
+        void Write(uint32_t nBits, unsigned int nCount)
+        {
+            m_nBuffer |= (uint64_t)nBits << m_nCount;
+            m_nCount += nCount;
+            while (m_nCount >= 8)
+            {
+                m_szOut.push_back((char)(m_nBuffer & 0xFF));
+                m_nBuffer >>= 8;
+                m_nCount -= 8;
+            }
+        }
+
+        // 补齐到字节边界
+        void Align()
+        {
+            if (m_nCount > 0)
+            {
+                Write(0, 8 - m_nCount);
+            }
+        }
+
+    private:
+        std::string& m_szOut;
+        uint64_t m_nBuffer = 0;
+        unsigned int m_nCount = 0;
+    };
+
+    // 哈夫曼编码表：码长与按位反转后的码字(写入时低位在前)
+    struct SHuffmanCode
+    {
+        uint8_t nLengths[LITLEN_COUNT] = {};
+        uint16_t nCodes[LITLEN_COUNT] = {};
+    };
+
+    // LZ77输出的记号：字面量时nDist为0
+    struct SToken
+    {
+        uint16_t nValue;    // 字面量或匹配长度
+        uint16_t nDist;     // 匹配距离
+    };
+
+    static unsigned int LengthCode(unsigned int nLength)
+    {
+        unsigned int nCode = 0;
+        while (nCode < 28 && LENGTH_BASE[nCode + 1] <= nLength)
+        {
+            nCode++;
+        }
+        return nCode;
+    }
+
+    static unsigned int DistCode(unsigned int nDist)
+    {
+        unsigned int nCode = 0;
+        while (nCode < 29 && DIST_BASE[nCode + 1] <= nDist)
+        {
+            nCode++;
+        }
+        return nCode;
+    }
+
+    // 根据频率生成不超过nMaxBits的码长，超过时频率减半后重建
+    static void BuildLengths(const uint32_t* pFreqs, unsigned int nCount, unsigned int nMaxBits, uint8_t* pLengths)
+    {
+        std::vector<uint32_t> vFreqs(pFreqs, pFreqs + nCount);
+        while (true)
+        {
+            memset(pLengths, 0, nCount);
+            typedef std::pair<uint64_t, unsigned int> TNode;  // (频率, 节点序号)
+            std::priority_queue<TNode, std::vector<TNode>, std::greater<TNode>> Heap;
+            std::vector<int> vParents;
+            for (unsigned int i = 0; i < nCount; i++)
+            {
+                if (vFreqs[i] > 0)
+                {
+                    Heap.emplace(vFreqs[i], i);
+                }
+            }
+            if (Heap.size() <= 1)
+            {
+                // 只有一个符号时也需要1位的码
+                if (!Heap.empty())
+                {
+                    pLengths[Heap.top().second] = 1;
+                }
+                return;
+            }
+
+            // 叶子节点序号为符号值，内部节点从nCount开始编号
+            vParents.assign(nCount, -1);
+            while (Heap.size() > 1)
+            {
+                TNode First = Heap.top();
+                Heap.pop();
+                TNode Second = Heap.top();
+                Heap.pop();
+                unsigned int nNode = (unsigned int)vParents.size();
+                vParents.push_back(-1);
+                vParents[First.second] = (int)nNode;
+                vParents[Second.second] = (int)nNode;
+                Heap.emplace(First.first + Second.first, nNode);
+            }
+
+            // 内部节点的深度在其子节点之前算出(父节点序号总是更大)
+            std::vector<uint8_t> vDepths(vParents.size(), 0);
+            unsigned int nMaxLength = 0;
+            for (size_t i = vParents.size(); i-- > 0;)
+            {
+                if (vParents[i] >= 0)
+                {
+                    vDepths[i] = vDepths[vParents[i]] + 1;
+                }
+                if (i < nCount && vFreqs[i] > 0)
+                {
+                    pLengths[i] = vDepths[i];
+                    if (vDepths[i] > nMaxLength)
+                    {
+                        nMaxLength = vDepths[i];
+                    }
+                }
+            }
+            if (nMaxLength <= nMaxBits)
+            {
+                return;
+            }
+            for (auto& nFreq : vFreqs)
+            {
+                if (nFreq > 0)
+                {
+                    nFreq = (nFreq >> 1) | 1;
+                }
+            }
+        }
+    }
+
+    // 根据码长生成规范哈夫曼码(RFC 1951 3.2.2)，码字按位反转以便低位在前写入
+    static void BuildCodes(const uint8_t* pLengths, unsigned int nCount, uint16_t* pCodes)
+    {
+        unsigned int nLengthCounts[16] = {};
+        for (unsigned int i = 0; i < nCount; i++)
+        {
+            nLengthCounts[pLengths[i]]++;
+        }
+        nLengthCounts[0] = 0;
+        unsigned int nNextCodes[16] = {};
+        unsigned int nCode = 0;
+        for (unsigned int nBits = 1; nBits < 16; nBits++)
+        {
+            nCode = (nCode + nLengthCounts[nBits - 1]) << 1;
+            nNextCodes[nBits] = nCode;
+        }
+        for (unsigned int i = 0; i < nCount; i++)
+        {
+            unsigned int nLength = pLengths[i];
+            if (nLength == 0)
+            {
+                continue;
+            }
+            unsigned int nValue = nNextCodes[nLength]++;
+            unsigned int nReversed = 0;
+            for (unsigned int b = 0; b < nLength; b++)
+            {
+                nReversed = (nReversed << 1) | ((nValue >> b) & 1);
+            }
+            pCodes[i] = (uint16_t)nReversed;
+        }
+    }
+
+    // LZ77：在哈希链中查找最长匹配，生成记号序列
+    static void FindMatches(const unsigned char* pData, size_t nLength, std::vector<SToken>& vTokens)
+    {
+        const unsigned int nHashSize = 1u << HASH_BITS;
+        std::vector<int32_t> vHead(nHashSize, -1);
+        std::vector<int32_t> vPrev(WINDOW_SIZE, -1);
+        auto Hash = [pData](size_t nPos) {
+            return (((unsigned int)pData[nPos] << 10) ^ ((unsigned int)pData[nPos + 1] << 5) ^ pData[nPos + 2]) & ((1u << HASH_BITS) - 1);
+        };
+        auto Insert = [&](size_t nPos) {
+            unsigned int nHash = Hash(nPos);
+            vPrev[nPos & (WINDOW_SIZE - 1)] = vHead[nHash];
+            vHead[nHash] = (int32_t)nPos;
+        };
+
+        size_t nPos = 0;
+        while (nPos < nLength)
+        {
+            unsigned int nBestLength = 0;
+            unsigned int nBestDist = 0;
+            if (nPos + MIN_MATCH <= nLength)
+            {
+                size_t nMaxLength = nLength - nPos < MAX_MATCH ? nLength - nPos : MAX_MATCH;
+                int32_t nCandidate = vHead[Hash(nPos)];
+                for (unsigned int nChain = 0; nCandidate >= 0 && nChain < MAX_CHAIN; nChain++)
+                {
+                    size_t nDist = nPos - (size_t)nCandidate;
+                    if (nDist > WINDOW_SIZE)
+                    {
+                        break;
+                    }
+                    const unsigned char* pMatch = pData + nCandidate;
+                    if (pMatch[nBestLength] == pData[nPos + nBestLength])
+                    {
+                        size_t nMatch = 0;
+                        while (nMatch < nMaxLength && pMatch[nMatch] == pData[nPos + nMatch])
+                        {
+                            nMatch++;
+                        }
+                        if (nMatch > nBestLength)
+                        {
+                            nBestLength = (unsigned int)nMatch;
+                            nBestDist = (unsigned int)nDist;
+                            if (nMatch >= nMaxLength || nMatch >= GOOD_MATCH)
+                            {
+                                break;
+                            }
+                        }
+                    }
+                    // 窗口内的前一个位置可能已被更新的位置覆盖，链上的位置必须递减
+                    int32_t nNext = vPrev[nCandidate & (WINDOW_SIZE - 1)];
+                    if (nNext >= nCandidate)
+                    {
+                        break;
+                    }
+                    nCandidate = nNext;
+                }
+            }
+
+            if (nBestLength >= MIN_MATCH)
+            {
+                vTokens.push_back({ (uint16_t)nBestLength, (uint16_t)nBestDist });
+                size_t nEnd = nPos + nBestLength;
+                for (; nPos < nEnd; nPos++)
+                {
+                    if (nPos + MIN_MATCH <= nLength)
+                    {
+                        Insert(nPos);
+                    }
+                }
+            }
+            else
+            {
+                vTokens.push_back({ pData[nPos], 0 });
+                if (nPos + MIN_MATCH <= nLength)
+                {
+                    Insert(nPos);
+                }
+                nPos++;
+            }
+        }
+    }
+
+    // 写入记号序列与块结束码
+    static void WriteTokens(CBitWriter& Writer, const std::vector<SToken>& vTokens, const SHuffmanCode& LitLen, const SHuffmanCode& Dist)
+    {
+        for (auto& Token : vTokens)
+        {
+            if (Token.nDist == 0)
+            {
+                Writer.Write(LitLen.nCodes[Token.nValue], LitLen.nLengths[Token.nValue]);
+                continue;
+            }
+            unsigned int nLengthCode = LengthCode(Token.nValue);
+            Writer.Write(LitLen.nCodes[257 + nLengthCode], LitLen.nLengths[257 + nLengthCode]);
+            Writer.Write(Token.nValue - LENGTH_BASE[nLengthCode], LENGTH_EXTRA[nLengthCode]);
+            unsigned int nDistCode = DistCode(Token.nDist);
+            Writer.Write(Dist.nCodes[nDistCode], Dist.nLengths[nDistCode]);
+            Writer.Write(Token.nDist - DIST_BASE[nDistCode], DIST_EXTRA[nDistCode]);
+        }
+        Writer.Write(LitLen.nCodes[END_OF_BLOCK], LitLen.nLengths[END_OF_BLOCK]);
+    }
+
+    // 按编码表计算记号序列的位数(不含块头)
+    static uint64_t TokenBits(const uint32_t* pLitFreqs, const uint32_t* pDistFreqs, const SHuffmanCode& LitLen, const SHuffmanCode& Dist)
+    {
+        uint64_t nBits = 0;
+        for (unsigned int i = 0; i < LITLEN_COUNT; i++)
+        {
+            nBits += (uint64_t)pLitFreqs[i] * (LitLen.nLengths[i] + (i > END_OF_BLOCK ? LENGTH_EXTRA[i - 257] : 0));
+        }
+        for (unsigned int i = 0; i < DIST_COUNT; i++)
+        {
+            nBits += (uint64_t)pDistFreqs[i] * (Dist.nLengths[i] + DIST_EXTRA[i]);
+        }
+        return nBits;
+    }
+
+    // 写入不压缩的存储块(每块最多65535字节)
+    static void WriteStored(CBitWriter& Writer, std::string& szOut, const char* pData, size_t nLength)
+    {
+        do
+        {
+            size_t nBlock = nLength < 65535 ? nLength : 65535;
+            nLength -= nBlock;
+            Writer.Write(nLength == 0 ? 1 : 0, 1);
+            Writer.Write(0, 2);
+            Writer.Align();
+            Writer.Write((uint32_t)nBlock, 16);
+            Writer.Write((uint32_t)(~nBlock & 0xFFFF), 16);
+            szOut.append(pData, nBlock);
+            pData += nBlock;
+        } while (nLength > 0);
+    }
+
+    // 压缩为一个deflate块(动态或固定哈夫曼编码)，压缩后更大时改为存储块
+    static void Deflate(const char* pData, size_t nLength, std::string& szOut)
+    {
+        std::vector<SToken> vTokens;
+        vTokens.reserve(nLength / 4 + 16);
+        FindMatches((const unsigned char*)pData, nLength, vTokens);
+
+        uint32_t nLitFreqs[LITLEN_COUNT] = {};
+        uint32_t nDistFreqs[DIST_COUNT] = {};
+        for (auto& Token : vTokens)
+        {
+            if (Token.nDist == 0)
+            {
+                nLitFreqs[Token.nValue]++;
+            }
+            else
+            {
+                nLitFreqs[257 + LengthCode(Token.nValue)]++;
+                nDistFreqs[DistCode(Token.nDist)]++;
+            }
+        }
+        nLitFreqs[END_OF_BLOCK] = 1;
+
+        // 动态哈夫曼编码表
+        SHuffmanCode LitLen, Dist;
+        BuildLengths(nLitFreqs, LITLEN_COUNT, 15, LitLen.nLengths);
+        BuildLengths(nDistFreqs, DIST_COUNT, 15, Dist.nLengths);
+        if (vTokens.size() == 0 || std::count(Dist.nLengths, Dist.nLengths + DIST_COUNT, 0) == DIST_COUNT)
+        {
+            // 没有匹配时也至少定义一个距离码
+            Dist.nLengths[0] = 1;
+        }
+        BuildCodes(LitLen.nLengths, LITLEN_COUNT, LitLen.nCodes);
+        BuildCodes(Dist.nLengths, DIST_COUNT, Dist.nCodes);
+
+        // 码长序列按游程编码(16:重复前一个码长3~6次，17:3~10个0，18:11~138个0)
+        unsigned int nLitCount = LITLEN_COUNT;
+        while (nLitCount > 257 && LitLen.nLengths[nLitCount - 1] == 0)
+        {
+            nLitCount--;
+        }
+        unsigned int nDistCount = DIST_COUNT;
+        while (nDistCount > 1 && Dist.nLengths[nDistCount - 1] == 0)
+        {
+            nDistCount--;
+        }
+        std::vector<uint8_t> vLengths(LitLen.nLengths, LitLen.nLengths + nLitCount);
+        vLengths.insert(vLengths.end(), Dist.nLengths, Dist.nLengths + nDistCount);
+        std::vector<std::pair<uint8_t, uint8_t>> vSymbols;   // (码长码, 附加值)
+        for (size_t i = 0; i < vLengths.size();)
+        {
+            uint8_t nValue = vLengths[i];
+            size_t nRun = 1;
+            while (i + nRun < vLengths.size() && vLengths[i + nRun] == nValue)
+            {
+                nRun++;
+            }
+            i += nRun;
+            if (nValue == 0)
+            {
+                while (nRun >= 11)
+                {
+                    size_t nRepeat = nRun < 138 ? nRun : 138;
+                    vSymbols.emplace_back(18, (uint8_t)(nRepeat - 11));
+                    nRun -= nRepeat;
+                }
+                if (nRun >= 3)
+                {
+                    vSymbols.emplace_back(17, (uint8_t)(nRun - 3));
+                    nRun = 0;
+                }
+            }
+            else
+            {
+                vSymbols.emplace_back(nValue, 0);
+                nRun--;
+                while (nRun >= 3)
+                {
+                    size_t nRepeat = nRun < 6 ? nRun : 6;
+                    vSymbols.emplace_back(16, (uint8_t)(nRepeat - 3));
+                    nRun -= nRepeat;
+                }
+            }
+            while (nRun-- > 0)
+            {
+                vSymbols.emplace_back(nValue, 0);
+            }
+        }
+
+        uint32_t nCodeLenFreqs[CODELEN_COUNT] = {};
+        for (auto& Symbol : vSymbols)
+        {
+            nCodeLenFreqs[Symbol.first]++;
+        }
+        SHuffmanCode CodeLen;
+        BuildLengths(nCodeLenFreqs, CODELEN_COUNT, 7, CodeLen.nLengths);
+        if (std::count(CodeLen.nLengths, CodeLen.nLengths + CODELEN_COUNT, 0) == CODELEN_COUNT - 1)
+        {
+            // 码长码必须是完整的编码，只用到一个时补一个未使用的码
+            CodeLen.nLengths[CodeLen.nLengths[0] == 0 ? 0 : 1] = 1;
+        }
+        BuildCodes(CodeLen.nLengths, CODELEN_COUNT, CodeLen.nCodes);
+        unsigned int nCodeLenCount = CODELEN_COUNT;
+        while (nCodeLenCount > 4 && CodeLen.nLengths[CODELEN_ORDER[nCodeLenCount - 1]] == 0)
+        {
+            nCodeLenCount--;
+        }
+
+        uint64_t nDynamicBits = 3 + 5 + 5 + 4 + 3 * nCodeLenCount + TokenBits(nLitFreqs, nDistFreqs, LitLen, Dist);
+        for (auto& Symbol : vSymbols)
+        {
+            nDynamicBits += CodeLen.nLengths[Symbol.first] + (Symbol.first == 16 ? 2 : Symbol.first == 17 ? 3 : Symbol.first == 18 ? 7 : 0);
+        }
+
+        // 固定哈夫曼编码表：必须按RFC 1951 3.2.6的全部288个符号生成，
+        // 否则280~287少了两个8位码会使144~255的9位码整体错位
+        SHuffmanCode FixedLitLen, FixedDist;
+        uint8_t nFixedLengths[FIXED_LITLEN_COUNT];
+        uint16_t nFixedCodes[FIXED_LITLEN_COUNT];
+        for (unsigned int i = 0; i < FIXED_LITLEN_COUNT; i++)
+        {
+            nFixedLengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        }
+        BuildCodes(nFixedLengths, FIXED_LITLEN_COUNT, nFixedCodes);
+        std::copy(nFixedLengths, nFixedLengths + LITLEN_COUNT, FixedLitLen.nLengths);
+        std::copy(nFixedCodes, nFixedCodes + LITLEN_COUNT, FixedLitLen.nCodes);
+        for (unsigned int i = 0; i < DIST_COUNT; i++)
+        {
+            FixedDist.nLengths[i] = 5;
+        }
+        BuildCodes(FixedDist.nLengths, DIST_COUNT, FixedDist.nCodes);
+        uint64_t nFixedBits = 3 + TokenBits(nLitFreqs, nDistFreqs, FixedLitLen, FixedDist);
+
+        CBitWriter Writer(szOut);
+        uint64_t nStoredBits = ((uint64_t)nLength + 5 * (nLength / 65535 + 1)) * 8;
+        if (nLength > 0 && nStoredBits < nDynamicBits && nStoredBits < nFixedBits)
+        {
+            WriteStored(Writer, szOut, pData, nLength);
+        }
+        else if (nDynamicBits < nFixedBits)
+        {
+            Writer.Write(1, 1);
+            Writer.Write(2, 2);
+            Writer.Write(nLitCount - 257, 5);
+            Writer.Write(nDistCount - 1, 5);
+            Writer.Write(nCodeLenCount - 4, 4);
+            for (unsigned int i = 0; i < nCodeLenCount; i++)
+            {
+                Writer.Write(CodeLen.nLengths[CODELEN_ORDER[i]], 3);
+            }
+            for (auto& Symbol : vSymbols)
+            {
+                Writer.Write(CodeLen.nCodes[Symbol.first], CodeLen.nLengths[Symbol.first]);
+                if (Symbol.first >= 16)
+                {
+                    Writer.Write(Symbol.second, Symbol.first == 16 ? 2 : Symbol.first == 17 ? 3 : 7);
+                }
+            }
+            WriteTokens(Writer, vTokens, LitLen, Dist);
+        }
+        else
+        {
+            Writer.Write(1, 1);
+            Writer.Write(1, 2);
+            WriteTokens(Writer, vTokens, FixedLitLen, FixedDist);
+        }
+        Writer.Align();
+    }
+
+    uint32_t CLogGzip::Crc32(uint32_t nCrc, const char* pData, size_t nLength)
+    {
+        static const std::vector<uint32_t> vTable = []() {
+            std::vector<uint32_t> vTable(256);
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t nValue = i;
+                for (int k = 0; k < 8; k++)
+                {
+                    nValue = (nValue & 1) ? 0xEDB88320u ^ (nValue >> 1) : nValue >> 1;
+                }
+                vTable[i] = nValue;
+            }
+            return vTable;
+        }();
+
+        nCrc = ~nCrc;
+        for (size_t i = 0; i < nLength; i++)
+        {
+            nCrc = vTable[(nCrc ^ (unsigned char)pData[i]) & 0xFF] ^ (nCrc >> 8);
+        }
+        return ~nCrc;
+    }
+
+    void CLogGzip::Compress(const char* pData, size_t nLength, std::string& szOut)
+    {
+        // gzip头：魔数、deflate、无标志、无修改时间、无额外标志、NTFS
+        static const char szHeader[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 11 };
+        szOut.append(szHeader, sizeof(szHeader));
+        Deflate(pData, nLength, szOut);
+
+        // gzip尾：CRC-32与原始长度(低32位)，小端
+        uint32_t nTrailer[2] = { Crc32(0, pData, nLength), (uint32_t)nLength };
+        for (uint32_t nValue : nTrailer)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                szOut.push_back((char)((nValue >> (i * 8)) & 0xFF));
+            }
+        }
+    }
+
+    bool CLogGzip::CompressFile(const std::string& szSrcPath, const std::string& szDstPath)
+    {
+        // 限制同时压缩的文件个数
+        static std::mutex s_locker;
+        static std::condition_variable s_cvSlot;
+        static unsigned int s_nRunning = 0;
+        {
+            std::unique_lock<std::mutex> Lock(s_locker);
+            s_cvSlot.wait(Lock, [] { return s_nRunning < MAX_CONCURRENCY; });
+            s_nRunning++;
+        }
+
+        bool bSuccess = false;
+        {
+            std::ifstream ifs(szSrcPath, std::ios::binary);
+            std::ofstream ofs;
+            if (ifs)
+            {
+                ofs.open(szDstPath, std::ios::binary | std::ios::trunc);
+            }
+            if (ifs && ofs)
+            {
+                std::vector<char> vBlock(FILE_BLOCK_SIZE);
+                std::string szCompressed;
+                while (ifs)
+                {
+                    ifs.read(vBlock.data(), vBlock.size());
+                    size_t nRead = (size_t)ifs.gcount();
+                    if (nRead == 0)
+                    {
+                        break;
+                    }
+                    szCompressed.clear();
+                    Compress(vBlock.data(), nRead, szCompressed);
+                    ofs.write(szCompressed.data(), szCompressed.size());
+                }
+                bSuccess = ifs.eof() && ofs.good();
+            }
+        }
+
+        if (bSuccess)
+        {
+            remove(szSrcPath.c_str());
+        }
+        else
+        {
+            std::cout << "compress '" << szSrcPath << "' failed" << std::endl;
+            remove(szDstPath.c_str());
+        }
+
+        {
+            std::lock_guard<std::mutex> LockGuard(s_locker);
+            s_nRunning--;
+        }
+        s_cvSlot.notify_one();
+        return bSuccess;
+    }
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef XSLOG_LIB
+#define XSLOG_API
+#else
+#ifdef XSLOG_EXPORTS
+#define XSLOG_API __declspec(dllexport)
+#else
+#define XSLOG_API __declspec(dllimport)
+#endif /* XSLOG_EXPORTS */
+#endif /* XSLOG_LIB */
+
+namespace xs
+{
+    ////////////////////////////////////////////////////////////////////////
+    // 日志压缩(gzip格式，RFC 1951/1952)
+    // - 每次压缩生成一个完整的gzip成员，多个成员直接拼接仍是合法的gzip文件，可由gzip/zcat等工具解压
+    // - LZ77(哈希链)加动态哈夫曼编码，数据无法压缩时退化为固定编码或不压缩存储
+    // - 文件压缩在全进程范围内限制并发数，避免多个输出对象同时滚动时占满CPU
+    ////////////////////////////////////////////////////////////////////////
+    class XSLOG_API CLogGzip
+    {
+    public:
+        // 同时压缩文件的最大个数
+        static const unsigned int MAX_CONCURRENCY = 2;
+        // 压缩文件时每个gzip成员的数据大小
+        static const size_t FILE_BLOCK_SIZE = 1024 * 1024;
+
+        // 压缩一段数据，追加一个gzip成员到szOut
+        static void Compress(const char* pData, size_t nLength, std::string& szOut);
+
+        // 压缩文件(按块生成多个gzip成员，内存占用有限)，成功后删除源文件
+        // 已有MAX_CONCURRENCY个文件在压缩时等待
+        static bool CompressFile(const std::string& szSrcPath, const std::string& szDstPath);
+
+        // 计算CRC-32(gzip使用的多项式)
+        static uint32_t Crc32(uint32_t nCrc, const char* pData, size_t nLength);
+    };
+}
@@ -1,19 +1,94 @@
 ﻿#pragma once
 #include "logger.h"
+#include "loglimit.h"
+#include "logseg.h"
+#include "logrecorder.h"
+#include "logscope.h"
 
 #define XsSetLogLevel(eLogLevel) xs::CLogger::Inst().SetOutputLevel(eLogLevel)
+#define XsSetAsyncMode(bAsync) xs::CLogger::Inst().SetAsyncMode(bAsync)
+#define XsSetTimeFormat(ePrecision, bUtcTime) xs::CLogger::Inst().SetTimeFormat(ePrecision, bUtcTime)
+#define XsEnableLogSites(szFilePattern, eLogLevel) xs::CLogger::Inst().EnableSites(szFilePattern, eLogLevel)
+#define XsDisableLogSites(szFilePattern, eLogLevel) xs::CLogger::Inst().DisableSites(szFilePattern, eLogLevel)
 #define XsAddLogSink(ptrSink) xs::CLogger::Inst().InsertLogSink(ptrSink)
 #define XsAddConsoleSink() XsAddLogSink(std::shared_ptr<xs::CLogSink>(new xs::CConsoleSink()))
 #define XsAddSingleFileSink(szFilePrefix, bAppend) XsAddLogSink(std::shared_ptr<xs::CLogSink>(new xs::CFileSink(szFilePrefix, bAppend)))
 #define XsAddRollingFileSink(szFilePrefix, bAppend, nFileMaxSize, nFileMaxCount) XsAddLogSink(std::shared_ptr<xs::CLogSink>(new xs::CFileSink(szFilePrefix, bAppend, nFileMaxSize, nFileMaxCount)))
+#define XsAddMmapFileSink(szFilePrefix, bAppend, nFileMaxSize, nFileMaxCount) XsAddLogSink(std::shared_ptr<xs::CLogSink>(new xs::CMmapFileSink(szFilePrefix, bAppend, nFileMaxSize, nFileMaxCount)))
+#define XsAddBinaryFileSink(szFilePrefix) XsAddLogSink(std::shared_ptr<xs::CLogSink>(new xs::CBinaryFileSink(szFilePrefix)))
+#define XsAddSegmentFileSink(szFilePrefix, bAppend, nFileMaxSize, nFileMaxCount) XsAddLogSink(std::shared_ptr<xs::CLogSink>(new xs::CSegmentFileSink(szFilePrefix, bAppend, nFileMaxSize, nFileMaxCount)))
 #define XsAddNetworkSink(szHost, nPort) XsAddLogSink(std::shared_ptr<xs::CLogSink>(new xs::CNetworkSink(szHost, nPort)))
+#define XsAddFlightRecorderSink(szFilePrefix, nCapacity) XsAddLogSink(std::shared_ptr<xs::CLogSink>(new xs::CFlightRecorderSink(szFilePrefix, nCapacity)))
 #define XsAddFunctionSink(fnCallback) XsAddLogSink(std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink(fnCallback)))
 
 #define XsLogEndl xs::CLogMsg::m_sLogEndl
 
-#define XSLOGD xs::CLogger::Inst()(xs::ELogLevel::LEVEL_DEBUG, __FILEW__, __LINE__)
-#define XSLOGT xs::CLogger::Inst()(xs::ELogLevel::LEVEL_TRACE, __FILEW__, __LINE__)
-#define XSLOGI xs::CLogger::Inst()(xs::ELogLevel::LEVEL_INFO, __FILEW__, __LINE__)
-#define XSLOGW xs::CLogger::Inst()(xs::ELogLevel::LEVEL_WARNING, __FILEW__, __LINE__)
-#define XSLOGE xs::CLogger::Inst()(xs::ELogLevel::LEVEL_ERROR, __FILEW__, __LINE__)
-#define XSLOGF xs::CLogger::Inst()(xs::ELogLevel::LEVEL_FATAL, __FILEW__, __LINE__)
+// 编译期日志等级开关，低于该等级的日志语句将在编译期被整体剔除(参数表达式也不会被求值)
+// 可在包含本头文件之前或在工程预处理器定义中指定，例如 XSLOG_ACTIVE_LEVEL=XSLOG_LEVEL_INFO
+#define XSLOG_LEVEL_DEBUG   0
+#define XSLOG_LEVEL_TRACE   1
+#define XSLOG_LEVEL_INFO    2
+#define XSLOG_LEVEL_WARNING 3
+#define XSLOG_LEVEL_ERROR   4
+#define XSLOG_LEVEL_FATAL   5
+#define XSLOG_LEVEL_OFF     6
+
+#ifndef XSLOG_ACTIVE_LEVEL
+#define XSLOG_ACTIVE_LEVEL XSLOG_LEVEL_DEBUG
+#endif
+
+// 生成当前日志语句的调用点位置(编译期常量)：文件名、行号、等级与"file:line"文本(UTF-8)
+// 每个日志语句对应唯一的静态实例，可作为调用点的固定标识
+#define XSLOG_LOCATION(eLogLevel) \
+    []() -> const xs::SLogLocation& { \
+        static constexpr xs::TLogLocationText<xs::SLogLocation::RenderText(__FILEW__, __LINE__, nullptr)> Text(__FILEW__, __LINE__); \
+        static constexpr xs::SLogLocation Location = { \
+            __FILEW__ + xs::SLogLocation::FileOffset(__FILEW__), __LINE__, eLogLevel, Text.szText, sizeof(Text.szText) }; \
+        return Location; \
+    }()
+
+// 获取当前日志语句的调用点信息，首次执行时注册到全局调用点注册表，并按输出等级与调用点规则计算是否输出
+#define XSLOG_SITE(eLogLevel) \
+    []() -> const xs::SLogSite& { \
+        static const xs::SLogSite Site(XSLOG_LOCATION(eLogLevel)); \
+        return Site; \
+    }()
+
+// 延迟格式化模式：定义XSLOG_DEFERRED_FORMAT后，日志语句只记录调用点标识与参数的原始数据
+// 文本格式化由写线程完成(配合异步模式)，或使用CBinaryFileSink写入二进制文件后由xslog_decode离线还原
+#ifdef XSLOG_DEFERRED_FORMAT
+#define XSLOG_MESSAGE(Site) xs::CBinLogMsg(xs::CLogger::Inst(), Site)
+#else
+#define XSLOG_MESSAGE(Site) xs::CLogger::Inst()(Site)
+#endif
+
+// 先判断日志等级(编译期常量)，再读取调用点的输出标记(一次原子读取)，被过滤的日志不会构造日志消息，也不会对流式参数求值
+// 每个分支都带有else，可以安全地用在不带花括号的if/else语句中
+#define XSLOG_STREAM(nLevel, eLogLevel) \
+    if ((nLevel) < XSLOG_ACTIVE_LEVEL) {} \
+    else if (const xs::SLogSite& XsLogSite = XSLOG_SITE(eLogLevel); !XsLogSite.IsEnabled()) {} \
+    else xs::SLogMsgVoidify() & XSLOG_MESSAGE(XsLogSite)
+
+// 限流日志：调用点通过过滤后再由该调用点的限流器决定是否输出，被抑制的日志不会构造日志消息
+// 再次放行时在消息开头输出之前被抑制的条数，例如 [suppressed 99]
+#define XSLOG_LIMITED_STREAM(nLevel, eLogLevel, TLimiter, nParam) \
+    if ((nLevel) < XSLOG_ACTIVE_LEVEL) {} \
+    else if (const xs::SLogSite& XsLogSite = XSLOG_SITE(eLogLevel); !XsLogSite.IsEnabled()) {} \
+    else if (uint64_t XsSuppressed = 0; !([]() -> TLimiter& { static TLimiter Limiter; return Limiter; }().Allow((nParam), XsSuppressed))) {} \
+    else xs::SLogMsgVoidify() & XSLOG_MESSAGE(XsLogSite) << xs::SLogSuppressed{ XsSuppressed }
+
+// 限流日志宏，LEVEL为DEBUG/TRACE/INFO/WARNING/ERROR/FATAL，例如 XSLOG_EVERY_N(ERROR, 100) << L"retry failed";
+// LEVEL只参与记号拼接，不会被展开，因此与windows.h中的ERROR宏不冲突
+// XSLOG_EVERY_N：每N次输出一次；XSLOG_FIRST_N：只输出前N次
+// XSLOG_EVERY_T：每隔ms毫秒最多输出一次；XSLOG_RATE：令牌桶，每秒最多输出N条(允许N条的突发)
+#define XSLOG_EVERY_N(LEVEL, nCount) XSLOG_LIMITED_STREAM(XSLOG_LEVEL_##LEVEL, xs::ELogLevel::LEVEL_##LEVEL, xs::CLogEveryN, nCount)
+#define XSLOG_FIRST_N(LEVEL, nCount) XSLOG_LIMITED_STREAM(XSLOG_LEVEL_##LEVEL, xs::ELogLevel::LEVEL_##LEVEL, xs::CLogFirstN, nCount)
+#define XSLOG_EVERY_T(LEVEL, nMilliseconds) XSLOG_LIMITED_STREAM(XSLOG_LEVEL_##LEVEL, xs::ELogLevel::LEVEL_##LEVEL, xs::CLogEveryT, nMilliseconds)
+#define XSLOG_RATE(LEVEL, nPerSecond) XSLOG_LIMITED_STREAM(XSLOG_LEVEL_##LEVEL, xs::ELogLevel::LEVEL_##LEVEL, xs::CLogRate, nPerSecond)
+
+#define XSLOGD XSLOG_STREAM(XSLOG_LEVEL_DEBUG, xs::ELogLevel::LEVEL_DEBUG)
+#define XSLOGT XSLOG_STREAM(XSLOG_LEVEL_TRACE, xs::ELogLevel::LEVEL_TRACE)
+#define XSLOGI XSLOG_STREAM(XSLOG_LEVEL_INFO, xs::ELogLevel::LEVEL_INFO)
+#define XSLOGW XSLOG_STREAM(XSLOG_LEVEL_WARNING, xs::ELogLevel::LEVEL_WARNING)
+#define XSLOGE XSLOG_STREAM(XSLOG_LEVEL_ERROR, xs::ELogLevel::LEVEL_ERROR)
+#define XSLOGF XSLOG_STREAM(XSLOG_LEVEL_FATAL, xs::ELogLevel::LEVEL_FATAL)
@@ -0,0 +1,67 @@
+﻿#include <windows.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <xslog/include/xslog.hpp>
+
+#pragma comment(lib, "xslog_dll.lib")
+
+// 将二进制日志文件(CBinaryFileSink生成的.xslb文件)还原为文本日志
+// 用法：xslog_decode <input.xslb> [output.log]，不指定输出文件时输出到标准输出，编码为UTF-8
+int wmain(int argc, const wchar_t* argv[])
+{
+    if (argc < 2)
+    {
+        std::wcerr << L"usage: xslog_decode <input.xslb> [output.log]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream ifs(argv[1], std::ios::binary);
+    if (!ifs)
+    {
+        std::wcerr << L"open '" << argv[1] << L"' failed" << std::endl;
+        return 1;
+    }
+
+    std::ofstream ofs;
+    if (argc >= 3)
+    {
+        ofs.open(argv[2], std::ios::binary | std::ios::trunc);
+        if (!ofs)
+        {
+            std::wcerr << L"open '" << argv[2] << L"' failed" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& Output = ofs.is_open() ? ofs : std::cout;
+
+    // 解码出的文本日志已是UTF-8编码，直接输出
+    auto fnOutput = [&](const std::string& szLog) {
+        Output.write(szLog.data(), szLog.size());
+    };
+
+    // 分块读取，未解码完的尾部条目与下一块拼接后继续解码(默认格式：毫秒精度、本地时间)
+    xs::CLogBinDecoder Decoder;
+    std::vector<char> vBuffer;
+    std::vector<char> vChunk(1024 * 1024);
+    while (ifs)
+    {
+        ifs.read(vChunk.data(), vChunk.size());
+        vBuffer.insert(vBuffer.end(), vChunk.data(), vChunk.data() + ifs.gcount());
+
+        size_t nUsed = Decoder.Decode(vBuffer.data(), vBuffer.size(), fnOutput);
+        if (nUsed == xs::CLogBinDecoder::DECODE_ERROR)
+        {
+            std::wcerr << L"invalid binary log file: " << argv[1] << std::endl;
+            return 2;
+        }
+        vBuffer.erase(vBuffer.begin(), vBuffer.begin() + nUsed);
+    }
+
+    if (!vBuffer.empty())
+    {
+        std::wcerr << L"truncated entry at end of file (" << vBuffer.size() << L" bytes)" << std::endl;
+    }
+    Output.flush();
+    return 0;
+}
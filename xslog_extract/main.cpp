@@ -0,0 +1,105 @@
+﻿#include <windows.h>
+#include <iostream>
+#include <string>
+#include <xslog/include/xslog.hpp>
+
+#pragma comment(lib, "xslog_dll.lib")
+
+// 导出飞行记录器文件(CFlightRecorderSink生成的.xslr文件)中的日志，用于进程崩溃后查看崩溃前的最近日志
+// 用法：xslog_extract <file> [-level D|T|I|W|E|F] [-tail N] [-info]
+//      -level输出不低于该等级的日志，-tail只输出最后N条，-info只输出文件头信息，输出编码为UTF-8
+static void Usage()
+{
+    std::wcerr << L"usage: xslog_extract <file> [-level D|T|I|W|E|F] [-tail N] [-info]" << std::endl;
+}
+
+int wmain(int argc, const wchar_t* argv[])
+{
+    std::wstring szFile;
+    xs::ELogLevel eMinLevel = xs::ELogLevel::LEVEL_DEBUG;
+    size_t nTail = 0;
+    bool bInfoOnly = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::wstring szArg(argv[i]);
+        bool bHasValue = (i + 1 < argc);
+        if (szArg == L"-level" && bHasValue)
+        {
+            static const wchar_t szLevels[] = L"DTIWEF";
+            const wchar_t* pLevel = wcschr(szLevels, towupper(argv[++i][0]));
+            if (!pLevel || !*pLevel)
+            {
+                Usage();
+                return 1;
+            }
+            eMinLevel = (xs::ELogLevel)(pLevel - szLevels);
+        }
+        else if (szArg == L"-tail" && bHasValue)
+        {
+            nTail = (size_t)wcstoul(argv[++i], nullptr, 10);
+        }
+        else if (szArg == L"-info")
+        {
+            bInfoOnly = true;
+        }
+        else if (szArg[0] == L'-' || !szFile.empty())
+        {
+            Usage();
+            return 1;
+        }
+        else
+        {
+            szFile = szArg;
+        }
+    }
+    if (szFile.empty())
+    {
+        Usage();
+        return 1;
+    }
+
+    xs::CLogRecorderReader Reader;
+    if (!Reader.Open(szFile))
+    {
+        std::wcerr << L"open '" << szFile << L"' failed or not a flight recorder file" << std::endl;
+        return 2;
+    }
+
+    if (bInfoOnly)
+    {
+        char szTime[xs::CLogTime::MAX_LENGTH + 1] = { 0 };
+        xs::CLogTime::Format(Reader.CreateTime(), xs::ETimePrecision::PRECISION_MILLI, false, szTime);
+        std::cout << "process: " << Reader.ProcessId() << std::endl;
+        std::cout << "created: " << szTime << std::endl;
+        std::cout << "capacity: " << Reader.Capacity() << std::endl;
+        std::cout << "written: " << Reader.WritePosition() << std::endl;
+        return 0;
+    }
+
+    // 只输出最后N条时先统计条数，第二遍跳过之前的记录
+    size_t nSkip = 0;
+    if (nTail > 0)
+    {
+        size_t nCount = Reader.Read(eMinLevel, [](const xs::CLogRecorderReader::SRecord&) {
+            return true;
+        });
+        nSkip = nCount > nTail ? nCount - nTail : 0;
+    }
+
+    // 日志文本通常以换行结尾，截断的记录补上换行
+    size_t nIndex = 0;
+    Reader.Read(eMinLevel, [&](const xs::CLogRecorderReader::SRecord& Record) {
+        if (nIndex++ < nSkip)
+        {
+            return true;
+        }
+        std::cout.write(Record.pData, Record.nLength);
+        if (Record.pData[Record.nLength - 1] != '\n')
+        {
+            std::cout.put('\n');
+        }
+        return true;
+    });
+    std::cout.flush();
+    return 0;
+}
@@ -0,0 +1,576 @@
+﻿#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <string_view>
+#include <iostream>
+
+// x86/x64平台使用SSE2(编译器默认支持)查找换行符与右方括号
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define XSLOG_GREP_SIMD
+#endif
+
+// 查询xslog文本日志(CFileSink/CMmapFileSink生成的日志文件)
+// 日志格式：[L YYYY-MM-DD HH:MM:SS.mmm THREAD FILE:LINE] MESSAGE，不以日志前缀开头的行属于上一条日志
+// 用法：xslog_grep <prefix.log>... [-from TIME] [-to TIME] [-level D|T|I|W|E|F] [-thread TID] [-site FILE[:LINE]] [-e TEXT] [-j N] [-c]
+//      每个参数为当前日志文件，自动包含其滚动文件 prefix.log.index(按序号从旧到新，当前文件最新)，压缩文件(.gz)不支持
+//      TIME按日志中的时间文本比较，可以只写前缀，如 "2024-01-01 12:00"；-to包含该前缀表示的整段时间
+//      日志按时间顺序写入，先二分查找时间范围，再将范围内的数据分块交给多个线程并行过滤，按原顺序输出
+//      -level输出不低于该等级的日志，-e按子串过滤消息，-j指定线程数(默认为CPU核数)，-c只输出匹配条数
+
+// 查询条件
+struct SGrepQuery
+{
+    std::string szFrom;             // 起始时间前缀，为空表示不限
+    std::string szTo;               // 结束时间前缀，为空表示不限
+    int nMinLevel = 0;              // 最低等级
+    std::string szThread;           // 线程标识，为空表示不限
+    std::string szSiteFile;         // 调用点文件名，为空表示不限
+    std::string szSiteLine;         // 调用点行号，为空表示不限
+    std::string szText;             // 消息中包含的子串，为空表示不限
+    std::unique_ptr<std::boyer_moore_horspool_searcher<std::string::const_iterator>> pSearcher;
+};
+
+// 一条日志前缀的解析结果(指向映射区)
+struct SLogHeader
+{
+    int nLevel;                     // 等级序号
+    const char* pTime;              // 时间文本
+    size_t nTimeLength;
+    const char* pThread;            // 线程标识
+    size_t nThreadLength;
+    const char* pSite;              // FILE:LINE
+    size_t nSiteLength;
+    const char* pMessage;           // 消息开始位置
+};
+
+static const char LEVEL_NAMES[] = "DTIWEF";
+
+// 在[p, pEnd)中查找字符，找不到时返回pEnd
+static const char* FindByte(const char* p, const char* pEnd, char ch)
+{
+#ifdef XSLOG_GREP_SIMD
+    const __m128i Target = _mm_set1_epi8(ch);
+    for (; p + 16 <= pEnd; p += 16)
+    {
+        unsigned int nMask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), Target));
+        if (nMask != 0)
+        {
+            unsigned long nIndex = 0;
+            _BitScanForward(&nIndex, nMask);
+            return p + nIndex;
+        }
+    }
+#endif
+    const char* pFound = (const char*)memchr(p, ch, pEnd - p);
+    return pFound ? pFound : pEnd;
+}
+
+// 下一行的开始位置
+static const char* NextLine(const char* p, const char* pEnd)
+{
+    const char* pNewline = FindByte(p, pEnd, '\n');
+    return pNewline < pEnd ? pNewline + 1 : pEnd;
+}
+
+static bool IsDigit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+// 解析一行开头的日志前缀，不是日志前缀时返回false
+static bool ParseHeader(const char* p, const char* pEnd, SLogHeader& Header)
+{
+    // [L YYYY-MM-DD HH:MM:SS
+    if (pEnd - p < 24 || p[0] != '[' || p[2] != ' ' || p[7] != '-' || p[10] != '-' || p[13] != ' ' || p[16] != ':' || p[19] != ':'
+        || !IsDigit(p[3]) || !IsDigit(p[21]))
+    {
+        return false;
+    }
+    const char* pLevel = strchr(LEVEL_NAMES, p[1]);
+    if (!pLevel || !*pLevel)
+    {
+        return false;
+    }
+    Header.nLevel = (int)(pLevel - LEVEL_NAMES);
+
+    // 前缀在行内以"] "结束，开头相似但在时间戳内就结束的行(如多行日志的后续行)不是日志前缀
+    const char* pLineEnd = FindByte(p, pEnd, '\n');
+    if (pLineEnd - p < 24)
+    {
+        return false;
+    }
+    const char* pClose = FindByte(p + 23, pLineEnd, ']');
+    if (pClose == pLineEnd)
+    {
+        return false;
+    }
+
+    // 时间、线程、调用点以空格分隔
+    Header.pTime = p + 3;
+    const char* pSpace = (const char*)memchr(p + 14, ' ', pClose - (p + 14));
+    if (!pSpace)
+    {
+        return false;
+    }
+    Header.nTimeLength = pSpace - Header.pTime;
+    Header.pThread = pSpace + 1;
+    pSpace = (const char*)memchr(Header.pThread, ' ', pClose - Header.pThread);
+    if (!pSpace)
+    {
+        return false;
+    }
+    Header.nThreadLength = pSpace - Header.pThread;
+    Header.pSite = pSpace + 1;
+    Header.nSiteLength = pClose - Header.pSite;
+    Header.pMessage = (pClose + 1 < pLineEnd && pClose[1] == ' ') ? pClose + 2 : pClose + 1;
+    return true;
+}
+
+// 从p开始(p为行首)查找第一条日志的开始位置
+static const char* NextEntry(const char* p, const char* pEnd)
+{
+    SLogHeader Header;
+    while (p < pEnd && !ParseHeader(p, pEnd, Header))
+    {
+        p = NextLine(p, pEnd);
+    }
+    return p;
+}
+
+// 查找不早于pPos的第一条日志的开始位置(pPos可以不在行首)
+static const char* AlignEntry(const char* pBegin, const char* pPos, const char* pEnd)
+{
+    if (pPos <= pBegin)
+    {
+        return NextEntry(pBegin, pEnd);
+    }
+    if (pPos[-1] != '\n')
+    {
+        pPos = NextLine(pPos, pEnd);
+    }
+    return NextEntry(pPos, pEnd);
+}
+
+// 比较日志时间与时间前缀(只比较前缀长度)
+static int CompareTime(const SLogHeader& Header, const std::string& szBound)
+{
+    size_t nLength = (std::min)(Header.nTimeLength, szBound.size());
+    int nResult = memcmp(Header.pTime, szBound.data(), nLength);
+    if (nResult == 0 && Header.nTimeLength < szBound.size())
+    {
+        nResult = -1;
+    }
+    return nResult;
+}
+
+// 二分查找第一条满足条件的日志(条件随时间单调：前面的日志不满足，后面的日志满足)
+static const char* SearchEntry(const char* pBegin, const char* pEnd, const std::function<bool(const SLogHeader&)>& fnPredicate)
+{
+    size_t nLow = 0;
+    size_t nHigh = pEnd - pBegin;
+    while (nLow < nHigh)
+    {
+        size_t nMid = nLow + (nHigh - nLow) / 2;
+        const char* pEntry = AlignEntry(pBegin, pBegin + nMid, pEnd);
+        SLogHeader Header;
+        if (pEntry < pEnd && ParseHeader(pEntry, pEnd, Header) && !fnPredicate(Header))
+        {
+            nLow = nMid + 1;
+        }
+        else
+        {
+            nHigh = nMid;
+        }
+    }
+    return AlignEntry(pBegin, pBegin + nLow, pEnd);
+}
+
+// 判断一条日志是否匹配(时间范围已由二分查找确定，块边界附近的日志仍需逐条判断)
+static bool MatchEntry(const SGrepQuery& Query, const SLogHeader& Header, const char* pEntryEnd)
+{
+    if (Header.nLevel < Query.nMinLevel)
+    {
+        return false;
+    }
+    if (!Query.szFrom.empty() && CompareTime(Header, Query.szFrom) < 0)
+    {
+        return false;
+    }
+    if (!Query.szTo.empty() && CompareTime(Header, Query.szTo) > 0)
+    {
+        return false;
+    }
+    if (!Query.szThread.empty() && (Header.nThreadLength != Query.szThread.size() || 0 != memcmp(Header.pThread, Query.szThread.data(), Header.nThreadLength)))
+    {
+        return false;
+    }
+    if (!Query.szSiteFile.empty())
+    {
+        // FILE:LINE，行号为空时只比较文件名
+        const char* pColon = Header.pSite + Header.nSiteLength;
+        while (pColon > Header.pSite && pColon[-1] != ':')
+        {
+            pColon--;
+        }
+        if (pColon == Header.pSite)
+        {
+            return false;
+        }
+        size_t nFileLength = pColon - 1 - Header.pSite;
+        size_t nLineLength = Header.pSite + Header.nSiteLength - pColon;
+        if (nFileLength != Query.szSiteFile.size() || 0 != _strnicmp(Header.pSite, Query.szSiteFile.data(), nFileLength))
+        {
+            return false;
+        }
+        if (!Query.szSiteLine.empty() && (nLineLength != Query.szSiteLine.size() || 0 != memcmp(pColon, Query.szSiteLine.data(), nLineLength)))
+        {
+            return false;
+        }
+    }
+    if (Query.pSearcher)
+    {
+        std::string_view Message(Header.pMessage, pEntryEnd - Header.pMessage);
+        auto iter = std::search(Message.begin(), Message.end(), *Query.pSearcher);
+        if (iter == Message.end())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 过滤一个数据块[pBegin, pEnd)(均为日志开始位置)，匹配的日志追加到szOutput
+static size_t GrepChunk(const SGrepQuery& Query, const char* pBegin, const char* pEnd, bool bCountOnly, std::string& szOutput)
+{
+    size_t nCount = 0;
+    const char* p = pBegin;
+    while (p < pEnd)
+    {
+        SLogHeader Header;
+        ParseHeader(p, pEnd, Header);
+
+        // 日志的结束位置：下一条日志的开始位置(多行日志的后续行不是日志前缀)
+        const char* pEntryEnd = NextLine(p, pEnd);
+        SLogHeader Next;
+        while (pEntryEnd < pEnd && !ParseHeader(pEntryEnd, pEnd, Next))
+        {
+            pEntryEnd = NextLine(pEntryEnd, pEnd);
+        }
+
+        if (MatchEntry(Query, Header, pEntryEnd))
+        {
+            nCount++;
+            if (!bCountOnly)
+            {
+                szOutput.append(p, pEntryEnd);
+            }
+        }
+        p = pEntryEnd;
+    }
+    return nCount;
+}
+
+// 只读映射的日志文件
+class CMappedFile
+{
+public:
+    ~CMappedFile()
+    {
+        if (m_pView)
+        {
+            ::UnmapViewOfFile(m_pView);
+        }
+        if (m_hMapping)
+        {
+            ::CloseHandle(m_hMapping);
+        }
+        if (m_hFile != INVALID_HANDLE_VALUE)
+        {
+            ::CloseHandle(m_hFile);
+        }
+    }
+
+    // 打开并映射整个文件，空文件返回true但没有数据
+    bool Open(const std::wstring& szFilePath)
+    {
+        m_hFile = ::CreateFileW(szFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_hFile == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER nFileSize = { 0 };
+        if (!::GetFileSizeEx(m_hFile, &nFileSize) || (unsigned long long)nFileSize.QuadPart > (std::numeric_limits<size_t>::max)())
+        {
+            return false;
+        }
+        m_nSize = (size_t)nFileSize.QuadPart;
+        if (m_nSize == 0)
+        {
+            return true;
+        }
+        m_hMapping = ::CreateFileMappingW(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_hMapping)
+        {
+            m_pView = (const char*)::MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, m_nSize);
+        }
+        return m_pView != nullptr;
+    }
+
+    const char* Data() const { return m_pView; }
+    size_t Size() const { return m_pView ? m_nSize : 0; }
+
+private:
+    HANDLE m_hFile = INVALID_HANDLE_VALUE;
+    HANDLE m_hMapping = NULL;
+    const char* m_pView = nullptr;
+    size_t m_nSize = 0;
+};
+
+// 获取当前日志文件及其滚动文件，按时间从旧到新排列
+static void CollectLogFiles(const std::wstring& szLogFile, std::vector<std::wstring>& vFiles)
+{
+    size_t pos = szLogFile.find_last_of(L"/\\");
+    std::wstring szDir = (pos != std::wstring::npos) ? szLogFile.substr(0, pos + 1) : L"";
+    std::wstring szName = (pos != std::wstring::npos) ? szLogFile.substr(pos + 1) : szLogFile;
+
+    // 滚动文件的序号越大越新
+    std::vector<std::pair<unsigned long long, std::wstring>> vRolled;
+    WIN32_FIND_DATAW FindData;
+    HANDLE hFindFile = ::FindFirstFileW((szLogFile + L".*").c_str(), &FindData);
+    if (hFindFile != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            std::wstring szSuffix = std::wstring(FindData.cFileName).substr(szName.size());
+            if (szSuffix.size() > 1 && szSuffix[0] == L'.'
+                && szSuffix.find_first_not_of(L"0123456789", 1) == std::wstring::npos)
+            {
+                vRolled.emplace_back(wcstoull(szSuffix.c_str() + 1, nullptr, 10), szDir + FindData.cFileName);
+            }
+        } while (::FindNextFileW(hFindFile, &FindData));
+        ::FindClose(hFindFile);
+    }
+    std::sort(vRolled.begin(), vRolled.end());
+    for (auto& Rolled : vRolled)
+    {
+        vFiles.push_back(Rolled.second);
+    }
+    if (0 == _waccess(szLogFile.c_str(), 0))
+    {
+        vFiles.push_back(szLogFile);
+    }
+}
+
+static std::string ToUtf8(const wchar_t* pszText)
+{
+    int nLength = ::WideCharToMultiByte(CP_UTF8, 0, pszText, -1, nullptr, 0, nullptr, nullptr);
+    std::string szText(nLength > 0 ? nLength - 1 : 0, '\0');
+    if (nLength > 1)
+    {
+        ::WideCharToMultiByte(CP_UTF8, 0, pszText, -1, &szText[0], nLength, nullptr, nullptr);
+    }
+    return szText;
+}
+
+static void Usage()
+{
+    std::wcerr << L"usage: xslog_grep <prefix.log>... [-from TIME] [-to TIME] [-level D|T|I|W|E|F] [-thread TID]"
+        << L" [-site FILE[:LINE]] [-e TEXT] [-j N] [-c]" << std::endl;
+}
+
+int wmain(int argc, const wchar_t* argv[])
+{
+    SGrepQuery Query;
+    std::vector<std::wstring> vLogFiles;
+    unsigned int nThreads = std::thread::hardware_concurrency();
+    bool bCountOnly = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::wstring szArg(argv[i]);
+        bool bHasValue = (i + 1 < argc);
+        if (szArg == L"-from" && bHasValue)
+        {
+            Query.szFrom = ToUtf8(argv[++i]);
+        }
+        else if (szArg == L"-to" && bHasValue)
+        {
+            Query.szTo = ToUtf8(argv[++i]);
+        }
+        else if (szArg == L"-level" && bHasValue)
+        {
+            const char* pLevel = strchr(LEVEL_NAMES, (char)towupper(argv[++i][0]));
+            if (!pLevel || !*pLevel)
+            {
+                Usage();
+                return 1;
+            }
+            Query.nMinLevel = (int)(pLevel - LEVEL_NAMES);
+        }
+        else if (szArg == L"-thread" && bHasValue)
+        {
+            Query.szThread = ToUtf8(argv[++i]);
+        }
+        else if (szArg == L"-site" && bHasValue)
+        {
+            std::string szSite = ToUtf8(argv[++i]);
+            size_t nColon = szSite.rfind(':');
+            if (nColon != std::string::npos && nColon + 1 < szSite.size() && szSite.find_first_not_of("0123456789", nColon + 1) == std::string::npos)
+            {
+                Query.szSiteFile = szSite.substr(0, nColon);
+                Query.szSiteLine = szSite.substr(nColon + 1);
+            }
+            else
+            {
+                Query.szSiteFile = szSite;
+            }
+        }
+        else if (szArg == L"-e" && bHasValue)
+        {
+            Query.szText = ToUtf8(argv[++i]);
+        }
+        else if (szArg == L"-j" && bHasValue)
+        {
+            nThreads = (unsigned int)wcstoul(argv[++i], nullptr, 10);
+        }
+        else if (szArg == L"-c")
+        {
+            bCountOnly = true;
+        }
+        else if (szArg[0] == L'-')
+        {
+            Usage();
+            return 1;
+        }
+        else
+        {
+            CollectLogFiles(szArg, vLogFiles);
+        }
+    }
+    if (vLogFiles.empty())
+    {
+        Usage();
+        return 1;
+    }
+    if (nThreads == 0)
+    {
+        nThreads = 1;
+    }
+    if (!Query.szText.empty())
+    {
+        Query.pSearcher.reset(new std::boyer_moore_horspool_searcher<std::string::const_iterator>(Query.szText.begin(), Query.szText.end()));
+    }
+
+    // 映射所有文件，二分查找每个文件中时间范围内的数据，再切分为数据块
+    struct SChunk
+    {
+        const char* pBegin;
+        const char* pEnd;
+        std::string szOutput;
+        size_t nCount = 0;
+        bool bDone = false;
+    };
+    const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+    std::vector<std::unique_ptr<CMappedFile>> vMappedFiles;
+    std::vector<SChunk> vChunks;
+    for (auto& szFile : vLogFiles)
+    {
+        std::unique_ptr<CMappedFile> pFile(new CMappedFile());
+        if (!pFile->Open(szFile))
+        {
+            std::wcerr << L"open '" << szFile << L"' failed" << std::endl;
+            continue;
+        }
+        const char* pBegin = pFile->Data();
+        const char* pEnd = pBegin + pFile->Size();
+        const char* pFirst = NextEntry(pBegin, pEnd);
+        if (!Query.szFrom.empty())
+        {
+            pFirst = SearchEntry(pBegin, pEnd, [&Query](const SLogHeader& Header) { return CompareTime(Header, Query.szFrom) >= 0; });
+        }
+        const char* pLast = pEnd;
+        if (!Query.szTo.empty())
+        {
+            pLast = SearchEntry(pBegin, pEnd, [&Query](const SLogHeader& Header) { return CompareTime(Header, Query.szTo) > 0; });
+        }
+
+        // 数据块边界对齐到日志开始位置，多行日志不会被拆开
+        const char* pChunk = pFirst;
+        while (pChunk < pLast)
+        {
+            const char* pNext = ((size_t)(pLast - pChunk) > CHUNK_SIZE) ? AlignEntry(pBegin, pChunk + CHUNK_SIZE, pLast) : pLast;
+            SChunk Chunk;
+            Chunk.pBegin = pChunk;
+            Chunk.pEnd = pNext;
+            vChunks.push_back(std::move(Chunk));
+            pChunk = pNext;
+        }
+        vMappedFiles.push_back(std::move(pFile));
+    }
+
+    // 工作线程依次领取数据块，主线程按顺序输出已完成的数据块
+    std::atomic<size_t> nNextChunk{ 0 };
+    std::mutex locker;
+    std::condition_variable cvDone;
+    std::vector<std::thread> vWorkers;
+    for (unsigned int i = 0; i < nThreads && i < vChunks.size(); i++)
+    {
+        vWorkers.emplace_back([&]() {
+            size_t nIndex = 0;
+            while ((nIndex = nNextChunk.fetch_add(1)) < vChunks.size())
+            {
+                SChunk& Chunk = vChunks[nIndex];
+                std::string szOutput;
+                size_t nCount = GrepChunk(Query, Chunk.pBegin, Chunk.pEnd, bCountOnly, szOutput);
+                {
+                    std::lock_guard<std::mutex> LockGuard(locker);
+                    Chunk.szOutput = std::move(szOutput);
+                    Chunk.nCount = nCount;
+                    Chunk.bDone = true;
+                }
+                cvDone.notify_all();
+            }
+        });
+    }
+
+    // 输出与日志文件一致的原始字节(含换行符)
+    _setmode(_fileno(stdout), _O_BINARY);
+    size_t nTotal = 0;
+    for (auto& Chunk : vChunks)
+    {
+        std::string szOutput;
+        {
+            std::unique_lock<std::mutex> Lock(locker);
+            cvDone.wait(Lock, [&Chunk] { return Chunk.bDone; });
+            szOutput = std::move(Chunk.szOutput);
+        }
+        nTotal += Chunk.nCount;
+        fwrite(szOutput.data(), 1, szOutput.size(), stdout);
+    }
+    for (auto& Worker : vWorkers)
+    {
+        Worker.join();
+    }
+
+    if (bCountOnly)
+    {
+        printf("%zu\n", nTotal);
+    }
+    fflush(stdout);
+    return nTotal > 0 ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+﻿#include <windows.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <ctime>
+#include <xslog/include/xslog.hpp>
+
+#pragma comment(lib, "xslog_dll.lib")
+
+// 查询分段二进制日志文件(CSegmentFileSink生成的.xsls文件)，按时间范围、等级与线程过滤后输出文本日志
+// 用法：xslog_query <file>... [-from "YYYY-MM-DD HH:MM:SS"] [-to "YYYY-MM-DD HH:MM:SS"] [-level D|T|I|W|E|F] [-thread TID] [-utc] [-count]
+//      文件名支持通配符(如 app.xsls*)，多个文件按时间先后输出；时间默认为本地时间，-utc表示UTC时间
+//      -level输出不低于该等级的日志，-count只输出各等级的匹配条数，输出编码为UTF-8
+static void Usage()
+{
+    std::wcerr << L"usage: xslog_query <file>... [-from \"YYYY-MM-DD HH:MM:SS\"] [-to \"YYYY-MM-DD HH:MM:SS\"]"
+        << L" [-level D|T|I|W|E|F] [-thread TID] [-utc] [-count]" << std::endl;
+}
+
+// 解析时间参数，返回自1970-01-01 00:00:00 UTC起的纳秒数，格式不正确时返回false
+static bool ParseTime(const wchar_t* pszTime, bool bUtcTime, int64_t& nTime)
+{
+    tm m = { 0 };
+    if (6 != swscanf_s(pszTime, L"%d-%d-%d %d:%d:%d", &m.tm_year, &m.tm_mon, &m.tm_mday, &m.tm_hour, &m.tm_min, &m.tm_sec))
+    {
+        return false;
+    }
+    m.tm_year -= 1900;
+    m.tm_mon -= 1;
+    m.tm_isdst = -1;
+    time_t nSecond = bUtcTime ? _mkgmtime(&m) : mktime(&m);
+    if (nSecond == (time_t)-1)
+    {
+        return false;
+    }
+    nTime = (int64_t)nSecond * 1000000000LL;
+    return true;
+}
+
+// 展开文件名中的通配符，没有匹配的文件时原样返回
+static void ExpandFiles(const std::wstring& szPattern, std::vector<std::wstring>& vFiles)
+{
+    size_t pos = szPattern.find_last_of(L"/\\");
+    std::wstring szDir = (pos != std::wstring::npos) ? szPattern.substr(0, pos + 1) : L"";
+    WIN32_FIND_DATAW FindData;
+    HANDLE hFindFile = ::FindFirstFileW(szPattern.c_str(), &FindData);
+    if (hFindFile == INVALID_HANDLE_VALUE)
+    {
+        vFiles.push_back(szPattern);
+        return;
+    }
+    do
+    {
+        if (0 == (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        {
+            vFiles.push_back(szDir + FindData.cFileName);
+        }
+    } while (::FindNextFileW(hFindFile, &FindData));
+    ::FindClose(hFindFile);
+}
+
+int wmain(int argc, const wchar_t* argv[])
+{
+    std::vector<std::wstring> vFiles;
+    const wchar_t* pszFrom = nullptr;
+    const wchar_t* pszTo = nullptr;
+    bool bUtcTime = false;
+    bool bCountOnly = false;
+    xs::CLogSegmentReader::SQuery Query;
+    for (int i = 1; i < argc; i++)
+    {
+        std::wstring szArg(argv[i]);
+        bool bHasValue = (i + 1 < argc);
+        if (szArg == L"-from" && bHasValue)
+        {
+            pszFrom = argv[++i];
+        }
+        else if (szArg == L"-to" && bHasValue)
+        {
+            pszTo = argv[++i];
+        }
+        else if (szArg == L"-level" && bHasValue)
+        {
+            static const wchar_t szLevels[] = L"DTIWEF";
+            const wchar_t* pLevel = wcschr(szLevels, towupper(argv[++i][0]));
+            if (!pLevel || !*pLevel)
+            {
+                Usage();
+                return 1;
+            }
+            Query.eMinLevel = (xs::ELogLevel)(pLevel - szLevels);
+        }
+        else if (szArg == L"-thread" && bHasValue)
+        {
+            Query.nThreadId = (uint32_t)wcstoul(argv[++i], nullptr, 10);
+        }
+        else if (szArg == L"-utc")
+        {
+            bUtcTime = true;
+        }
+        else if (szArg == L"-count")
+        {
+            bCountOnly = true;
+        }
+        else if (szArg[0] == L'-')
+        {
+            Usage();
+            return 1;
+        }
+        else
+        {
+            ExpandFiles(szArg, vFiles);
+        }
+    }
+    if (vFiles.empty())
+    {
+        Usage();
+        return 1;
+    }
+
+    // 结束时间包含该秒内的所有日志
+    if ((pszFrom && !ParseTime(pszFrom, bUtcTime, Query.nBeginTime)) || (pszTo && !ParseTime(pszTo, bUtcTime, Query.nEndTime)))
+    {
+        std::wcerr << L"invalid time, expected \"YYYY-MM-DD HH:MM:SS\"" << std::endl;
+        return 1;
+    }
+    if (pszTo)
+    {
+        Query.nEndTime += 999999999LL;
+    }
+    xs::SBinLogFormat Format;
+    Format.bUtcTime = bUtcTime;
+
+    // 打开所有文件，按各文件的最早时间排序(滚动文件的序号与时间先后一致，当前文件最新)
+    std::vector<std::unique_ptr<xs::CLogSegmentReader>> vReaders;
+    for (auto& szFile : vFiles)
+    {
+        std::unique_ptr<xs::CLogSegmentReader> pReader(new xs::CLogSegmentReader(Format));
+        if (!pReader->Open(szFile))
+        {
+            std::wcerr << L"open '" << szFile << L"' failed or not a segment log file" << std::endl;
+            continue;
+        }
+        vReaders.push_back(std::move(pReader));
+    }
+    std::stable_sort(vReaders.begin(), vReaders.end(), [](const std::unique_ptr<xs::CLogSegmentReader>& a, const std::unique_ptr<xs::CLogSegmentReader>& b) {
+        return a->MinTime() < b->MinTime();
+    });
+
+    uint64_t nCounts[xs::XSLOG_SEG_LEVEL_COUNT] = { 0 };
+    std::string szLog;
+    for (auto& pReader : vReaders)
+    {
+        xs::CLogSegmentReader& Reader = *pReader;
+        Reader.Query(Query, [&](const xs::CLogSegmentReader::SRecord& Record) {
+            unsigned int nLevel = (unsigned int)Record.eLevel;
+            nCounts[nLevel < xs::XSLOG_SEG_LEVEL_COUNT ? nLevel : xs::XSLOG_SEG_LEVEL_COUNT - 1]++;
+            if (!bCountOnly && Reader.Format(Record, szLog))
+            {
+                std::cout.write(szLog.data(), szLog.size());
+            }
+            return true;
+        });
+    }
+
+    if (bCountOnly)
+    {
+        static const char* pszNames[xs::XSLOG_SEG_LEVEL_COUNT] = { "DEBUG", "TRACE", "INFO", "WARNING", "ERROR", "FATAL" };
+        for (unsigned int i = 0; i < xs::XSLOG_SEG_LEVEL_COUNT; i++)
+        {
+            std::cout << pszNames[i] << ": " << nCounts[i] << std::endl;
+        }
+    }
+    std::cout.flush();
+    return vReaders.empty() ? 2 : 0;
+}
@@ -1,10 +1,1643 @@
-﻿#include <windows.h>
+﻿#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
 #include <Shlwapi.h>
 #include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <crtdbg.h>
 #include <xslog/include/xslog.hpp>
+#include <xslog/include/logbuffer.h>
+#include <xslog/include/logformat.h>
+#include <xslog/include/logutf8.h>
+#include <xslog/include/logzip.h>
 
 #pragma comment(lib, "xslog_dll.lib")
 #pragma comment(lib, "shlwapi.lib")
+#pragma comment(lib, "ws2_32.lib")
+
+// 微基准：被等级过滤掉的日志语句，其开销应与一次分支判断相当
+static void BenchDisabledLevel()
+{
+    const int nLoopCount = 10000000;
+    volatile int nLimit = -1;
+
+    auto tpStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        XSLOGT << L"disabled trace: " << i << L", " << std::to_wstring(i);
+    }
+    auto tpLog = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        if (i == nLimit)
+        {
+            nLimit = i;
+        }
+    }
+    auto tpBranch = std::chrono::steady_clock::now();
+
+    double dLogNs = std::chrono::duration<double, std::nano>(tpLog - tpStart).count() / nLoopCount;
+    double dBranchNs = std::chrono::duration<double, std::nano>(tpBranch - tpLog).count() / nLoopCount;
+    XSLOGI << L"disabled statement: " << dLogNs << L" ns/op, branch: " << dBranchNs << L" ns/op";
+}
+
+// 微基准：按秒缓存的时间戳格式化与每次调用localtime_s/put_time的开销对比
+static void BenchTimestamp()
+{
+    const int nLoopCount = 1000000;
+    std::wostringstream OSStream;
+
+    auto tpStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        OSStream.str(std::wstring());
+        auto tpNow = std::chrono::system_clock::now();
+        std::time_t ctNow = std::chrono::system_clock::to_time_t(tpNow);
+        struct tm tmNow = { 0 };
+        localtime_s(&tmNow, &ctNow);
+        OSStream << std::put_time(&tmNow, L"%F %T") << L"." << std::setw(3) << std::setfill(L'0')
+            << std::chrono::duration_cast<std::chrono::milliseconds>(tpNow.time_since_epoch()).count() % 1000;
+    }
+    auto tpPutTime = std::chrono::steady_clock::now();
+    wchar_t szTime[xs::CLogTime::MAX_LENGTH];
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        xs::CLogTime::Format(xs::CLogTime::Now(), xs::ETimePrecision::PRECISION_MILLI, false, szTime);
+    }
+    auto tpCached = std::chrono::steady_clock::now();
+
+    double dPutTimeNs = std::chrono::duration<double, std::nano>(tpPutTime - tpStart).count() / nLoopCount;
+    double dCachedNs = std::chrono::duration<double, std::nano>(tpCached - tpPutTime).count() / nLoopCount;
+    XSLOGI << L"timestamp put_time: " << dPutTimeNs << L" ns/op, cached: " << dCachedNs << L" ns/op";
+}
+
+// 微基准：数值格式化内核与流对象输出(日志消息原先的输出方式)的开销对比，日志缓冲区为UTF-8，使用char版本的内核
+// 另外测量日志消息中同样输出的实际开销：低于输出等级的消息照常格式化但不输出，减去空消息的开销
+static void BenchNumericFormat()
+{
+    typedef xs::TLogFormat<char> TFormat;
+    const int nLoopCount = 1000000;
+    xs::TLogStreamBuf<char, 512> Buffer;
+    std::ostream OSStream(&Buffer);
+    double dValue = 3.14159;
+
+    auto tpStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        Buffer.Clear();
+        OSStream << i << ' ' << std::hex << i << std::dec << ' ' << dValue * i << ' ' << (const void*)&i;
+    }
+    auto tpStream = std::chrono::steady_clock::now();
+    char szText[TFormat::MAX_INTEGER_LENGTH];
+    char* pszEnd = szText + TFormat::MAX_INTEGER_LENGTH;
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        Buffer.Clear();
+        char* pszBegin = TFormat::FormatDecimal(i, pszEnd);
+        Buffer.Append(pszBegin, pszEnd - pszBegin);
+        Buffer.Append(' ');
+        pszBegin = TFormat::FormatHex(i, false, pszEnd);
+        Buffer.Append(pszBegin, pszEnd - pszBegin);
+        Buffer.Append(' ');
+        Buffer.Commit(TFormat::FormatFloat(dValue * i, false, Buffer.Reserve(TFormat::MAX_FLOAT_LENGTH)));
+        Buffer.Append(' ');
+        Buffer.Commit(TFormat::FormatPointer(&i, Buffer.Reserve(TFormat::POINTER_LENGTH)));
+    }
+    auto tpKernel = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        xs::CLogger::Inst()(xs::ELogLevel::LEVEL_DEBUG, __FILEW__, __LINE__) << i << ' ' << std::hex << i << std::dec << ' ' << dValue * i << ' ' << (const void*)&i;
+    }
+    auto tpMessage = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        xs::CLogger::Inst()(xs::ELogLevel::LEVEL_DEBUG, __FILEW__, __LINE__);
+    }
+    auto tpEmpty = std::chrono::steady_clock::now();
+
+    double dStreamNs = std::chrono::duration<double, std::nano>(tpStream - tpStart).count() / nLoopCount;
+    double dKernelNs = std::chrono::duration<double, std::nano>(tpKernel - tpStream).count() / nLoopCount;
+    double dMessageNs = std::chrono::duration<double, std::nano>((tpMessage - tpKernel) - (tpEmpty - tpMessage)).count() / nLoopCount;
+    XSLOGI << L"numeric format stream: " << dStreamNs << L" ns/op, kernel: " << dKernelNs << L" ns/op, log message: " << dMessageNs << L" ns/op";
+}
+
+// 微基准：UTF-8转码内核与Win32转码接口(两次调用，先计算长度再转换)的吞吐量对比
+static void BenchTranscode()
+{
+    const int nLoopCount = 200;
+    const std::wstring szAscii = L"[I 2024-01-01 12:00:00.000 1234 main.cpp:100] request 12345 done, status=0x00ff, user=admin\n";
+    const std::wstring szMixed = L"[I 2024-01-01 12:00:00.000 1234 main.cpp:100] 用户admin登录成功，耗时12ms\n";
+
+    for (const std::wstring* pText : { &szAscii, &szMixed })
+    {
+        // 约1MB的宽字符文本
+        std::wstring szWide;
+        while (szWide.size() * sizeof(wchar_t) < 1024 * 1024)
+        {
+            szWide += *pText;
+        }
+        std::string szUtf8;
+        std::vector<char> vNarrow(szWide.size() * xs::CLogUtf8::MAX_BYTES_PER_WCHAR);
+        std::vector<wchar_t> vWide(szWide.size() * xs::CLogUtf8::MAX_BYTES_PER_WCHAR);
+        xs::CLogUtf8::FromWide(szWide.data(), szWide.size(), szUtf8);
+
+        auto tpStart = std::chrono::steady_clock::now();
+        for (int i = 0; i < nLoopCount; i++)
+        {
+            int nBytes = ::WideCharToMultiByte(CP_UTF8, 0, szWide.data(), (int)szWide.size(), NULL, 0, NULL, NULL);
+            ::WideCharToMultiByte(CP_UTF8, 0, szWide.data(), (int)szWide.size(), vNarrow.data(), nBytes, NULL, NULL);
+            int nChars = ::MultiByteToWideChar(CP_UTF8, 0, szUtf8.data(), (int)szUtf8.size(), NULL, 0);
+            ::MultiByteToWideChar(CP_UTF8, 0, szUtf8.data(), (int)szUtf8.size(), vWide.data(), nChars);
+        }
+        auto tpWin32 = std::chrono::steady_clock::now();
+        for (int i = 0; i < nLoopCount; i++)
+        {
+            xs::CLogUtf8::FromWide(szWide.data(), szWide.size(), vNarrow.data());
+            xs::CLogUtf8::ToWide(szUtf8.data(), szUtf8.size(), vWide.data());
+        }
+        auto tpKernel = std::chrono::steady_clock::now();
+
+        double dMegaBytes = (double)(szWide.size() * sizeof(wchar_t) + szUtf8.size()) * nLoopCount / (1024 * 1024);
+        double dWin32 = dMegaBytes / std::chrono::duration<double>(tpWin32 - tpStart).count();
+        double dKernel = dMegaBytes / std::chrono::duration<double>(tpKernel - tpWin32).count();
+        XSLOGI << (pText == &szAscii ? L"transcode ascii" : L"transcode mixed") << L" win32: " << dWin32 << L" MB/s, kernel: " << dKernel << L" MB/s";
+    }
+}
+
+// 延迟格式化测试使用的日志参数：整数、浮点数、字符串与格式操作函数
+template<class TMsg>
+static void WriteDeferredArgs(TMsg&& Msg, int i)
+{
+    Msg << L"deferred args " << i << L": int=" << -i * 7 << L", float=" << i * 0.25f << L", fixed=" << std::fixed << i / 3.0
+        << L", str=" << std::string("admin") << L", wide=" << L"宽字符" << L", hex=0x" << std::hex << std::uppercase
+        << std::setw(8) << std::setfill(L'0') << ((unsigned int)i * 2654435761u >> 12);
+}
+
+// 微基准：延迟格式化模式下日志语句在调用线程上的开销(只复制参数的原始数据)，与文本格式化及等量数据的memcpy对比
+static void BenchDeferredFormat()
+{
+    const int nLoopCount = 50000;
+    const size_t nCopySize = 64;    // 与上述参数生成的二进制记录大小相近
+
+    // 异步模式下调用线程只负责生成记录并入队，队列容量大于日志条数，测量期间不会因队列已满而等待
+    xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_SHARED_QUEUE, nLoopCount + 1);
+    auto tpStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        WriteDeferredArgs(xs::CLogger::Inst()(XSLOG_SITE(xs::ELogLevel::LEVEL_INFO)), i);
+    }
+    auto tpText = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        // 与定义XSLOG_DEFERRED_FORMAT时日志宏生成的语句相同
+        WriteDeferredArgs(xs::CBinLogMsg(xs::CLogger::Inst(), XSLOG_SITE(xs::ELogLevel::LEVEL_INFO)), i);
+    }
+    auto tpDeferred = std::chrono::steady_clock::now();
+    xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_SYNC);
+
+    char szSource[nCopySize] = { 0 };
+    std::vector<char> vTarget(nCopySize * 1024);
+    auto tpCopyStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        szSource[0] = (char)i;
+        memcpy(&vTarget[(i & 1023) * nCopySize], szSource, nCopySize);
+    }
+    auto tpCopy = std::chrono::steady_clock::now();
+    volatile char chLast = vTarget[((nLoopCount - 1) & 1023) * nCopySize];
+    (void)chLast;
+
+    double dTextNs = std::chrono::duration<double, std::nano>(tpText - tpStart).count() / nLoopCount;
+    double dDeferredNs = std::chrono::duration<double, std::nano>(tpDeferred - tpText).count() / nLoopCount;
+    double dCopyNs = std::chrono::duration<double, std::nano>(tpCopy - tpCopyStart).count() / nLoopCount;
+    XSLOGI << L"call site text: " << dTextNs << L" ns/op, deferred: " << dDeferredNs << L" ns/op, memcpy("
+        << nCopySize << L" bytes): " << dCopyNs << L" ns/op";
+}
+
+// 微基准：运行期截取文件名并格式化行号与使用编译期生成的调用点位置的开销对比(不输出日志)
+static void BenchLocation()
+{
+    const int nLoopCount = 1000000;
+    auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([](const std::string&) {}));
+    XsAddLogSink(pSink);
+
+    auto tpStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        xs::CLogger::Inst()(xs::ELogLevel::LEVEL_INFO, __FILEW__, __LINE__) << i;
+    }
+    auto tpRuntime = std::chrono::steady_clock::now();
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        xs::CLogger::Inst()(XSLOG_LOCATION(xs::ELogLevel::LEVEL_INFO)) << i;
+    }
+    auto tpLocation = std::chrono::steady_clock::now();
+
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+    double dRuntimeNs = std::chrono::duration<double, std::nano>(tpRuntime - tpStart).count() / nLoopCount;
+    double dLocationNs = std::chrono::duration<double, std::nano>(tpLocation - tpRuntime).count() / nLoopCount;
+    XSLOGI << L"log line runtime location: " << dRuntimeNs << L" ns/op, compile-time location: " << dLocationNs << L" ns/op";
+}
+
+// 微基准：文件流、异步写入、异步直接写入与内存映射文件的写入吞吐量对比(直接调用输出对象)
+static void BenchFileSink(const std::wstring& szLogDir)
+{
+    const int nLoopCount = 1000000;
+    const std::string szLine = "[I 2024-01-01 12:00:00.000 1234 main.cpp:100] request 12345 done, status=0x00ff, user=admin\n";
+    const wchar_t* pszNames[] = { L"stream", L"async", L"direct", L"mmap" };
+
+    for (int nSink = 0; nSink < 4; nSink++)
+    {
+        std::wstring szPrefix = szLogDir + L"bench_" + pszNames[nSink];
+        auto tpStart = std::chrono::steady_clock::now();
+        {
+            std::unique_ptr<xs::CLogSink> pSink;
+            if (nSink < 3)
+            {
+                xs::CFileSink* pFileSink = new xs::CFileSink(szPrefix, false, 256 * 1024 * 1024, 2);
+                pFileSink->SetWriteMode((xs::EFileWriteMode)nSink);
+                pSink.reset(pFileSink);
+            }
+            else
+            {
+                pSink.reset(new xs::CMmapFileSink(szPrefix, false, 256 * 1024 * 1024, 2));
+            }
+            for (int i = 0; i < nLoopCount; i++)
+            {
+                pSink->WriteLog(szLine);
+            }
+        }
+        auto tpEnd = std::chrono::steady_clock::now();
+
+        double dMegaBytes = (double)szLine.size() * nLoopCount / (1024 * 1024);
+        double dSpeed = dMegaBytes / std::chrono::duration<double>(tpEnd - tpStart).count();
+        XSLOGI << L"file sink " << pszNames[nSink] << L": " << dSpeed << L" MB/s";
+    }
+}
+
+// 性能测试：ERROR日志写入后立即刷新并持久化，多个线程同时写入时共享持久化(组提交)
+static void BenchGroupCommit(const std::wstring& szLogDir)
+{
+    const int nThreadCount = 8;
+    const int nLoopCount = 200;
+
+    xs::SFileFlushPolicy Policy;
+    Policy.eFlushLevel = xs::ELogLevel::LEVEL_ERROR;
+    Policy.bSync = true;
+    auto pFileSink = std::make_shared<xs::CFileSink>(szLogDir + L"bench_sync", false);
+    pFileSink->SetFlushPolicy(Policy);
+    std::shared_ptr<xs::CLogSink> pSink = pFileSink;
+    XsAddLogSink(pSink);
+
+    auto tpStart = std::chrono::steady_clock::now();
+    std::vector<std::thread> vThreads;
+    for (int t = 0; t < nThreadCount; t++)
+    {
+        vThreads.emplace_back([t] {
+            for (int i = 0; i < nLoopCount; i++)
+            {
+                XSLOGE << L"durable error " << t << L"-" << i;
+            }
+        });
+    }
+    for (auto& Thread : vThreads)
+    {
+        Thread.join();
+    }
+    auto tpEnd = std::chrono::steady_clock::now();
+
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+    double dSeconds = std::chrono::duration<double>(tpEnd - tpStart).count();
+    XSLOGI << L"durable error logs: " << (nThreadCount * nLoopCount / dSeconds) << L" lines/s";
+}
+
+// 多个线程同时输出日志，返回所有日志语句的耗时(纳秒，已排序)
+static std::vector<int64_t> MeasureLogLatency(int nThreadCount, int nLoopCount)
+{
+    std::vector<std::vector<int64_t>> vLatencies(nThreadCount);
+    std::vector<std::thread> vThreads;
+    for (int t = 0; t < nThreadCount; t++)
+    {
+        vThreads.emplace_back([t, nLoopCount, &vLatencies] {
+            auto& vLatency = vLatencies[t];
+            vLatency.reserve(nLoopCount);
+            for (int i = 0; i < nLoopCount; i++)
+            {
+                auto tpStart = std::chrono::steady_clock::now();
+                XSLOGI << L"latency " << t << L"-" << i << L", user=admin, status=0x00ff";
+                vLatency.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tpStart).count());
+            }
+        });
+    }
+    for (auto& Thread : vThreads)
+    {
+        Thread.join();
+    }
+
+    std::vector<int64_t> vAll;
+    for (auto& vLatency : vLatencies)
+    {
+        vAll.insert(vAll.end(), vLatency.begin(), vLatency.end());
+    }
+    std::sort(vAll.begin(), vAll.end());
+    return vAll;
+}
+
+// 性能测试：多线程写文件日志时单条日志的延迟分布，磁盘写入不应阻塞输出日志的线程
+static void BenchLogLatency(const std::wstring& szLogDir)
+{
+    std::shared_ptr<xs::CLogSink> pSink(new xs::CFileSink(szLogDir + L"bench_latency", false));
+    XsAddLogSink(pSink);
+    std::vector<int64_t> vAll = MeasureLogLatency(4, 50000);
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+
+    XSLOGI << L"file log latency: p50 " << vAll[vAll.size() / 2] << L" ns, p99 " << vAll[vAll.size() * 99 / 100]
+        << L" ns, p999 " << vAll[vAll.size() * 999 / 1000] << L" ns, max " << vAll.back() << L" ns";
+}
+
+// 性能测试：1~64个线程同时输出日志时单条日志的延迟分布，异步模式下调用线程的延迟不应随线程数明显增长
+static void BenchAsyncLatency(const std::wstring& szLogDir)
+{
+    const int nLoopCount = 5000;
+    const xs::EAsyncMode Modes[] = { xs::EAsyncMode::MODE_SYNC, xs::EAsyncMode::MODE_SHARED_QUEUE, xs::EAsyncMode::MODE_THREAD_QUEUE };
+    const wchar_t* pszModeNames[] = { L"sync", L"shared queue", L"thread queue" };
+
+    std::shared_ptr<xs::CLogSink> pSink(new xs::CFileSink(szLogDir + L"bench_async", false));
+    XsAddLogSink(pSink);
+    for (size_t m = 0; m < _countof(Modes); m++)
+    {
+        for (int nThreadCount = 1; nThreadCount <= 64; nThreadCount *= 4)
+        {
+            xs::CLogger::Inst().SetAsyncMode(Modes[m]);
+            std::vector<int64_t> vAll = MeasureLogLatency(nThreadCount, nLoopCount);
+            xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_SYNC);
+            XSLOGI << pszModeNames[m] << L" latency, " << nThreadCount << L" threads: p50 " << vAll[vAll.size() / 2]
+                << L" ns, p99 " << vAll[vAll.size() * 99 / 100] << L" ns";
+        }
+    }
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+}
+
+// 测试：异步模式下多个线程输出的日志在停止写线程后全部送达，同一线程的日志保持输出顺序
+static void TestAsyncDelivery()
+{
+    const int nThreadCount = 8;
+    const int nLoopCount = 10000;
+    const std::string szTest = "async delivery ";
+    std::vector<int> vNext(nThreadCount, 0);
+    int nReceived = 0;
+    bool bOrdered = true;
+    // 异步模式下只有写线程调用输出对象
+    auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([&](const std::string& szLog) {
+        size_t nPos = szLog.find(szTest);
+        if (nPos != std::string::npos)
+        {
+            size_t nIndexPos = 0;
+            int t = std::stoi(szLog.substr(nPos + szTest.size()), &nIndexPos);
+            int i = std::stoi(szLog.substr(nPos + szTest.size() + nIndexPos + 1));
+            bOrdered = bOrdered && t >= 0 && t < nThreadCount && vNext[t] == i;
+            vNext[t] = i + 1;
+            nReceived++;
+        }
+    }));
+    XsAddLogSink(pSink);
+
+    // 队列容量远小于日志条数，覆盖队列已满时的等待
+    xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_SHARED_QUEUE, 1024);
+    std::vector<std::thread> vThreads;
+    for (int t = 0; t < nThreadCount; t++)
+    {
+        vThreads.emplace_back([t] {
+            for (int i = 0; i < nLoopCount; i++)
+            {
+                XSLOGI << L"async delivery " << t << L"-" << i;
+            }
+        });
+    }
+    for (auto& Thread : vThreads)
+    {
+        Thread.join();
+    }
+    // 切换回同步模式时停止写线程，并输出队列中剩余的日志
+    xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_SYNC);
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+    XSLOGI << L"async delivered: " << nReceived << L", dropped: " << xs::CLogger::Inst().DroppedCount()
+        << (nReceived == nThreadCount * nLoopCount && bOrdered ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试：生产者写日志期间反复切换异步模式，切换前已进入旧队列或正在入队的日志不丢失
+static void TestAsyncModeSwitch()
+{
+    const int nThreadCount = 4;
+    const int nLoopCount = 20000;
+    const std::string szTest = "mode switch ";
+    std::mutex Locker;
+    int nReceived = 0;
+    // 同步模式下由生产者线程直接调用输出对象，需要加锁计数
+    auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([&](const std::string& szLog) {
+        if (szLog.find(szTest) != std::string::npos)
+        {
+            std::lock_guard<std::mutex> LockGuard(Locker);
+            nReceived++;
+        }
+    }));
+    XsAddLogSink(pSink);
+
+    std::atomic<int> nRunning(nThreadCount);
+    std::vector<std::thread> vThreads;
+    for (int t = 0; t < nThreadCount; t++)
+    {
+        vThreads.emplace_back([t, &nRunning] {
+            for (int i = 0; i < nLoopCount; i++)
+            {
+                XSLOGI << L"mode switch " << t << L"-" << i;
+            }
+            nRunning--;
+        });
+    }
+    const xs::EAsyncMode eModes[] = { xs::EAsyncMode::MODE_SHARED_QUEUE, xs::EAsyncMode::MODE_SYNC, xs::EAsyncMode::MODE_THREAD_QUEUE };
+    int nSwitchCount = 0;
+    while (nRunning > 0)
+    {
+        // 每种模式保持一小段时间，让生产者在各模式下都有日志入队
+        xs::CLogger::Inst().SetAsyncMode(eModes[nSwitchCount++ % _countof(eModes)], 256);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    for (auto& Thread : vThreads)
+    {
+        Thread.join();
+    }
+    xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_SYNC);
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+    XSLOGI << L"mode switch delivered: " << nReceived << L", switches: " << nSwitchCount
+        << (nReceived == nThreadCount * nLoopCount ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试：线程独占队列模式下多个线程的日志按时间顺序合并输出，线程退出后其队列被回收
+static void TestThreadQueue()
+{
+    const int nWaveCount = 4;
+    const int nThreadCount = 8;
+    const int nLoopCount = 200;
+    std::string szLastTime;
+    int nReceived = 0;
+    bool bOrdered = true;
+    // 异步模式下只有写线程调用输出对象，时间戳为"YYYY-MM-DD HH:MM:SS.nnnnnnnnn"，按字符串比较即按时间比较
+    // 输出对象收到的第一条日志之前带有引导信息，时间戳从日志所在行的行首开始
+    auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([&](const std::string& szLog) {
+        size_t nPos = szLog.find("] thread queue ");
+        if (nPos != std::string::npos)
+        {
+            size_t nLineStart = szLog.rfind('\n', nPos) + 1;
+            std::string szTime = szLog.substr(nLineStart + 3, 29);
+            bOrdered = bOrdered && szTime >= szLastTime;
+            szLastTime = szTime;
+            nReceived++;
+        }
+    }));
+    XsAddLogSink(pSink);
+    XsSetTimeFormat(xs::ETimePrecision::PRECISION_NANO, false);
+    xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_THREAD_QUEUE);
+    size_t nBaseCount = xs::CLogger::Inst().ThreadQueueCount();
+
+    // 多批短生命周期的线程交替输出日志，日志语句之间互斥，使各线程日志的先后顺序(即时间戳顺序)是确定的
+    std::mutex Locker;
+    size_t nPeakCount = 0;
+    for (int w = 0; w < nWaveCount; w++)
+    {
+        std::vector<std::thread> vThreads;
+        for (int t = 0; t < nThreadCount; t++)
+        {
+            vThreads.emplace_back([t, &Locker, &nPeakCount] {
+                for (int i = 0; i < nLoopCount; i++)
+                {
+                    std::lock_guard<std::mutex> LockGuard(Locker);
+                    XSLOGI << L"thread queue " << t << L"-" << i;
+                }
+                // 线程退出前其队列一定处于注册状态
+                std::lock_guard<std::mutex> LockGuard(Locker);
+                nPeakCount = (std::max)(nPeakCount, xs::CLogger::Inst().ThreadQueueCount());
+            });
+        }
+        for (auto& Thread : vThreads)
+        {
+            Thread.join();
+        }
+    }
+
+    // 写线程在所有队列取空后回收已退出线程的队列(空闲时最多等待一个刷新周期)
+    size_t nQueueCount = xs::CLogger::Inst().ThreadQueueCount();
+    for (int i = 0; i < 100 && nQueueCount > nBaseCount; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        nQueueCount = xs::CLogger::Inst().ThreadQueueCount();
+    }
+    xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_SYNC);
+    XsSetTimeFormat(xs::ETimePrecision::PRECISION_MILLI, false);
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+    XSLOGI << L"thread queue received: " << nReceived << L", queues: " << nPeakCount << L" -> " << nQueueCount
+        << (nReceived == nWaveCount * nThreadCount * nLoopCount && bOrdered && nPeakCount > nBaseCount && nQueueCount == nBaseCount
+            ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试：日志文件按大小与时间滚动，只保留限定个数的文件
+static void TestRollFiles(const std::wstring& szLogDir)
+{
+    const unsigned short nFileMaxCount = 3;
+    {
+        xs::CFileSink Sink(szLogDir + L"test_roll", true, 64 * 1024, nFileMaxCount);
+        Sink.SetRollInterval(xs::ERollInterval::ROLL_DAILY);
+        for (int i = 0; i < 20000; i++)
+        {
+            Sink.WriteLog("roll test line " + std::to_string(i) + "\n");
+        }
+    }
+
+    // 超出个数限制的文件由后台线程删除，Sink析构时已删除完毕
+    int nFileCount = 0;
+    WIN32_FIND_DATAW FindData;
+    HANDLE hFindFile = ::FindFirstFileW((szLogDir + L"test_roll.log*").c_str(), &FindData);
+    if (hFindFile != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            nFileCount++;
+        } while (::FindNextFileW(hFindFile, &FindData));
+        ::FindClose(hFindFile);
+    }
+    XSLOGI << L"roll files: " << nFileCount << (nFileCount == nFileMaxCount ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试用的deflate解码器：按RFC 1951独立实现(参照zlib的puff)，用于校验CLogGzip的压缩结果
+class CTestInflater
+{
+public:
+    CTestInflater(const std::string& szData, size_t nPos) : m_szData(szData), m_nPos(nPos)
+    {
+    }
+
+    // 解码从当前位置开始的一个gzip成员，校验CRC-32与原始长度，解码出的数据追加到szOut
+    bool InflateMember(std::string& szOut)
+    {
+        if (m_nPos + 10 > m_szData.size() || m_szData.compare(m_nPos, 3, "\x1f\x8b\x08", 3) != 0 || m_szData[m_nPos + 3] != 0)
+        {
+            return false;
+        }
+        m_nPos += 10;
+        size_t nStart = szOut.size();
+        int nFinal = 0;
+        do
+        {
+            nFinal = Bits(1);
+            int nType = Bits(2);
+            if (nFinal < 0 || nType < 0 || nType == 3)
+            {
+                return false;
+            }
+            m_nBlockTypes |= 1u << nType;
+            bool bSuccess = (nType == 0 ? Stored(szOut) : nType == 1 ? Fixed(szOut) : Dynamic(szOut));
+            if (!bSuccess)
+            {
+                return false;
+            }
+        } while (nFinal == 0);
+
+        // gzip尾部按字节对齐
+        m_nBitBuffer = 0;
+        m_nBitCount = 0;
+        if (m_nPos + 8 > m_szData.size())
+        {
+            return false;
+        }
+        uint32_t nTrailer[2] = {};
+        for (int i = 0; i < 8; i++)
+        {
+            nTrailer[i / 4] |= (uint32_t)(unsigned char)m_szData[m_nPos++] << ((i % 4) * 8);
+        }
+        size_t nLength = szOut.size() - nStart;
+        return nTrailer[0] == xs::CLogGzip::Crc32(0, szOut.data() + nStart, nLength) && nTrailer[1] == (uint32_t)nLength;
+    }
+
+    // 是否已解码到数据末尾
+    bool AtEnd() const
+    {
+        return m_nPos == m_szData.size();
+    }
+
+    // 遇到过的块类型(位0:存储 位1:固定编码 位2:动态编码)
+    unsigned int BlockTypes() const
+    {
+        return m_nBlockTypes;
+    }
+
+private:
+    // 规范哈夫曼码：各码长的码字个数与按码字排序的符号
+    struct SHuffman
+    {
+        short nCounts[16];
+        short nSymbols[288];
+    };
+
+    // 读取nCount位(低位在前)，数据不足时返回-1
+    int Bits(int nCount)
+    {
+        uint32_t nValue = m_nBitBuffer;
+        while (m_nBitCount < nCount)
+        {
+            if (m_nPos >= m_szData.size())
+            {
+                return -1;
+            }
+            nValue |= (uint32_t)(unsigned char)m_szData[m_nPos++] << m_nBitCount;
+            m_nBitCount += 8;
+        }
+        m_nBitBuffer = nValue >> nCount;
+        m_nBitCount -= nCount;
+        return (int)(nValue & ((1u << nCount) - 1));
+    }
+
+    // 存储块：丢弃剩余的位，按字节读取长度及其反码
+    bool Stored(std::string& szOut)
+    {
+        m_nBitBuffer = 0;
+        m_nBitCount = 0;
+        if (m_nPos + 4 > m_szData.size())
+        {
+            return false;
+        }
+        unsigned int nLength = (unsigned char)m_szData[m_nPos] | ((unsigned char)m_szData[m_nPos + 1] << 8);
+        unsigned int nComplement = (unsigned char)m_szData[m_nPos + 2] | ((unsigned char)m_szData[m_nPos + 3] << 8);
+        m_nPos += 4;
+        if (nLength != (~nComplement & 0xFFFF) || m_nPos + nLength > m_szData.size())
+        {
+            return false;
+        }
+        szOut.append(m_szData, m_nPos, nLength);
+        m_nPos += nLength;
+        return true;
+    }
+
+    // 由码长生成解码表，码长超额订阅时失败(不完整的编码是允许的)
+    static bool Build(SHuffman& Huffman, const short* pLengths, int nCount)
+    {
+        std::fill(Huffman.nCounts, Huffman.nCounts + 16, (short)0);
+        for (int i = 0; i < nCount; i++)
+        {
+            Huffman.nCounts[pLengths[i]]++;
+        }
+        int nLeft = 1;
+        for (int nBits = 1; nBits < 16; nBits++)
+        {
+            nLeft = (nLeft << 1) - Huffman.nCounts[nBits];
+            if (nLeft < 0)
+            {
+                return false;
+            }
+        }
+        short nOffsets[16] = {};
+        for (int nBits = 1; nBits < 15; nBits++)
+        {
+            nOffsets[nBits + 1] = nOffsets[nBits] + Huffman.nCounts[nBits];
+        }
+        for (int i = 0; i < nCount; i++)
+        {
+            if (pLengths[i] != 0)
+            {
+                Huffman.nSymbols[nOffsets[pLengths[i]]++] = (short)i;
+            }
+        }
+        return true;
+    }
+
+    // 逐位解码一个符号，失败时返回-1
+    int Decode(const SHuffman& Huffman)
+    {
+        int nCode = 0;
+        int nFirst = 0;
+        int nIndex = 0;
+        for (int nBits = 1; nBits < 16; nBits++)
+        {
+            int nBit = Bits(1);
+            if (nBit < 0)
+            {
+                return -1;
+            }
+            nCode |= nBit;
+            int nCount = Huffman.nCounts[nBits];
+            if (nCode - nCount < nFirst)
+            {
+                return Huffman.nSymbols[nIndex + (nCode - nFirst)];
+            }
+            nIndex += nCount;
+            nFirst = (nFirst + nCount) << 1;
+            nCode <<= 1;
+        }
+        return -1;
+    }
+
+    // 按字面量/长度码表与距离码表解码数据，直到块结束码
+    bool Codes(std::string& szOut, const SHuffman& LitLen, const SHuffman& Dist)
+    {
+        static const short nLengthBase[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const short nLengthExtra[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const short nDistBase[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const short nDistExtra[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+        for (;;)
+        {
+            int nSymbol = Decode(LitLen);
+            if (nSymbol < 0)
+            {
+                return false;
+            }
+            if (nSymbol < 256)
+            {
+                szOut.push_back((char)nSymbol);
+                continue;
+            }
+            if (nSymbol == 256)
+            {
+                return true;
+            }
+            nSymbol -= 257;
+            if (nSymbol >= 29)
+            {
+                return false;
+            }
+            int nLengthBits = Bits(nLengthExtra[nSymbol]);
+            int nDistSymbol = Decode(Dist);
+            if (nLengthBits < 0 || nDistSymbol < 0 || nDistSymbol >= 30)
+            {
+                return false;
+            }
+            int nDistBits = Bits(nDistExtra[nDistSymbol]);
+            if (nDistBits < 0)
+            {
+                return false;
+            }
+            size_t nLength = nLengthBase[nSymbol] + nLengthBits;
+            size_t nDist = nDistBase[nDistSymbol] + nDistBits;
+            if (nDist > szOut.size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < nLength; i++)
+            {
+                szOut.push_back(szOut[szOut.size() - nDist]);
+            }
+        }
+    }
+
+    // 固定哈夫曼编码块(RFC 1951 3.2.6)
+    bool Fixed(std::string& szOut)
+    {
+        short nLengths[288 + 30];
+        for (int i = 0; i < 288; i++)
+        {
+            nLengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+        }
+        std::fill(nLengths + 288, nLengths + 288 + 30, (short)5);
+        SHuffman LitLen, Dist;
+        Build(LitLen, nLengths, 288);
+        Build(Dist, nLengths + 288, 30);
+        return Codes(szOut, LitLen, Dist);
+    }
+
+    // 动态哈夫曼编码块(RFC 1951 3.2.7)
+    bool Dynamic(std::string& szOut)
+    {
+        static const int nOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        int nLitCount = Bits(5);
+        int nDistCount = Bits(5);
+        int nCodeCount = Bits(4);
+        if (nLitCount < 0 || nDistCount < 0 || nCodeCount < 0)
+        {
+            return false;
+        }
+        nLitCount += 257;
+        nDistCount += 1;
+        nCodeCount += 4;
+        if (nLitCount > 286 || nDistCount > 30)
+        {
+            return false;
+        }
+
+        short nLengths[286 + 30] = {};
+        for (int i = 0; i < nCodeCount; i++)
+        {
+            int nLength = Bits(3);
+            if (nLength < 0)
+            {
+                return false;
+            }
+            nLengths[nOrder[i]] = (short)nLength;
+        }
+        SHuffman CodeLen;
+        if (!Build(CodeLen, nLengths, 19))
+        {
+            return false;
+        }
+
+        int nIndex = 0;
+        while (nIndex < nLitCount + nDistCount)
+        {
+            int nSymbol = Decode(CodeLen);
+            if (nSymbol < 0)
+            {
+                return false;
+            }
+            if (nSymbol < 16)
+            {
+                nLengths[nIndex++] = (short)nSymbol;
+                continue;
+            }
+            short nLength = 0;
+            int nRepeat = 0;
+            if (nSymbol == 16)
+            {
+                if (nIndex == 0)
+                {
+                    return false;
+                }
+                nLength = nLengths[nIndex - 1];
+                nRepeat = Bits(2) + 3;
+            }
+            else
+            {
+                nRepeat = (nSymbol == 17 ? Bits(3) + 3 : Bits(7) + 11);
+            }
+            if (nRepeat < 3 || nIndex + nRepeat > nLitCount + nDistCount)
+            {
+                return false;
+            }
+            while (nRepeat-- > 0)
+            {
+                nLengths[nIndex++] = nLength;
+            }
+        }
+
+        SHuffman LitLen, Dist;
+        if (nLengths[256] == 0 || !Build(LitLen, nLengths, nLitCount) || !Build(Dist, nLengths + nLitCount, nDistCount))
+        {
+            return false;
+        }
+        return Codes(szOut, LitLen, Dist);
+    }
+
+    const std::string& m_szData;
+    size_t m_nPos;
+    uint32_t m_nBitBuffer = 0;
+    int m_nBitCount = 0;
+    unsigned int m_nBlockTypes = 0;
+};
+
+// 测试：日志文件压缩，滚动后压缩的文件为 .index.gz，写入时压缩的当前文件即为 .gz
+static void TestCompress(const std::wstring& szLogDir)
+{
+    const xs::ECompressMode eModes[] = { xs::ECompressMode::COMPRESS_ROLLED, xs::ECompressMode::COMPRESS_LIVE };
+    const wchar_t* pszNames[] = { L"test_zip_rolled", L"test_zip_live" };
+    for (int m = 0; m < 2; m++)
+    {
+        {
+            xs::CFileSink Sink(szLogDir + pszNames[m], true, 64 * 1024, 3);
+            Sink.SetCompressMode(eModes[m]);
+            for (int i = 0; i < 50000; i++)
+            {
+                Sink.WriteLog("compress test line " + std::to_string(i) + "\n");
+            }
+        }
+
+        // 压缩由后台线程完成，Sink析构时已压缩完毕
+        int nFileCount = 0;
+        int nZipCount = 0;
+        WIN32_FIND_DATAW FindData;
+        HANDLE hFindFile = ::FindFirstFileW((szLogDir + pszNames[m] + L".log*").c_str(), &FindData);
+        if (hFindFile != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                std::wstring szName(FindData.cFileName);
+                nFileCount++;
+                if (szName.size() > 3 && szName.compare(szName.size() - 3, 3, L".gz") == 0)
+                {
+                    nZipCount++;
+                }
+            } while (::FindNextFileW(hFindFile, &FindData));
+            ::FindClose(hFindFile);
+        }
+        int nExpected = (m == 0 ? nFileCount - 1 : nFileCount);
+        XSLOGI << pszNames[m] << L" files: " << nFileCount << L", gz: " << nZipCount << (nZipCount == nExpected ? L" (PASS)" : L" (FAIL)");
+    }
+
+    // 往返校验：压缩后由独立的解码器解压，结果应与原始数据完全一致，且覆盖存储、固定编码、动态编码三种块类型
+    std::string szLines;
+    for (int i = 0; i < 2000; i++)
+    {
+        szLines += "[INFO 2026-10-18 12:00:00.000 1234 main.cpp:100] compress round trip " + std::to_string(i) + "\n";
+    }
+    std::string szRandom(xs::CLogGzip::FILE_BLOCK_SIZE + 100000, '\0');
+    uint32_t nSeed = 12345;
+    for (char& c : szRandom)
+    {
+        nSeed = nSeed * 1103515245 + 12345;
+        c = (char)(nSeed >> 24);
+    }
+    const std::string szInputs[] = {
+        szLines,
+        "\xe6\x97\xa5\xe5\xbf\x97 UTF-8 \xc3\xa9\xc3\xbf message\n",
+        std::string(),
+        std::string(1, '\xe9'),
+        std::string(100000, 'a'),
+        szRandom,
+    };
+    const wchar_t* pszInputNames[] = { L"ascii", L"utf8", L"empty", L"1 byte", L"repetitive", L"random" };
+    unsigned int nBlockTypes = 0;
+    for (size_t i = 0; i < _countof(szInputs); i++)
+    {
+        std::string szZipped;
+        xs::CLogGzip::Compress(szInputs[i].data(), szInputs[i].size(), szZipped);
+        std::string szUnzipped;
+        CTestInflater Inflater(szZipped, 0);
+        bool bSuccess = Inflater.InflateMember(szUnzipped) && Inflater.AtEnd() && szUnzipped == szInputs[i];
+        nBlockTypes |= Inflater.BlockTypes();
+        XSLOGI << L"gzip round trip " << pszInputNames[i] << L": " << szInputs[i].size() << L" -> " << szZipped.size()
+            << L" block types " << Inflater.BlockTypes() << (bSuccess ? L" (PASS)" : L" (FAIL)");
+    }
+    XSLOGI << L"gzip block types: " << nBlockTypes << (nBlockTypes == 7 ? L" (PASS)" : L" (FAIL)");
+
+    // 文件压缩超过FILE_BLOCK_SIZE时生成多个gzip成员，依次解压后应与源文件一致(CompressFile使用ANSI路径)
+    char szAnsiDir[MAX_PATH] = { 0 };
+    ::WideCharToMultiByte(CP_ACP, 0, szLogDir.c_str(), -1, szAnsiDir, MAX_PATH, NULL, NULL);
+    std::string szSrcPath = std::string(szAnsiDir) + "test_zip_file.log";
+    std::string szSource;
+    while (szSource.size() <= xs::CLogGzip::FILE_BLOCK_SIZE * 2)
+    {
+        szSource += szLines;
+    }
+    {
+        std::ofstream ofs(szSrcPath, std::ios::binary | std::ios::trunc);
+        ofs.write(szSource.data(), szSource.size());
+    }
+    bool bCompressed = xs::CLogGzip::CompressFile(szSrcPath, szSrcPath + ".gz");
+    std::ifstream ifs(szSrcPath + ".gz", std::ios::binary);
+    std::string szZipped((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    std::string szUnzipped;
+    CTestInflater Inflater(szZipped, 0);
+    int nMemberCount = 0;
+    while (!Inflater.AtEnd() && Inflater.InflateMember(szUnzipped))
+    {
+        nMemberCount++;
+    }
+    XSLOGI << L"gzip file round trip: " << szSource.size() << L" -> " << szZipped.size() << L", members: " << nMemberCount
+        << (bCompressed && Inflater.AtEnd() && nMemberCount == 3 && szUnzipped == szSource ? L" (PASS)" : L" (FAIL)");
+}
+
+// 查找匹配的文件中名称最大的一个(非追加模式的文件名带有进程标识与时间戳，即最新生成的文件)，未找到时返回空字符串
+static std::wstring FindLatestFile(const std::wstring& szPattern)
+{
+    WIN32_FIND_DATAW FindData;
+    HANDLE hFindFile = ::FindFirstFileW(szPattern.c_str(), &FindData);
+    if (hFindFile == INVALID_HANDLE_VALUE)
+    {
+        return std::wstring();
+    }
+    std::wstring szFileName(FindData.cFileName);
+    while (::FindNextFileW(hFindFile, &FindData))
+    {
+        szFileName = (std::wstring(FindData.cFileName) > szFileName) ? FindData.cFileName : szFileName;
+    }
+    ::FindClose(hFindFile);
+    return szFileName;
+}
+
+// 测试：分段二进制日志文件，按等级与时间范围查询
+static void TestSegmentFile(const std::wstring& szLogDir)
+{
+    {
+        xs::CSegmentFileSink Sink(szLogDir + L"test_segment", false, 0, 0, 64 * 1024);
+        for (int i = 0; i < 20000; i++)
+        {
+            const char* pszLevel = (i % 100 == 0) ? "E" : "I";
+            Sink.WriteLog(std::string("[") + pszLevel + " 2024-01-01 12:00:" + (i < 10000 ? "00" : "01") + ".000 1 main.cpp:1] segment test " + std::to_string(i) + "\n");
+        }
+    }
+
+    std::wstring szFileName = FindLatestFile(szLogDir + L"test_segment_*.xsls");
+    if (szFileName.empty())
+    {
+        XSLOGE << L"segment file not found (FAIL)";
+        return;
+    }
+
+    xs::CLogSegmentReader Reader;
+    if (!Reader.Open(szLogDir + szFileName))
+    {
+        XSLOGE << L"open segment file failed (FAIL)";
+        return;
+    }
+    xs::CLogSegmentReader::SQuery Query;
+    Query.eMinLevel = xs::ELogLevel::LEVEL_ERROR;
+    Query.nBeginTime = Reader.MinTime() + 1000000000LL;
+    size_t nCount = Reader.Query(Query, [](const xs::CLogSegmentReader::SRecord&) { return true; });
+    XSLOGI << L"segments: " << Reader.SegmentCount() << L", errors in second half: " << nCount << (nCount == 100 ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试：延迟格式化的二进制日志记录经CLogBinDecoder还原后，与直接格式化的文本日志一致
+static void TestDeferredFormat(const std::wstring& szLogDir)
+{
+    const int nLoopCount = 100;
+    const std::string szTest = "] deferred args ";
+
+    // 二进制日志记录写入二进制文件
+    {
+        auto pBinarySink = std::make_shared<xs::CBinaryFileSink>(szLogDir + L"test_deferred");
+        XsAddLogSink(pBinarySink);
+        for (int i = 0; i < nLoopCount; i++)
+        {
+            WriteDeferredArgs(xs::CBinLogMsg(xs::CLogger::Inst(), XSLOG_SITE(xs::ELogLevel::LEVEL_INFO)), i);
+        }
+        xs::CLogger::Inst().RemoveLogSink(pBinarySink);
+    }
+
+    // 相同参数的文本日志
+    std::vector<std::string> vTexts;
+    auto pTextSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([&vTexts, &szTest](const std::string& szLog) {
+        size_t nPos = szLog.find(szTest);
+        if (nPos != std::string::npos)
+        {
+            vTexts.push_back(szLog.substr(nPos + 2));
+        }
+    }));
+    XsAddLogSink(pTextSink);
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        WriteDeferredArgs(xs::CLogger::Inst()(XSLOG_SITE(xs::ELogLevel::LEVEL_INFO)), i);
+    }
+    xs::CLogger::Inst().RemoveLogSink(pTextSink);
+
+    // 解码二进制文件，逐条比较消息内容(时间戳与调用点不同)
+    std::vector<std::string> vDecoded;
+    std::wstring szFileName = FindLatestFile(szLogDir + L"test_deferred_*.xslb");
+    std::ifstream ifs(szLogDir + szFileName, std::ios::binary);
+    std::string szData((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    xs::CLogBinDecoder Decoder;
+    size_t nUsed = Decoder.Decode(szData.data(), szData.size(), [&vDecoded, &szTest](const std::string& szLog) {
+        size_t nPos = szLog.find(szTest);
+        if (nPos != std::string::npos)
+        {
+            vDecoded.push_back(szLog.substr(nPos + 2));
+        }
+    });
+    XSLOGI << L"deferred decoded: " << vDecoded.size() << L", text: " << vTexts.size()
+        << (!szFileName.empty() && nUsed == szData.size() && vDecoded.size() == (size_t)nLoopCount && vDecoded == vTexts ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试：后台写入跟不上时按溢出策略丢弃新日志，ERROR日志不丢弃，丢弃标记写入文件
+static void TestOverflow(const std::wstring& szLogDir)
+{
+    const int nLoopCount = 100000;
+    std::wstring szFileName = szLogDir + L"test_overflow.log";
+    ::DeleteFileW(szFileName.c_str());
+    uint64_t nDropped = 0;
+    {
+        xs::CFileSink Sink(szLogDir + L"test_overflow", true, 256 * 1024 * 1024, 2);
+        xs::SFileFlushPolicy FlushPolicy;
+        FlushPolicy.nPendingLimit = 1;
+        Sink.SetFlushPolicy(FlushPolicy);
+        xs::SOverflowPolicy Overflow;
+        Overflow.ePolicy = xs::EOverflowPolicy::OVERFLOW_DROP_NEWEST;
+        Sink.SetOverflowPolicy(Overflow);
+        for (int i = 0; i < nLoopCount; i++)
+        {
+            xs::ELogLevel eLevel = (i % 100 == 0) ? xs::ELogLevel::LEVEL_ERROR : xs::ELogLevel::LEVEL_INFO;
+            Sink.WriteLog("[I 2024-01-01 12:00:00.000 1 main.cpp:1] overflow test " + std::to_string(i) + "\n", eLevel);
+        }
+        nDropped = Sink.DroppedCount();
+    }
+
+    // 写入的日志条数 + 丢弃条数 = 总条数，丢弃标记中的条数之和不超过丢弃条数
+    std::ifstream ifs(szFileName);
+    std::string szLine;
+    uint64_t nWritten = 0;
+    uint64_t nErrors = 0;
+    uint64_t nMarked = 0;
+    const std::string szTest = "overflow test ";
+    while (std::getline(ifs, szLine))
+    {
+        size_t nPos = szLine.find(szTest);
+        if (nPos != std::string::npos)
+        {
+            nWritten++;
+            nErrors += (std::stoi(szLine.substr(nPos + szTest.size())) % 100 == 0) ? 1 : 0;
+        }
+        else if ((nPos = szLine.find("] ")) != std::string::npos && szLine.find(" messages dropped") != std::string::npos)
+        {
+            nMarked += std::stoull(szLine.substr(nPos + 2));
+        }
+    }
+    XSLOGI << L"overflow written: " << nWritten << L", dropped: " << nDropped << L", marked: " << nMarked
+        << (nWritten + nDropped == nLoopCount && nErrors == nLoopCount / 100 && nMarked <= nDropped ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试：异步队列已满时按溢出策略丢弃日志，ERROR日志不丢弃，写线程为丢弃的日志输出丢弃标记(WARNING)
+static void TestQueueOverflow()
+{
+    const int nThreadCount = 4;
+    const int nLoopCount = 2000;
+    const int nTotal = nThreadCount * nLoopCount;
+    const xs::EOverflowPolicy Policies[] = { xs::EOverflowPolicy::OVERFLOW_DROP_NEWEST, xs::EOverflowPolicy::OVERFLOW_DROP_OLDEST,
+        xs::EOverflowPolicy::OVERFLOW_DROP_BELOW_LEVEL };
+    const wchar_t* pszNames[] = { L"drop newest", L"drop oldest", L"drop below level" };
+
+    for (size_t p = 0; p < _countof(Policies); p++)
+    {
+        std::atomic<int> nReceived(0);
+        std::atomic<int> nErrors(0);
+        std::atomic<uint64_t> nMarked(0);
+        std::atomic_bool bMarkerLevel(true);
+        // 输出对象写入较慢(忙等待，Sleep的精度不足)，生产者很快填满队列
+        // 丢弃最旧的日志时生产者会直接输出从队列中取出的ERROR日志，因此使用原子计数
+        auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([&](const std::string& szLog) {
+            auto tpEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+            while (std::chrono::steady_clock::now() < tpEnd)
+            {
+            }
+            size_t nLineStart = szLog.rfind('\n', szLog.size() - 2) + 1;
+            size_t nPos = szLog.find("] ", nLineStart);
+            if (szLog.find("] queue overflow ", nLineStart) != std::string::npos)
+            {
+                nReceived++;
+                nErrors += (szLog[nLineStart + 1] == 'E') ? 1 : 0;
+            }
+            else if (nPos != std::string::npos && szLog.find(" messages dropped", nPos) != std::string::npos)
+            {
+                nMarked += std::stoull(szLog.substr(nPos + 2));
+                bMarkerLevel = bMarkerLevel && szLog[nLineStart + 1] == 'W';
+            }
+        }));
+        XsAddLogSink(pSink);
+        xs::SOverflowPolicy Overflow;
+        Overflow.ePolicy = Policies[p];
+        xs::CLogger::Inst().SetOverflowPolicy(Overflow);
+        xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_SHARED_QUEUE, 64);
+        uint64_t nDropped = xs::CLogger::Inst().DroppedCount();
+
+        std::vector<std::thread> vThreads;
+        for (int t = 0; t < nThreadCount; t++)
+        {
+            vThreads.emplace_back([t] {
+                for (int i = 0; i < nLoopCount; i++)
+                {
+                    if (i % 100 == 0)
+                    {
+                        XSLOGE << L"queue overflow " << t << L"-" << i;
+                    }
+                    else
+                    {
+                        XSLOGI << L"queue overflow " << t << L"-" << i;
+                    }
+                }
+            });
+        }
+        for (auto& Thread : vThreads)
+        {
+            Thread.join();
+        }
+        // 停止写线程前输出队列中剩余的日志与最后一条丢弃标记
+        xs::CLogger::Inst().SetAsyncMode(xs::EAsyncMode::MODE_SYNC);
+        nDropped = xs::CLogger::Inst().DroppedCount() - nDropped;
+        xs::CLogger::Inst().RemoveLogSink(pSink);
+
+        // 输出条数 + 丢弃条数 = 总条数，丢弃标记中的条数之和等于丢弃条数
+        XSLOGI << pszNames[p] << L" received: " << nReceived.load() << L", dropped: " << nDropped << L", marked: " << nMarked.load()
+            << (nReceived + nDropped == (uint64_t)nTotal && nErrors == nTotal / 100 && nDropped > 0 && nMarked == nDropped && bMarkerLevel
+                ? L" (PASS)" : L" (FAIL)");
+    }
+    xs::CLogger::Inst().SetOverflowPolicy(xs::SOverflowPolicy());
+}
+
+// 测试：飞行记录器环形覆盖最旧的记录，低于输出等级的调试日志只进入记录器
+static void TestFlightRecorder(const std::wstring& szLogDir)
+{
+    const int nLoopCount = 10000;
+    std::wstring szFilePrefix = szLogDir + L"test_recorder";
+    auto pSink = std::make_shared<xs::CFlightRecorderSink>(szFilePrefix, 64 * 1024);
+    XsAddLogSink(pSink);
+    for (int i = 0; i < nLoopCount; i++)
+    {
+        XSLOGD << L"recorder test " << i;
+    }
+
+    // 从旧到新读取：序号连续递增，最后一条存在，最早的记录已被覆盖
+    xs::CLogRecorderReader Reader;
+    bool bOpened = Reader.Open(szFilePrefix + L".xslr");
+    const std::string szTest = "recorder test ";
+    int nFirst = -1;
+    int nLast = -1;
+    bool bOrdered = true;
+    Reader.Read(xs::ELogLevel::LEVEL_DEBUG, [&](const xs::CLogRecorderReader::SRecord& Record) {
+        std::string szLog(Record.pData, Record.nLength);
+        size_t nPos = szLog.find(szTest);
+        if (nPos != std::string::npos)
+        {
+            int nIndex = std::stoi(szLog.substr(nPos + szTest.size()));
+            bOrdered = bOrdered && (nLast < 0 || nIndex == nLast + 1) && Record.eLevel == xs::ELogLevel::LEVEL_DEBUG;
+            nFirst = nFirst < 0 ? nIndex : nFirst;
+            nLast = nIndex;
+        }
+        return true;
+    });
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+    XSLOGI << L"recorder first: " << nFirst << L", last: " << nLast
+        << (bOpened && bOrdered && nFirst > 0 && nLast == nLoopCount - 1 ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试：日志作用域正常结束时丢弃调试日志，出错或标记时在错误日志之前输出缓存的调试日志
+static void TestLogScope()
+{
+    std::vector<std::string> vLines;
+    auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([&vLines](const std::string& szLog) {
+        if (szLog.find("scope test") != std::string::npos || szLog.find("] scope req-") != std::string::npos)
+        {
+            vLines.push_back(szLog);
+        }
+    }));
+    XsAddLogSink(pSink);
+    {
+        xs::CLogScope Scope("req-1");
+        for (int i = 0; i < 100; i++)
+        {
+            XSLOGD << L"scope test discarded " << i;
+        }
+    }
+    size_t nDiscarded = vLines.size();
+    {
+        xs::CLogScope Scope("req-2");
+        XSLOGD << L"scope test context 1";
+        XSLOGT << L"scope test context 2";
+        XSLOGE << L"scope test error";
+        XSLOGD << L"scope test after error";
+    }
+    bool bErrorOk = vLines.size() == 5 && vLines[0].find("] scope req-2: 2 buffered messages") != std::string::npos
+        && vLines[1].find("context 1") != std::string::npos && vLines[3].find("error") != std::string::npos;
+    {
+        xs::CLogScope Scope("req-3");
+        XSLOGD << L"scope test marked";
+        Scope.Mark();
+    }
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+    XSLOGI << L"scope discarded: " << nDiscarded << L", lines: " << vLines.size()
+        << (nDiscarded == 0 && bErrorOk && vLines.size() == 7 ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试：输出日志期间反复添加、删除输出对象，已有输出对象不丢日志，输出线程不被阻塞
+static void TestSinkChurn()
+{
+    const int nThreadCount = 4;
+    const int nLoopCount = 2000;
+    std::atomic<int> nReceived(0);
+    auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([&nReceived](const std::string& szLog) {
+        if (szLog.find("sink churn ") != std::string::npos)
+        {
+            nReceived++;
+        }
+    }));
+    XsAddLogSink(pSink);
+
+    std::atomic_bool bStop(false);
+    int nChurnCount = 0;
+    std::thread Churn([&bStop, &nChurnCount] {
+        while (!bStop)
+        {
+            auto pTemp = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([](const std::string&) {}));
+            XsAddLogSink(pTemp);
+            xs::CLogger::Inst().RemoveLogSink(pTemp);
+            nChurnCount++;
+        }
+    });
+    std::vector<std::thread> vThreads;
+    for (int t = 0; t < nThreadCount; t++)
+    {
+        vThreads.emplace_back([] {
+            for (int i = 0; i < nLoopCount; i++)
+            {
+                XSLOGI << L"sink churn " << i;
+            }
+        });
+    }
+    for (auto& Thread : vThreads)
+    {
+        Thread.join();
+    }
+    bStop = true;
+    Churn.join();
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+    XSLOGI << L"sink churn received: " << nReceived.load() << L", sink changes: " << nChurnCount
+        << (nReceived == nThreadCount * nLoopCount && nChurnCount > 0 ? L" (PASS)" : L" (FAIL)");
+}
+
+// 接收数据，最多等待nTimeout毫秒，返回接收的字节数，超时或出错时返回0
+static int RecvTimeout(SOCKET hSocket, char* pBuffer, int nSize, int nTimeout)
+{
+    fd_set ReadFds;
+    FD_ZERO(&ReadFds);
+    FD_SET(hSocket, &ReadFds);
+    timeval Timeout = { nTimeout / 1000, (nTimeout % 1000) * 1000 };
+    if (::select((int)hSocket + 1, &ReadFds, nullptr, nullptr, &Timeout) <= 0)
+    {
+        return 0;
+    }
+    int nLength = ::recv(hSocket, pBuffer, nSize, 0);
+    return nLength > 0 ? nLength : 0;
+}
+
+// 从TCP连接接收日志帧(4字节网络字节序长度 + 日志文本)，直到收到nCount条或超时
+static std::vector<std::string> RecvFrames(SOCKET hSocket, size_t nCount)
+{
+    std::vector<std::string> vLogs;
+    std::string szData;
+    char szBuffer[4096];
+    while (vLogs.size() < nCount)
+    {
+        int nLength = RecvTimeout(hSocket, szBuffer, sizeof(szBuffer), 3000);
+        if (nLength == 0)
+        {
+            break;
+        }
+        szData.append(szBuffer, nLength);
+        size_t nOffset = 0;
+        while (szData.size() - nOffset >= 4)
+        {
+            uint32_t nFrameLength = 0;
+            memcpy(&nFrameLength, szData.data() + nOffset, 4);
+            nFrameLength = ::ntohl(nFrameLength);
+            if (szData.size() - nOffset - 4 < nFrameLength)
+            {
+                break;
+            }
+            vLogs.push_back(szData.substr(nOffset + 4, nFrameLength));
+            nOffset += 4 + nFrameLength;
+        }
+        szData.erase(0, nOffset);
+    }
+    return vLogs;
+}
+
+// 绑定本地回环地址的任意端口(TCP不监听，连接会被拒绝)，返回套接字与端口
+static SOCKET BindLoopback(int nType, unsigned short& nPort)
+{
+    SOCKET hSocket = ::socket(AF_INET, nType, 0);
+    sockaddr_in Addr = { 0 };
+    Addr.sin_family = AF_INET;
+    Addr.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    socklen_t nAddrLength = sizeof(Addr);
+    ::bind(hSocket, (sockaddr*)&Addr, sizeof(Addr));
+    ::getsockname(hSocket, (sockaddr*)&Addr, &nAddrLength);
+    nPort = ::ntohs(Addr.sin_port);
+    return hSocket;
+}
+
+// 测试：网络输出，监听端先不可用，验证缓存、重连、对端关闭后重连、缓存溢出丢弃与UDP打包
+static void TestNetworkSink()
+{
+    WSADATA WsaData;
+    ::WSAStartup(MAKEWORD(2, 2), &WsaData);
+    xs::SNetworkPolicy Policy;
+    Policy.nReconnectMin = 50;
+    Policy.nReconnectMax = 200;
+
+    unsigned short nPort = 0;
+    SOCKET hListen = BindLoopback(SOCK_STREAM, nPort);
+    {
+        xs::CNetworkSink Sink("127.0.0.1", nPort);
+        Sink.SetNetworkPolicy(Policy);
+        for (int i = 0; i < 1000; i++)
+        {
+            Sink.WriteLog("network test " + std::to_string(i) + "\n");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        bool bOffline = !Sink.IsConnected();
+
+        // 开始监听后，重连成功并按顺序收到未连接期间缓存的日志
+        ::listen(hListen, 1);
+        SOCKET hClient = ::accept(hListen, nullptr, nullptr);
+        std::vector<std::string> vLogs = RecvFrames(hClient, 1000);
+        bool bInOrder = (vLogs.size() == 1000);
+        for (size_t i = 0; bInOrder && i < vLogs.size(); i++)
+        {
+            bInOrder = (vLogs[i] == "network test " + std::to_string(i) + "\n");
+        }
+        XSLOGI << L"network spooled: " << vLogs.size() << (bOffline && bInOrder ? L" (PASS)" : L" (FAIL)");
+
+        // 对端关闭连接后，空闲检查发现断开并重连
+        ::closesocket(hClient);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+        for (int i = 0; i < 100; i++)
+        {
+            Sink.WriteLog("network reconnect " + std::to_string(i) + "\n");
+        }
+        hClient = ::accept(hListen, nullptr, nullptr);
+        vLogs = RecvFrames(hClient, 100);
+        XSLOGI << L"network reconnected: " << vLogs.size() << L", sent: " << Sink.SentCount() << (vLogs.size() == 100 ? L" (PASS)" : L" (FAIL)");
+        ::closesocket(hClient);
+    }
+    ::closesocket(hListen);
+
+    // 缓存溢出：未连接期间只保留最新的日志，其余计入丢弃条数，缓存恢复后先发送丢弃标记
+    hListen = BindLoopback(SOCK_STREAM, nPort);
+    {
+        Policy.nSpoolSize = 1024;
+        xs::SOverflowPolicy Overflow;
+        Overflow.ePolicy = xs::EOverflowPolicy::OVERFLOW_DROP_OLDEST;
+        xs::CNetworkSink Sink("127.0.0.1", nPort);
+        Sink.SetNetworkPolicy(Policy);
+        Sink.SetOverflowPolicy(Overflow);
+        for (int i = 0; i < 1000; i++)
+        {
+            Sink.WriteLog("network drop " + std::to_string(i) + "\n");
+        }
+        uint64_t nDropped = Sink.DroppedCount();
+        ::listen(hListen, 1);
+        SOCKET hClient = ::accept(hListen, nullptr, nullptr);
+        std::vector<std::string> vLogs = RecvFrames(hClient, 1000 - (size_t)nDropped);
+        bool bNewest = !vLogs.empty() && vLogs.back() == "network drop 999\n";
+        Sink.WriteLog("network drop tail\n");
+        std::vector<std::string> vTail = RecvFrames(hClient, 2);
+        std::string szMarker = " " + std::to_string(nDropped) + " messages dropped\n";
+        bool bMarked = vTail.size() == 2 && vTail[0].size() > szMarker.size()
+            && vTail[0].compare(vTail[0].size() - szMarker.size(), szMarker.size(), szMarker) == 0 && vTail[1] == "network drop tail\n";
+        XSLOGI << L"network dropped: " << nDropped << L", received: " << vLogs.size()
+            << (bNewest && bMarked && vLogs.size() + nDropped == 1000 ? L" (PASS)" : L" (FAIL)");
+        ::closesocket(hClient);
+    }
+    ::closesocket(hListen);
+
+    // UDP：多条日志打包为不超过数据报大小限制的数据报
+    SOCKET hReceiver = BindLoopback(SOCK_DGRAM, nPort);
+    {
+        xs::SNetworkPolicy UdpPolicy;
+        UdpPolicy.eProtocol = xs::ENetProtocol::PROTOCOL_UDP;
+        xs::CNetworkSink Sink("127.0.0.1", nPort, xs::ENetProtocol::PROTOCOL_UDP);
+        Sink.SetNetworkPolicy(UdpPolicy);
+        for (int i = 0; i < 300; i++)
+        {
+            Sink.WriteLog("network udp " + std::to_string(i) + "\n");
+        }
+        int nDatagramCount = 0;
+        int nLineCount = 0;
+        bool bSizeOk = true;
+        char szBuffer[65536];
+        int nLength = 0;
+        while (nLineCount < 300 && (nLength = RecvTimeout(hReceiver, szBuffer, sizeof(szBuffer), 3000)) > 0)
+        {
+            nDatagramCount++;
+            nLineCount += (int)std::count(szBuffer, szBuffer + nLength, '\n');
+            bSizeOk = bSizeOk && (size_t)nLength <= UdpPolicy.nDatagramSize;
+        }
+        XSLOGI << L"network udp lines: " << nLineCount << L", datagrams: " << nDatagramCount
+            << (nLineCount == 300 && bSizeOk && nDatagramCount < nLineCount ? L" (PASS)" : L" (FAIL)");
+    }
+    ::closesocket(hReceiver);
+
+    ::WSACleanup();
+}
+
+// 测试：按调用点开启调试日志，不影响全局输出等级
+static void TestSiteFilter()
+{
+    // 收集输出对象收到的日志消息(输出对象收到的第一条日志之前带有引导信息，只解析最后一行)
+    std::vector<std::string> vMessages;
+    auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([&vMessages](const std::string& szLog) {
+        size_t nLineStart = szLog.rfind('\n', szLog.size() - 2) + 1;
+        size_t nPos = szLog.find("] ", nLineStart);
+        if (nPos != std::string::npos && szLog.compare(nPos + 2, 7, "site - ") == 0)
+        {
+            vMessages.push_back(szLog.substr(nPos + 9, szLog.size() - nPos - 10));
+        }
+    }));
+    XsAddLogSink(pSink);
+
+    // 全局等级为INFO：启用规则之前的调试日志被过滤，启用之后输出
+    for (int i = 0; i < 2; i++)
+    {
+        XSLOGD << L"site - site debug " << i;
+        XsEnableLogSites(L"main.cpp", xs::ELogLevel::LEVEL_DEBUG);
+    }
+    XsDisableLogSites(L"main.cpp", xs::ELogLevel::LEVEL_INFO);
+    XSLOGI << L"site - site info";
+    xs::CLogger::Inst().ClearSiteRules();
+    XSLOGD << L"site - global debug";
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+
+    XSLOGI << L"site filter messages: " << vMessages.size()
+        << (vMessages.size() == 1 && vMessages[0] == "site debug 1" ? L" (PASS)" : L" (FAIL)");
+}
+
+// 测试：限流日志宏，被抑制的日志在再次放行时报告条数
+static void TestRateLimit()
+{
+    // 按消息名称记录每条放行的日志：序号与报告的被抑制条数(输出对象收到的第一条日志之前带有引导信息，只解析最后一行)
+    std::map<std::string, std::vector<std::pair<int, uint64_t>>> mapLines;
+    auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([&mapLines](const std::string& szLog) {
+        size_t nLineStart = szLog.rfind('\n', szLog.size() - 2) + 1;
+        size_t nPos = szLog.find("] ", nLineStart);
+        if (nPos == std::string::npos)
+        {
+            return;
+        }
+        std::string szMsg = szLog.substr(nPos + 2);
+        uint64_t nSuppressed = 0;
+        if (szMsg.compare(0, 12, "[suppressed ") == 0)
+        {
+            nSuppressed = std::stoull(szMsg.substr(12));
+            szMsg = szMsg.substr(szMsg.find("] ") + 2);
+        }
+        size_t nColon = szMsg.find(": ");
+        if (nColon != std::string::npos)
+        {
+            mapLines[szMsg.substr(0, nColon)].emplace_back(std::stoi(szMsg.substr(nColon + 2)), nSuppressed);
+        }
+    }));
+    XsAddLogSink(pSink);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        XSLOG_EVERY_N(WARNING, 300) << L"every 300: " << i;
+        XSLOG_FIRST_N(INFO, 2) << L"first 2: " << i;
+    }
+
+    auto tpStart = std::chrono::steady_clock::now();
+    for (int i = 0; std::chrono::steady_clock::now() - tpStart < std::chrono::milliseconds(1500); i++)
+    {
+        XSLOG_EVERY_T(ERROR, 500) << L"every 500ms: " << i;
+        XSLOG_RATE(ERROR, 2) << L"2 per second: " << i;
+    }
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+
+    // 单线程调用时，每条放行日志报告的被抑制条数等于与上一条放行日志之间的调用次数
+    bool bSuppressedOk = true;
+    for (auto& Item : mapLines)
+    {
+        auto& vLines = Item.second;
+        for (size_t k = 0; k < vLines.size(); k++)
+        {
+            int nExpected = (k == 0) ? vLines[k].first : vLines[k].first - vLines[k - 1].first - 1;
+            bSuppressedOk = bSuppressedOk && vLines[k].second == (uint64_t)nExpected;
+        }
+    }
+    // 1000次调用中每300次放行1条；1.5秒内每500毫秒的窗口放行1条；令牌桶开始时可突发2条，之后每500毫秒补充1条
+    size_t nEveryN = mapLines["every 300"].size();
+    size_t nFirstN = mapLines["first 2"].size();
+    size_t nEveryT = mapLines["every 500ms"].size();
+    size_t nRate = mapLines["2 per second"].size();
+    XSLOGI << L"rate limit lines: " << nEveryN << L", " << nFirstN << L", " << nEveryT << L", " << nRate
+        << (nEveryN == 4 && nFirstN == 2 && nEveryT == 3 && nRate == 4 && bSuppressedOk ? L" (PASS)" : L" (FAIL)");
+}
+
+#ifdef _DEBUG
+// 内存分配计数(调试版CRT的分配钩子对所有使用同一CRT的模块生效，包括xslog_dll)
+static std::atomic<long> g_nAllocCount(0);
+
+static int AllocCountHook(int nAllocType, void*, size_t, int, long, const unsigned char*, int)
+{
+    if (nAllocType == _HOOK_ALLOC || nAllocType == _HOOK_REALLOC)
+    {
+        g_nAllocCount++;
+    }
+    return TRUE;
+}
+
+// 测试：常规长度的日志语句(同步模式)不应产生任何堆内存分配
+static void TestNoAllocation()
+{
+    auto pSink = std::shared_ptr<xs::CLogSink>(new xs::CFunctionSink([](const std::wstring&) {}));
+    XsAddLogSink(pSink);
+
+    const int nLoopCount = 1000;
+    long nAllocCount = 0;
+    for (int nRound = 0; nRound < 2; nRound++)
+    {
+        // 第一轮用于预热(线程内复用的缓存、日志引导信息等)
+        g_nAllocCount = 0;
+        auto pfnOldHook = _CrtSetAllocHook(AllocCountHook);
+        for (int i = 0; i < nLoopCount; i++)
+        {
+            XSLOGI << "request " << i << L" done, status=0x" << std::hex << std::setw(4) << std::setfill(L'0') << 255
+                << std::dec << ", user=" << std::string("admin");
+        }
+        _CrtSetAllocHook(pfnOldHook);
+        nAllocCount = g_nAllocCount;
+    }
+
+    xs::CLogger::Inst().RemoveLogSink(pSink);
+    XSLOGI << L"allocations for " << nLoopCount << L" log lines: " << nAllocCount << (nAllocCount == 0 ? L" (PASS)" : L" (FAIL)");
+}
+#endif
 
 int main(int argc, const char* argv[])
 {
@@ -13,8 +1646,43 @@ int main(int argc, const char* argv[])
     ::PathAppend(Path, L"..\\log\\xslog");
 
     XsSetLogLevel(xs::ELogLevel::LEVEL_INFO);
+#ifdef _DEBUG
+    TestNoAllocation();
+#endif
     XsAddSingleFileSink(Path, true);
 
+    BenchDisabledLevel();
+    BenchTimestamp();
+    BenchNumericFormat();
+    BenchTranscode();
+    BenchLocation();
+    BenchDeferredFormat();
+    std::wstring szLogDir(Path);
+    szLogDir = szLogDir.substr(0, szLogDir.find_last_of(L"\\/") + 1);
+    BenchFileSink(szLogDir);
+    BenchGroupCommit(szLogDir);
+    BenchLogLatency(szLogDir);
+    BenchAsyncLatency(szLogDir);
+    TestAsyncDelivery();
+    TestAsyncModeSwitch();
+    TestThreadQueue();
+    TestRollFiles(szLogDir);
+    TestCompress(szLogDir);
+    TestSegmentFile(szLogDir);
+    TestDeferredFormat(szLogDir);
+    TestOverflow(szLogDir);
+    TestQueueOverflow();
+    TestFlightRecorder(szLogDir);
+    TestLogScope();
+    TestSinkChurn();
+    TestNetworkSink();
+    TestSiteFilter();
+    TestRateLimit();
+
+    XsSetTimeFormat(xs::ETimePrecision::PRECISION_MICRO, true);
+    XSLOGI << L"UTC时间，微秒精度";
+    XsSetTimeFormat(xs::ETimePrecision::PRECISION_MILLI, false);
+
     XSLOGI << "我是main: " << L"龍龖龘𪚥";
     XSLOGW << L"我是main[0x" << std::hex << std::uppercase << std::setw(8) << std::setfill(L'0') << 55296 << "]";
     XSLOGE << L"我是main[0xD800 = " << 55296 << "]";